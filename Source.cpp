@@ -1,41 +1,202 @@
 #include <iostream>
 #include <string>
-#include <chrono>
-#include <opencv2\opencv.hpp>
-#include <opencv2\core.hpp>
-#include <opencv2\highgui.hpp>
-#include <opencv2\videoio.hpp>
-
-extern "C" {
-#include "vc.h"
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "vc.hpp"
+
+
+// Mostra o tempo decorrido desde vc_context_timer_start()
+void vc_timer(VCCONTEXT* ctx) {
+	// Tempo em segundos.
+	double nseconds = vc_context_timer_elapsed(ctx);
+
+	std::cout << "Tempo decorrido: " << nseconds << "segundos" << std::endl;
+	std::cout << "Pressione qualquer tecla para continuar...\n";
+	std::cin.get();
 }
 
 
-void vc_timer(void) {
-	static bool running = false;
-	static std::chrono::steady_clock::time_point previousTime = std::chrono::steady_clock::now();
+// +++++++++++++++++++++++++
+// Leitura antecipada: uma thread descodifica o vdeo e converte as frames (BGR -> RGB -> HSV)  frente
+// do processamento, para um anel de PREFETCH_DEPTH frames (vc_prefetch)
+// +++++++++++++++++++++++++
 
-	if (!running) {
-		running = true;
+#define PREFETCH_DEPTH 4	// Frames descodificadas  frente da frame em processamento
+
+struct VideoSource {
+	cv::VideoCapture* capture;
+	cv::Mat frame;
+};
+
+// Corre na thread de descodificao: l a frame seguinte e copia-a para a IVC do anel
+static int video_decode(void* arg, IVC* image) {
+	VideoSource* source = (VideoSource*)arg;
+
+	if (!source->capture->read(source->frame) || source->frame.empty()) return 0;
+	if ((source->frame.cols != image->width) || (source->frame.rows != image->height) || (source->frame.type() != CV_8UC3)) return -1;
+
+	// As linhas da IVC esto alinhadas e podem ter padding: copiar linha a linha
+	for (int y = 0; y < image->height; y++)
+		memcpy(image->data + y * image->bytesperline, source->frame.ptr(y), image->width * 3);
+
+	return 1;
+}
+
+
+// +++++++++++++++++++++++++
+// Modo com vrias streams: Source.exe video1.mp4 video2.mp4 0 ...
+// (um nmero abre a cmara com esse ndice). Cada fonte tem uma thread que descodifica e entrega as frames
+//  biblioteca (vc_multistream); o processamento corre nas threads partilhadas da biblioteca.
+// +++++++++++++++++++++++++
+
+#define MULTI_DEPTH 4		// Frames em curso por stream
+#define WATERSHED_DEPTH 3	// Profundidade mnima (pixis) do estrangulamento entre moedas que se tocam
+#define BACKGROUND_RATE 5		// Mdia mvel do fundo: cada frame pesa 1/2^5
+#define FOREGROUND_THRESHOLD 30	// Diferena mnima ao fundo (por canal RGB) de um pixel de primeiro plano
+#define FOREGROUND_MINPIXELS 8	// Pixis de primeiro plano para activar um bloco da segmentao
+#define HOUGH_RMIN 20			// Raios (pixis) das moedas procuradas pela transformada de Hough
+#define HOUGH_RMAX 80
+#define HOUGH_THRESHOLD 60.0f	// Magnitude mnima do gradiente de Sobel
+#define HOUGH_SUPPORT 0.5f		// Fraco mnima do permetro com contorno
+#define HOUGH_MAXCIRCLES 64
+
+struct MultiResult {
+	cv::Mat mask;
+	int nblobs = 0;
+};
+
+struct MultiApp {
+	std::vector<std::vector<MultiResult>> results;	// [stream][frame % MULTI_DEPTH]
+	std::vector<MultiResult> latest;				// ltima frame entregue de cada stream
+	std::mutex mutex;
+	std::atomic<bool> stop{ false };
+};
+
+// Thread de trabalho: BGR -> RGB, segmentao das moedas douradas com abertura e contagem de blobs
+// (as moedas que se tocam so separadas pela watershed da transformada de distncia)
+static int multi_process(void* arg, VCCONTEXT* ctx, int stream, int frame, IVC* image) {
+	MultiApp* app = (MultiApp*)arg;
+	MultiResult& result = app->results[stream][frame % MULTI_DEPTH];
+	IVC* rgb = vc_context_image_get(ctx, image->width, image->height, 3, 255);
+	IVC* mask = vc_context_image_get(ctx, image->width, image->height, 1, 255);
+	IVC* labels = vc_context_image_get(ctx, image->width, image->height, 1, 255);
+	int ok = (rgb != NULL) && (mask != NULL) && (labels != NULL) &&
+		vc_bgr_to_rgb(image, rgb) &&
+		vc_hsv_segmentation_tiled_ctx(ctx, rgb, mask, 40, 70, 20, 70, 20, 70, 5, 0);
+
+	if (ok) {
+		vc_binary_blob_watershed_ctx(ctx, mask, labels, WATERSHED_DEPTH, &result.nblobs);
+		cv::Mat(image->height, image->width, CV_8UC1, mask->data, mask->bytesperline).copyTo(result.mask);
+	}
+
+	vc_context_image_release(ctx, rgb);
+	vc_context_image_release(ctx, mask);
+	vc_context_image_release(ctx, labels);
+
+	return ok;
+}
+
+// Entrega por ordem de frame: guarda o resultado para ser mostrado pela thread principal
+static void multi_done(void* arg, int stream, int frame, IVC* image, int ok) {
+	MultiApp* app = (MultiApp*)arg;
+
+	if (!ok) return;
+
+	std::lock_guard<std::mutex> lock(app->mutex);
+	std::swap(app->latest[stream], app->results[stream][frame % MULTI_DEPTH]);
+}
+
+// Thread de descodificao de uma fonte
+static void multi_reader(MultiApp* app, VCMULTISTREAM* ms, int stream, std::string source) {
+	cv::VideoCapture capture;
+	cv::Mat frame;
+
+	if (!source.empty() && source.find_first_not_of("0123456789") == std::string::npos) capture.open(std::atoi(source.c_str()));
+	else capture.open(source);
+
+	if (!capture.isOpened()) {
+		std::cerr << "Erro ao abrir " << source << "!\n";
+		return;
+	}
+
+	while (!app->stop && capture.read(frame) && !frame.empty()) {
+		IVC* image = vc_multistream_acquire(ms, stream, frame.cols, frame.rows, 3);
+		if (image == NULL) break;
+
+		for (int y = 0; y < frame.rows; y++)
+			memcpy(image->data + y * image->bytesperline, frame.ptr(y), frame.cols * 3);
+
+		vc_multistream_submit(ms, stream, image);
+	}
+
+	capture.release();
+}
+
+static int run_multistream(int nsources, char* sources[]) {
+	MultiApp app;
+	std::vector<std::thread> readers;
+	int key = 0;
+
+	app.results.resize(nsources, std::vector<MultiResult>(MULTI_DEPTH));
+	app.latest.resize(nsources);
+
+	VCMULTISTREAM* ms = vc_multistream_new(nsources, 0, MULTI_DEPTH, multi_process, multi_done, &app);
+	if (ms == NULL) {
+		std::cerr << "Erro ao criar o processamento de vrias streams!\n";
+		return 1;
+	}
+
+	for (int i = 0; i < nsources; i++) readers.emplace_back(multi_reader, &app, ms, i, std::string(sources[i]));
+
+	// Mostra a ltima mscara de cada stream at todas terminarem (ou at premir 'q')
+	std::thread joiner([&]() { for (auto& t : readers) t.join(); app.stop = true; });
+
+	while (!app.stop) {
+		{
+			std::lock_guard<std::mutex> lock(app.mutex);
+			for (int i = 0; i < nsources; i++) {
+				if (app.latest[i].mask.empty()) continue;
+				cv::imshow(std::string("VC - STREAM ").append(std::to_string(i)), app.latest[i].mask);
+			}
+		}
+		key = cv::waitKey(30);
+		if (key == 'q') app.stop = true;
 	}
-	else {
-		std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
-		std::chrono::steady_clock::duration elapsedTime = currentTime - previousTime;
 
-		// Tempo em segundos.
-		std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(elapsedTime);
-		double nseconds = time_span.count();
+	joiner.join();
+	vc_multistream_wait(ms);
+
+	for (int i = 0; i < nsources; i++) {
+		VCSTREAMSTATS stats;
 
-		std::cout << "Tempo decorrido: " << nseconds << "segundos" << std::endl;
-		std::cout << "Pressione qualquer tecla para continuar...\n";
-		std::cin.get();
+		vc_multistream_stats(ms, i, &stats);
+		std::cout << sources[i] << ": " << stats.frames << " frames, " << stats.fps << " fps, latencia media "
+			<< stats.latency << " ms (max " << stats.latency_max << " ms), processamento " << stats.busy << " ms, blobs na ultima frame "
+			<< app.latest[i].nblobs << std::endl;
 	}
+
+	vc_multistream_free(ms);
+	cv::destroyAllWindows();
+
+	return 0;
 }
 
 
-int main(void) {
+int main(int argc, char* argv[]) {
+	// Vrias fontes: processamento partilhado
+	if (argc > 2) return run_multistream(argc - 1, &argv[1]);
+
 	// Vdeo
-	char videofile[20] = "video1.mp4";
+	std::string videofile = (argc == 2) ? argv[1] : "video1.mp4";
 	cv::VideoCapture capture;
 	struct
 	{
@@ -75,72 +236,101 @@ int main(void) {
 	/* Cria uma janela para exibir o vdeo */
 	cv::namedWindow("VC - VIDEO", cv::WINDOW_AUTOSIZE);
 
+	/* Contexto de processamento: pool de imagens reutilizadas entre frames, threads e temporizador
+	   (libertado no fim de main) */
+	vc::context ctx(0);
+	if (!ctx)
+	{
+		std::cerr << "Erro ao criar o contexto de processamento!\n";
+		return 1;
+	}
+
+	/* Leitura antecipada: a descodificao, a cpia para IVC e as converses BGR -> RGB -> HSV
+	   correm numa thread prpria,  frente do processamento */
+	VideoSource source;
+	source.capture = &capture;
+	VCPREFETCH* prefetch = vc_prefetch_open(video.width, video.height, PREFETCH_DEPTH, VC_PREFETCH_BGR | VC_PREFETCH_HSV, video_decode, &source);
+	if (prefetch == NULL)
+	{
+		std::cerr << "Erro ao iniciar a leitura do vdeo!\n";
+		return 1;
+	}
+
+	/* Modelo do fundo (tapete), em RGB: a segmentao HSV s corre onde a frame difere dele */
+	VCBACKGROUND* background = vc_background_new(video.width, video.height, 3, VC_BACKGROUND_AVERAGE, BACKGROUND_RATE);
+	if (background == NULL)
+	{
+		std::cerr << "Erro ao criar o modelo de fundo!\n";
+		vc_prefetch_close(prefetch);
+		return 1;
+	}
+
 	/* Inicia o timer */
-	vc_timer();
+	vc_context_timer_start(ctx);
 
 	cv::Mat frame;
+	cv::Mat coins;
 	while (key != 'q') {
-		/* Leitura de uma frame do vdeo */
-		capture.read(frame);
-
-		/* Verifica se conseguiu ler a frame */
-		if (frame.empty()) break;
+		/* Frame seguinte, j em RGB e HSV (NULL no fim do vdeo) */
+		VCFRAME* vframe = vc_prefetch_read(prefetch);
+		if (vframe == NULL) break;
 
 		/* Nmero da frame a processar */
-		video.nframe = (int)capture.get(cv::CAP_PROP_POS_FRAMES);
+		video.nframe = vframe->number + 1;
 
-<<<<<<< HEAD
 
 		// Faa o seu cdigo aqui...
 
-		// Criao das imagens para processamento
-		IVC* imageFromVideo = vc_image_new(video.width, video.height, 3, 255);
-		IVC* imageInRGB = vc_image_new(video.width, video.height, 3, 255);
-		IVC* imageInHSV = vc_image_new(video.width, video.height, 3, 255);
-		IVC* imageSegmentation = vc_image_new(video.width, video.height, 1, 255);
-
-		// Copiar dados da frame para o buffer de processamento
-		memcpy(imageFromVideo->data, frame.data, video.width * video.height * 3);
+		// Imagens para processamento: RGB e HSV pertencem ao anel da leitura antecipada (vlidas at 
+		// prxima leitura); as restantes so reutilizadas entre frames pela pool do contexto
+		IVC* imageInRGB = vframe->rgb;
+		IVC* imageInHSV = vframe->hsv;
+		IVC* imageSegmentation = vc_context_image_get(ctx, video.width, video.height, 1, 255);
+		IVC* imageForeground = vc_context_image_get(ctx, video.width, video.height, 1, 255);
 
 
+		cv::Mat rgbImage(video.height, video.width, CV_8UC3, imageInRGB->data, imageInRGB->bytesperline);
+		cv::cvtColor(rgbImage, frame, cv::COLOR_RGB2BGR);
+		cv::imshow("BGR to RGB", frame);
 
-		if (vc_bgr_to_rgb(imageFromVideo, imageInRGB) == 0) {
-			std::cerr << "Erro na converso de BGR para RBG!\n";
-			vc_image_free(imageFromVideo);
-			vc_image_free(imageInRGB);
-			vc_image_free(imageInHSV);
-			vc_image_free(imageSegmentation);
-			return 1;
-		}
-
-
-		cv::Mat rgbImage(video.height, video.width, CV_8UC3, imageInRGB->data);
-		cv::cvtColor(rgbImage, rgbImage, cv::COLOR_RGB2BGR);
-		cv::imshow("BGR to RGB", rgbImage);
+		// Primeiro plano (o que difere do fundo) e segmentao HSV s nessa zona
 
-		// Converso para HSV
-		if (vc_rgb_to_hsv(imageInRGB, imageInHSV) == 0) {
-			std::cerr << "Erro na converso de RGB para HSV!\n";
-			vc_image_free(imageFromVideo);
-			vc_image_free(imageInRGB);
-			vc_image_free(imageInHSV);
-			vc_image_free(imageSegmentation);
+		if ((vc_background_foreground(background, imageInRGB, imageForeground, FOREGROUND_THRESHOLD) != 1) ||
+			(vc_hsv_segmentation_foreground_ctx(ctx, imageInHSV, imageForeground, imageSegmentation, FOREGROUND_MINPIXELS, 210, 230, 30, 100, 30, 60) != 1)) {
+			std::cerr << "Erro na segmentao HSV!\n";
+			vc_context_image_release(ctx, imageSegmentation);
+			vc_context_image_release(ctx, imageForeground);
+			background = vc_background_free(background);
+			vc_prefetch_close(prefetch);
 			return 1;
 		}
-		cv::imshow("BGR to RGB", rgbImage);
-
-		// Segmentao HSV
 
-		if (vc_hsv_segmentation(imageInHSV, imageSegmentation, 210, 230, 30, 100, 30, 60) != 1) {
-			std::cerr << "Erro na segmentao HSV!\n";
-			vc_image_free(imageFromVideo);
-			vc_image_free(imageInHSV);
-			vc_image_free(imageSegmentation);
-			return 1;
+		// No primeiro plano o fundo  actualizado muito mais devagar (as moedas paradas demoram a ser absorvidas)
+		vc_background_update(background, imageInRGB, imageForeground);
+
+		// Etiquetagem com separao das moedas que se tocam
+		IVC* imageLabels = vc_context_image_get(ctx, video.width, video.height, 1, 255);
+		int nblobs = 0;
+		OVC* blobs = vc_binary_blob_watershed_ctx(ctx, imageSegmentation, imageLabels, WATERSHED_DEPTH, &nblobs);
+		if (blobs != NULL) vc_binary_blob_info(imageLabels, blobs, nblobs);
+		vc_context_image_release(ctx, imageLabels);
+
+		// Um crculo por moeda (Hough nas caixas dos blobs), desenhado sobre uma cpia da frame na sua prpria
+		// janela (a frame  reescrita mais abaixo pelas demonstraes HSV)
+		frame.copyTo(coins);
+		IVC* imageGray = vc_context_image_get(ctx, video.width, video.height, 1, 255);
+		CIRCLEVC circles[HOUGH_MAXCIRCLES];
+		int ncircles = 0;
+		if ((blobs != NULL) && (vc_rgb_to_gray(imageInRGB, imageGray) == 1) &&
+			(vc_gray_hough_circles(ctx, imageGray, blobs, nblobs, HOUGH_RMIN, HOUGH_RMAX, HOUGH_THRESHOLD, HOUGH_SUPPORT, circles, HOUGH_MAXCIRCLES, &ncircles) == 1)) {
+			for (int i = 0; i < ncircles; i++)
+				cv::circle(coins, cv::Point(circles[i].x, circles[i].y), circles[i].r, cv::Scalar(0, 255, 0), 2);
 		}
+		vc_context_image_release(ctx, imageGray);
+		cv::imshow("Moedas", coins);
 
 		// Exibio da imagem segmentada frame a frame
-		cv::Mat segImage(video.height, video.width, CV_8UC1, imageSegmentation->data);
+		cv::Mat segImage(video.height, video.width, CV_8UC1, imageSegmentation->data, imageSegmentation->bytesperline);
 		//cv::imshow("Segmentacao", segImage);
 		cv::imshow("VC - VIDEO", frame);
 
@@ -150,50 +340,40 @@ int main(void) {
 
 
 		/* douradas */
-		// Cria novas imagens IVC  
-		IVC* image3 = vc_image_new(video.width, video.height, 3, 255);
-		IVC* image4 = vc_image_new(video.width, video.height, 3, 255);
-		IVC* image5 = vc_image_new(video.width, video.height, 3, 255);
+		// Cria novas imagens IVC (o HSV j vem da thread de descodificao)
+		IVC* image5 = vc_context_image_get(ctx, video.width, video.height, 3, 255);
 
-		vc_bgr_to_rgb(imageInRGB, image3);
-		vc_rgb_to_hsv(image3, image4);
-		vc_hsv_segmentation(image4, image5, 40, 70, 20, 70, 20, 70);
+		vc_hsv_segmentation(imageInHSV, image5, 40, 70, 20, 70, 20, 70);
 
 		// Mostra a imagem hsv 
-		memcpy(frame.data, imageInHSV->data, video.width * video.height * 3);
+		for (int y = 0; y < video.height; y++)
+			memcpy(frame.ptr(y), imageInHSV->data + y * imageInHSV->bytesperline, video.width * 3);
 		cv::imshow("VC - VIDEO", frame);
 
 		// Cria um Mat com os dados da imagem segmentada e mostra
-		cv::Mat segmentedImage(video.height, video.width, CV_8UC1, image5->data);
+		cv::Mat segmentedImage(video.height, video.width, CV_8UC1, image5->data, image5->bytesperline);
 		cv::imshow("Segmentacao HSV", segmentedImage);
 
-		// Liberta a memria da imagem IVC que havia sido criada  
-		vc_image_free(image3);
-		vc_image_free(image4);
-		vc_image_free(image5);
+		// Devolve as imagens IVC ao contexto  
+		vc_context_image_release(ctx, image5);
 
 		/* escuras */
 		// Cria novas imagens IVC  
-		IVC* image6 = vc_image_new(video.width, video.height, 3, 255);
-		IVC* image7 = vc_image_new(video.width, video.height, 3, 255);
-		IVC* image8 = vc_image_new(video.width, video.height, 3, 255);
+		IVC* image8 = vc_context_image_get(ctx, video.width, video.height, 3, 255);
 
-		vc_bgr_to_rgb(imageInRGB, image6);
-		vc_rgb_to_hsv(image6, image7);
-		vc_hsv_segmentation(image7, image8, 30, 45, 50, 75, 20, 35);
+		vc_hsv_segmentation(imageInHSV, image8, 30, 45, 50, 75, 20, 35);
 
 		// Mostra a imagem hsv 
-		memcpy(frame.data, imageInHSV->data, video.width * video.height * 3);
+		for (int y = 0; y < video.height; y++)
+			memcpy(frame.ptr(y), imageInHSV->data + y * imageInHSV->bytesperline, video.width * 3);
 		cv::imshow("VC - VIDEO", frame);
 
 		// Cria um Mat com os dados da imagem segmentada e mostra
-		cv::Mat segmentedImage2(video.height, video.width, CV_8UC1, image8->data);
+		cv::Mat segmentedImage2(video.height, video.width, CV_8UC1, image8->data, image8->bytesperline);
 		cv::imshow("Segmentacao HSV", segmentedImage2);
 
-		// Liberta a memria da imagem IVC que havia sido criada  
-		vc_image_free(image6);
-		vc_image_free(image7);
-		vc_image_free(image8);
+		// Devolve as imagens IVC ao contexto  
+		vc_context_image_release(ctx, image8);
 
 
 
@@ -203,26 +383,9 @@ int main(void) {
 		key = cv::waitKey(60);
 
 		// Liberao dos recursos
-		vc_image_free(imageFromVideo);
-		vc_image_free(imageInHSV);
-		vc_image_free(imageSegmentation);
+		vc_context_image_release(ctx, imageSegmentation);
+		vc_context_image_release(ctx, imageForeground);
 
-
-=======
-		// Faa o seu cdigo aqui...
-		/*
-		// Cria uma nova imagem IVC
-		IVC *image = vc_image_new(video.width, video.height, 3, 255);
-		// Copia dados de imagem da estrutura cv::Mat para uma estrutura IVC
-		memcpy(image->data, frame.data, video.width * video.height * 3);
-		// Executa uma funo da nossa biblioteca vc
-		vc_rgb_get_green(image);
-		// Copia dados de imagem da estrutura IVC para uma estrutura cv::Mat
-		memcpy(frame.data, image->data, video.width * video.height * 3);
-		// Liberta a memria da imagem IVC que havia sido criada
-		vc_image_free(image);
-		*/
->>>>>>> parent of 646d8aa (Convert BGR to RGB and Inicial Segmentation)
 		// +++++++++++++++++++++++++
 
 		/* Exemplo de insero texto na frame */
@@ -246,8 +409,15 @@ int main(void) {
 		key = cv::waitKey(1);
 	}
 
+	/* Tempo em que o processamento esteve  espera da descodificao */
+	std::cout << "Espera pela descodificacao: " << vc_prefetch_wait_ms(prefetch) << " ms" << std::endl;
+
+	/* Pra a thread de descodificao (usa capture, pelo que tem de terminar antes de o fechar) */
+	if (!vc_prefetch_close(prefetch)) std::cerr << "Erro na leitura do vdeo!\n";
+	background = vc_background_free(background);
+
 	/* Para o timer e exibe o tempo decorrido */
-	vc_timer();
+	vc_timer(ctx);
 
 	/* Fecha a janela */
 	cv::destroyWindow("VC - VIDEO");
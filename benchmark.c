@@ -0,0 +1,527 @@
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//           INSTITUTO POLITCNICO DO CVADO E DO AVE
+//                          2022/2023
+//             ENGENHARIA DE SISTEMAS INFORMTICOS
+//                    VISO POR COMPUTADOR
+//
+//             [  DUARTE DUQUE - dduque@ipca.pt  ]
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Benchmark sem interface grfica (headless) da biblioteca vc.
+// Mede o tempo mdio por frame de cada etapa do pipeline, sobre frames sintticas
+// ou sobre uma sequncia PPM (vrios PPM concatenados, ver vc_stream_open_read()).
+//
+// Utilizao: vc_bench [-w largura] [-h altura] [-n frames] [-r repeties] [-i sequencia.ppm] [-s streams] [-t threads]
+//   -s: mede tambm o processamento de vrias streams em simultneo (vc_multistream)
+//   -t: compara, com o nmero de threads dado (0 = uma por processador), o trabalho por blob repartido
+//       estaticamente entre as threads e com roubo de trabalho (vc_context_tasks)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vc.h"
+
+#define BENCH_MAX_FRAMES 64
+#define BENCH_BLOB_PASSES 4		// Passagens do trabalho por blob (simula a extraco de vrias caractersticas)
+
+// Intervalos HSV das moedas (iguais aos de Source.cpp)
+#define GOLD_HMIN 40
+#define GOLD_HMAX 70
+#define GOLD_SMIN 20
+#define GOLD_SMAX 70
+#define GOLD_VMIN 20
+#define GOLD_VMAX 70
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	timespec_get(&ts, TIME_UTC);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+// Frame sinttica: fundo azulado com gradiente e rudo (fora do intervalo GOLD), e discos de cores diferentes (alguns dentro do intervalo GOLD)
+// index < 0: s o fundo (sem discos)
+static void bench_synthetic_frame(IVC* frame, int index)
+{
+	static const unsigned char colors[4][3] = { { 170, 150, 110 }, { 120, 110, 80 }, { 60, 90, 160 }, { 200, 60, 50 } };
+	unsigned int seed = 12345u + (unsigned int)index * 7919u;
+	int ndisks = (index < 0) ? 0 : 12;
+	int x, y, i;
+
+	for (y = 0; y < frame->height; y++)
+	{
+		unsigned char* row = &frame->data[y * frame->bytesperline];
+
+		for (x = 0; x < frame->width; x++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			row[x * 3] = (unsigned char)(40 + ((seed >> 16) & 15));
+			row[x * 3 + 1] = (unsigned char)(50 + (y * 40) / frame->height + ((seed >> 20) & 15));
+			row[x * 3 + 2] = (unsigned char)(110 + (x * 60) / frame->width + ((seed >> 24) & 15));
+		}
+	}
+
+	for (i = 0; i < ndisks; i++)
+	{
+		int r = frame->height / 16 + (i * 7) % (frame->height / 16 + 1);
+		int cx = (frame->width * (i * 37 % 100)) / 100 + index * 3;
+		int cy = (frame->height * (i * 53 % 100)) / 100;
+		const unsigned char* c = colors[i % 4];
+
+		for (y = MAX2(cy - r, 0); y < MIN2(cy + r, frame->height); y++)
+		{
+			for (x = MAX2(cx - r, 0); x < MIN2(cx + r, frame->width); x++)
+			{
+				if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+				{
+					unsigned char* p = &frame->data[y * frame->bytesperline + x * 3];
+					p[0] = c[0];
+					p[1] = c[1];
+					p[2] = c[2];
+				}
+			}
+		}
+	}
+}
+
+
+// Etapa corrida pelas threads de vc_multistream
+static int bench_multistream_process(void* arg, VCCONTEXT* ctx, int stream, int frame, IVC* image)
+{
+	IVC* mask = vc_context_image_get(ctx, image->width, image->height, 1, 255);
+	int ok = (mask != NULL) && vc_hsv_segmentation_tiled_ctx(ctx, image, mask, GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX, 5, 0);
+
+	vc_context_image_release(ctx, mask);
+
+	return ok;
+}
+
+
+// nstreams streams com nframes frames cada, todas submetidas de uma vez: a stream 0 tem frames
+// width x height e as restantes 1/4 da rea, pelo que o escalonamento justo no a deve deixar atrasar as outras
+static void bench_multistream(int nstreams, int width, int height, int nframes)
+{
+	VCMULTISTREAM* ms = vc_multistream_new(nstreams, 0, nframes, bench_multistream_process, NULL, NULL);
+	VCSTREAMSTATS stats;
+	double t;
+	int i, s;
+
+	if (ms == NULL) return;
+
+	printf("\n%d streams (stream 0: %dx%d, restantes: %dx%d), %d frames cada\n", nstreams, width, height, width / 2, height / 2, nframes);
+
+	t = bench_now();
+	for (i = 0; i < nframes; i++)
+	{
+		for (s = 0; s < nstreams; s++)
+		{
+			IVC* image = (s == 0) ? vc_multistream_acquire(ms, s, width, height, 3) : vc_multistream_acquire(ms, s, width / 2, height / 2, 3);
+
+			if (image == NULL) break;
+			bench_synthetic_frame(image, i);
+			vc_multistream_submit(ms, s, image);
+		}
+	}
+	vc_multistream_wait(ms);
+	t = bench_now() - t;
+
+	for (s = 0; s < nstreams; s++)
+	{
+		vc_multistream_stats(ms, s, &stats);
+		printf("stream %d: %7.1f fps  latencia %8.2f ms (max %8.2f)  cpu %8.1f ms\n", s, stats.fps, stats.latency, stats.latency_max, stats.busy);
+	}
+	printf("total: %.1f frames/s\n", nstreams * nframes * 1000.0 / t);
+
+	vc_multistream_free(ms);
+}
+
+
+// Mscara com poucos blobs enormes (em cima, pelo que ficam com as primeiras etiquetas) e muitos minsculos
+static void bench_blob_mask(IVC* mask, int index)
+{
+	int width = mask->width, height = mask->height;
+	int x, y, x0, y0, k, dy;
+
+	memset(mask->data, 0, mask->bytesperline * height);
+
+	// Rectngulos (a etiquetagem cria etiquetas provisrias nos rebordos inclinados de formas maiores)
+	for (k = 0; k < 3; k++)
+	{
+		x0 = (width / 4) * (k + 1) - width / 10 + ((index * 13 + k * 29) % 21) - 10;
+		y0 = 8 + ((index * 7 + k * 11) % 9);
+
+		for (y = y0; y < y0 + height / 3; y++) memset(&mask->data[y * mask->bytesperline + x0], 255, width / 5);
+	}
+
+	// Grelha de quadrados 3x3 na metade de baixo (at 200 blobs)
+	for (k = 0, y = height / 2; (y < height - 4) && (k < 200); y += 16)
+	{
+		for (x = 8 + (index % 5); (x < width - 4) && (k < 200); x += 24, k++)
+		{
+			for (dy = 0; dy < 3; dy++) memset(&mask->data[(y + dy) * mask->bytesperline + x], 255, 3);
+		}
+	}
+}
+
+typedef struct {
+	IVC* labels;
+	OVC* blobs;
+	int nblobs;
+	int nthreads;
+	double* features;
+	int order[256];				// ndices dos blobs por ordem crescente de rea (tarefas do roubo de trabalho)
+} BENCHBLOBS;
+
+// Trabalho por blob: momentos de segunda ordem dentro da caixa delimitadora (custo proporcional  rea)
+static void bench_blob_work(BENCHBLOBS* state, int i)
+{
+	OVC* blob = &state->blobs[i];
+	unsigned char* data = state->labels->data;
+	double m = 0.0;
+	int x, y, pass;
+
+	for (pass = 0; pass < BENCH_BLOB_PASSES; pass++)
+	{
+		for (y = blob->y; y < blob->y + blob->height; y++)
+		{
+			for (x = blob->x; x < blob->x + blob->width; x++)
+			{
+				if (data[y * state->labels->bytesperline + x] == blob->label)
+				{
+					m += (double)(x - blob->xc) * (y - blob->yc) + pass;
+				}
+			}
+		}
+	}
+
+	state->features[i] = m;
+}
+
+// Repartio esttica: a thread t fica com o bloco [t * n / T, (t + 1) * n / T[ dos blobs (por ordem de etiqueta)
+static int bench_blob_static_job(void* arg, int index, int thread)
+{
+	BENCHBLOBS* state = (BENCHBLOBS*)arg;
+	int i;
+
+	for (i = index * state->nblobs / state->nthreads; i < (index + 1) * state->nblobs / state->nthreads; i++) bench_blob_work(state, i);
+
+	return 1;
+}
+
+static int bench_blob_task(void* arg, int index, int thread)
+{
+	BENCHBLOBS* state = (BENCHBLOBS*)arg;
+
+	bench_blob_work(state, state->order[index]);
+
+	return 1;
+}
+
+static int bench_compare_ms(const void* a, const void* b)
+{
+	double d = *(const double*)a - *(const double*)b;
+
+	return (d > 0.0) - (d < 0.0);
+}
+
+static void bench_latency_report(const char* name, double* ms, int n)
+{
+	double sum = 0.0;
+	int i;
+
+	qsort(ms, n, sizeof(double), bench_compare_ms);
+	for (i = 0; i < n; i++) sum += ms[i];
+
+	printf("%-28s media %7.3f  p50 %7.3f  p95 %7.3f  max %7.3f ms/frame\n", name, sum / n, ms[n / 2], ms[(n * 95) / 100], ms[n - 1]);
+}
+
+// Trabalho por blob em frames com 3 blobs enormes e 200 minsculos: repartio esttica vs roubo de trabalho
+static void bench_blob_tasks(int width, int height, int nframes, int nthreads)
+{
+	VCCONTEXT* ctx = vc_context_new(nthreads);
+	IVC* mask = vc_image_new(width, height, 1, 255);
+	IVC* labels = vc_image_new(width, height, 1, 255);
+	double* tstatic = (double*)malloc(nframes * sizeof(double));
+	double* ttasks = (double*)malloc(nframes * sizeof(double));
+	double features[256];
+	BENCHBLOBS state;
+	double t;
+	int i, j, k;
+
+	if ((ctx != NULL) && (mask != NULL) && (labels != NULL) && (tstatic != NULL) && (ttasks != NULL))
+	{
+		printf("\ntrabalho por blob, %d threads, %d frames\n", vc_context_nthreads(ctx), nframes);
+
+		state.labels = labels;
+		state.nthreads = vc_context_nthreads(ctx);
+		state.features = features;
+
+		for (i = 0; i < nframes; i++)
+		{
+			bench_blob_mask(mask, i);
+			state.blobs = vc_binary_blob_labelling_ctx(ctx, mask, labels, &state.nblobs);
+			vc_binary_blob_tasks(ctx, labels, state.blobs, state.nblobs, NULL, NULL);
+
+			// As tarefas vo para vc_context_tasks() por ordem crescente de custo (rea), como em vc_binary_blob_tasks()
+			for (j = 0; j < state.nblobs; j++)
+			{
+				for (k = j; (k > 0) && (state.blobs[state.order[k - 1]].area > state.blobs[j].area); k--) state.order[k] = state.order[k - 1];
+				state.order[k] = j;
+			}
+
+			t = bench_now();
+			vc_context_parallel_for(ctx, state.nthreads, bench_blob_static_job, &state);
+			tstatic[i] = bench_now() - t;
+
+			t = bench_now();
+			vc_context_tasks(ctx, state.nblobs, bench_blob_task, &state);
+			ttasks[i] = bench_now() - t;
+		}
+
+		bench_latency_report("blobs estatico", tstatic, nframes);
+		bench_latency_report("blobs roubo de trabalho", ttasks, nframes);
+	}
+
+	free(tstatic);
+	free(ttasks);
+	vc_image_free(mask);
+	vc_image_free(labels);
+	vc_context_free(ctx);
+}
+
+
+// Escreve o tempo mdio por frame da etapa e acumula-o no total
+static void bench_report(const char* name, double ms, int nframes, int reps, double* total)
+{
+	double perframe = ms / ((double)nframes * reps);
+
+	printf("%-28s %9.3f ms/frame\n", name, perframe);
+	*total += perframe;
+}
+
+
+int main(int argc, char* argv[])
+{
+	IVC* frames[BENCH_MAX_FRAMES];
+	IVC* hsv[BENCH_MAX_FRAMES];
+	IVC* masks[BENCH_MAX_FRAMES];
+	IVCPLANAR* planar;
+	IVC* gray, * tmp, * labels, * scene, * foreground;
+	IVCPOOL pool;
+	VCCONTEXT* ctx;
+	VCBACKGROUND* background;
+	char* input = NULL;
+	int width = 1280, height = 720, nframes = 8, reps = 3, nstreams = 0, nthreads = -1;
+	int i, r;
+	double t, total = 0.0;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "-w") == 0) && (i + 1 < argc)) width = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-h") == 0) && (i + 1 < argc)) height = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) nframes = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) reps = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-i") == 0) && (i + 1 < argc)) input = argv[++i];
+		else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc)) nstreams = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) nthreads = atoi(argv[++i]);
+		else
+		{
+			printf("Utilizacao: %s [-w largura] [-h altura] [-n frames] [-r repeticoes] [-i sequencia.ppm] [-s streams] [-t threads]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (nframes < 1) nframes = 1;
+	if (nframes > BENCH_MAX_FRAMES) nframes = BENCH_MAX_FRAMES;
+	if (reps < 1) reps = 1;
+
+	// Frames de entrada
+	if (input != NULL)
+	{
+		VCSTREAM* stream = vc_stream_open_read(input);
+		IVC* image;
+
+		if (stream == NULL) return 1;
+
+		for (i = 0; i < nframes; i++)
+		{
+			if ((image = vc_stream_read(stream)) == NULL) break;
+			if (image->channels != 3)
+			{
+				printf("ERRO: a sequencia deve ser PPM (3 canais)\n");
+				vc_stream_close(stream);
+				return 1;
+			}
+			if (i == 0)
+			{
+				width = image->width;
+				height = image->height;
+			}
+			if ((image->width != width) || (image->height != height)) break;
+
+			frames[i] = vc_image_new(width, height, 3, 255);
+			for (r = 0; r < height; r++) memcpy(&frames[i]->data[r * frames[i]->bytesperline], &image->data[r * image->bytesperline], width * 3);
+		}
+		vc_stream_close(stream);
+
+		if (i == 0) return 1;
+		nframes = i;
+	}
+	else
+	{
+		for (i = 0; i < nframes; i++)
+		{
+			frames[i] = vc_image_new(width, height, 3, 255);
+			bench_synthetic_frame(frames[i], i);
+		}
+	}
+
+	for (i = 0; i < nframes; i++)
+	{
+		hsv[i] = vc_image_new(width, height, 3, 255);
+		masks[i] = vc_image_new(width, height, 1, 255);
+	}
+	planar = vc_planar_new(width, height, 3, 255);
+	gray = vc_image_new(width, height, 1, 255);
+	tmp = vc_image_new(width, height, 1, 255);
+	labels = vc_image_new(width, height, 1, 255);
+	scene = vc_image_new(width, height, 3, 255);
+	foreground = vc_image_new(width, height, 1, 255);
+	vc_pool_init(&pool);
+	ctx = vc_context_new(0);
+	if (ctx == NULL) return 1;
+
+	printf("%d frames %dx%d, %d repeticoes, CPU: %s\n\n", nframes, width, height, reps, vc_cpu_tier_name(vc_cpu_tier()));
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_rgb_to_hsv(frames[i], hsv[i]);
+	bench_report("rgb_to_hsv", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_rgb_to_hsv_planar(frames[i], planar);
+	bench_report("rgb_to_hsv_planar", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_hsv_segmentation(hsv[i], masks[i], GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX);
+	bench_report("hsv_segmentation", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_hsv_segmentation_planar(planar, masks[i], GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX);
+	bench_report("hsv_segmentation_planar", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_binary_erode(masks[i], tmp, 5);
+	bench_report("binary_erode 5x5", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_binary_dilate(masks[i], tmp, 5);
+	bench_report("binary_dilate 5x5", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++)
+	{
+		vc_rgb_to_gray(frames[i], gray);
+		vc_gray_to_binary_otsu(gray, tmp);
+	}
+	bench_report("rgb_to_gray + otsu", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_gray_edge_sobel(gray, tmp, 100.0f);
+	bench_report("gray_edge_sobel", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_hsv_segmentation_tiled(frames[i], masks[i], GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX, 5, 0);
+	bench_report("pipeline tiled (hsv+seg+open)", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) vc_batch_hsv_segmentation(&pool, frames, masks, nframes, GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX, 5, 0);
+	bench_report("pipeline batch (hsv+seg+open)", bench_now() - t, nframes, reps, &total);
+
+	// Verses com contexto: intermdios, threads e memria de trabalho reutilizados entre chamadas
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++) vc_hsv_segmentation_tiled_ctx(ctx, frames[i], masks[i], GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX, 5, 0);
+	bench_report("pipeline tiled ctx", bench_now() - t, nframes, reps, &total);
+
+	t = bench_now();
+	for (r = 0; r < reps; r++) vc_batch_hsv_segmentation_ctx(ctx, frames, masks, nframes, GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX, 5);
+	bench_report("pipeline batch ctx", bench_now() - t, nframes, reps, &total);
+
+	// Etiquetagem sobre as mscaras j filtradas pela abertura (etiquetas limitadas a 254)
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++)
+	{
+		int nblobs = 0;
+		OVC* blobs = vc_binary_blob_labelling(masks[i], labels, &nblobs);
+
+		if (blobs != NULL) vc_binary_blob_info(labels, blobs, nblobs);
+		free(blobs);
+	}
+	bench_report("blob_labelling + info", bench_now() - t, nframes, reps, &total);
+
+	// Etiquetagem com separao dos blobs que se tocam (transformada de distncia + watershed)
+	t = bench_now();
+	for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++)
+	{
+		int nblobs = 0;
+		OVC* blobs = vc_binary_blob_watershed_ctx(ctx, masks[i], labels, 3, &nblobs);
+
+		if (blobs != NULL) vc_binary_blob_info(labels, blobs, nblobs);
+	}
+	bench_report("blob_watershed + info", bench_now() - t, nframes, reps, &total);
+
+	// Segmentao s no primeiro plano, com o modelo de fundo aprendido em frames sem discos
+	// (numa sequncia gravada, nas suas primeiras frames)
+	background = vc_background_new(width, height, 3, VC_BACKGROUND_MEDIAN, 5);
+	if (background != NULL)
+	{
+		for (i = 0; i < 5; i++)
+		{
+			if (input != NULL) vc_background_update(background, frames[i % nframes], NULL);
+			else
+			{
+				bench_synthetic_frame(scene, -1 - i);
+				vc_background_update(background, scene, NULL);
+			}
+		}
+
+		t = bench_now();
+		for (r = 0; r < reps; r++) for (i = 0; i < nframes; i++)
+		{
+			vc_background_foreground(background, frames[i], foreground, 30);
+			vc_hsv_segmentation_foreground_ctx(ctx, hsv[i], foreground, masks[i], 8, GOLD_HMIN, GOLD_HMAX, GOLD_SMIN, GOLD_SMAX, GOLD_VMIN, GOLD_VMAX);
+		}
+		bench_report("foreground + hsv_segmentation", bench_now() - t, nframes, reps, &total);
+
+		background = vc_background_free(background);
+	}
+
+	// Usado por pgo.cmake para comparar builds
+	printf("\n%-28s %9.3f ms/frame\n", "total", total);
+
+	if (nstreams > 0) bench_multistream(nstreams, width, height, nframes * reps);
+	if (nthreads >= 0) bench_blob_tasks(width, height, nframes * reps, nthreads);
+
+	for (i = 0; i < nframes; i++)
+	{
+		vc_image_free(frames[i]);
+		vc_image_free(hsv[i]);
+		vc_image_free(masks[i]);
+	}
+	vc_planar_free(planar);
+	vc_image_free(gray);
+	vc_image_free(tmp);
+	vc_image_free(labels);
+	vc_image_free(scene);
+	vc_image_free(foreground);
+	vc_pool_free(&pool);
+	vc_context_free(ctx);
+
+	return 0;
+}
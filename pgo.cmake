@@ -0,0 +1,135 @@
+# Profile-guided optimisation da biblioteca vc (GCC ou Clang).
+#
+#   cmake [-DVC_PGO_BUILD=<dir>] [-DVC_PGO_FRAMES=<sequencia.ppm>] [-DVC_PGO_ARGS="-n 16 -r 3"] [-DVC_PGO_RUNS=5] -P pgo.cmake
+#
+# 1. Compila uma build Release de referência (<dir>/base) e mede-a com vc_bench.
+# 2. Compila uma build instrumentada (<dir>/pgo, VC_PGO=GENERATE) e corre o treino:
+#    o pipeline headless de vc_bench sobre as frames sintéticas, ou sobre a sequência
+#    PPM gravada indicada em VC_PGO_FRAMES (ver vc_stream_open_read()).
+# 3. Recompila a mesma build com o perfil (VC_PGO=USE), mede-a e mostra o ganho.
+#
+# A build instrumentada e a final partilham o directório: o GCC associa os perfis
+# ao caminho dos ficheiros objecto. O treino corre no nível SIMD desta máquina;
+# para treinar outro nível, definir a variável de ambiente VC_CPU antes de correr.
+
+cmake_minimum_required(VERSION 3.13)
+
+get_filename_component(VC_SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}" ABSOLUTE)
+
+if(NOT VC_PGO_BUILD)
+  set(VC_PGO_BUILD "${VC_SOURCE_DIR}/_pgo_build")
+endif()
+get_filename_component(VC_PGO_BUILD "${VC_PGO_BUILD}" ABSOLUTE)
+
+if(NOT DEFINED VC_PGO_ARGS)
+  set(VC_PGO_ARGS "-n 16 -r 3")
+endif()
+separate_arguments(VC_PGO_ARGS)
+
+# Medições: é usado o melhor de VC_PGO_RUNS execuções
+if(NOT VC_PGO_RUNS)
+  set(VC_PGO_RUNS 5)
+endif()
+
+set(VC_BENCH_ARGS ${VC_PGO_ARGS})
+if(VC_PGO_FRAMES)
+  get_filename_component(VC_PGO_FRAMES "${VC_PGO_FRAMES}" ABSOLUTE)
+  list(APPEND VC_BENCH_ARGS -i "${VC_PGO_FRAMES}")
+endif()
+
+set(VC_PGO_PROFILES "${VC_PGO_BUILD}/pgo/profiles")
+
+
+# Configura e compila uma build em dir, com as opções extra dadas
+function(vc_pgo_build dir)
+  execute_process(COMMAND "${CMAKE_COMMAND}" -S "${VC_SOURCE_DIR}" -B "${dir}"
+                          -DCMAKE_BUILD_TYPE=Release -DVC_BUILD_VIDEO=OFF ${ARGN}
+                  RESULT_VARIABLE result OUTPUT_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pgo: falhou a configuração de ${dir}")
+  endif()
+
+  execute_process(COMMAND "${CMAKE_COMMAND}" --build "${dir}" --config Release --target vc_bench
+                  RESULT_VARIABLE result OUTPUT_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pgo: falhou a compilação de ${dir}")
+  endif()
+endfunction()
+
+# Corre vc_bench da build em dir runs vezes e devolve em out o melhor total, em microssegundos por frame
+function(vc_pgo_run dir runs out)
+  set(bench "")
+  foreach(candidate "${dir}/vc_bench" "${dir}/vc_bench.exe" "${dir}/Release/vc_bench.exe")
+    if(NOT bench AND EXISTS "${candidate}")
+      set(bench "${candidate}")
+    endif()
+  endforeach()
+  if(NOT bench)
+    message(FATAL_ERROR "pgo: vc_bench não encontrado em ${dir}")
+  endif()
+
+  set(best "")
+  foreach(run RANGE 1 ${runs})
+    execute_process(COMMAND "${bench}" ${VC_BENCH_ARGS}
+                    RESULT_VARIABLE result OUTPUT_VARIABLE output)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "pgo: vc_bench terminou com erro (${result})")
+    endif()
+
+    if(NOT output MATCHES "total +([0-9]+)\\.([0-9]+) ms/frame")
+      message(FATAL_ERROR "pgo: total não encontrado na saída de vc_bench")
+    endif()
+    math(EXPR us "${CMAKE_MATCH_1} * 1000 + ${CMAKE_MATCH_2}")
+    if(NOT best OR us LESS best)
+      set(best ${us})
+      set(best_output "${output}")
+    endif()
+  endforeach()
+
+  message("${best_output}")
+  set(${out} ${best} PARENT_SCOPE)
+endfunction()
+
+
+# 1. Referência
+message(STATUS "pgo: build de referência")
+vc_pgo_build("${VC_PGO_BUILD}/base")
+vc_pgo_run("${VC_PGO_BUILD}/base" ${VC_PGO_RUNS} base_us)
+
+# 2. Instrumentação e treino (perfis antigos são descartados)
+message(STATUS "pgo: build instrumentada e treino")
+file(REMOVE_RECURSE "${VC_PGO_PROFILES}")
+file(MAKE_DIRECTORY "${VC_PGO_PROFILES}")
+vc_pgo_build("${VC_PGO_BUILD}/pgo" -DVC_PGO=GENERATE "-DVC_PGO_DIR=${VC_PGO_PROFILES}")
+vc_pgo_run("${VC_PGO_BUILD}/pgo" 1 train_us)
+
+# Clang: juntar os .profraw no .profdata lido por VC_PGO=USE
+file(GLOB profraw "${VC_PGO_PROFILES}/*.profraw")
+if(profraw)
+  find_program(LLVM_PROFDATA NAMES llvm-profdata)
+  if(NOT LLVM_PROFDATA)
+    message(FATAL_ERROR "pgo: llvm-profdata não encontrado")
+  endif()
+  execute_process(COMMAND "${LLVM_PROFDATA}" merge -o "${VC_PGO_PROFILES}/vc.profdata" ${profraw}
+                  RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pgo: llvm-profdata merge falhou")
+  endif()
+endif()
+
+# 3. Build final com o perfil
+message(STATUS "pgo: build optimizada com o perfil")
+vc_pgo_build("${VC_PGO_BUILD}/pgo" -DVC_PGO=USE "-DVC_PGO_DIR=${VC_PGO_PROFILES}")
+vc_pgo_run("${VC_PGO_BUILD}/pgo" ${VC_PGO_RUNS} pgo_us)
+
+math(EXPR speedup "${base_us} * 1000 / ${pgo_us}")
+math(EXPR speedup_int "${speedup} / 1000")
+math(EXPR speedup_frac "${speedup} % 1000")
+string(LENGTH "${speedup_frac}" len)
+while(len LESS 3)
+  set(speedup_frac "0${speedup_frac}")
+  string(LENGTH "${speedup_frac}" len)
+endwhile()
+
+message(STATUS "pgo: referência ${base_us} us/frame, PGO ${pgo_us} us/frame, ganho ${speedup_int}.${speedup_frac}x")
+message(STATUS "pgo: vc_bench optimizado em ${VC_PGO_BUILD}/pgo; perfis em ${VC_PGO_PROFILES}")
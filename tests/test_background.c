@@ -0,0 +1,62 @@
+// Modelo de fundo (VCBACKGROUND) actualizado com a mscara do primeiro plano, como na aplicao de vdeo:
+// - um objecto presente na primeira frame (que fica no modelo) deixa de ser primeiro plano ao fim de algum tempo;
+// - um objecto que acabou de chegar continua a ser primeiro plano nas frames seguintes.
+
+#include "vc_test.h"
+
+#define WIDTH	96
+#define HEIGHT	64
+
+static const unsigned char coin[3] = { 220, 180, 60 };
+
+// Corre nframes frames iguais a frame, com actualizao mascarada; devolve os pixis de primeiro plano da ltima
+static int test_run(VCBACKGROUND* bg, IVC* frame, IVC* fg, int nframes)
+{
+	int i, n = -1;
+
+	for (i = 0; i < nframes; i++)
+	{
+		if (!vc_background_foreground(bg, frame, fg, 30)) return -1;
+		n = vc_test_count(fg);
+		if (!vc_background_update(bg, frame, fg)) return -1;
+	}
+
+	return n;
+}
+
+static int test_mode(int mode, int param, int nframes)
+{
+	IVC* frame = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	IVC* fg = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	VCBACKGROUND* bg = vc_background_new(WIDTH, HEIGHT, 3, mode, param);
+
+	VC_CHECK((frame != NULL) && (fg != NULL) && (bg != NULL));
+
+	// Primeira frame com uma moeda, que fica no modelo
+	vc_test_fill(frame, 40);
+	vc_test_disk(frame, 30, 30, 10, coin);
+	VC_CHECK(vc_background_update(bg, frame, NULL));
+
+	// A moeda sai: o stio onde estava  primeiro plano, at o modelo o absorver
+	vc_test_fill(frame, 40);
+	VC_CHECK(test_run(bg, frame, fg, 1) > 250);
+	VC_CHECK(test_run(bg, frame, fg, nframes) == 0);
+
+	// Chega outra moeda: continua a ser primeiro plano nas frames seguintes
+	vc_test_disk(frame, 70, 30, 10, coin);
+	VC_CHECK(test_run(bg, frame, fg, 20) > 250);
+
+	vc_image_free(frame);
+	vc_image_free(fg);
+	VC_CHECK(vc_background_free(bg) == NULL);
+
+	return 0;
+}
+
+int main(void)
+{
+	if (test_mode(VC_BACKGROUND_AVERAGE, 3, 400)) return 1;
+	if (test_mode(VC_BACKGROUND_MEDIAN, 5, 2 * VC_BACKGROUND_REFRESH)) return 1;
+
+	return 0;
+}
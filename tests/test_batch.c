@@ -0,0 +1,77 @@
+// A segmentao em lote (com pool e nthreads, ou com as threads de um contexto) d, frame a frame,
+// o mesmo resultado que o processamento em srie: vc_rgb_to_hsv -> vc_hsv_segmentation -> abertura
+
+#include "vc_test.h"
+
+#define NFRAMES	5
+
+static const unsigned char gold[3] = { 200, 160, 40 };
+
+int main(void)
+{
+	static const int kernels[2] = { 1, 5 };
+	IVC* frames[NFRAMES];
+	IVC* masks[NFRAMES];
+	IVC* ref[NFRAMES];
+	IVCPOOL pool;
+	VCCONTEXT* ctx = vc_context_new(3);
+	int i, k, nthreads;
+
+	if (ctx == NULL) return 1;
+	vc_pool_init(&pool);
+
+	// Frames de tamanhos diferentes, com os discos em posies diferentes
+	for (i = 0; i < NFRAMES; i++)
+	{
+		frames[i] = vc_image_new(97 + 13 * i, 61 + 7 * i, 3, 255);
+		masks[i] = vc_image_new(frames[i]->width, frames[i]->height, 1, 255);
+		ref[i] = vc_image_new(frames[i]->width, frames[i]->height, 1, 255);
+		if ((frames[i] == NULL) || (masks[i] == NULL) || (ref[i] == NULL)) return 1;
+
+		vc_test_noise(frames[i], 100u + i);
+		vc_test_disk(frames[i], 20 + 9 * i, 30, 12 + i, gold);
+		vc_test_disk(frames[i], frames[i]->width - 15, frames[i]->height - 10, 10, gold);
+	}
+
+	for (k = 0; k < 2; k++)
+	{
+		// Referncia em srie
+		for (i = 0; i < NFRAMES; i++)
+		{
+			IVC* hsv = vc_image_new(frames[i]->width, frames[i]->height, 3, 255);
+			IVC* seg = vc_image_new(frames[i]->width, frames[i]->height, 1, 255);
+			IVC* ero = vc_image_new(frames[i]->width, frames[i]->height, 1, 255);
+
+			VC_CHECK(vc_rgb_to_hsv(frames[i], hsv));
+			VC_CHECK(vc_hsv_segmentation(hsv, (kernels[k] > 1) ? seg : ref[i], 30, 60, 50, 100, 50, 100));
+			if (kernels[k] > 1) VC_CHECK(vc_binary_erode(seg, ero, kernels[k]) && vc_binary_dilate(ero, ref[i], kernels[k]));
+			VC_CHECK(vc_test_count(ref[i]) > 0);
+
+			vc_image_free(hsv);
+			vc_image_free(seg);
+			vc_image_free(ero);
+		}
+
+		for (nthreads = 1; nthreads <= 3; nthreads++)
+		{
+			for (i = 0; i < NFRAMES; i++) vc_test_fill(masks[i], 77);
+			VC_CHECK(vc_batch_hsv_segmentation(&pool, frames, masks, NFRAMES, 30, 60, 50, 100, 50, 100, kernels[k], nthreads));
+			for (i = 0; i < NFRAMES; i++) VC_CHECK(vc_test_diff(ref[i], masks[i]) == 0);
+		}
+
+		for (i = 0; i < NFRAMES; i++) vc_test_fill(masks[i], 77);
+		VC_CHECK(vc_batch_hsv_segmentation_ctx(ctx, frames, masks, NFRAMES, 30, 60, 50, 100, 50, 100, kernels[k]));
+		for (i = 0; i < NFRAMES; i++) VC_CHECK(vc_test_diff(ref[i], masks[i]) == 0);
+	}
+
+	for (i = 0; i < NFRAMES; i++)
+	{
+		vc_image_free(frames[i]);
+		vc_image_free(masks[i]);
+		vc_image_free(ref[i]);
+	}
+	vc_pool_free(&pool);
+	vc_context_free(ctx);
+
+	return 0;
+}
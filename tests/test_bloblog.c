@@ -0,0 +1,105 @@
+// Registo de blobs (vc_bloblog_*): os blobs escritos so lidos tal e qual, por ndice, e uma frame sem blobs
+// distingue-se de um erro (vc_bloblog_read() devolve 1 com nblobs = 0). Um ficheiro sem ndice (escrita
+// interrompida)  reaberto com o ndice reconstrudo, sem a ltima frame se esta ficou incompleta.
+
+#include "vc_test.h"
+
+#define FILENAME	"test_bloblog.vcb"
+#define TRUNCATED	"test_bloblog_cut.vcb"
+
+// Bytes at ao fim da ltima frame: header (16) + frames 100 (12 + 3 x 36), 101 (12) e 102 (12 + 2 x 36)
+#define FRAMESEND	(16 + 120 + 12 + 84)
+
+// Copia os primeiros size bytes de src para dst (ficheiro deixado a meio)
+static int test_truncate(const char* src, const char* dst, long size)
+{
+	unsigned char data[FRAMESEND];
+	FILE* in = fopen(src, "rb");
+	FILE* out = fopen(dst, "wb");
+	int ok = (in != NULL) && (out != NULL) && (size <= FRAMESEND) &&
+		(fread(data, 1, size, in) == (size_t)size) && (fwrite(data, 1, size, out) == (size_t)size);
+
+	if (in != NULL) fclose(in);
+	if (out != NULL) fclose(out);
+
+	return ok;
+}
+
+int main(void)
+{
+	char filename[] = FILENAME;
+	char truncated[] = TRUNCATED;
+	OVC written[3], * blobs;
+	VCBLOBLOG* log;
+	int i, frame, nblobs;
+
+	memset(written, 0, sizeof(written));
+	for (i = 0; i < 3; i++)
+	{
+		written[i].x = 10 * i;
+		written[i].y = 20 + i;
+		written[i].width = 5 + i;
+		written[i].height = 7;
+		written[i].area = 30 + i;
+		written[i].xc = written[i].x + 2;
+		written[i].yc = written[i].y + 3;
+		written[i].perimeter = 24;
+		written[i].label = i + 1;
+	}
+
+	// Frames 100 (3 blobs), 101 (nenhum) e 102 (2 blobs)
+	log = vc_bloblog_create(filename);
+	VC_CHECK(log != NULL);
+	VC_CHECK(vc_bloblog_append(log, 100, written, 3));
+	VC_CHECK(vc_bloblog_append(log, 101, NULL, 0));
+	VC_CHECK(vc_bloblog_append(log, 102, written, 2));
+	VC_CHECK(vc_bloblog_close(log));
+
+	log = vc_bloblog_open(filename);
+	VC_CHECK((log != NULL) && (vc_bloblog_nframes(log) == 3));
+
+	VC_CHECK(vc_bloblog_read(log, 0, &frame, &blobs, &nblobs));
+	VC_CHECK((frame == 100) && (nblobs == 3) && (blobs != NULL));
+	for (i = 0; i < 3; i++)
+	{
+		VC_CHECK((blobs[i].x == written[i].x) && (blobs[i].y == written[i].y) && (blobs[i].width == written[i].width));
+		VC_CHECK((blobs[i].area == written[i].area) && (blobs[i].xc == written[i].xc) && (blobs[i].label == written[i].label));
+	}
+	free(blobs);
+
+	// Frame vazia: sucesso, sem array
+	VC_CHECK(vc_bloblog_read(log, 1, &frame, &blobs, &nblobs));
+	VC_CHECK((frame == 101) && (nblobs == 0) && (blobs == NULL));
+
+	// Acesso directo fora de ordem
+	VC_CHECK(vc_bloblog_read(log, 2, &frame, &blobs, &nblobs));
+	VC_CHECK((frame == 102) && (nblobs == 2) && (blobs[1].label == 2));
+	free(blobs);
+
+	// Erros: ndice fora do registo
+	VC_CHECK(!vc_bloblog_read(log, 3, &frame, &blobs, &nblobs) && (blobs == NULL) && (nblobs == 0));
+	VC_CHECK(!vc_bloblog_read(log, -1, &frame, &blobs, &nblobs));
+
+	VC_CHECK(vc_bloblog_close(log));
+
+	// Sem ndice nem trailer, mas com as frames todas: o ndice  reconstrudo
+	VC_CHECK(test_truncate(filename, truncated, FRAMESEND));
+	log = vc_bloblog_open(truncated);
+	VC_CHECK((log != NULL) && (vc_bloblog_nframes(log) == 3));
+	VC_CHECK(vc_bloblog_read(log, 2, &frame, &blobs, &nblobs) && (frame == 102) && (nblobs == 2));
+	free(blobs);
+	VC_CHECK(vc_bloblog_close(log));
+
+	// Escrita interrompida a meio dos registos da ltima frame: s as frames completas ficam no ndice
+	VC_CHECK(test_truncate(filename, truncated, FRAMESEND - 10));
+	log = vc_bloblog_open(truncated);
+	VC_CHECK((log != NULL) && (vc_bloblog_nframes(log) == 2));
+	VC_CHECK(vc_bloblog_read(log, 1, &frame, &blobs, &nblobs) && (frame == 101) && (nblobs == 0));
+	VC_CHECK(!vc_bloblog_read(log, 2, &frame, &blobs, &nblobs));
+	VC_CHECK(vc_bloblog_close(log));
+
+	remove(filename);
+	remove(truncated);
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+// Segmentao coarse-to-fine (vc_hsv_segmentation_coarse_to_fine e _ctx):
+// - numa cena com poucos objectos grandes, igual  segmentao  resoluo original;
+// - numa cena densa (mais de 254 blobs na imagem reduzida, a etiquetagem falha), tambm igual:
+//   no pode devolver sucesso com a mscara vazia.
+
+#include "vc_test.h"
+
+#define WIDTH	640
+#define HEIGHT	480
+
+static const unsigned char gold[3] = { 40, 200, 200 };	// HSV: H = 80 graus, S = 78%, V = 78%
+
+static int test_scene(IVC* hsv, IVCPOOL* pool, VCCONTEXT* ctx, int factor)
+{
+	IVC* ref = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* dst = vc_image_new(WIDTH, HEIGHT, 1, 255);
+
+	if ((ref == NULL) || (dst == NULL)) return 1;
+
+	VC_CHECK(vc_hsv_segmentation(hsv, ref, 60, 100, 50, 100, 50, 100));
+	VC_CHECK(vc_test_count(ref) > 0);
+
+	vc_test_fill(dst, 77);
+	VC_CHECK(vc_hsv_segmentation_coarse_to_fine(pool, hsv, dst, factor, 60, 100, 50, 100, 50, 100));
+	VC_CHECK(vc_test_diff(ref, dst) == 0);
+
+	vc_test_fill(dst, 77);
+	VC_CHECK(vc_hsv_segmentation_coarse_to_fine_ctx(ctx, hsv, dst, factor, 60, 100, 50, 100, 50, 100));
+	VC_CHECK(vc_test_diff(ref, dst) == 0);
+
+	vc_image_free(ref);
+	vc_image_free(dst);
+
+	return 0;
+}
+
+int main(void)
+{
+	IVC* hsv = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	VCCONTEXT* ctx = vc_context_new(1);
+	IVCPOOL pool;
+	int x, y, factor;
+
+	if ((hsv == NULL) || (ctx == NULL)) return 1;
+	vc_pool_init(&pool);
+
+	for (factor = 2; factor <= 4; factor += 2)
+	{
+		// Fundo fora do intervalo (H = 200 graus) com trs discos grandes
+		vc_test_fill(hsv, 100);
+		vc_test_disk(hsv, 100, 100, 40, gold);
+		vc_test_disk(hsv, 400, 300, 60, gold);
+		vc_test_disk(hsv, 600, 450, 25, gold);
+		if (test_scene(hsv, &pool, ctx, factor)) return 1;
+
+		// Cena densa: 1131 pontos 4x4 isolados (cada um  um blob na imagem reduzida)
+		vc_test_fill(hsv, 100);
+		for (y = 8; y < HEIGHT - 8; y += 16)
+		{
+			for (x = 8; x < WIDTH - 8; x += 16)
+			{
+				int k;
+
+				for (k = 0; k < 4; k++) memcpy(&hsv->data[(y + k) * hsv->bytesperline + x * 3], "\x28\xc8\xc8\x28\xc8\xc8\x28\xc8\xc8\x28\xc8\xc8", 12);
+			}
+		}
+		if (test_scene(hsv, &pool, ctx, factor)) return 1;
+	}
+
+	vc_image_free(hsv);
+	vc_pool_free(&pool);
+	vc_context_free(ctx);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+// Contornos de Freeman (vc_binary_blob_contour): a cadeia fecha no pixel inicial, s passa por pixis do blob
+// e visita todos os pixis do contorno exterior (os do blob vizinhos, em vizinhana 4, do fundo exterior).
+
+#include "vc_test.h"
+
+#define WIDTH	80
+#define HEIGHT	60
+
+static const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+// Fundo exterior do blob: pixis que no so do blob e esto ligados (vizinhana 4) ao rebordo da imagem
+static void test_outside(IVC* labels, int label, unsigned char* outside, int* stack)
+{
+	int x, y, k, n = 0;
+
+	memset(outside, 0, WIDTH * HEIGHT);
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < WIDTH; x++)
+		{
+			if (((x == 0) || (y == 0) || (x == WIDTH - 1) || (y == HEIGHT - 1)) && (labels->data[y * labels->bytesperline + x] != label))
+			{
+				outside[y * WIDTH + x] = 1;
+				stack[n++] = y * WIDTH + x;
+			}
+		}
+	}
+
+	while (n > 0)
+	{
+		int p = stack[--n];
+
+		for (k = 0; k < 8; k += 2)
+		{
+			x = p % WIDTH + dx[k];
+			y = p / WIDTH + dy[k];
+			if ((x < 0) || (y < 0) || (x >= WIDTH) || (y >= HEIGHT)) continue;
+			if (outside[y * WIDTH + x] || (labels->data[y * labels->bytesperline + x] == label)) continue;
+
+			outside[y * WIDTH + x] = 1;
+			stack[n++] = y * WIDTH + x;
+		}
+	}
+}
+
+static int test_blob(IVC* labels, OVC* blob, CHAINVC* chain, unsigned char* outside, unsigned char* visited, int* stack)
+{
+	int x, y, c, k, nvisited = 1, nboundary = 0;
+
+	VC_CHECK(vc_binary_blob_contour(labels, blob, chain));
+	if (blob->area == 1) VC_CHECK(chain->length == 0);
+
+	memset(visited, 0, WIDTH * HEIGHT);
+	x = chain->x;
+	y = chain->y;
+	visited[y * WIDTH + x] = 1;
+
+	for (c = 0; c < chain->length; c++)
+	{
+		VC_CHECK(chain->codes[c] < 8);
+		x += dx[chain->codes[c]];
+		y += dy[chain->codes[c]];
+		VC_CHECK(labels->data[y * labels->bytesperline + x] == blob->label);
+
+		if (!visited[y * WIDTH + x])
+		{
+			visited[y * WIDTH + x] = 1;
+			nvisited++;
+		}
+	}
+	VC_CHECK((x == chain->x) && (y == chain->y));
+
+	test_outside(labels, blob->label, outside, stack);
+	for (y = 1; y < HEIGHT - 1; y++)
+	{
+		for (x = 1; x < WIDTH - 1; x++)
+		{
+			int boundary = 0;
+
+			if (labels->data[y * labels->bytesperline + x] != blob->label) continue;
+			for (k = 0; k < 8; k += 2) boundary |= outside[(y + dy[k]) * WIDTH + x + dx[k]];
+			if (!boundary) continue;
+
+			nboundary++;
+			VC_CHECK(visited[y * WIDTH + x]);
+		}
+	}
+	VC_CHECK(nvisited == nboundary);
+
+	return 0;
+}
+
+int main(void)
+{
+	IVC* mask = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* labels = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	unsigned char* outside = (unsigned char*)malloc(WIDTH * HEIGHT);
+	unsigned char* visited = (unsigned char*)malloc(WIDTH * HEIGHT);
+	int* stack = (int*)malloc(WIDTH * HEIGHT * sizeof(int));
+	CHAINVC chain = { 0 };
+	unsigned int seed = 1u;
+	int it, i, k, nblobs;
+	OVC* blobs;
+
+	if ((mask == NULL) || (labels == NULL) || (outside == NULL) || (visited == NULL) || (stack == NULL)) return 1;
+
+	// Rectngulo 17x10: 2 x 16 passos horizontais e 2 x 9 verticais
+	vc_test_fill(mask, 0);
+	for (i = 5; i < 15; i++) memset(&mask->data[i * mask->bytesperline + 3], 255, 17);
+	blobs = vc_binary_blob_labelling(mask, labels, &nblobs);
+	VC_CHECK((blobs != NULL) && (nblobs == 1));
+	VC_CHECK(vc_binary_blob_info(labels, blobs, nblobs));
+	VC_CHECK(vc_binary_blob_contour(labels, &blobs[0], &chain));
+	VC_CHECK(chain.length == 2 * 16 + 2 * 9);
+	VC_CHECK((chain.perimeter > 49.99f) && (chain.perimeter < 50.01f));
+	free(blobs);
+
+	// Formas aleatrias: quadrados sobrepostos, alguns com furos e pixis soltos
+	for (it = 0; it < 300; it++)
+	{
+		vc_test_fill(mask, 0);
+		for (k = 0; k < 1 + it % 12; k++)
+		{
+			int x0, y0, s, x, y;
+
+			seed = seed * 1103515245u + 12345u;
+			x0 = (seed >> 16) % WIDTH;
+			y0 = (seed >> 8) % HEIGHT;
+			s = 1 + (seed >> 24) % ((it % 3) ? 6 : 20);
+
+			for (y = y0; (y < y0 + s) && (y < HEIGHT); y++)
+			{
+				for (x = x0; (x < x0 + s) && (x < WIDTH); x++)
+				{
+					seed = seed * 1103515245u + 12345u;
+					if ((it % 3 != 2) || ((seed >> 16) % 3)) mask->data[y * mask->bytesperline + x] = 255;
+				}
+			}
+		}
+
+		blobs = vc_binary_blob_labelling(mask, labels, &nblobs);
+		if (nblobs == 0) continue;
+		VC_CHECK(blobs != NULL);
+		VC_CHECK(vc_binary_blob_info(labels, blobs, nblobs));
+
+		for (i = 0; i < nblobs; i++)
+		{
+			if (test_blob(labels, &blobs[i], &chain, outside, visited, stack)) return 1;
+		}
+		free(blobs);
+	}
+
+	vc_chain_free(&chain);
+	vc_image_free(mask);
+	vc_image_free(labels);
+	free(outside);
+	free(visited);
+	free(stack);
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+// Crculos de Hough (vc_gray_hough_circles) sobre discos sintticos: duas moedas encostadas, uma moeda grande e
+// uma pequena do exactamente quatro crculos, sem fantasmas na juno nem dentro do disco grande, com ou sem
+// contexto. A largura mpar da imagem exercita o alinhamento da memria de trabalho (correr com -fsanitize).
+
+#include "vc_test.h"
+
+#define WIDTH	321
+#define HEIGHT	241
+#define NDISKS	4
+
+static const int disks[NDISKS][3] = { { 60, 70, 25 }, { 108, 70, 25 }, { 200, 90, 30 }, { 270, 190, 20 } };
+
+static int test_circles(VCCONTEXT* ctx, IVC* gray, OVC* blobs, int nblobs, float minsupport)
+{
+	CIRCLEVC circles[32];
+	int ncircles, i, k, found;
+
+	VC_CHECK(vc_gray_hough_circles(ctx, gray, blobs, nblobs, 10, 40, 60.0f, minsupport, circles, 32, &ncircles));
+	VC_CHECK(ncircles == NDISKS);
+
+	// Cada disco tem um crculo com centro e raio a menos de 2 pixis
+	for (k = 0; k < NDISKS; k++)
+	{
+		for (i = 0, found = 0; i < ncircles; i++)
+		{
+			if ((abs(circles[i].x - disks[k][0]) <= 2) && (abs(circles[i].y - disks[k][1]) <= 2) && (abs(circles[i].r - disks[k][2]) <= 2)) found++;
+		}
+		VC_CHECK(found == 1);
+	}
+
+	// Etiqueta do blob de cada disco (as duas moedas encostadas partilham o blob)
+	for (i = 0; i < ncircles; i++)
+	{
+		for (k = 0, found = 0; k < nblobs; k++) found += (blobs[k].label == circles[i].label) && (circles[i].x >= blobs[k].x) && (circles[i].x < blobs[k].x + blobs[k].width);
+		VC_CHECK((found == 1) && (circles[i].votes > 0));
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned char white = 255, bright = 180, dim = 140;
+	IVC* gray = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* mask = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* labels = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	VCCONTEXT* ctx = vc_context_new(1);
+	CIRCLEVC circles[4];
+	OVC* blobs;
+	int nblobs, ncircles, k;
+
+	if ((gray == NULL) || (mask == NULL) || (labels == NULL) || (ctx == NULL)) return 1;
+
+	vc_test_fill(gray, 60);
+	vc_test_fill(mask, 0);
+	for (k = 0; k < NDISKS; k++)
+	{
+		vc_test_disk(gray, disks[k][0], disks[k][1], disks[k][2], (k == 3) ? &dim : &bright);
+		vc_test_disk(mask, disks[k][0], disks[k][1], disks[k][2], &white);
+	}
+
+	// As moedas encostadas formam um s blob
+	blobs = vc_binary_blob_labelling(mask, labels, &nblobs);
+	VC_CHECK((blobs != NULL) && (nblobs == 3));
+	VC_CHECK(vc_binary_blob_info(labels, blobs, nblobs));
+
+	if (test_circles(NULL, gray, blobs, nblobs, 0.4f)) return 1;
+	if (test_circles(NULL, gray, blobs, nblobs, 0.6f)) return 1;
+	if (test_circles(ctx, gray, blobs, nblobs, 0.4f)) return 1;
+	if (test_circles(ctx, gray, blobs, nblobs, 0.6f)) return 1;
+
+	// O suporte  uma fraco do permetro: acima de 1 nenhum crculo  aceite
+	VC_CHECK(vc_gray_hough_circles(NULL, gray, blobs, nblobs, 10, 40, 60.0f, 1.01f, circles, 4, &ncircles));
+	VC_CHECK(ncircles == 0);
+
+	// Sem espao, sem blobs e com parmetros invlidos
+	VC_CHECK(vc_gray_hough_circles(NULL, gray, blobs, nblobs, 10, 40, 60.0f, 0.4f, circles, 0, &ncircles) && (ncircles == 0));
+	VC_CHECK(vc_gray_hough_circles(NULL, gray, NULL, 0, 10, 40, 60.0f, 0.4f, circles, 4, &ncircles) && (ncircles == 0));
+	VC_CHECK(!vc_gray_hough_circles(NULL, gray, blobs, nblobs, 1, 40, 60.0f, 0.4f, circles, 4, &ncircles));
+
+	free(blobs);
+	vc_image_free(gray);
+	vc_image_free(mask);
+	vc_image_free(labels);
+	vc_context_free(ctx);
+
+	return 0;
+}
@@ -0,0 +1,40 @@
+// Camada C++ (vc.hpp): vc::image e vc::context libertam o que possuem, podem ser movidos e servem
+// directamente s funes vc_*.
+
+#include "vc_test.h"
+
+#define WIDTH	97
+#define HEIGHT	61
+
+static int test_ownership(void)
+{
+	vc::image a(WIDTH, HEIGHT, 3);
+	IVC* raw = a.get();
+	vc::image b(std::move(a));
+	vc::context ctx(1);
+
+	VC_CHECK(!a && (b.get() == raw) && (b->channels == 3));
+
+	a = std::move(b);
+	VC_CHECK((a.get() == raw) && !b);
+
+	// release() devolve a posse ao chamador
+	raw = a.release();
+	VC_CHECK(!a && (raw != NULL));
+	vc_image_free(raw);
+
+	// O contexto serve s verses _ctx
+	vc::image mask(WIDTH, HEIGHT, 1), out(WIDTH, HEIGHT, 1);
+	VC_CHECK(ctx && mask && out);
+	vc_test_fill(mask, 255);
+	VC_CHECK(vc_binary_erode_ctx(ctx, mask, out, 3) && (vc_test_count(out) == WIDTH * HEIGHT));
+
+	return 0;
+}
+
+int main(void)
+{
+	if (test_ownership()) return 1;
+
+	return 0;
+}
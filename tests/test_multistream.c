@@ -0,0 +1,124 @@
+// Vrias streams com threads partilhadas (vc_multistream): uma stream pesada e uma leve, com 1 e 3 threads.
+// done() recebe as frames de cada stream pela ordem de submisso e com o contedo certo, as estatsticas
+// batem com o que foi submetido, e com uma s thread (cuja stream prpria  a pesada) a stream leve no
+// fica  espera que a pesada acabe: o escalonamento reparte o tempo de CPU entre as duas.
+
+#include "vc_test.h"
+
+#define NSTREAMS	2
+#define NFRAMES		30
+#define FAILFRAME	3		// Frame da stream leve em que process() falha
+
+static const int widths[NSTREAMS] = { 1280, 64 };
+static const int heights[NSTREAMS] = { 960, 48 };
+
+typedef struct {
+	int nthreads;
+	int next[NSTREAMS];		// Prxima frame esperada em done() (cada stream  entregue por uma thread de cada vez)
+	int errors[NSTREAMS];
+	int heavy;				// Frames da stream pesada entregues quando a leve entregou a ltima (s com 1 thread)
+} VCTESTAPP;
+
+static int test_process(void* arg, VCCONTEXT* ctx, int stream, int frame, IVC* image)
+{
+	IVC* tmp = vc_context_image_get(ctx, image->width, image->height, 1, 255);
+	int ok = (tmp != NULL) && (image->data[0] == (unsigned char)frame);
+	int i;
+
+	(void)arg;
+
+	// O mesmo trabalho por pixel nas duas streams: a pesada tem 400 vezes mais pixis
+	for (i = 0; ok && (i < 4); i++) ok = vc_binary_erode_ctx(ctx, image, tmp, 9);
+	vc_context_image_release(ctx, tmp);
+
+	return ok && !((stream == 1) && (frame == FAILFRAME));
+}
+
+static void test_done(void* arg, int stream, int frame, IVC* image, int ok)
+{
+	VCTESTAPP* app = (VCTESTAPP*)arg;
+
+	if (frame != app->next[stream]) app->errors[stream]++;
+	if (image->data[0] != (unsigned char)frame) app->errors[stream]++;
+	if (ok != !((stream == 1) && (frame == FAILFRAME))) app->errors[stream]++;
+	app->next[stream] = frame + 1;
+
+	if ((app->nthreads == 1) && (stream == 1) && (frame == NFRAMES - 1)) app->heavy = app->next[0];
+}
+
+static int test_run(int nthreads, int depth)
+{
+	VCTESTAPP app;
+	VCSTREAMSTATS stats[NSTREAMS];
+	VCMULTISTREAM* ms;
+	IVC* image;
+	int f, s;
+
+	memset(&app, 0, sizeof(app));
+	app.nthreads = nthreads;
+
+	ms = vc_multistream_new(NSTREAMS, nthreads, depth, test_process, test_done, &app);
+	VC_CHECK(ms != NULL);
+
+	// As duas streams so alimentadas ao mesmo ritmo (acquire bloqueia quando o anel de uma est cheio).
+	// O preenchimento  rpido, para que as frames fiquem  espera das threads e no do produtor.
+	for (f = 0; f < NFRAMES; f++)
+	{
+		for (s = 0; s < NSTREAMS; s++)
+		{
+			image = vc_multistream_acquire(ms, s, widths[s], heights[s], 1);
+			VC_CHECK(image != NULL);
+			vc_test_fill(image, (unsigned char)(37 * f + s));
+			image->data[0] = (unsigned char)f;
+			VC_CHECK(vc_multistream_submit(ms, s, image) == f);
+		}
+	}
+
+	VC_CHECK(vc_multistream_wait(ms));
+
+	for (s = 0; s < NSTREAMS; s++)
+	{
+		VC_CHECK((app.next[s] == NFRAMES) && (app.errors[s] == 0));
+
+		VC_CHECK(vc_multistream_stats(ms, s, &stats[s]));
+		VC_CHECK((stats[s].frames == NFRAMES) && (stats[s].pending == 0));
+		VC_CHECK(stats[s].failed == ((s == 1) ? 1 : 0));
+		VC_CHECK((stats[s].fps > 0.0) && (stats[s].latency > 0.0) && (stats[s].latency_max >= stats[s].latency));
+		VC_CHECK(stats[s].busy > 0.0);
+	}
+	VC_CHECK(stats[0].busy > stats[1].busy);
+
+	// Com a stream pesada sempre  espera, uma thread que s servisse a sua stream (a 0) acabava-a antes de
+	// comear a leve; com o tempo repartido, a leve acaba quando a pesada ainda vai no incio
+	if (nthreads == 1) VC_CHECK(app.heavy < NFRAMES / 2);
+
+	ms = vc_multistream_free(ms);
+	VC_CHECK(ms == NULL);
+
+	return 0;
+}
+
+int main(void)
+{
+	VCMULTISTREAM* ms = vc_multistream_new(NSTREAMS, 1, 2, test_process, NULL, NULL);
+	IVC* image;
+
+	// Argumentos invlidos e submisses fora de ordem
+	VC_CHECK(ms != NULL);
+	VC_CHECK(vc_multistream_new(0, 1, 2, test_process, NULL, NULL) == NULL);
+	VC_CHECK(vc_multistream_acquire(ms, NSTREAMS, 8, 8, 1) == NULL);
+	image = vc_multistream_acquire(ms, 0, 8, 8, 1);
+	VC_CHECK(image != NULL);
+	VC_CHECK(vc_multistream_submit(ms, 1, image) == -1);
+	image->data[0] = 0;
+	VC_CHECK(vc_multistream_submit(ms, 0, image) == 0);
+	VC_CHECK(vc_multistream_submit(ms, 0, image) == -1);
+	ms = vc_multistream_free(ms);
+
+	// Todas as frames submetidas de uma vez (anel com NFRAMES), e anel pequeno (o produtor espera)
+	if (test_run(1, NFRAMES)) return 1;
+	if (test_run(3, NFRAMES)) return 1;
+	if (test_run(3, 2)) return 1;
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+// Imagens PBM (P4): vc_write_image compacta cada linha (8 pixis de cada vez, 16 com SSE2) exactamente como uma
+// compactao bit a bit, incluindo o ltimo byte incompleto de larguras que no so mltiplas de 8 ou 16, e
+// vc_read_image devolve a imagem escrita (qualquer valor diferente de 0  branco, 1).
+
+#include "vc_test.h"
+
+#define FILENAME	"test_pbm.pbm"
+#define NWIDTHS		24
+#define HEIGHT		5
+#define MAXBYTES	(((130 + 7) / 8) * HEIGHT)
+
+static const int widths[NWIDTHS] = { 1, 2, 3, 5, 7, 8, 9, 12, 15, 16, 17, 23, 24, 25, 31, 32, 33, 47, 48, 63, 65, 97, 127, 130 };
+
+// Compactao de referncia: bit a 1 = preto (pixel a 0), primeiro pixel no bit mais significativo
+static int test_pack(IVC* image, unsigned char* bits)
+{
+	int rowbytes = (image->width + 7) / 8;
+	int x, y;
+
+	memset(bits, 0, rowbytes * image->height);
+	for (y = 0; y < image->height; y++)
+	{
+		for (x = 0; x < image->width; x++)
+		{
+			if (image->data[y * image->bytesperline + x] == 0) bits[y * rowbytes + x / 8] |= 0x80 >> (x % 8);
+		}
+	}
+
+	return rowbytes * image->height;
+}
+
+static int test_width(int width, unsigned int seed)
+{
+	char filename[] = FILENAME;
+	unsigned char expected[MAXBYTES], written[MAXBYTES + 1];
+	char header[32];
+	IVC* image = vc_image_new(width, HEIGHT, 1, 1);
+	IVC* read;
+	FILE* file;
+	int nbytes, x, y;
+
+	VC_CHECK(image != NULL);
+
+	// Pretos, brancos a 1 e brancos com outros valores (o resto do rudo)
+	vc_test_noise(image, seed);
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			unsigned char* p = &image->data[y * image->bytesperline + x];
+
+			*p = (*p < 96) ? 0 : ((*p < 192) ? 1 : *p);
+		}
+	}
+	nbytes = test_pack(image, expected);
+
+	VC_CHECK(vc_write_image(filename, image));
+
+	// Header "P4 <largura> <altura>\n" seguido dos bytes compactados, nem mais nem menos
+	sprintf(header, "P4 %d %d\n", width, HEIGHT);
+	file = fopen(filename, "rb");
+	VC_CHECK(file != NULL);
+	VC_CHECK(fread(written, 1, strlen(header), file) == strlen(header));
+	VC_CHECK(memcmp(written, header, strlen(header)) == 0);
+	VC_CHECK(fread(written, 1, sizeof(written), file) == (size_t)nbytes);
+	fclose(file);
+	VC_CHECK(memcmp(written, expected, nbytes) == 0);
+
+	read = vc_read_image(filename);
+	VC_CHECK((read != NULL) && (read->width == width) && (read->height == HEIGHT) && (read->channels == 1) && (read->levels == 1));
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			VC_CHECK(read->data[y * read->bytesperline + x] == (image->data[y * image->bytesperline + x] != 0));
+		}
+	}
+
+	vc_image_free(image);
+	vc_image_free(read);
+	remove(filename);
+
+	return 0;
+}
+
+int main(void)
+{
+	int i;
+
+	for (i = 0; i < NWIDTHS; i++)
+	{
+		if (test_width(widths[i], 3u * i + 1)) return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+// Leitura antecipada (vc_prefetch_*) com uma fonte sinttica: as frames chegam pela ordem da fonte, com a converso
+// BGR -> RGB e o HSV iguais aos das funes vc_*, o fim da fonte d NULL e close() sem erro, um erro de decode()
+//  devolvido por close(), e fechar a meio (com a thread de descodificao  espera de espao no anel) no bloqueia.
+
+#include "vc_test.h"
+
+#define WIDTH	67
+#define HEIGHT	23
+#define NFRAMES	12
+
+// Fonte sinttica: a frame k  rudo com a seed k, escrito em BGR ou RGB
+typedef struct {
+	int bgr;
+	int failat;				// decode() devolve -1 nesta frame (-1 = nunca)
+	int calls;				// Chamadas a decode() (lido depois de close())
+} VCTESTSOURCE;
+
+static void test_frame(IVC* rgb, int k)
+{
+	vc_test_noise(rgb, 1000u + k);
+}
+
+static int test_decode(void* arg, IVC* image)
+{
+	VCTESTSOURCE* source = (VCTESTSOURCE*)arg;
+	int k = source->calls++;
+
+	if (k == source->failat) return -1;
+	if (k >= NFRAMES) return 0;
+
+	test_frame(image, k);
+	if (source->bgr) vc_bgr_to_rgb(image, image);
+
+	return 1;
+}
+
+static int test_read(int depth, int flags)
+{
+	VCTESTSOURCE source = { (flags & VC_PREFETCH_BGR) != 0, -1, 0 };
+	IVC* rgb = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	IVC* hsv = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	VCPREFETCH* pf = vc_prefetch_open(WIDTH, HEIGHT, depth, flags, test_decode, &source);
+	VCFRAME* frame;
+	int k;
+
+	VC_CHECK((rgb != NULL) && (hsv != NULL) && (pf != NULL));
+
+	for (k = 0; k < NFRAMES; k++)
+	{
+		frame = vc_prefetch_read(pf);
+		VC_CHECK((frame != NULL) && (frame->number == k));
+
+		test_frame(rgb, k);
+		VC_CHECK(vc_test_diff(frame->rgb, rgb) == 0);
+
+		if (flags & VC_PREFETCH_HSV)
+		{
+			VC_CHECK(vc_rgb_to_hsv(rgb, hsv) && (frame->hsv != NULL) && (vc_test_diff(frame->hsv, hsv) == 0));
+		}
+		else VC_CHECK(frame->hsv == NULL);
+	}
+
+	VC_CHECK(vc_prefetch_read(pf) == NULL);
+	VC_CHECK(vc_prefetch_read(pf) == NULL);
+	VC_CHECK(vc_prefetch_wait_ms(pf) >= 0.0);
+	VC_CHECK(vc_prefetch_close(pf));
+	VC_CHECK(source.calls == NFRAMES + 1);
+
+	vc_image_free(rgb);
+	vc_image_free(hsv);
+
+	return 0;
+}
+
+int main(void)
+{
+	VCTESTSOURCE source = { 0, 3, 0 };
+	VCPREFETCH* pf;
+	int k;
+
+	VC_CHECK(vc_prefetch_open(WIDTH, HEIGHT, 2, 0, NULL, NULL) == NULL);
+
+	if (test_read(2, 0)) return 1;
+	if (test_read(2, VC_PREFETCH_BGR | VC_PREFETCH_HSV)) return 1;
+	if (test_read(4, VC_PREFETCH_BGR)) return 1;
+	if (test_read(4, VC_PREFETCH_HSV)) return 1;
+
+	// Erro na frame 3: as anteriores so entregues e close() devolve 0
+	pf = vc_prefetch_open(WIDTH, HEIGHT, 4, VC_PREFETCH_HSV, test_decode, &source);
+	VC_CHECK(pf != NULL);
+	for (k = 0; k < 3; k++) VC_CHECK(vc_prefetch_read(pf) != NULL);
+	VC_CHECK(vc_prefetch_read(pf) == NULL);
+	VC_CHECK(!vc_prefetch_close(pf));
+
+	// Fechar com a fonte a meio: a thread pra sem descodificar o resto
+	source.failat = -1;
+	source.calls = 0;
+	pf = vc_prefetch_open(WIDTH, HEIGHT, 2, VC_PREFETCH_BGR, test_decode, &source);
+	VC_CHECK((pf != NULL) && (vc_prefetch_read(pf) != NULL));
+	VC_CHECK(vc_prefetch_close(pf));
+	VC_CHECK(source.calls <= 3);
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+// Cada nvel SIMD suportado pelo CPU d exactamente o mesmo resultado que a verso escalar:
+// RGB -> HSV (entrelaado e planar), segmentao planar, threshold, eroso/dilatao, Sobel e diferena ao fundo.
+// Larguras mpares para exercitar as caudas escalares dos ciclos vectoriais.
+
+#include "vc_test.h"
+
+#define WIDTH	333
+#define HEIGHT	61
+
+typedef struct {
+	IVC* hsv;
+	IVCPLANAR* planar;
+	IVC* seg;
+	IVC* binary;
+	IVC* erode[2];
+	IVC* dilate[2];
+	IVC* sobel;
+	IVC* magnitude;
+	IVC* foreground;
+} VCTESTOUT;
+
+static int test_outputs_new(VCTESTOUT* out)
+{
+	int k;
+
+	out->hsv = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	out->planar = vc_planar_new(WIDTH, HEIGHT, 3, 255);
+	out->seg = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	out->binary = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	for (k = 0; k < 2; k++)
+	{
+		out->erode[k] = vc_image_new(WIDTH, HEIGHT, 1, 255);
+		out->dilate[k] = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	}
+	out->sobel = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	out->magnitude = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	out->foreground = vc_image_new(WIDTH, HEIGHT, 1, 255);
+
+	return (out->hsv != NULL) && (out->planar != NULL) && (out->seg != NULL) && (out->binary != NULL) && (out->sobel != NULL) &&
+		(out->magnitude != NULL) && (out->foreground != NULL) && (out->erode[1] != NULL) && (out->dilate[1] != NULL);
+}
+
+static void test_outputs_free(VCTESTOUT* out)
+{
+	int k;
+
+	vc_image_free(out->hsv);
+	vc_planar_free(out->planar);
+	vc_image_free(out->seg);
+	vc_image_free(out->binary);
+	for (k = 0; k < 2; k++)
+	{
+		vc_image_free(out->erode[k]);
+		vc_image_free(out->dilate[k]);
+	}
+	vc_image_free(out->sobel);
+	vc_image_free(out->magnitude);
+	vc_image_free(out->foreground);
+}
+
+// Corre todas as funes com o nvel actual
+static int test_run(IVC* rgb, IVC* gray, VCBACKGROUND* bg, VCTESTOUT* out)
+{
+	static const int kernels[2] = { 3, 7 };
+	int k;
+
+	VC_CHECK(vc_rgb_to_hsv(rgb, out->hsv));
+	VC_CHECK(vc_rgb_to_hsv_planar(rgb, out->planar));
+	VC_CHECK(vc_hsv_segmentation_planar(out->planar, out->seg, 30, 200, 10, 90, 20, 95));
+	VC_CHECK(vc_gray_to_binary(gray, out->binary, 127));
+	for (k = 0; k < 2; k++)
+	{
+		VC_CHECK(vc_binary_erode(out->binary, out->erode[k], kernels[k]));
+		VC_CHECK(vc_binary_dilate(out->binary, out->dilate[k], kernels[k]));
+	}
+	VC_CHECK(vc_gray_edge_sobel_ex(gray, out->sobel, 40.0f, out->magnitude, NULL));
+	VC_CHECK(vc_background_foreground(bg, rgb, out->foreground, 25));
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned char blob[3] = { 200, 200, 200 };
+	VCTESTOUT scalar, simd;
+	IVC* rgb = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	IVC* gray = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* scene = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	VCBACKGROUND* bg = vc_background_new(WIDTH, HEIGHT, 3, VC_BACKGROUND_AVERAGE, 0);
+	int best = vc_cpu_detect();
+	int tier;
+
+	if ((rgb == NULL) || (gray == NULL) || (scene == NULL) || (bg == NULL) || !test_outputs_new(&scalar) || !test_outputs_new(&simd)) return 1;
+
+	// Rudo com blobs grandes, para que a morfologia e o Sobel tenham regies e orlas
+	vc_test_noise(rgb, 1u);
+	vc_test_noise(scene, 2u);
+	vc_background_update(bg, scene, NULL);
+	vc_rgb_to_gray(rgb, gray);
+	vc_test_disk(gray, 80, 30, 20, blob);
+	vc_test_disk(gray, 250, 25, 28, blob);
+
+	vc_cpu_set_tier(VC_CPU_SCALAR);
+	if (test_run(rgb, gray, bg, &scalar)) return 1;
+
+	for (tier = VC_CPU_SSE2; tier <= best; tier++)
+	{
+		int k, c;
+
+		VC_CHECK(vc_cpu_set_tier(tier) == tier);
+		printf("nivel %s\n", vc_cpu_tier_name(tier));
+		if (test_run(rgb, gray, bg, &simd)) return 1;
+
+		VC_CHECK(vc_test_diff(scalar.hsv, simd.hsv) == 0);
+		for (c = 0; c < 3; c++) VC_CHECK(vc_test_diff(scalar.planar->plane[c], simd.planar->plane[c]) == 0);
+		VC_CHECK(vc_test_diff(scalar.seg, simd.seg) == 0);
+		VC_CHECK(vc_test_diff(scalar.binary, simd.binary) == 0);
+		for (k = 0; k < 2; k++)
+		{
+			VC_CHECK(vc_test_diff(scalar.erode[k], simd.erode[k]) == 0);
+			VC_CHECK(vc_test_diff(scalar.dilate[k], simd.dilate[k]) == 0);
+		}
+		VC_CHECK(vc_test_diff(scalar.sobel, simd.sobel) == 0);
+		VC_CHECK(vc_test_diff(scalar.magnitude, simd.magnitude) == 0);
+		VC_CHECK(vc_test_diff(scalar.foreground, simd.foreground) == 0);
+
+		// Limiar acima do gradiente mximo (e de 46340, em que th^2 j no cabe num int): nenhum contorno
+		VC_CHECK(vc_gray_edge_sobel(gray, simd.sobel, 1.0e6f) && (vc_test_count(simd.sobel) == 0));
+	}
+
+	// O resultado no  trivial (as comparaes acima no passam por estar tudo a 0)
+	VC_CHECK(vc_test_count(scalar.seg) > 0);
+	VC_CHECK(vc_test_count(scalar.erode[1]) > 0);
+	VC_CHECK(vc_test_count(scalar.sobel) > 0);
+	VC_CHECK(vc_test_count(scalar.foreground) > 0);
+
+	test_outputs_free(&scalar);
+	test_outputs_free(&simd);
+	vc_image_free(rgb);
+	vc_image_free(gray);
+	vc_image_free(scene);
+	bg = vc_background_free(bg);
+
+	return 0;
+}
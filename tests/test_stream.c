@@ -0,0 +1,86 @@
+// Sequncias de imagens (vc_stream_*): uma sequncia escrita com frames P4, P5 e P6 misturadas, de larguras mpares
+// e tamanhos diferentes,  lida de volta frame a frame tal e qual, e a leitura termina com NULL e sem erro
+// (ou com erro, se o ficheiro foi cortado a meio de uma frame).
+
+#include "vc_test.h"
+
+#define FILENAME	"test_stream.pnm"
+#define NFRAMES		9
+
+// Largura, altura, canais e levels de cada frame (levels = 1: PBM)
+static const int formats[NFRAMES][4] = {
+	{ 97, 31, 3, 255 }, { 97, 31, 1, 255 }, { 97, 31, 1, 1 },
+	{ 13, 5, 1, 1 }, { 61, 17, 3, 255 }, { 61, 17, 3, 255 },
+	{ 1, 1, 1, 1 }, { 33, 9, 1, 255 }, { 97, 31, 3, 255 }
+};
+
+int main(void)
+{
+	static unsigned char cut[97 * 31 * 3];
+	char filename[] = FILENAME;
+	FILE* file;
+	IVC* frames[NFRAMES];
+	IVC* image;
+	VCSTREAM* stream;
+	int i, x, y;
+
+	for (i = 0; i < NFRAMES; i++)
+	{
+		frames[i] = vc_image_new(formats[i][0], formats[i][1], formats[i][2], formats[i][3]);
+		VC_CHECK(frames[i] != NULL);
+		vc_test_noise(frames[i], 17u * i + 1);
+
+		// PBM: 0 ou 1 por pixel
+		if (formats[i][3] == 1)
+		{
+			for (y = 0; y < frames[i]->height; y++)
+			{
+				for (x = 0; x < frames[i]->width; x++) frames[i]->data[y * frames[i]->bytesperline + x] &= 1;
+			}
+		}
+	}
+
+	stream = vc_stream_open_write(filename);
+	VC_CHECK(stream != NULL);
+	for (i = 0; i < NFRAMES; i++) VC_CHECK(vc_stream_write(stream, frames[i]));
+	VC_CHECK(vc_stream_read(stream) == NULL);
+	VC_CHECK(vc_stream_close(stream));
+
+	stream = vc_stream_open_read(filename);
+	VC_CHECK(stream != NULL);
+	VC_CHECK(!vc_stream_write(stream, frames[0]));
+	for (i = 0; i < NFRAMES; i++)
+	{
+		image = vc_stream_read(stream);
+		VC_CHECK(image != NULL);
+		VC_CHECK((image->width == frames[i]->width) && (image->height == frames[i]->height));
+		VC_CHECK((image->channels == frames[i]->channels) && (image->levels == frames[i]->levels));
+		VC_CHECK(vc_test_diff(image, frames[i]) == 0);
+	}
+	VC_CHECK(vc_stream_read(stream) == NULL);
+	VC_CHECK(vc_stream_read(stream) == NULL);
+	VC_CHECK(vc_stream_close(stream));
+
+	// A primeira frame tambm se l como imagem isolada
+	image = vc_read_image(filename);
+	VC_CHECK((image != NULL) && (image->channels == 3) && (vc_test_diff(image, frames[0]) == 0));
+	vc_image_free(image);
+
+	// Ficheiro cortado a meio da primeira frame (header + 97 x 31 x 3 bytes): a leitura termina com erro
+	file = fopen(filename, "rb");
+	VC_CHECK((file != NULL) && (fread(cut, 1, sizeof(cut), file) == sizeof(cut)));
+	fclose(file);
+	file = fopen(filename, "wb");
+	VC_CHECK((file != NULL) && (fwrite(cut, 1, sizeof(cut), file) == sizeof(cut)));
+	fclose(file);
+
+	stream = vc_stream_open_read(filename);
+	VC_CHECK(stream != NULL);
+	VC_CHECK(vc_stream_read(stream) == NULL);
+	VC_CHECK(!vc_stream_close(stream));
+
+	remove(filename);
+	for (i = 0; i < NFRAMES; i++) vc_image_free(frames[i]);
+
+	return 0;
+}
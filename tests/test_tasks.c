@@ -0,0 +1,168 @@
+// Escalonador com roubo de trabalho: vc_binary_blob_tasks d os mesmos blobs que vc_binary_blob_info (com a
+// tarefa do utilizador uma vez por blob), e as tarefas criadas dentro de outras (vc_context_spawn, em vrios
+// nveis) correm todas exactamente uma vez, com 1 ou vrias threads. Com os ndices por ordem crescente de custo,
+// as tarefas iniciais maiores correm primeiro.
+
+#include "vc_test.h"
+
+#define WIDTH		211
+#define HEIGHT		157
+#define NDISKS		40
+#define MAXTHREADS	4
+#define NROOTS		8
+#define NNODES		4096
+
+// rvore de tarefas: as razes so 0..NROOTS-1 e os filhos de k so NROOTS * (k + 1) + j, j em [0, NROOTS[
+typedef struct {
+	VCCONTEXT* ctx;
+	int runs[MAXTHREADS][NNODES];	// Execues de cada n por thread (cada thread s escreve na sua linha)
+	int failed;
+} VCTESTTREE;
+
+static int test_node(void* arg, int index, int thread)
+{
+	VCTESTTREE* tree = (VCTESTTREE*)arg;
+	int j, child;
+
+	if ((thread < 0) || (thread >= MAXTHREADS) || (index < 0) || (index >= NNODES))
+	{
+		tree->failed = 1;
+		return 0;
+	}
+	tree->runs[thread][index]++;
+
+	for (j = 0; j < NROOTS; j++)
+	{
+		child = NROOTS * (index + 1) + j;
+		if (child >= NNODES) break;
+		if (!vc_context_spawn(tree->ctx, thread, test_node, tree, child)) return 0;
+	}
+
+	return 1;
+}
+
+// Conta as chamadas de task por blob (cada blob  tratado por uma s tarefa)
+static int test_blob(void* arg, IVC* labels, OVC* blob, int thread)
+{
+	int* calls = (int*)arg;
+
+	calls[blob->label]++;
+
+	return (labels != NULL) && (thread >= 0) && (thread < MAXTHREADS);
+}
+
+static int test_blobs(VCCONTEXT* ctx, IVC* labels, OVC* ref, int nblobs)
+{
+	OVC blobs[256];
+	int calls[256] = { 0 };
+	int i;
+
+	memcpy(blobs, ref, nblobs * sizeof(OVC));
+	for (i = 0; i < nblobs; i++) blobs[i].area = blobs[i].perimeter = -1;
+
+	VC_CHECK(vc_binary_blob_tasks(ctx, labels, blobs, nblobs, test_blob, calls));
+
+	for (i = 0; i < nblobs; i++)
+	{
+		VC_CHECK((blobs[i].label == ref[i].label) && (blobs[i].area == ref[i].area) && (blobs[i].perimeter == ref[i].perimeter));
+		VC_CHECK((blobs[i].x == ref[i].x) && (blobs[i].y == ref[i].y) && (blobs[i].width == ref[i].width) && (blobs[i].height == ref[i].height));
+		VC_CHECK((blobs[i].xc == ref[i].xc) && (blobs[i].yc == ref[i].yc));
+		VC_CHECK(calls[blobs[i].label] == 1);
+	}
+
+	return 0;
+}
+
+// Ordem de execuo das tarefas iniciais numa s thread
+static int test_record(void* arg, int index, int thread)
+{
+	int* order = (int*)arg;
+
+	order[++order[0]] = index;
+
+	return thread == 0;
+}
+
+static int test_order(void)
+{
+	VCCONTEXT* ctx = vc_context_new(1);
+	int order[NROOTS + 1] = { 0 };
+	int i;
+
+	VC_CHECK(ctx != NULL);
+	VC_CHECK(vc_context_tasks(ctx, NROOTS, test_record, order) && (order[0] == NROOTS));
+	for (i = 0; i < NROOTS; i++) VC_CHECK(order[1 + i] == NROOTS - 1 - i);
+
+	vc_context_free(ctx);
+
+	return 0;
+}
+
+static int test_tree(VCCONTEXT* ctx, VCTESTTREE* tree)
+{
+	int i, t, n;
+	long long tasks = vc_context_counters(ctx)->tasks;
+
+	memset(tree, 0, sizeof(VCTESTTREE));
+	tree->ctx = ctx;
+
+	VC_CHECK(vc_context_tasks(ctx, NROOTS, test_node, tree));
+	VC_CHECK(!tree->failed);
+	VC_CHECK(vc_context_counters(ctx)->tasks - tasks == NNODES);
+
+	for (i = 0; i < NNODES; i++)
+	{
+		for (t = 0, n = 0; t < MAXTHREADS; t++) n += tree->runs[t][i];
+		VC_CHECK(n == 1);
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned char white = 255;
+	static VCTESTTREE tree;
+	IVC* mask = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* labels = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	OVC* ref;
+	int nblobs, nthreads, i;
+
+	if ((mask == NULL) || (labels == NULL)) return 1;
+
+	// Grelha de 8 x 5 discos de raios muito diferentes (tarefas de custo muito diferente), por ordem baralhada
+	vc_test_fill(mask, 0);
+	for (i = 0; i < NDISKS; i++)
+	{
+		int r = 1 + (i * 7) % 12;
+
+		vc_test_disk(mask, 13 + 26 * (i % 8), 16 + 31 * (i / 8), r, &white);
+	}
+
+	ref = vc_binary_blob_labelling(mask, labels, &nblobs);
+	VC_CHECK((ref != NULL) && (nblobs == NDISKS));
+	VC_CHECK(vc_binary_blob_info(labels, ref, nblobs));
+
+	if (test_order()) return 1;
+
+	for (nthreads = 1; nthreads <= MAXTHREADS; nthreads++)
+	{
+		VCCONTEXT* ctx = vc_context_new(nthreads);
+
+		VC_CHECK(ctx != NULL);
+		if (test_blobs(ctx, labels, ref, nblobs)) return 1;
+		if (test_tree(ctx, &tree)) return 1;
+
+		// O contexto serve para mais do que uma execuo (deques vazias no fim de cada uma)
+		if (test_tree(ctx, &tree)) return 1;
+		if (test_blobs(ctx, labels, ref, nblobs)) return 1;
+
+		vc_context_free(ctx);
+	}
+
+	free(ref);
+	vc_image_free(mask);
+	vc_image_free(labels);
+
+	return 0;
+}
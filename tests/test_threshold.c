@@ -0,0 +1,173 @@
+// Threshold local: vc_gray_to_binary_midpoint (janelas deslizantes) e vc_gray_to_binary_adaptive (Bradley e Sauvola
+// sobre a imagem integral, e o modo midpoint) do o mesmo que uma janela percorrida por fora bruta, cortada nos
+// limites da imagem, para tamanhos e kernels aleatrios (incluindo kernels maiores do que a imagem).
+
+#include "vc_test.h"
+#include <math.h>
+
+#define NTRIALS	80
+#define MAXSIZE	37
+#define WIDTH	120
+#define HEIGHT	40
+
+// Traos da imagem com iluminao em gradiente: 3 de cada 12 colunas, entre as linhas 11 e 29
+static int test_ink(int x, int y)
+{
+	return (x % 12 < 3) && (y > 10) && (y < 30);
+}
+
+// Referncia por fora bruta de vc_gray_to_binary_adaptive() (as mesmas contas em float sobre as somas exactas)
+static void test_reference(IVC* src, IVC* dst, int kernel, int mode, float k)
+{
+	int half = kernel / 2;
+	int x, y, wx, wy, x0, x1, y0, y1, count, v, vmin, vmax;
+	unsigned int s;
+	unsigned long long sq;
+	float mean, var, threshold;
+
+	for (y = 0; y < src->height; y++)
+	{
+		for (x = 0; x < src->width; x++)
+		{
+			x0 = MAX2(x - half, 0);
+			x1 = MIN2(x + half, src->width - 1);
+			y0 = MAX2(y - half, 0);
+			y1 = MIN2(y + half, src->height - 1);
+			count = (x1 - x0 + 1) * (y1 - y0 + 1);
+			s = 0;
+			sq = 0;
+			vmin = 255;
+			vmax = 0;
+
+			for (wy = y0; wy <= y1; wy++)
+			{
+				for (wx = x0; wx <= x1; wx++)
+				{
+					v = src->data[wy * src->bytesperline + wx];
+					s += v;
+					sq += (unsigned long long)v * v;
+					vmin = MIN2(vmin, v);
+					vmax = MAX2(vmax, v);
+				}
+			}
+
+			mean = (float)s / count;
+			if (mode == VC_THRESHOLD_MIDPOINT) threshold = (float)((vmin + vmax) / 2);
+			else if (mode == VC_THRESHOLD_MEAN) threshold = mean * (1.0f - k);
+			else
+			{
+				var = (float)sq / count - mean * mean;
+				threshold = mean * (1.0f + k * (((var > 0.0f) ? sqrtf(var) : 0.0f) / 128.0f - 1.0f));
+			}
+
+			dst->data[y * dst->bytesperline + x] = (src->data[y * src->bytesperline + x] > threshold) ? 255 : 0;
+		}
+	}
+}
+
+// Tamanhos, kernels e imagens aleatrios contra a referncia
+static int test_random(void)
+{
+	static const int modes[3] = { VC_THRESHOLD_MEAN, VC_THRESHOLD_SAUVOLA, VC_THRESHOLD_MIDPOINT };
+	static const float ks[3] = { 0.15f, 0.3f, 0.0f };
+	static const unsigned char flat = 128;
+	unsigned int seed = 12345u;
+	int trial, m, width, height, kernel;
+	IVC* src, * out, * ref;
+
+	for (trial = 0; trial < NTRIALS; trial++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		width = 1 + (int)((seed >> 16) % MAXSIZE);
+		seed = seed * 1103515245u + 12345u;
+		height = 1 + (int)((seed >> 16) % MAXSIZE);
+		seed = seed * 1103515245u + 12345u;
+		kernel = 1 + (int)((seed >> 16) % (2 * MAXSIZE + 8));	// mpares e pares, at mais do dobro da imagem
+
+		src = vc_image_new(width, height, 1, 255);
+		out = vc_image_new(width, height, 1, 255);
+		ref = vc_image_new(width, height, 1, 255);
+		VC_CHECK((src != NULL) && (out != NULL) && (ref != NULL));
+
+		// Rudo, e metade das vezes com uma zona lisa (janelas com desvio padro 0 e min = max)
+		vc_test_noise(src, seed);
+		if (trial % 2) vc_test_disk(src, width / 2, height / 2, MAX2(width, height) / 3, &flat);
+
+		test_reference(src, ref, kernel, VC_THRESHOLD_MIDPOINT, 0.0f);
+		vc_test_fill(out, 77);
+		VC_CHECK(vc_gray_to_binary_midpoint(src, out, kernel));
+		VC_CHECK(vc_test_diff(out, ref) == 0);
+
+		for (m = 0; m < 3; m++)
+		{
+			test_reference(src, ref, kernel, modes[m], ks[m]);
+			vc_test_fill(out, 77);
+			VC_CHECK(vc_gray_to_binary_adaptive(src, out, kernel, modes[m], ks[m]));
+			VC_CHECK(vc_test_diff(out, ref) == 0);
+		}
+
+		vc_image_free(src);
+		vc_image_free(out);
+		vc_image_free(ref);
+	}
+
+	return 0;
+}
+
+// Papel com iluminao em gradiente (60 a 250) e traos verticais a 40% do papel: Bradley e Sauvola separam-nos
+// todos, um limiar global (Otsu) no
+static int test_illumination(void)
+{
+	static const int modes[2] = { VC_THRESHOLD_MEAN, VC_THRESHOLD_SAUVOLA };
+	static const float ks[2] = { 0.15f, 0.3f };
+	IVC* src = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* out = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	int x, y, m, paper, errors;
+
+	VC_CHECK((src != NULL) && (out != NULL));
+
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < WIDTH; x++)
+		{
+			paper = 60 + (x * 190) / (WIDTH - 1);
+			src->data[y * src->bytesperline + x] = (unsigned char)(test_ink(x, y) ? (paper * 2) / 5 : paper);
+		}
+	}
+
+	for (m = 0; m < 3; m++)
+	{
+		VC_CHECK((m < 2) ? vc_gray_to_binary_adaptive(src, out, 15, modes[m], ks[m]) : vc_gray_to_binary_otsu(src, out));
+
+		for (y = 0, errors = 0; y < HEIGHT; y++)
+		{
+			for (x = 0; x < WIDTH; x++) errors += ((out->data[y * out->bytesperline + x] == 0) != test_ink(x, y));
+		}
+		VC_CHECK((m < 2) ? (errors == 0) : (errors > 0));
+	}
+
+	vc_image_free(src);
+	vc_image_free(out);
+
+	return 0;
+}
+
+int main(void)
+{
+	IVC* gray = vc_image_new(8, 8, 1, 255);
+	IVC* rgb = vc_image_new(8, 8, 3, 255);
+
+	if (test_random()) return 1;
+	if (test_illumination()) return 1;
+
+	// Parmetros invlidos
+	VC_CHECK((gray != NULL) && (rgb != NULL));
+	VC_CHECK(!vc_gray_to_binary_adaptive(gray, rgb, 3, VC_THRESHOLD_MEAN, 0.1f));
+	VC_CHECK(!vc_gray_to_binary_adaptive(gray, gray, 0, VC_THRESHOLD_MEAN, 0.1f));
+	VC_CHECK(!vc_gray_to_binary_adaptive(gray, gray, 3, 7, 0.1f));
+
+	vc_image_free(gray);
+	vc_image_free(rgb);
+
+	return 0;
+}
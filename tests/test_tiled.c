@@ -0,0 +1,69 @@
+// O executor por faixas (vc_hsv_segmentation_tiled e _ctx) d o mesmo resultado que a cadeia sobre a imagem inteira:
+// vc_rgb_to_hsv -> vc_hsv_segmentation -> vc_binary_erode -> vc_binary_dilate
+
+#include "vc_test.h"
+
+#define WIDTH	203
+#define HEIGHT	149
+
+static const unsigned char gold[3] = { 200, 160, 40 };
+
+// Cadeia de referncia, sobre a imagem inteira
+static int test_reference(IVC* rgb, IVC* dst, int kernel)
+{
+	IVC* hsv = vc_image_new(rgb->width, rgb->height, 3, 255);
+	IVC* seg = vc_image_new(rgb->width, rgb->height, 1, 255);
+	IVC* ero = vc_image_new(rgb->width, rgb->height, 1, 255);
+	int ok = (hsv != NULL) && (seg != NULL) && (ero != NULL) &&
+		vc_rgb_to_hsv(rgb, hsv) && vc_hsv_segmentation(hsv, (kernel > 1) ? seg : dst, 30, 60, 50, 100, 50, 100);
+
+	if (ok && (kernel > 1)) ok = vc_binary_erode(seg, ero, kernel) && vc_binary_dilate(ero, dst, kernel);
+
+	vc_image_free(hsv);
+	vc_image_free(seg);
+	vc_image_free(ero);
+
+	return ok;
+}
+
+int main(void)
+{
+	static const int kernels[3] = { 1, 3, 5 };
+	static const int bands[4] = { 1, 7, 50, 0 };
+	IVC* rgb = vc_image_new(WIDTH, HEIGHT, 3, 255);
+	IVC* ref = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* out = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	VCCONTEXT* ctx = vc_context_new(1);
+	int k, b;
+
+	if ((rgb == NULL) || (ref == NULL) || (out == NULL) || (ctx == NULL)) return 1;
+
+	// Discos a tocar o topo, o fundo e os lados, para exercitar os halos das faixas
+	vc_test_noise(rgb, 7u);
+	vc_test_disk(rgb, 20, 0, 15, gold);
+	vc_test_disk(rgb, 100, 75, 30, gold);
+	vc_test_disk(rgb, 190, 148, 20, gold);
+	vc_test_disk(rgb, 60, 130, 3, gold);
+
+	for (k = 0; k < 3; k++)
+	{
+		VC_CHECK(test_reference(rgb, ref, kernels[k]));
+		VC_CHECK(vc_test_count(ref) > 0);
+
+		for (b = 0; b < 4; b++)
+		{
+			VC_CHECK(vc_hsv_segmentation_tiled(rgb, out, 30, 60, 50, 100, 50, 100, kernels[k], bands[b]));
+			VC_CHECK(vc_test_diff(ref, out) == 0);
+
+			VC_CHECK(vc_hsv_segmentation_tiled_ctx(ctx, rgb, out, 30, 60, 50, 100, 50, 100, kernels[k], bands[b]));
+			VC_CHECK(vc_test_diff(ref, out) == 0);
+		}
+	}
+
+	vc_image_free(rgb);
+	vc_image_free(ref);
+	vc_image_free(out);
+	vc_context_free(ctx);
+
+	return 0;
+}
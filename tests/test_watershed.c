@@ -0,0 +1,85 @@
+// Watershed da transformada de distncia (vc_binary_blob_watershed e _ctx): dois discos que se tocam do duas
+// etiquetas, um disco isolado d uma, e todos os pixis do objecto (fora do rebordo da imagem) ficam etiquetados.
+
+#include "vc_test.h"
+
+#define WIDTH	200
+#define HEIGHT	120
+
+static int test_labels(IVC* mask, IVC* labels, OVC* blobs, int nblobs)
+{
+	int x, y, i;
+
+	VC_CHECK((blobs != NULL) && (nblobs == 3));
+	VC_CHECK(vc_binary_blob_info(labels, blobs, nblobs));
+
+	// Todos os pixis do objecto etiquetados, e s esses
+	for (y = 1; y < HEIGHT - 1; y++)
+	{
+		for (x = 1; x < WIDTH - 1; x++)
+		{
+			VC_CHECK((mask->data[y * mask->bytesperline + x] != 0) == (labels->data[y * labels->bytesperline + x] != 0));
+			VC_CHECK(labels->data[y * labels->bytesperline + x] <= nblobs);
+		}
+	}
+
+	// Um blob por disco, com o centro de massa perto do centro do disco e reas semelhantes nos que se tocam
+	for (i = 0; i < nblobs; i++)
+	{
+		if (blobs[i].xc > 130) VC_CHECK((abs(blobs[i].xc - 160) <= 2) && (abs(blobs[i].yc - 40) <= 2));
+		else if (blobs[i].xc < 75) VC_CHECK((abs(blobs[i].xc - 50) <= 3) && (abs(blobs[i].yc - 60) <= 2));
+		else VC_CHECK((abs(blobs[i].xc - 100) <= 3) && (abs(blobs[i].yc - 60) <= 2));
+
+		if (blobs[i].xc <= 130) VC_CHECK(abs(blobs[i].area - 2700) < 150);
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned char white = 255;
+	IVC* mask = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* labels = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	IVC* dist = vc_image_new(WIDTH, HEIGHT, 1, 255);
+	VCCONTEXT* ctx = vc_context_new(1);
+	OVC* blobs;
+	int nblobs;
+
+	if ((mask == NULL) || (labels == NULL) || (dist == NULL) || (ctx == NULL)) return 1;
+
+	// Dois discos de raio 30 que se sobrepem (moedas encostadas) e um disco isolado
+	vc_test_fill(mask, 0);
+	vc_test_disk(mask, 50, 60, 30, &white);
+	vc_test_disk(mask, 100, 60, 30, &white);
+	vc_test_disk(mask, 160, 40, 15, &white);
+
+	// A etiquetagem simples v s dois blobs
+	blobs = vc_binary_blob_labelling(mask, labels, &nblobs);
+	VC_CHECK(nblobs == 2);
+	free(blobs);
+
+	// Distncia ao fundo no centro do disco isolado: cerca de 15 pixis
+	VC_CHECK(vc_binary_distance_transform(mask, dist));
+	VC_CHECK(abs(dist->data[40 * dist->bytesperline + 160] - 16) <= 1);
+	VC_CHECK(dist->data[0] == 0);
+
+	blobs = vc_binary_blob_watershed(mask, labels, 2, &nblobs);
+	if (test_labels(mask, labels, blobs, nblobs)) return 1;
+	free(blobs);
+
+	blobs = vc_binary_blob_watershed_ctx(ctx, mask, labels, 2, &nblobs);
+	if (test_labels(mask, labels, blobs, nblobs)) return 1;
+
+	// Uma profundidade maior do que a do estrangulamento volta a juntar os discos que se tocam
+	blobs = vc_binary_blob_watershed(mask, labels, 40, &nblobs);
+	VC_CHECK(nblobs == 2);
+	free(blobs);
+
+	vc_image_free(mask);
+	vc_image_free(labels);
+	vc_image_free(dist);
+	vc_context_free(ctx);
+
+	return 0;
+}
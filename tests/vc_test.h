@@ -0,0 +1,87 @@
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//            TESTES DA BIBLIOTECA vc (ctest)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cada teste  um executvel que devolve 0 se todas as verificaes passarem (ver CMakeLists.txt).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// Os testes em C++ (vc.hpp) recebem tambm a camada C++, que j inclui vc.h
+#ifdef __cplusplus
+#include "vc.hpp"
+#else
+#include "vc.h"
+#endif
+
+// Falha a funo de teste actual (que devolve int), indicando a condio e a linha
+#define VC_CHECK(cond) do { if (!(cond)) { printf("FALHOU %s:%d: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+
+// Rudo uniforme, reprodutvel a partir de seed
+static inline void vc_test_noise(IVC* image, unsigned int seed)
+{
+	int x, y;
+
+	for (y = 0; y < image->height; y++)
+	{
+		for (x = 0; x < image->width * image->channels; x++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			image->data[y * image->bytesperline + x] = (unsigned char)(seed >> 16);
+		}
+	}
+}
+
+// Fundo liso com value em todos os canais
+static inline void vc_test_fill(IVC* image, unsigned char value)
+{
+	int y;
+
+	for (y = 0; y < image->height; y++) memset(&image->data[y * image->bytesperline], value, image->width * image->channels);
+}
+
+// Disco de raio r centrado em (cx, cy), com a cor color (image->channels valores)
+static inline void vc_test_disk(IVC* image, int cx, int cy, int r, const unsigned char* color)
+{
+	int x, y, c;
+
+	for (y = MAX2(cy - r, 0); y <= MIN2(cy + r, image->height - 1); y++)
+	{
+		for (x = MAX2(cx - r, 0); x <= MIN2(cx + r, image->width - 1); x++)
+		{
+			if ((x - cx) * (x - cx) + (y - cy) * (y - cy) > r * r) continue;
+
+			for (c = 0; c < image->channels; c++) image->data[y * image->bytesperline + x * image->channels + c] = color[c];
+		}
+	}
+}
+
+// Nmero de bytes diferentes entre duas imagens com as mesmas dimenses (o preenchimento das linhas  ignorado)
+static inline int vc_test_diff(IVC* a, IVC* b)
+{
+	int x, y, n = 0;
+
+	for (y = 0; y < a->height; y++)
+	{
+		for (x = 0; x < a->width * a->channels; x++)
+		{
+			n += (a->data[y * a->bytesperline + x] != b->data[y * b->bytesperline + x]);
+		}
+	}
+
+	return n;
+}
+
+// Nmero de pixis diferentes de 0 numa imagem de 1 canal
+static inline int vc_test_count(IVC* image)
+{
+	int x, y, n = 0;
+
+	for (y = 0; y < image->height; y++)
+	{
+		for (x = 0; x < image->width; x++) n += (image->data[y * image->bytesperline + x] != 0);
+	}
+
+	return n;
+}
@@ -10,20 +10,90 @@
 // Desabilita (no MSVC++) warnings de funes no seguras (fopen, sscanf, etc...)
 #define _CRT_SECURE_NO_WARNINGS
 
+// Em POSIX: fseeko()/ftello() com offsets de 64 bits
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include <math.h>
+#include <time.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
 #include "vc.h"
 
+// Intrnsecas SSE2 (sempre disponveis em x64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VC_SSE2
+#include <emmintrin.h>
+#endif
+
+// Intrnsecas AVX2 e AVX-512: compiladas funo a funo (VC_TARGET) e escolhidas em runtime (vc_cpu_tier)
+#if defined(VC_SSE2) && (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && (_MSC_VER >= 1910)))
+#define VC_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VC_TARGET(isa)
+#endif
+
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //            FUNES: ALOCAR E LIBERTAR UMA IMAGEM
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 
+static void vc_file_unmap(void* addr, size_t size);
+
+
+// Memria alinhada a VC_ALIGNMENT bytes
+static void* vc_aligned_malloc(size_t size)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, VC_ALIGNMENT);
+#else
+	void* p = NULL;
+
+	// posix_memalign() exige um mltiplo de sizeof(void*)
+	if (posix_memalign(&p, MAX2(VC_ALIGNMENT, sizeof(void*)), size) != 0) return NULL;
+
+	return p;
+#endif
+}
+
+
+static void vc_aligned_free(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+
 // Alocar memria para uma imagem
+// Cada linha comea num endereo alinhado a VC_ALIGNMENT bytes: bytesperline  width * channels
+// arredondado ao mltiplo de VC_ALIGNMENT seguinte (os bytes de enchimento no fazem parte da imagem).
 IVC* vc_image_new(int width, int height, int channels, int levels)
 {
 	IVC* image = (IVC*)malloc(sizeof(IVC));
@@ -35,8 +105,10 @@ IVC* vc_image_new(int width, int height, int channels, int levels)
 	image->height = height;
 	image->channels = channels;
 	image->levels = levels;
-	image->bytesperline = image->width * image->channels;
-	image->data = (unsigned char*)malloc(image->width * image->height * image->channels * sizeof(char));
+	image->bytesperline = ((image->width * image->channels + VC_ALIGNMENT - 1) / VC_ALIGNMENT) * VC_ALIGNMENT;
+	image->mapaddr = NULL;
+	image->mapsize = 0;
+	image->data = (unsigned char*)vc_aligned_malloc((size_t)image->bytesperline * MAX2(image->height, 1) + VC_ALIGNMENT);
 
 	if (image->data == NULL)
 	{
@@ -52,9 +124,16 @@ IVC* vc_image_free(IVC* image)
 {
 	if (image != NULL)
 	{
-		if (image->data != NULL)
+		if (image->mapaddr != NULL)
 		{
-			free(image->data);
+			// Imagem lida com vc_read_image_mmap(): data aponta para o ficheiro mapeado
+			vc_file_unmap(image->mapaddr, image->mapsize);
+			image->mapaddr = NULL;
+			image->data = NULL;
+		}
+		else if (image->data != NULL)
+		{
+			vc_aligned_free(image->data);
 			image->data = NULL;
 		}
 
@@ -67,1348 +146,7274 @@ IVC* vc_image_free(IVC* image)
 
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-//    FUNES: LEITURA E ESCRITA DE IMAGENS (PBM, PGM E PPM)
+//                FUNES: IMAGENS PLANARES
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 
-char* netpbm_get_token(FILE* file, char* tok, int len)
+// Alocar uma imagem planar: nplanes imagens de 1 canal, cada uma com as linhas alinhadas
+IVCPLANAR* vc_planar_new(int width, int height, int nplanes, int levels)
 {
-	char* t;
-	int c;
+	if ((nplanes <= 0) || (nplanes > VC_PLANAR_MAX_PLANES)) return NULL;
 
-	for (;;)
+	IVCPLANAR* image = (IVCPLANAR*)malloc(sizeof(IVCPLANAR));
+
+	if (image == NULL) return NULL;
+
+	image->width = width;
+	image->height = height;
+	image->nplanes = nplanes;
+
+	for (int c = 0; c < VC_PLANAR_MAX_PLANES; c++) image->plane[c] = NULL;
+
+	for (int c = 0; c < nplanes; c++)
 	{
-		while (isspace(c = getc(file)));
-		if (c != '#') break;
-		do c = getc(file);
-		while ((c != '\n') && (c != EOF));
-		if (c == EOF) break;
+		image->plane[c] = vc_image_new(width, height, 1, levels);
+		if (image->plane[c] == NULL) return vc_planar_free(image);
 	}
 
-	t = tok;
+	return image;
+}
 
-	if (c != EOF)
+
+// Libertar memria de uma imagem planar
+IVCPLANAR* vc_planar_free(IVCPLANAR* image)
+{
+	if (image != NULL)
 	{
-		do
+		for (int c = 0; c < VC_PLANAR_MAX_PLANES; c++)
 		{
-			*t++ = c;
-			c = getc(file);
-		} while ((!isspace(c)) && (c != '#') && (c != EOF) && (t - tok < len - 1));
+			image->plane[c] = vc_image_free(image->plane[c]);
+		}
 
-		if (c == '#') ungetc(c, file);
+		free(image);
+		image = NULL;
 	}
 
-	*t = 0;
-
-	return tok;
+	return image;
 }
 
 
-long int unsigned_char_to_bit(unsigned char* datauchar, unsigned char* databit, int width, int height)
+// Verifica se a imagem planar  compatvel com src (mesmas dimenses, um plano por canal)
+static int vc_planar_check(IVC* image, IVCPLANAR* planar)
 {
-	int x, y;
-	int countbits;
-	long int pos, counttotalbytes;
-	unsigned char* p = databit;
-
-	*p = 0;
-	countbits = 1;
-	counttotalbytes = 0;
+	if (image == NULL || planar == NULL) return 0;
+	if ((image->width != planar->width) || (image->height != planar->height)) return 0;
+	if (image->channels != planar->nplanes) return 0;
 
-	for (y = 0; y < height; y++)
+	for (int c = 0; c < planar->nplanes; c++)
 	{
-		for (x = 0; x < width; x++)
-		{
-			pos = width * y + x;
-
-			if (countbits <= 8)
-			{
-				// Numa imagem PBM:
-				// 1 = Preto
-				// 0 = Branco
-				//*p |= (datauchar[pos] != 0) << (8 - countbits);
-
-				// Na nossa imagem:
-				// 1 = Branco
-				// 0 = Preto
-				*p |= (datauchar[pos] == 0) << (8 - countbits);
-
-				countbits++;
-			}
-			if ((countbits > 8) || (x == width - 1))
-			{
-				p++;
-				*p = 0;
-				countbits = 1;
-				counttotalbytes++;
-			}
-		}
+		if (planar->plane[c] == NULL || planar->plane[c]->channels != 1) return 0;
+		if ((planar->plane[c]->width != image->width) || (planar->plane[c]->height != image->height)) return 0;
 	}
 
-	return counttotalbytes;
+	return 1;
 }
 
 
-void bit_to_unsigned_char(unsigned char* databit, unsigned char* datauchar, int width, int height)
+// Intercalada -> planar
+int vc_planar_split(IVC* src, IVCPLANAR* dst)
 {
-	int x, y;
-	int countbits;
-	long int pos;
-	unsigned char* p = databit;
+	if (!vc_planar_check(src, dst)) return 0;
 
-	countbits = 1;
+	int channels = src->channels;
 
-	for (y = 0; y < height; y++)
+	for (int c = 0; c < channels; c++)
 	{
-		for (x = 0; x < width; x++)
-		{
-			pos = width * y + x;
-
-			if (countbits <= 8)
-			{
-				// Numa imagem PBM:
-				// 1 = Preto
-				// 0 = Branco
-				//datauchar[pos] = (*p & (1 << (8 - countbits))) ? 1 : 0;
+		IVC* plane = dst->plane[c];
 
-				// Na nossa imagem:
-				// 1 = Branco
-				// 0 = Preto
-				datauchar[pos] = (*p & (1 << (8 - countbits))) ? 0 : 1;
+		for (int y = 0; y < src->height; y++)
+		{
+			unsigned char* data_src = &src->data[y * src->bytesperline + c];
+			unsigned char* data_dst = &plane->data[y * plane->bytesperline];
 
-				countbits++;
-			}
-			if ((countbits > 8) || (x == width - 1))
+			for (int x = 0; x < src->width; x++)
 			{
-				p++;
-				countbits = 1;
+				data_dst[x] = data_src[x * channels];
 			}
 		}
 	}
+
+	return 1;
 }
 
 
-IVC* vc_read_image(char* filename)
+// Planar -> intercalada
+int vc_planar_merge(IVCPLANAR* src, IVC* dst)
 {
-	FILE* file = NULL;
-	IVC* image = NULL;
-	unsigned char* tmp;
-	char tok[20];
-	long int size, sizeofbinarydata;
-	int width, height, channels;
-	int levels = 255;
-	int v;
+	if (!vc_planar_check(dst, src)) return 0;
 
-	// Abre o ficheiro
-	if ((file = fopen(filename, "rb")) != NULL)
+	int channels = dst->channels;
+
+	for (int c = 0; c < channels; c++)
 	{
-		// Efectua a leitura do header
-		netpbm_get_token(file, tok, sizeof(tok));
+		IVC* plane = src->plane[c];
 
-		if (strcmp(tok, "P4") == 0) { channels = 1; levels = 1; }	// Se PBM (Binary [0,1])
-		else if (strcmp(tok, "P5") == 0) channels = 1;				// Se PGM (Gray [0,MAX(level,255)])
-		else if (strcmp(tok, "P6") == 0) channels = 3;				// Se PPM (RGB [0,MAX(level,255)])
-		else
+		for (int y = 0; y < dst->height; y++)
 		{
-#ifdef VC_DEBUG
-			printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM, PGM or PPM file.\n\tBad magic number!\n");
-#endif
-
-			fclose(file);
-			return NULL;
-		}
+			unsigned char* data_src = &plane->data[y * plane->bytesperline];
+			unsigned char* data_dst = &dst->data[y * dst->bytesperline + c];
 
-		if (levels == 1) // PBM
-		{
-			if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
-				sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1)
+			for (int x = 0; x < dst->width; x++)
 			{
-#ifdef VC_DEBUG
-				printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM file.\n\tBad size!\n");
-#endif
-
-				fclose(file);
-				return NULL;
+				data_dst[x * channels] = data_src[x];
 			}
+		}
+	}
 
-			// Aloca memria para imagem
-			image = vc_image_new(width, height, channels, levels);
-			if (image == NULL) return NULL;
+	return 1;
+}
 
-			sizeofbinarydata = (image->width / 8 + ((image->width % 8) ? 1 : 0)) * image->height;
-			tmp = (unsigned char*)malloc(sizeofbinarydata);
-			if (tmp == NULL) return 0;
 
-#ifdef VC_DEBUG
-			printf("\nchannels=%d w=%d h=%d levels=%d\n", image->channels, image->width, image->height, levels);
-#endif
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//     FUNES: DESPACHO EM RUNTIME PELAS CAPACIDADES DO CPU
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-			if ((v = fread(tmp, sizeof(unsigned char), sizeofbinarydata, file)) != sizeofbinarydata)
-			{
-#ifdef VC_DEBUG
-				printf("ERROR -> vc_read_image():\n\tPremature EOF on file.\n");
-#endif
+// Cada kernel crtico (linha a linha) tem uma verso escalar e, em x86, verses SSE2, AVX2 e AVX-512.
+// A tabela vc_cpu  preenchida na primeira utilizao com as verses do melhor nvel suportado
+// pelo CPU (ou do nvel pedido na varivel de ambiente VC_CPU). Todas as verses do o mesmo resultado.
 
-				vc_image_free(image);
-				fclose(file);
-				free(tmp);
-				return NULL;
-			}
 
-			bit_to_unsigned_char(tmp, image->data, image->width, image->height);
+// Converso de um pixel RGB em HSV (H: 0-179, S: 0-255, V: 0-255)
+static void vc_rgb_to_hsv_pixel(const unsigned char* rgb, unsigned char* h_out, unsigned char* s_out, unsigned char* v_out)
+{
+	float r = rgb[0] / 255.0f;
+	float g = rgb[1] / 255.0f;
+	float b = rgb[2] / 255.0f;
 
-			free(tmp);
+	float max = MAX3(r, g, b);
+	float min = MIN3(r, g, b);
+	float delta = max - min;
+	float h = 0, s = 0, v = max;
+
+	if (delta > 0)
+	{
+		if (max == r)
+		{
+			h = 60 * fmodf(((g - b) / delta), 6);
 		}
-		else // PGM ou PPM
+		else if (max == g)
 		{
-			if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
-				sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1 ||
-				sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &levels) != 1 || levels <= 0 || levels > 255)
-			{
-#ifdef VC_DEBUG
-				printf("ERROR -> vc_read_image():\n\tFile is not a valid PGM or PPM file.\n\tBad size!\n");
-#endif
-
-				fclose(file);
-				return NULL;
-			}
+			h = 60 * (((b - r) / delta) + 2);
+		}
+		else
+		{
+			h = 60 * (((r - g) / delta) + 4);
+		}
 
-			// Aloca memria para imagem
-			image = vc_image_new(width, height, channels, levels);
-			if (image == NULL) return NULL;
+		if (h < 0)
+			h += 360;
 
-#ifdef VC_DEBUG
-			printf("\nchannels=%d w=%d h=%d levels=%d\n", image->channels, image->width, image->height, levels);
-#endif
+		s = max == 0 ? 0 : (delta / max);
+	}
 
-			size = image->width * image->height * image->channels;
+	*h_out = (unsigned char)(h / 2.0f + 0.5f);     // H (0179)
+	*s_out = (unsigned char)(s * 255.0f + 0.5f);   // S (0255)
+	*v_out = (unsigned char)(v * 255.0f + 0.5f);   // V (0255)
+}
 
-			if ((v = fread(image->data, sizeof(unsigned char), size, file)) != size)
-			{
-#ifdef VC_DEBUG
-				printf("ERROR -> vc_read_image():\n\tPremature EOF on file.\n");
-#endif
 
-				vc_image_free(image);
-				fclose(file);
-				return NULL;
-			}
-		}
+// --- Verses escalares (todas as plataformas) ---
 
-		fclose(file);
-	}
-	else
+// n pixis RGB -> H, S e V escritos com passo step (3: imagem intercalada; 1: planos)
+static void vc_rgb_to_hsv_row_scalar(const unsigned char* rgb, unsigned char* h, unsigned char* s, unsigned char* v, int n, int step)
+{
+	for (int x = 0; x < n; x++)
 	{
-#ifdef VC_DEBUG
-		printf("ERROR -> vc_read_image():\n\tFile not found.\n");
-#endif
+		vc_rgb_to_hsv_pixel(&rgb[x * 3], &h[x * step], &s[x * step], &v[x * step]);
 	}
+}
 
-	return image;
+// dst[x] = 255 se H, S e V esto nos intervalos [lo[c], hi[c]], seno 0
+static void vc_hsv_range_row_scalar(const unsigned char* h, const unsigned char* s, const unsigned char* v, unsigned char* dst, int n, const int* lo, const int* hi)
+{
+	for (int x = 0; x < n; x++)
+	{
+		int inside = (h[x] >= lo[0] && h[x] <= hi[0]) &&
+			(s[x] >= lo[1] && s[x] <= hi[1]) &&
+			(v[x] >= lo[2] && v[x] <= hi[2]);
+
+		dst[x] = inside ? 255 : 0;
+	}
 }
 
+// dst[x] = (src[x] > threshold) ? 255 : 0, com 0 <= threshold < 255
+static void vc_threshold_row_scalar(const unsigned char* src, unsigned char* dst, int n, int threshold)
+{
+	for (int x = 0; x < n; x++)
+	{
+		dst[x] = (unsigned char)(-(src[x] > threshold));
+	}
+}
 
-int vc_write_image(char* filename, IVC* image)
+// dst[x] = (|a[x] - b[x]| > threshold) ? 255 : 0, com 0 <= threshold < 255
+static void vc_absdiff_row_scalar(const unsigned char* a, const unsigned char* b, unsigned char* dst, int n, int threshold)
 {
-	FILE* file = NULL;
-	unsigned char* tmp;
-	long int totalbytes, sizeofbinarydata;
+	for (int x = 0; x < n; x++)
+	{
+		int d = a[x] - b[x];
 
-	if (image == NULL) return 0;
+		dst[x] = (unsigned char)(-(((d < 0) ? -d : d) > threshold));
+	}
+}
 
-	if ((file = fopen(filename, "wb")) != NULL)
+// Morfologia, passo horizontal: hit[x] = 255 se algum row[x - r .. x + r] == value, para x em [r, n - r[
+static void vc_morph_hrow_scalar(const unsigned char* row, unsigned char* hit, int n, int r, unsigned char value)
+{
+	for (int x = r; x < n - r; x++)
 	{
-		if (image->levels == 1)
-		{
-			sizeofbinarydata = (image->width / 8 + ((image->width % 8) ? 1 : 0)) * image->height + 1;
-			tmp = (unsigned char*)malloc(sizeofbinarydata);
-			if (tmp == NULL) return 0;
+		unsigned char found = 0;
 
-			fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+		for (int k = -r; k <= r; k++) found |= (row[x + k] == value);
 
-			totalbytes = unsigned_char_to_bit(image->data, tmp, image->width, image->height);
-			printf("Total = %ld\n", totalbytes);
-			if (fwrite(tmp, sizeof(unsigned char), totalbytes, file) != totalbytes)
-			{
-#ifdef VC_DEBUG
-				fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
-#endif
+		hit[x] = (unsigned char)(-found);
+	}
+}
 
-				fclose(file);
-				free(tmp);
-				return 0;
-			}
+// Morfologia, passo vertical: dst[x] = value se algum rows[j][x] != 0 (j < nrows), seno 255 - value, para x em [x0, x1[
+static void vc_morph_vrows_scalar(unsigned char** rows, int nrows, unsigned char* dst, int x0, int x1, unsigned char value)
+{
+	for (int x = x0; x < x1; x++)
+	{
+		unsigned char found = 0;
 
-			free(tmp);
-		}
-		else
-		{
-			fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
+		for (int j = 0; j < nrows; j++) found |= rows[j][x];
 
-			if (fwrite(image->data, image->bytesperline, image->height, file) != image->height)
-			{
-#ifdef VC_DEBUG
-				fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
-#endif
+		dst[x] = found ? value : (unsigned char)(255 - value);
+	}
+}
 
-				fclose(file);
-				return 0;
-			}
-		}
+// Gradiente 3x3 limiarizado (|G|^2 > th2) nos pixis [1, x1[ da linha; devolve o primeiro x no processado
+static int vc_edge_row_scalar(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int x1, int w, int th2)
+{
+	int x;
 
-		fclose(file);
+	for (x = 1; x < x1; x++)
+	{
+		int gx = (p0[x + 1] - p0[x - 1]) + w * (p1[x + 1] - p1[x - 1]) + (p2[x + 1] - p2[x - 1]);
+		int gy = (p0[x - 1] + w * p0[x] + p0[x + 1]) - (p2[x - 1] + w * p2[x] + p2[x + 1]);
 
-		return 1;
+		d[x] = (gx * gx + gy * gy > th2) ? 255 : 0;
 	}
 
-	return 0;
+	return x;
 }
 
 
+#ifdef VC_SSE2
 
-int vc_gray_negative(IVC* srcdst) {
-	unsigned char* data = (unsigned char*)srcdst->data;
-	int width = srcdst->width;
-	int height = srcdst->height;
-	int bytesperline = srcdst->bytesperline;
-	int channels = srcdst->channels;
-	int x, y;
-	long int pos;
+// --- Verses SSE2 (128 bits) ---
 
-	//Verificao de erros
-	if ((srcdst->width <= 0) || (srcdst->height <= 0) || (srcdst->data == NULL)) {
-		return 0;
-	}
-	if (channels != 1) {
-		return 0;
-	}
+static void vc_rgb_to_hsv_row_sse2(const unsigned char* rgb, unsigned char* h, unsigned char* s, unsigned char* v, int n, int step)
+{
+	const __m128 k0 = _mm_setzero_ps(), k2 = _mm_set1_ps(2.0f), k4 = _mm_set1_ps(4.0f);
+	const __m128 k60 = _mm_set1_ps(60.0f), k255 = _mm_set1_ps(255.0f), k360 = _mm_set1_ps(360.0f), khalf = _mm_set1_ps(0.5f);
+	int x = 0;
 
-	//Inverter a Imagem Gray
-	for (y = 0; y < height; y++) {
-		for (x = 0; x < width; x++) {
-			pos = y * bytesperline + x * channels;
-			data[pos] = 255 - data[pos];
-			//data[pos] = srcdst->levels - data[pos];
+	for (; x + 4 <= n; x += 4)
+	{
+		const unsigned char* p = &rgb[x * 3];
+		__m128 r = _mm_div_ps(_mm_set_ps(p[9], p[6], p[3], p[0]), k255);
+		__m128 g = _mm_div_ps(_mm_set_ps(p[10], p[7], p[4], p[1]), k255);
+		__m128 b = _mm_div_ps(_mm_set_ps(p[11], p[8], p[5], p[2]), k255);
+		__m128 max = _mm_max_ps(r, _mm_max_ps(g, b));
+		__m128 min = _mm_min_ps(r, _mm_min_ps(g, b));
+		__m128 delta = _mm_sub_ps(max, min);
+
+		// As trs hipteses de H; com max == r, |(g - b) / delta| <= 1 e fmodf(., 6) no altera o valor
+		__m128 hr = _mm_mul_ps(k60, _mm_div_ps(_mm_sub_ps(g, b), delta));
+		__m128 hg = _mm_mul_ps(k60, _mm_add_ps(_mm_div_ps(_mm_sub_ps(b, r), delta), k2));
+		__m128 hb = _mm_mul_ps(k60, _mm_add_ps(_mm_div_ps(_mm_sub_ps(r, g), delta), k4));
+		__m128 isr = _mm_cmpeq_ps(max, r);
+		__m128 isg = _mm_andnot_ps(isr, _mm_cmpeq_ps(max, g));
+		__m128 hh = _mm_or_ps(_mm_and_ps(isr, hr), _mm_or_ps(_mm_and_ps(isg, hg), _mm_andnot_ps(_mm_or_ps(isr, isg), hb)));
+		__m128 pos = _mm_cmpgt_ps(delta, k0);
+		__m128 ss;
+		int out[3][4];
+
+		hh = _mm_add_ps(hh, _mm_and_ps(_mm_cmplt_ps(hh, k0), k360));
+		hh = _mm_and_ps(pos, hh);
+		ss = _mm_and_ps(pos, _mm_div_ps(delta, max));
+
+		_mm_storeu_si128((__m128i*)out[0], _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(hh, k2), khalf)));
+		_mm_storeu_si128((__m128i*)out[1], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(ss, k255), khalf)));
+		_mm_storeu_si128((__m128i*)out[2], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(max, k255), khalf)));
+
+		for (int i = 0; i < 4; i++)
+		{
+			h[(x + i) * step] = (unsigned char)out[0][i];
+			s[(x + i) * step] = (unsigned char)out[1][i];
+			v[(x + i) * step] = (unsigned char)out[2][i];
 		}
 	}
-	return 1;
+
+	vc_rgb_to_hsv_row_scalar(&rgb[x * 3], &h[x * step], &s[x * step], &v[x * step], n - x, step);
 }
 
-// Gerar negativo da imagem RGB
-int vc_rgb_negative(IVC* srcdst)
+static void vc_hsv_range_row_sse2(const unsigned char* h, const unsigned char* s, const unsigned char* v, unsigned char* dst, int n, const int* lo, const int* hi)
 {
-	unsigned char* data = (unsigned char*)srcdst->data;
-	int width = srcdst->width;
-	int height = srcdst->height;
-	int bytesperline = srcdst->width * srcdst->channels;
-	int channels = srcdst->channels;
-	int x, y;
-	long int pos;
-
-	// Verificao de erros
-	if ((srcdst->width <= 0) || (srcdst->height <= 0) || (srcdst->data == NULL)) return 0;
-	if (channels != 3) return 0;
+	// x >= lo <=> max(x, lo) == x; x <= hi <=> min(x, hi) == x (comparaes sem sinal)
+	__m128i hlo = _mm_set1_epi8((char)lo[0]), hhi = _mm_set1_epi8((char)hi[0]);
+	__m128i slo = _mm_set1_epi8((char)lo[1]), shi = _mm_set1_epi8((char)hi[1]);
+	__m128i vlo = _mm_set1_epi8((char)lo[2]), vhi = _mm_set1_epi8((char)hi[2]);
+	int x = 0;
 
-	// Inverte a imagem RGB
-	for (y = 0; y < height; y++)
+	for (; x + 16 <= n; x += 16)
 	{
-		for (x = 0; x < width; x++)
-		{
-			pos = y * bytesperline + x * channels;
+		__m128i hv = _mm_loadu_si128((const __m128i*) & h[x]);
+		__m128i sv = _mm_loadu_si128((const __m128i*) & s[x]);
+		__m128i vv = _mm_loadu_si128((const __m128i*) & v[x]);
 
-			data[pos] = 255 - data[pos];
-			data[pos + 1] = 255 - data[pos + 1];
-			data[pos + 2] = 255 - data[pos + 2];
-		}
+		__m128i m = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(hv, hlo), hv), _mm_cmpeq_epi8(_mm_min_epu8(hv, hhi), hv));
+		m = _mm_and_si128(m, _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(sv, slo), sv), _mm_cmpeq_epi8(_mm_min_epu8(sv, shi), sv)));
+		m = _mm_and_si128(m, _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(vv, vlo), vv), _mm_cmpeq_epi8(_mm_min_epu8(vv, vhi), vv)));
+
+		_mm_storeu_si128((__m128i*) & dst[x], m);
 	}
 
-	return 1;
+	vc_hsv_range_row_scalar(&h[x], &s[x], &v[x], &dst[x], n - x, lo, hi);
 }
 
+static void vc_threshold_row_sse2(const unsigned char* src, unsigned char* dst, int n, int threshold)
+{
+	// Comparao sem sinal via comparao com sinal, aps trocar o bit mais significativo
+	__m128i bias = _mm_set1_epi8((char)0x80);
+	__m128i th = _mm_set1_epi8((char)(threshold ^ 0x80));
+	int x = 0;
 
+	for (; x + 16 <= n; x += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) & src[x]);
+		_mm_storeu_si128((__m128i*) & dst[x], _mm_cmpgt_epi8(_mm_xor_si128(v, bias), th));
+	}
 
-// Converter de RGB para Gray
-int vc_rgb_to_gray(IVC* src, IVC* dst)
+	vc_threshold_row_scalar(&src[x], &dst[x], n - x, threshold);
+}
+
+static void vc_absdiff_row_sse2(const unsigned char* a, const unsigned char* b, unsigned char* dst, int n, int threshold)
 {
-	unsigned char* datasrc = (unsigned char*)src->data;
-	int bytesperline_src = src->width * src->channels;
-	int channels_src = src->channels;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int bytesperline_dst = dst->width * dst->channels;
-	int channels_dst = dst->channels;
-	int width = src->width;
-	int height = src->height;
-	int x, y;
-	long int pos_src, pos_dst;
-	float rf, gf, bf;
+	__m128i bias = _mm_set1_epi8((char)0x80);
+	__m128i th = _mm_set1_epi8((char)(threshold ^ 0x80));
+	int x = 0;
 
-	// Verificao de erros
-	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
-	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	for (; x + 16 <= n; x += 16)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i*) & a[x]);
+		__m128i vb = _mm_loadu_si128((const __m128i*) & b[x]);
+		__m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));	// |a - b| com saturao
+		_mm_storeu_si128((__m128i*) & dst[x], _mm_cmpgt_epi8(_mm_xor_si128(d, bias), th));
+	}
 
-	for (y = 0; y < height; y++)
+	vc_absdiff_row_scalar(&a[x], &b[x], &dst[x], n - x, threshold);
+}
+
+static void vc_morph_hrow_sse2(const unsigned char* row, unsigned char* hit, int n, int r, unsigned char value)
+{
+	__m128i val = _mm_set1_epi8((char)value);
+	int x = r;
+
+	for (; x + 16 + r <= n; x += 16)
 	{
-		for (x = 0; x < width; x++)
+		__m128i acc = _mm_setzero_si128();
+
+		for (int k = -r; k <= r; k++)
 		{
-			pos_src = y * bytesperline_src + x * channels_src;
-			pos_dst = y * bytesperline_dst + x * channels_dst;
+			acc = _mm_or_si128(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) & row[x + k]), val));
+		}
 
-			rf = (float)datasrc[pos_src];
-			gf = (float)datasrc[pos_src + 1];
-			bf = (float)datasrc[pos_src + 2];
+		_mm_storeu_si128((__m128i*) & hit[x], acc);
+	}
 
-			datadst[pos_dst] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
+	for (; x < n - r; x++)
+	{
+		unsigned char found = 0;
+
+		for (int k = -r; k <= r; k++) found |= (row[x + k] == value);
+
+		hit[x] = (unsigned char)(-found);
+	}
+}
+
+static void vc_morph_vrows_sse2(unsigned char** rows, int nrows, unsigned char* dst, int x0, int x1, unsigned char value)
+{
+	__m128i yes = _mm_set1_epi8((char)value);
+	__m128i no = _mm_set1_epi8((char)(255 - value));
+	int x = x0;
+
+	for (; x + 16 <= x1; x += 16)
+	{
+		__m128i acc = _mm_setzero_si128();
+
+		for (int j = 0; j < nrows; j++)
+		{
+			acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*) & rows[j][x]));
 		}
+
+		_mm_storeu_si128((__m128i*) & dst[x], _mm_or_si128(_mm_and_si128(acc, yes), _mm_andnot_si128(acc, no)));
 	}
 
-	return 1;
+	vc_morph_vrows_scalar(rows, nrows, dst, x, x1, value);
 }
 
-
-int vec_rgb_to_hsv(IVC* src, IVC* dst)
+static int vc_edge_row_sse2(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int x1, int w, int th2)
 {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3 || dst->channels != 3)) return 0;
-
-	int size = src->width * src->height * src->channels;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
+	// 8 pixis por iterao, em 16 bits (|gx|, |gy| <= 1020); gx^2 + gy^2 em 32 bits com madd
+	__m128i zero = _mm_setzero_si128();
+	__m128i th2v = _mm_set1_epi32(th2);
+	int x = 1;
 
-	for (int i = 0; i < size; i += 3)
+	for (; x + 8 <= x1; x += 8)
 	{
-		float r = data_src[i] / 255.0f;
-		float g = data_src[i + 1] / 255.0f;
-		float b = data_src[i + 2] / 255.0f;
+		__m128i a0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p0[x - 1]), zero);
+		__m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p0[x]), zero);
+		__m128i c0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p0[x + 1]), zero);
+		__m128i a1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p1[x - 1]), zero);
+		__m128i c1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p1[x + 1]), zero);
+		__m128i a2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p2[x - 1]), zero);
+		__m128i b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p2[x]), zero);
+		__m128i c2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) & p2[x + 1]), zero);
+		__m128i mid = _mm_sub_epi16(c1, a1);
+		__m128i vgx, vgy, lo, hi, mask;
+
+		if (w == 2)
+		{
+			mid = _mm_add_epi16(mid, mid);
+			b0 = _mm_add_epi16(b0, b0);
+			b2 = _mm_add_epi16(b2, b2);
+		}
 
+		vgx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(c0, a0), mid), _mm_sub_epi16(c2, a2));
+		vgy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a0, b0), c0), _mm_add_epi16(_mm_add_epi16(a2, b2), c2));
 
-		float max = MAX3(r, g, b);
-		float min = MIN3(r, g, b);
-		float delta = max - min;
-		float h = 0, s = 0, v = max;
+		lo = _mm_unpacklo_epi16(vgx, vgy);
+		hi = _mm_unpackhi_epi16(vgx, vgy);
+		lo = _mm_cmpgt_epi32(_mm_madd_epi16(lo, lo), th2v);
+		hi = _mm_cmpgt_epi32(_mm_madd_epi16(hi, hi), th2v);
+		mask = _mm_packs_epi16(_mm_packs_epi32(lo, hi), zero);
 
-		if (delta > 0)
-		{
-			if (max == r)
-			{
-				h = 60 * fmodf(((g - b) / delta), 6);
-			}
-			else if (max == g)
-			{
-				h = 60 * (((b - r) / delta) + 2);
-			}
-			else
-			{
-				h = 60 * (((r - g) / delta) + 4);
-			}
+		_mm_storel_epi64((__m128i*) & d[x], mask);
+	}
+
+	return x;
+}
+
+#endif // VC_SSE2
+
+
+#ifdef VC_AVX
+
+// --- Verses AVX2 (256 bits) ---
+
+VC_TARGET("avx2")
+static void vc_rgb_to_hsv_row_avx2(const unsigned char* rgb, unsigned char* h, unsigned char* s, unsigned char* v, int n, int step)
+{
+	const __m256 k0 = _mm256_setzero_ps(), k2 = _mm256_set1_ps(2.0f), k4 = _mm256_set1_ps(4.0f);
+	const __m256 k60 = _mm256_set1_ps(60.0f), k255 = _mm256_set1_ps(255.0f), k360 = _mm256_set1_ps(360.0f), khalf = _mm256_set1_ps(0.5f);
+	unsigned char cr[16], cg[16], cb[16];
+	int x = 0;
 
-			if (h < 0)
-				h += 360;
+	for (; x + 8 <= n; x += 8)
+	{
+		const unsigned char* p = &rgb[x * 3];
+		int out[3][8];
 
-			s = max == 0 ? 0 : (delta / max);
+		for (int i = 0; i < 8; i++)
+		{
+			cr[i] = p[i * 3];
+			cg[i] = p[i * 3 + 1];
+			cb[i] = p[i * 3 + 2];
 		}
 
-		data_dst[i] = (unsigned char)(h / 2);          // Convertendo H para 0-255
-		data_dst[i + 1] = (unsigned char)(s * 255);   // Convertendo S para 0-255
-		data_dst[i + 2] = (unsigned char)(v * 255);   // Convertendo V para 0-255
+		__m256 r = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)cr))), k255);
+		__m256 g = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)cg))), k255);
+		__m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)cb))), k255);
+		__m256 max = _mm256_max_ps(r, _mm256_max_ps(g, b));
+		__m256 min = _mm256_min_ps(r, _mm256_min_ps(g, b));
+		__m256 delta = _mm256_sub_ps(max, min);
+
+		__m256 hr = _mm256_mul_ps(k60, _mm256_div_ps(_mm256_sub_ps(g, b), delta));
+		__m256 hg = _mm256_mul_ps(k60, _mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(b, r), delta), k2));
+		__m256 hb = _mm256_mul_ps(k60, _mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(r, g), delta), k4));
+		__m256 hh = _mm256_blendv_ps(_mm256_blendv_ps(hb, hg, _mm256_cmp_ps(max, g, _CMP_EQ_OQ)), hr, _mm256_cmp_ps(max, r, _CMP_EQ_OQ));
+		__m256 pos = _mm256_cmp_ps(delta, k0, _CMP_GT_OQ);
+		__m256 ss;
+
+		hh = _mm256_add_ps(hh, _mm256_and_ps(_mm256_cmp_ps(hh, k0, _CMP_LT_OQ), k360));
+		hh = _mm256_and_ps(pos, hh);
+		ss = _mm256_and_ps(pos, _mm256_div_ps(delta, max));
+
+		_mm256_storeu_si256((__m256i*)out[0], _mm256_cvttps_epi32(_mm256_add_ps(_mm256_div_ps(hh, k2), khalf)));
+		_mm256_storeu_si256((__m256i*)out[1], _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(ss, k255), khalf)));
+		_mm256_storeu_si256((__m256i*)out[2], _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(max, k255), khalf)));
+
+		for (int i = 0; i < 8; i++)
+		{
+			h[(x + i) * step] = (unsigned char)out[0][i];
+			s[(x + i) * step] = (unsigned char)out[1][i];
+			v[(x + i) * step] = (unsigned char)out[2][i];
+		}
 	}
 
-	return 1;
+	vc_rgb_to_hsv_row_scalar(&rgb[x * 3], &h[x * step], &s[x * step], &v[x * step], n - x, step);
 }
 
+VC_TARGET("avx2")
+static void vc_hsv_range_row_avx2(const unsigned char* h, const unsigned char* s, const unsigned char* v, unsigned char* dst, int n, const int* lo, const int* hi)
+{
+	__m256i hlo = _mm256_set1_epi8((char)lo[0]), hhi = _mm256_set1_epi8((char)hi[0]);
+	__m256i slo = _mm256_set1_epi8((char)lo[1]), shi = _mm256_set1_epi8((char)hi[1]);
+	__m256i vlo = _mm256_set1_epi8((char)lo[2]), vhi = _mm256_set1_epi8((char)hi[2]);
+	int x = 0;
+
+	for (; x + 32 <= n; x += 32)
+	{
+		__m256i hv = _mm256_loadu_si256((const __m256i*) & h[x]);
+		__m256i sv = _mm256_loadu_si256((const __m256i*) & s[x]);
+		__m256i vv = _mm256_loadu_si256((const __m256i*) & v[x]);
 
+		__m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(hv, hlo), hv), _mm256_cmpeq_epi8(_mm256_min_epu8(hv, hhi), hv));
+		m = _mm256_and_si256(m, _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(sv, slo), sv), _mm256_cmpeq_epi8(_mm256_min_epu8(sv, shi), sv)));
+		m = _mm256_and_si256(m, _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(vv, vlo), vv), _mm256_cmpeq_epi8(_mm256_min_epu8(vv, vhi), vv)));
 
-int vc_rgb_to_hsv(IVC* src, IVC* dst)
+		_mm256_storeu_si256((__m256i*) & dst[x], m);
+	}
+
+	vc_hsv_range_row_scalar(&h[x], &s[x], &v[x], &dst[x], n - x, lo, hi);
+}
+
+VC_TARGET("avx2")
+static void vc_threshold_row_avx2(const unsigned char* src, unsigned char* dst, int n, int threshold)
 {
-	if (src == NULL || dst == NULL)
+	__m256i bias = _mm256_set1_epi8((char)0x80);
+	__m256i th = _mm256_set1_epi8((char)(threshold ^ 0x80));
+	int x = 0;
+
+	for (; x + 32 <= n; x += 32)
 	{
-		return 0;
+		__m256i v = _mm256_loadu_si256((const __m256i*) & src[x]);
+		_mm256_storeu_si256((__m256i*) & dst[x], _mm256_cmpgt_epi8(_mm256_xor_si256(v, bias), th));
 	}
 
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3 || dst->channels != 3))
+	vc_threshold_row_scalar(&src[x], &dst[x], n - x, threshold);
+}
+
+VC_TARGET("avx2")
+static void vc_absdiff_row_avx2(const unsigned char* a, const unsigned char* b, unsigned char* dst, int n, int threshold)
+{
+	__m256i bias = _mm256_set1_epi8((char)0x80);
+	__m256i th = _mm256_set1_epi8((char)(threshold ^ 0x80));
+	int x = 0;
+
+	for (; x + 32 <= n; x += 32)
 	{
-		return 0;
+		__m256i va = _mm256_loadu_si256((const __m256i*) & a[x]);
+		__m256i vb = _mm256_loadu_si256((const __m256i*) & b[x]);
+		__m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+		_mm256_storeu_si256((__m256i*) & dst[x], _mm256_cmpgt_epi8(_mm256_xor_si256(d, bias), th));
 	}
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
+	vc_absdiff_row_scalar(&a[x], &b[x], &dst[x], n - x, threshold);
+}
 
-	for (int y = 0; y < height; y++)
+VC_TARGET("avx2")
+static void vc_morph_hrow_avx2(const unsigned char* row, unsigned char* hit, int n, int r, unsigned char value)
+{
+	__m256i val = _mm256_set1_epi8((char)value);
+	int x = r;
+
+	for (; x + 32 + r <= n; x += 32)
 	{
-		for (int x = 0; x < width; x++)
+		__m256i acc = _mm256_setzero_si256();
+
+		for (int k = -r; k <= r; k++)
 		{
-			int i = (y * width + x) * 3; // ndice do pixel na matriz 1D
+			acc = _mm256_or_si256(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) & row[x + k]), val));
+		}
 
-			float r = data_src[i] / 255.0f;
-			float g = data_src[i + 1] / 255.0f;
-			float b = data_src[i + 2] / 255.0f;
+		_mm256_storeu_si256((__m256i*) & hit[x], acc);
+	}
 
-			float max = MAX3(r, g, b);
-			float min = MIN3(r, g, b);
-			float delta = max - min;
-			float h = 0, s = 0, v = max;
+	for (; x < n - r; x++)
+	{
+		unsigned char found = 0;
 
-			if (delta > 0)
-			{
-				if (max == r)
-				{
-					h = 60 * fmodf(((g - b) / delta), 6);
-				}
-				else if (max == g)
-				{
-					h = 60 * (((b - r) / delta) + 2);
-				}
-				else
-				{
-					h = 60 * (((r - g) / delta) + 4);
-				}
+		for (int k = -r; k <= r; k++) found |= (row[x + k] == value);
 
-				if (h < 0)
-					h += 360;
+		hit[x] = (unsigned char)(-found);
+	}
+}
 
-				s = max == 0 ? 0 : (delta / max);
-			}
+VC_TARGET("avx2")
+static void vc_morph_vrows_avx2(unsigned char** rows, int nrows, unsigned char* dst, int x0, int x1, unsigned char value)
+{
+	__m256i yes = _mm256_set1_epi8((char)value);
+	__m256i no = _mm256_set1_epi8((char)(255 - value));
+	int x = x0;
 
-			data_dst[i] = (unsigned char)(h / 2.0f + 0.5f);     // H (0179)
-			data_dst[i + 1] = (unsigned char)(s * 255.0f + 0.5f);   // S (0255)
-			data_dst[i + 2] = (unsigned char)(v * 255.0f + 0.5f);   // V (0255)
+	for (; x + 32 <= x1; x += 32)
+	{
+		__m256i acc = _mm256_setzero_si256();
+
+		for (int j = 0; j < nrows; j++)
+		{
+			acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i*) & rows[j][x]));
 		}
+
+		_mm256_storeu_si256((__m256i*) & dst[x], _mm256_or_si256(_mm256_and_si256(acc, yes), _mm256_andnot_si256(acc, no)));
 	}
 
-	return 1;
+	vc_morph_vrows_scalar(rows, nrows, dst, x, x1, value);
 }
 
+VC_TARGET("avx2")
+static int vc_edge_row_avx2(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int x1, int w, int th2)
+{
+	// 16 pixis por iterao; unpack/packs actuam por metades de 128 bits, pelo que a ordem dos pixis se mantm
+	__m256i th2v = _mm256_set1_epi32(th2);
+	int x = 1;
 
-// hmin,hmax = [0, 360]; smin,smax = [0, 100]; vmin,vmax = [0, 100]
-int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3)) return 0;
-
-	int bytesperline = src->width * src->channels;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
+	for (; x + 16 <= x1; x += 16)
+	{
+		__m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p0[x - 1]));
+		__m256i b0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p0[x]));
+		__m256i c0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p0[x + 1]));
+		__m256i a1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p1[x - 1]));
+		__m256i c1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p1[x + 1]));
+		__m256i a2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p2[x - 1]));
+		__m256i b2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p2[x]));
+		__m256i c2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) & p2[x + 1]));
+		__m256i mid = _mm256_sub_epi16(c1, a1);
+		__m256i vgx, vgy, lo, hi, mask;
+
+		if (w == 2)
+		{
+			mid = _mm256_add_epi16(mid, mid);
+			b0 = _mm256_add_epi16(b0, b0);
+			b2 = _mm256_add_epi16(b2, b2);
+		}
 
-	for (int y = 0; y < src->height; y++) {
-		for (int x = 0; x < src->width; x++) {
-			int pos = y * bytesperline + x * src->channels;
+		vgx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(c0, a0), mid), _mm256_sub_epi16(c2, a2));
+		vgy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(a0, b0), c0), _mm256_add_epi16(_mm256_add_epi16(a2, b2), c2));
 
-			// Obter os valores HSV da imagem de entrada
-			float h = data_src[pos] * 2;     // H: 0-360 graus
-			float s = data_src[pos + 1] / 255.0 * 100; // S: 0-100 %
-			float v = data_src[pos + 2] / 255.0 * 100; // V: 0-100 %
+		lo = _mm256_unpacklo_epi16(vgx, vgy);
+		hi = _mm256_unpackhi_epi16(vgx, vgy);
+		lo = _mm256_cmpgt_epi32(_mm256_madd_epi16(lo, lo), th2v);
+		hi = _mm256_cmpgt_epi32(_mm256_madd_epi16(hi, hi), th2v);
+		mask = _mm256_packs_epi32(lo, hi);
+		mask = _mm256_permute4x64_epi64(_mm256_packs_epi16(mask, mask), 0x08);
 
-			// Verificar se está dentro do intervalo
-			if ((h >= hmin && h <= hmax) && (s >= smin && s <= smax) && (v >= vmin && v <= vmax)) {
-				data_dst[y * dst->width + x] = 255; // Branco
-			}
-			else {
-				data_dst[y * dst->width + x] = 0;   // Preto
-			}
-		}
+		_mm_storeu_si128((__m128i*) & d[x], _mm256_castsi256_si128(mask));
 	}
 
-	return 1;
+	return x;
 }
 
 
-int vc_scale_gray_to_color_palette(IVC* src, IVC* dst)
+// --- Verses AVX-512 (F + BW, 512 bits) ---
+
+VC_TARGET("avx512f,avx512bw")
+static void vc_rgb_to_hsv_row_avx512(const unsigned char* rgb, unsigned char* h, unsigned char* s, unsigned char* v, int n, int step)
 {
-	if (src == NULL || dst == NULL)
-		return 0;
-	if (src->width != dst->width || src->height != dst->height || src->channels != 1 || dst->channels != 3)
-		return 0;
+	const __m512 k0 = _mm512_setzero_ps(), k2 = _mm512_set1_ps(2.0f), k4 = _mm512_set1_ps(4.0f);
+	const __m512 k60 = _mm512_set1_ps(60.0f), k255 = _mm512_set1_ps(255.0f), k360 = _mm512_set1_ps(360.0f), khalf = _mm512_set1_ps(0.5f);
+	unsigned char cr[16], cg[16], cb[16];
+	int x = 0;
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* gray_data = src->data;
-	unsigned char* color_data = dst->data;
+	for (; x + 16 <= n; x += 16)
+	{
+		const unsigned char* p = &rgb[x * 3];
+		unsigned char out[3][16];
 
-	int r, g, b;
+		for (int i = 0; i < 16; i++)
+		{
+			cr[i] = p[i * 3];
+			cg[i] = p[i * 3 + 1];
+			cb[i] = p[i * 3 + 2];
+		}
 
-	for (int y = 0; y < height; y++)
-	{
-		for (int x = 0; x < width; x++)
+		__m512 r = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)cr))), k255);
+		__m512 g = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)cg))), k255);
+		__m512 b = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)cb))), k255);
+		__m512 max = _mm512_max_ps(r, _mm512_max_ps(g, b));
+		__m512 min = _mm512_min_ps(r, _mm512_min_ps(g, b));
+		__m512 delta = _mm512_sub_ps(max, min);
+
+		__m512 hr = _mm512_mul_ps(k60, _mm512_div_ps(_mm512_sub_ps(g, b), delta));
+		__m512 hg = _mm512_mul_ps(k60, _mm512_add_ps(_mm512_div_ps(_mm512_sub_ps(b, r), delta), k2));
+		__m512 hb = _mm512_mul_ps(k60, _mm512_add_ps(_mm512_div_ps(_mm512_sub_ps(r, g), delta), k4));
+		__m512 hh = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(max, g, _CMP_EQ_OQ), hb, hg);
+		__mmask16 pos = _mm512_cmp_ps_mask(delta, k0, _CMP_GT_OQ);
+		__m512 ss;
+
+		hh = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(max, r, _CMP_EQ_OQ), hh, hr);
+		hh = _mm512_mask_add_ps(hh, _mm512_cmp_ps_mask(hh, k0, _CMP_LT_OQ), hh, k360);
+		hh = _mm512_maskz_mov_ps(pos, hh);
+		ss = _mm512_maskz_div_ps(pos, delta, max);
+
+		_mm_storeu_si128((__m128i*)out[0], _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(_mm512_add_ps(_mm512_div_ps(hh, k2), khalf))));
+		_mm_storeu_si128((__m128i*)out[1], _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(ss, k255), khalf))));
+		_mm_storeu_si128((__m128i*)out[2], _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(max, k255), khalf))));
+
+		for (int i = 0; i < 16; i++)
 		{
-			int i = y * width + x;
-			unsigned char gray = gray_data[i];
+			h[(x + i) * step] = out[0][i];
+			s[(x + i) * step] = out[1][i];
+			v[(x + i) * step] = out[2][i];
+		}
+	}
 
-			if (gray >= 0 && gray < 64) {
-				r = 255;
-				g = gray * 4;
-				b = 0;
-			}
-			else if (gray >= 64 && gray < 128) {
-				r = 255 - (gray - 64) * 4;
-				g = 255;
-				b = 0;
-			}
-			else if (gray >= 128 && gray < 193) {
-				r = 0;
-				g = 255;
-				b = (gray - 128) * 4;
-			}
-			else {
-				r = 0;
-				g = 255 - (gray - 193) * 4;
-				b = 255;
-			}
+	vc_rgb_to_hsv_row_scalar(&rgb[x * 3], &h[x * step], &s[x * step], &v[x * step], n - x, step);
+}
 
-			color_data[i * 3] = b;
-			color_data[i * 3 + 1] = g;
-			color_data[i * 3 + 2] = r;
-		}
+VC_TARGET("avx512f,avx512bw")
+static void vc_hsv_range_row_avx512(const unsigned char* h, const unsigned char* s, const unsigned char* v, unsigned char* dst, int n, const int* lo, const int* hi)
+{
+	__m512i hlo = _mm512_set1_epi8((char)lo[0]), hhi = _mm512_set1_epi8((char)hi[0]);
+	__m512i slo = _mm512_set1_epi8((char)lo[1]), shi = _mm512_set1_epi8((char)hi[1]);
+	__m512i vlo = _mm512_set1_epi8((char)lo[2]), vhi = _mm512_set1_epi8((char)hi[2]);
+	int x = 0;
+
+	for (; x + 64 <= n; x += 64)
+	{
+		__m512i hv = _mm512_loadu_si512((const void*)&h[x]);
+		__m512i sv = _mm512_loadu_si512((const void*)&s[x]);
+		__m512i vv = _mm512_loadu_si512((const void*)&v[x]);
+		__mmask64 m;
+
+		m = _mm512_cmpge_epu8_mask(hv, hlo) & _mm512_cmple_epu8_mask(hv, hhi);
+		m &= _mm512_cmpge_epu8_mask(sv, slo) & _mm512_cmple_epu8_mask(sv, shi);
+		m &= _mm512_cmpge_epu8_mask(vv, vlo) & _mm512_cmple_epu8_mask(vv, vhi);
+
+		_mm512_storeu_si512((void*)&dst[x], _mm512_movm_epi8(m));
 	}
 
-	return 1;
+	vc_hsv_range_row_scalar(&h[x], &s[x], &v[x], &dst[x], n - x, lo, hi);
 }
 
-int vc_gray_to_binary(IVC* src, IVC* dst, int threshold) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+VC_TARGET("avx512f,avx512bw")
+static void vc_threshold_row_avx512(const unsigned char* src, unsigned char* dst, int n, int threshold)
+{
+	__m512i th = _mm512_set1_epi8((char)threshold);
+	int x = 0;
 
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
+	for (; x + 64 <= n; x += 64)
+	{
+		__m512i v = _mm512_loadu_si512((const void*)&src[x]);
+		_mm512_storeu_si512((void*)&dst[x], _mm512_movm_epi8(_mm512_cmpgt_epu8_mask(v, th)));
+	}
 
-	for (int y = 0; y < src->height; y++) {
-		for (int x = 0; x < src->width; x++) {
-			int pos = y * src->width + x; // Clculo direto da posio
+	vc_threshold_row_scalar(&src[x], &dst[x], n - x, threshold);
+}
 
-			if (data_src[pos] > threshold) {
-				data_dst[pos] = 255;
-			}
-			else {
-				data_dst[pos] = 0;
-			}
-		}
+VC_TARGET("avx512f,avx512bw")
+static void vc_absdiff_row_avx512(const unsigned char* a, const unsigned char* b, unsigned char* dst, int n, int threshold)
+{
+	__m512i th = _mm512_set1_epi8((char)threshold);
+	int x = 0;
+
+	for (; x + 64 <= n; x += 64)
+	{
+		__m512i va = _mm512_loadu_si512((const void*)&a[x]);
+		__m512i vb = _mm512_loadu_si512((const void*)&b[x]);
+		__m512i d = _mm512_or_si512(_mm512_subs_epu8(va, vb), _mm512_subs_epu8(vb, va));
+		_mm512_storeu_si512((void*)&dst[x], _mm512_movm_epi8(_mm512_cmpgt_epu8_mask(d, th)));
 	}
 
-	return 1;
+	vc_absdiff_row_scalar(&a[x], &b[x], &dst[x], n - x, threshold);
 }
 
-int vc_gray_to_binary_global_mean(IVC* src, IVC* dst) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+VC_TARGET("avx512f,avx512bw")
+static void vc_morph_hrow_avx512(const unsigned char* row, unsigned char* hit, int n, int r, unsigned char value)
+{
+	__m512i val = _mm512_set1_epi8((char)value);
+	int x = r;
 
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int N = src->height; 
-	int M = src->width;  
-	long sum = 0; 
+	for (; x + 64 + r <= n; x += 64)
+	{
+		__mmask64 acc = 0;
 
-	for (int y = 0; y < N; y++) {
-		for (int x = 0; x < M; x++) {
-			sum += data_src[y * M + x];
+		for (int k = -r; k <= r; k++)
+		{
+			acc |= _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)&row[x + k]), val);
 		}
+
+		_mm512_storeu_si512((void*)&hit[x], _mm512_movm_epi8(acc));
 	}
-	int threshold = sum / (N * M);
 
+	for (; x < n - r; x++)
+	{
+		unsigned char found = 0;
 
+		for (int k = -r; k <= r; k++) found |= (row[x + k] == value);
 
-	for (int y = 0; y < N; y++) {
-		for (int x = 0; x < M; x++) {
-			int pos = y * M + x;
+		hit[x] = (unsigned char)(-found);
+	}
+}
 
-			if (data_src[pos] > threshold) {
-				data_dst[pos] = 255;
-			}
-			else {
-				data_dst[pos] = 0;
-			}
+VC_TARGET("avx512f,avx512bw")
+static void vc_morph_vrows_avx512(unsigned char** rows, int nrows, unsigned char* dst, int x0, int x1, unsigned char value)
+{
+	__m512i yes = _mm512_set1_epi8((char)value);
+	__m512i no = _mm512_set1_epi8((char)(255 - value));
+	int x = x0;
+
+	for (; x + 64 <= x1; x += 64)
+	{
+		__m512i acc = _mm512_setzero_si512();
+
+		for (int j = 0; j < nrows; j++)
+		{
+			acc = _mm512_or_si512(acc, _mm512_loadu_si512((const void*)&rows[j][x]));
 		}
+
+		_mm512_storeu_si512((void*)&dst[x], _mm512_mask_blend_epi8(_mm512_test_epi8_mask(acc, acc), no, yes));
 	}
 
-	return 1;
+	vc_morph_vrows_scalar(rows, nrows, dst, x, x1, value);
 }
 
-int vc_gray_to_binary_midpoint(IVC* src, IVC* dst, int kernel) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) ||
-		(src->channels != 1) || (dst->channels != 1)) return 0;
+VC_TARGET("avx512f,avx512bw")
+static int vc_edge_row_avx512(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int x1, int w, int th2)
+{
+	// 16 pixis por iterao, directamente em 32 bits
+	__m512i th2v = _mm512_set1_epi32(th2);
+	__m512i k255 = _mm512_set1_epi32(255);
+	int x = 1;
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int half_kernel = kernel / 2;
+	for (; x + 16 <= x1; x += 16)
+	{
+		__m512i a0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p0[x - 1]));
+		__m512i b0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p0[x]));
+		__m512i c0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p0[x + 1]));
+		__m512i a1 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p1[x - 1]));
+		__m512i c1 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p1[x + 1]));
+		__m512i a2 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p2[x - 1]));
+		__m512i b2 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p2[x]));
+		__m512i c2 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) & p2[x + 1]));
+		__m512i mid = _mm512_sub_epi32(c1, a1);
+		__m512i vgx, vgy, g2;
+
+		if (w == 2)
+		{
+			mid = _mm512_add_epi32(mid, mid);
+			b0 = _mm512_add_epi32(b0, b0);
+			b2 = _mm512_add_epi32(b2, b2);
+		}
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			int v_min = 255;
-			int v_max = 0;
+		vgx = _mm512_add_epi32(_mm512_add_epi32(_mm512_sub_epi32(c0, a0), mid), _mm512_sub_epi32(c2, a2));
+		vgy = _mm512_sub_epi32(_mm512_add_epi32(_mm512_add_epi32(a0, b0), c0), _mm512_add_epi32(_mm512_add_epi32(a2, b2), c2));
+		g2 = _mm512_add_epi32(_mm512_mullo_epi32(vgx, vgx), _mm512_mullo_epi32(vgy, vgy));
 
-			// Percorre a vizinhana
-			for (int ky = -half_kernel; ky <= half_kernel; ky++) {
-				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-					int ny = y + ky;
-					int nx = x + kx;
+		_mm_storeu_si128((__m128i*) & d[x], _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(g2, th2v), k255)));
+	}
 
-					// Verifica se est dentro da imagem
-					if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
-						int pos = ny * width + nx;
-						int value = data_src[pos];
+	return x;
+}
 
-						if (value < v_min) v_min = value;
-						if (value > v_max) v_max = value;
-					}
-				}
-			}
+#endif // VC_AVX
 
-			// Calcula o threshold
-			int threshold = (v_min + v_max) / 2;
-			int pos = y * width + x;
 
-			// Aplica a binarizao
-			if (data_src[pos] > threshold) {
-				data_dst[pos] = 255;
-			}
-			else {
-				data_dst[pos] = 0;
-			}
-		}
-	}
+// Tabela de despacho
+typedef struct {
+	int tier;
+	void (*rgb_to_hsv_row)(const unsigned char* rgb, unsigned char* h, unsigned char* s, unsigned char* v, int n, int step);
+	void (*hsv_range_row)(const unsigned char* h, const unsigned char* s, const unsigned char* v, unsigned char* dst, int n, const int* lo, const int* hi);
+	void (*threshold_row)(const unsigned char* src, unsigned char* dst, int n, int threshold);
+	void (*absdiff_row)(const unsigned char* a, const unsigned char* b, unsigned char* dst, int n, int threshold);
+	void (*morph_hrow)(const unsigned char* row, unsigned char* hit, int n, int r, unsigned char value);
+	void (*morph_vrows)(unsigned char** rows, int nrows, unsigned char* dst, int x0, int x1, unsigned char value);
+	int (*edge_row)(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int x1, int w, int th2);
+} VCCPUDISPATCH;
 
-	return 1;
-}
+static VCCPUDISPATCH vc_cpu = { -1, vc_rgb_to_hsv_row_scalar, vc_hsv_range_row_scalar, vc_threshold_row_scalar, vc_absdiff_row_scalar, vc_morph_hrow_scalar, vc_morph_vrows_scalar, vc_edge_row_scalar };
 
+static const char* vc_cpu_names[] = { "scalar", "sse2", "avx2", "avx512" };
 
-//Operadores morfologicos
-/*int vc_binary_dilate(IVC* src, IVC* dst, int kernel) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int half_kernel = kernel / 2;
+// Melhor nvel suportado pelo CPU (e pelo sistema operativo, no caso dos registos AVX)
+int vc_cpu_detect(void)
+{
+#if defined(VC_SSE2) && defined(VC_AVX) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return VC_CPU_AVX512;
+	if (__builtin_cpu_supports("avx2")) return VC_CPU_AVX2;
+	return VC_CPU_SSE2;
+#elif defined(VC_SSE2) && defined(VC_AVX) && defined(_MSC_VER)
+	int info[4];
+	unsigned long long xcr0;
+
+	__cpuid(info, 0);
+	if (info[0] < 7) return VC_CPU_SSE2;
+
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) return VC_CPU_SSE2;	// OSXSAVE e AVX
+
+	xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+
+	if ((info[1] & (1 << 16)) && (info[1] & (1 << 30)) && ((xcr0 & 0xE6) == 0xE6)) return VC_CPU_AVX512;	// AVX-512F, AVX-512BW, estado ZMM
+	if ((info[1] & (1 << 5)) && ((xcr0 & 0x06) == 0x06)) return VC_CPU_AVX2;	// AVX2, estado YMM
+	return VC_CPU_SSE2;
+#elif defined(VC_SSE2)
+	return VC_CPU_SSE2;
+#else
+	return VC_CPU_SCALAR;
+#endif
+}
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			int pos = y * width + x;
-			int found_white = 0;
 
-			// Percorre a vizinhana
-			for (int ky = -half_kernel; ky <= half_kernel; ky++) {
-				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-					int ny = y + ky;
-					int nx = x + kx;
+// Liga a tabela s verses do nvel tier (limitado ao suportado pelo CPU); devolve o nvel efectivo
+int vc_cpu_set_tier(int tier)
+{
+	VCCPUDISPATCH d = { VC_CPU_SCALAR, vc_rgb_to_hsv_row_scalar, vc_hsv_range_row_scalar, vc_threshold_row_scalar, vc_absdiff_row_scalar, vc_morph_hrow_scalar, vc_morph_vrows_scalar, vc_edge_row_scalar };
+	int best = vc_cpu_detect();
 
-					// Verifica se est dentro da imagem
-					if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
-						int neighbor_pos = ny * width + nx;
-						if (data_src[neighbor_pos] == 255) {
-							found_white = 1;
-						}
-					}
-				}
-			}
+	if (tier < VC_CPU_SCALAR) tier = VC_CPU_SCALAR;
+	if (tier > best)
+	{
+#ifdef VC_DEBUG
+		printf("vc_cpu_set_tier(): nivel %s nao suportado, a usar %s\n", vc_cpu_tier_name(tier), vc_cpu_tier_name(best));
+#endif
+		tier = best;
+	}
 
-			// Aplica a dilatao
-			data_dst[pos] = found_white ? 255 : 0;
-		}
+#ifdef VC_SSE2
+	if (tier >= VC_CPU_SSE2)
+	{
+		d.rgb_to_hsv_row = vc_rgb_to_hsv_row_sse2;
+		d.hsv_range_row = vc_hsv_range_row_sse2;
+		d.threshold_row = vc_threshold_row_sse2;
+		d.absdiff_row = vc_absdiff_row_sse2;
+		d.morph_hrow = vc_morph_hrow_sse2;
+		d.morph_vrows = vc_morph_vrows_sse2;
+		d.edge_row = vc_edge_row_sse2;
 	}
+#endif
+#ifdef VC_AVX
+	if (tier >= VC_CPU_AVX2)
+	{
+		d.rgb_to_hsv_row = vc_rgb_to_hsv_row_avx2;
+		d.hsv_range_row = vc_hsv_range_row_avx2;
+		d.threshold_row = vc_threshold_row_avx2;
+		d.absdiff_row = vc_absdiff_row_avx2;
+		d.morph_hrow = vc_morph_hrow_avx2;
+		d.morph_vrows = vc_morph_vrows_avx2;
+		d.edge_row = vc_edge_row_avx2;
+	}
+	if (tier >= VC_CPU_AVX512)
+	{
+		d.rgb_to_hsv_row = vc_rgb_to_hsv_row_avx512;
+		d.hsv_range_row = vc_hsv_range_row_avx512;
+		d.threshold_row = vc_threshold_row_avx512;
+		d.absdiff_row = vc_absdiff_row_avx512;
+		d.morph_hrow = vc_morph_hrow_avx512;
+		d.morph_vrows = vc_morph_vrows_avx512;
+		d.edge_row = vc_edge_row_avx512;
+	}
+#endif
 
-	return 1;
-}
+	d.tier = tier;
+	vc_cpu = d;
 
-int vc_binary_erode(IVC* src, IVC* dst, int kernel) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+	return tier;
+}
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int half_kernel = kernel / 2;
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			int pos = y * width + x;
-			int found_black = 0;
+// Nvel em uso; na primeira chamada escolhe o melhor suportado, ou o da varivel de ambiente VC_CPU
+int vc_cpu_tier(void)
+{
+	if (vc_cpu.tier < 0)
+	{
+		const char* env = getenv("VC_CPU");
+		int tier = vc_cpu_detect();
 
-			// Percorre a vizinhana
-			for (int ky = -half_kernel; ky <= half_kernel; ky++) {
-				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-					int ny = y + ky;
-					int nx = x + kx;
+		if (env != NULL)
+		{
+			int i;
 
-					// Verifica se est dentro da imagem
-					if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
-						int neighbor_pos = ny * width + nx;
-						if (data_src[neighbor_pos] == 0) {
-							found_black = 1;
-						}
-					}
-				}
+			for (i = 0; i <= VC_CPU_AVX512; i++)
+			{
+				if (strcmp(env, vc_cpu_names[i]) == 0) break;
 			}
 
-			// Aplica a eroso
-			data_dst[pos] = found_black ? 0 : 255;
+			if (i <= VC_CPU_AVX512) tier = i;
+#ifdef VC_DEBUG
+			else printf("vc_cpu_tier(): VC_CPU=%s desconhecido (scalar, sse2, avx2, avx512)\n", env);
+#endif
 		}
+
+		vc_cpu_set_tier(tier);
 	}
 
-	return 1;
+	return vc_cpu.tier;
 }
-*/
 
-int vc_binary_erode(IVC* src, IVC* dst, int kernel) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int half_kernel = kernel / 2;
+const char* vc_cpu_tier_name(int tier)
+{
+	if ((tier < VC_CPU_SCALAR) || (tier > VC_CPU_AVX512)) return "?";
 
-	memcpy(data_dst, data_src, width * height); // Copia original para evitar sobrescrita
+	return vc_cpu_names[tier];
+}
 
-	for (int y = half_kernel; y < height - half_kernel; y++) {
-		for (int x = half_kernel; x < width - half_kernel; x++) {
-			int pos = y * width + x;
-			int found_black = 0;
 
-			for (int ky = -half_kernel; ky <= half_kernel && !found_black; ky++) {
-				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-					int ny = y + ky;
-					int nx = x + kx;
-					int neighbor_pos = ny * width + nx;
+static const VCCPUDISPATCH* vc_cpu_dispatch(void)
+{
+	if (vc_cpu.tier < 0) vc_cpu_tier();
 
-					if (data_src[neighbor_pos] == 0) {
-						found_black = 1;
-						break; // Sai do loop assim que encontra um pixel preto
-					}
-				}
-			}
+	return &vc_cpu;
+}
 
-			data_dst[pos] = found_black ? 0 : 255;
-		}
-	}
 
-	return 1;
-}
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                FUNES: POOL DE IMAGENS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-int vc_binary_dilate(IVC* src, IVC* dst, int kernel) {
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
 
-	int width = src->width;
-	int height = src->height;
-	unsigned char* data_src = src->data;
-	unsigned char* data_dst = dst->data;
-	int half_kernel = kernel / 2;
+void vc_pool_init(IVCPOOL* pool)
+{
+	if (pool == NULL) return;
 
-	memcpy(data_dst, data_src, width * height); // Copia original para evitar sobrescrita
+	memset(pool, 0, sizeof(IVCPOOL));
+}
 
-	for (int y = half_kernel; y < height - half_kernel; y++) {
-		for (int x = half_kernel; x < width - half_kernel; x++) {
-			int pos = y * width + x;
-			int found_white = 0;
 
-			for (int ky = -half_kernel; ky <= half_kernel && !found_white; ky++) {
-				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-					int ny = y + ky;
-					int nx = x + kx;
-					int neighbor_pos = ny * width + nx;
+// Devolve uma imagem livre com as dimenses pedidas (aloca uma nova se no existir).
+// Com pool == NULL comporta-se como vc_image_new().
+IVC* vc_pool_get(IVCPOOL* pool, int width, int height, int channels, int levels)
+{
+	IVC* image;
+	int i;
 
-					if (data_src[neighbor_pos] == 255) {
-						found_white = 1;
-						break; // Sai do loop assim que encontra um pixel branco
-					}
-				}
-			}
+	if (pool == NULL) return vc_image_new(width, height, channels, levels);
 
-			data_dst[pos] = found_white ? 255 : 0;
+	for (i = 0; i < pool->nimages; i++)
+	{
+		image = pool->images[i];
+
+		if ((!pool->inuse[i]) && (image->width == width) && (image->height == height) && (image->channels == channels))
+		{
+			image->levels = levels;
+			pool->inuse[i] = 1;
+			return image;
 		}
 	}
 
-	return 1;
+	image = vc_image_new(width, height, channels, levels);
+	if (image == NULL) return NULL;
+
+	// Pool cheia: a imagem no fica registada e ser libertada em vc_pool_release()
+	if (pool->nimages < VC_POOL_MAX_IMAGES)
+	{
+		pool->images[pool->nimages] = image;
+		pool->inuse[pool->nimages] = 1;
+		pool->nimages++;
+	}
+
+	return image;
 }
 
-int vc_binary_open(IVC* src, IVC* dst, int kernel) {
 
-	IVC* imagefun[2];
+// Devolve a imagem  pool (ou liberta-a, se no pertencer  pool)
+void vc_pool_release(IVCPOOL* pool, IVC* image)
+{
+	int i;
 
-	//erosao
-	if (vc_binary_erode(src, dst, kernel) == 1) {
-		printf("Erosao feita com sucesso\n");
-	}
-	else
-	{
-		printf("Erro na erosao\n");
-	}
+	if (image == NULL) return;
 
-	imagefun[0] = vc_image_new(src->width, src->height, src->channels, src->levels);
-	if (imagefun[0] == NULL)
+	if (pool != NULL)
 	{
-		printf("ERROR -> vc_image_new(): \n\nMemory allocation failed!\n");
-		vc_image_free(imagefun[0]);
-		getchar();
-		return 0;
+		for (i = 0; i < pool->nimages; i++)
+		{
+			if (pool->images[i] == image)
+			{
+				pool->inuse[i] = 0;
+				return;
+			}
+		}
 	}
 
-	//dilatacao
-	if (vc_binary_dilate(dst, imagefun[0], kernel) == 1) {
-		printf("Dilatacao feita com sucesso\n");
-	}
-	else
+	vc_image_free(image);
+}
+
+
+void vc_pool_free(IVCPOOL* pool)
+{
+	int i;
+
+	if (pool == NULL) return;
+
+	for (i = 0; i < pool->nimages; i++)
 	{
-		printf("Erro na dilatacao\n");
+		vc_image_free(pool->images[i]);
 	}
 
-	dst = imagefun[0];
-
-	return 1;
+	memset(pool, 0, sizeof(IVCPOOL));
 }
 
-int vc_binary_close(IVC* src, IVC* dst, int kernel) {
 
-	IVC* imagefun[2];
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              FUNES: PIRMIDE DE IMAGENS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-	//erosao
-	if (vc_binary_dilate(src, dst, kernel) == 1) {
-		printf("Dilatacao feita com sucesso\n");
-	}
-	else
-	{
-		printf("Erro na dilatacao\n");
-	}
 
-	imagefun[0] = vc_image_new(src->width, src->height, src->channels, src->levels);
-	if (imagefun[0] == NULL)
-	{
-		printf("ERROR -> vc_image_new(): \n\nMemory allocation failed!\n");
-		vc_image_free(imagefun[0]);
-		getchar();
-		return 0;
-	}
+// Reduo 2x com filtro binomial 3x3 ([1 2 1] x [1 2 1] / 16), com replicao dos rebordos
+static void vc_image_downsample_gauss2(IVC* src, IVC* dst)
+{
+	int channels = src->channels;
+	int x, y, c, k, l;
+	int xs[3], ys[3];
+	static const int w[3] = { 1, 2, 1 };
 
-	//dilatacao
-	if (vc_binary_erode(dst, imagefun[0], kernel) == 1) {
-		printf("erosao feita com sucesso\n");
-	}
-	else
+	for (y = 0; y < dst->height; y++)
 	{
-		printf("Erro na erosao\n");
-	}
+		ys[0] = MAX2(2 * y - 1, 0);
+		ys[1] = 2 * y;
+		ys[2] = (2 * y + 1 < src->height) ? 2 * y + 1 : src->height - 1;
 
-	dst = imagefun[0];
+		for (x = 0; x < dst->width; x++)
+		{
+			xs[0] = MAX2(2 * x - 1, 0);
+			xs[1] = 2 * x;
+			xs[2] = (2 * x + 1 < src->width) ? 2 * x + 1 : src->width - 1;
 
-	return 1;
+			for (c = 0; c < channels; c++)
+			{
+				int sum = 0;
+
+				for (k = 0; k < 3; k++)
+				{
+					for (l = 0; l < 3; l++)
+					{
+						sum += w[k] * w[l] * src->data[ys[k] * src->bytesperline + xs[l] * channels + c];
+					}
+				}
+
+				dst->data[y * dst->bytesperline + x * channels + c] = (unsigned char)((sum + 8) / 16);
+			}
+		}
+	}
 }
 
 
-// Blobs e Etiquetagem
-//int vc_binary_blob_labelling(IVC* src, IVC* dst) {
-//	if (!src || !dst || !src->data || !dst->data) return -1;
-//
-//	// Copiar os dados da imagem fonte para a imagem destino (considerando bytesperline)
-//	memcpy(dst->data, src->data, src->bytesperline * src->height);
-//
-//	int label = 1;
-//
-//	for (int y = 1; y < dst->height - 1; y++) { // Evita acessar fora da memria
-//		for (int x = 1; x < dst->width - 1; x++) {
-//			int posX = y * dst->bytesperline + x;
-//			int posA = (y - 1) * dst->bytesperline + (x - 1);
-//			int posB = (y - 1) * dst->bytesperline + x;
-//			int posC = (y - 1) * dst->bytesperline + (x + 1);
-//			int posD = y * dst->bytesperline + (x - 1);
-//
-//			if (dst->data[posX] == 255) {
-//				int min_label = 255;
-//
-//				// Encontrar o menor rtulo vizinho
-//				if (dst->data[posA] > 0 && dst->data[posA] < min_label) min_label = dst->data[posA];
-//				if (dst->data[posB] > 0 && dst->data[posB] < min_label) min_label = dst->data[posB];
-//				if (dst->data[posC] > 0 && dst->data[posC] < min_label) min_label = dst->data[posC];
-//				if (dst->data[posD] > 0 && dst->data[posD] < min_label) min_label = dst->data[posD];
-//
-//				if (min_label == 255) { // Nenhum vizinho rotulado
-//					dst->data[posX] = label;
-//					label++;
-//					if (label > 254) label = 254; // Evita estouro
-//				}
-//				else {
-//					dst->data[posX] = min_label;
-//				}
-//			}
-//			else {
-//				dst->data[posX] = 0;
-//			}
-//		}
-//	}
-//
-//	return 1; // Sucesso
-//}
-
-// Etiquetagem de blobs
-// src		: Imagem binria de entrada
-// dst		: Imagem grayscale (ir conter as etiquetas)
-// nlabels	: Endereo de memria de uma varivel, onde ser armazenado o nmero de etiquetas encontradas.
-// OVC*		: Retorna um array de estruturas de blobs (objectos), com respectivas etiquetas.  necessrio libertar posteriormente esta memria.
-OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
+// Reduz a resoluo de src por factor (2 ou 4) para dst
+int vc_image_downsample(IVC* src, IVC* dst, int factor, int mode)
 {
-	unsigned char* datasrc = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, a, b;
-	long int i, size;
-	long int posX, posA, posB, posC, posD;
-	int labeltable[256] = { 0 };
-	int labelarea[256] = { 0 };
-	int label = 1; // Etiqueta inicial.
-	int num, tmplabel;
-	OVC* blobs; // Apontador para array de blobs (objectos) que ser retornado desta funo.
+	int channels;
+	int x, y, c, k, l;
 
 	// Verificao de erros
-	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return NULL;
-	if (channels != 1) return NULL;
+	if ((src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((factor != 2) && (factor != 4)) return 0;
+	if ((dst->width != src->width / factor) || (dst->height != src->height / factor)) return 0;
+	if ((dst->width <= 0) || (dst->height <= 0) || (src->channels != dst->channels)) return 0;
 
-	// Copia dados da imagem binria para imagem grayscale
-	memcpy(datadst, datasrc, bytesperline * height);
+	channels = src->channels;
 
-	// Todos os pixis de plano de fundo devem obrigatriamente ter valor 0
-	// Todos os pixis de primeiro plano devem obrigatriamente ter valor 255
-	// Sero atribudas etiquetas no intervalo [1,254]
-	// Este algoritmo est assim limitado a 254 labels
-	for (i = 0, size = bytesperline * height; i < size; i++)
+	if (mode == VC_DOWNSAMPLE_GAUSS)
 	{
-		if (datadst[i] != 0) datadst[i] = 255;
-	}
+		IVC* tmp;
 
-	// Limpa os rebordos da imagem binria
-	for (y = 0; y < height; y++)
-	{
-		datadst[y * bytesperline + 0 * channels] = 0;
-		datadst[y * bytesperline + (width - 1) * channels] = 0;
-	}
-	for (x = 0; x < width; x++)
-	{
-		datadst[0 * bytesperline + x * channels] = 0;
-		datadst[(height - 1) * bytesperline + x * channels] = 0;
+		if (factor == 2)
+		{
+			vc_image_downsample_gauss2(src, dst);
+			return 1;
+		}
+
+		// 4x = duas redues 2x consecutivas
+		tmp = vc_image_new(src->width / 2, src->height / 2, channels, src->levels);
+		if (tmp == NULL) return 0;
+
+		vc_image_downsample_gauss2(src, tmp);
+		vc_image_downsample_gauss2(tmp, dst);
+
+		vc_image_free(tmp);
+		return 1;
 	}
 
-	// Efectua a etiquetagem
-	for (y = 1; y < height - 1; y++)
+	for (y = 0; y < dst->height; y++)
 	{
-		for (x = 1; x < width - 1; x++)
+		for (x = 0; x < dst->width; x++)
 		{
-			// Kernel:
-			// A B C
-			// D X
-
-			posA = (y - 1) * bytesperline + (x - 1) * channels; // A
-			posB = (y - 1) * bytesperline + x * channels; // B
-			posC = (y - 1) * bytesperline + (x + 1) * channels; // C
-			posD = y * bytesperline + (x - 1) * channels; // D
-			posX = y * bytesperline + x * channels; // X
+			long int pos_src = (y * factor) * src->bytesperline + (x * factor) * channels;
+			long int pos_dst = y * dst->bytesperline + x * channels;
 
-			// Se o pixel foi marcado
-			if (datadst[posX] != 0)
+			for (c = 0; c < channels; c++)
 			{
-				if ((datadst[posA] == 0) && (datadst[posB] == 0) && (datadst[posC] == 0) && (datadst[posD] == 0))
-				{
-					datadst[posX] = label;
-					labeltable[label] = label;
-					label++;
-				}
-				else
+				if (mode == VC_DOWNSAMPLE_BOX)
 				{
-					num = 255;
-
-					// Se A est marcado
-					if (datadst[posA] != 0) num = labeltable[datadst[posA]];
-					// Se B est marcado, e  menor que a etiqueta "num"
-					if ((datadst[posB] != 0) && (labeltable[datadst[posB]] < num)) num = labeltable[datadst[posB]];
-					// Se C est marcado, e  menor que a etiqueta "num"
-					if ((datadst[posC] != 0) && (labeltable[datadst[posC]] < num)) num = labeltable[datadst[posC]];
-					// Se D est marcado, e  menor que a etiqueta "num"
-					if ((datadst[posD] != 0) && (labeltable[datadst[posD]] < num)) num = labeltable[datadst[posD]];
-
-					// Atribui a etiqueta ao pixel
-					datadst[posX] = num;
-					labeltable[num] = num;
+					int sum = 0;
 
-					// Actualiza a tabela de etiquetas
-					if (datadst[posA] != 0)
-					{
-						if (labeltable[datadst[posA]] != num)
-						{
-							for (tmplabel = labeltable[datadst[posA]], a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = num;
-								}
-							}
-						}
-					}
-					if (datadst[posB] != 0)
-					{
-						if (labeltable[datadst[posB]] != num)
-						{
-							for (tmplabel = labeltable[datadst[posB]], a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = num;
-								}
-							}
-						}
-					}
-					if (datadst[posC] != 0)
-					{
-						if (labeltable[datadst[posC]] != num)
-						{
-							for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = num;
-								}
-							}
-						}
-					}
-					if (datadst[posD] != 0)
+					for (k = 0; k < factor; k++)
 					{
-						if (labeltable[datadst[posD]] != num)
+						for (l = 0; l < factor; l++)
 						{
-							for (tmplabel = labeltable[datadst[posD]], a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = num;
-								}
-							}
+							sum += src->data[pos_src + k * src->bytesperline + l * channels + c];
 						}
 					}
+
+					dst->data[pos_dst + c] = (unsigned char)((sum + (factor * factor) / 2) / (factor * factor));
+				}
+				else
+				{
+					dst->data[pos_dst + c] = src->data[pos_src + c];
 				}
 			}
 		}
 	}
 
-	// Volta a etiquetar a imagem
-	for (y = 1; y < height - 1; y++)
+	return 1;
+}
+
+
+// Constri uma pirmide com nlevels nveis (level[0] = src). Os nveis 1..nlevels-1 vm da pool.
+int vc_pyramid_build(IVCPOOL* pool, IVC* src, PYRVC* pyr, int nlevels, int mode)
+{
+	int i;
+
+	if ((src == NULL) || (pyr == NULL)) return 0;
+	if ((nlevels < 1) || (nlevels > VC_PYRAMID_MAX_LEVELS)) return 0;
+
+	pyr->level[0] = src;
+	pyr->nlevels = 1;
+
+	for (i = 1; i < nlevels; i++)
 	{
-		for (x = 1; x < width - 1; x++)
-		{
-			posX = y * bytesperline + x * channels; // X
+		IVC* prev = pyr->level[i - 1];
 
-			if (datadst[posX] != 0)
-			{
-				datadst[posX] = labeltable[datadst[posX]];
-			}
+		if ((prev->width < 2) || (prev->height < 2)) break;
+
+		pyr->level[i] = vc_pool_get(pool, prev->width / 2, prev->height / 2, prev->channels, prev->levels);
+		if (pyr->level[i] == NULL)
+		{
+			vc_pyramid_release(pool, pyr);
+			return 0;
 		}
+		pyr->nlevels++;
+
+		vc_image_downsample(prev, pyr->level[i], 2, mode);
 	}
 
-	//printf("\nMax Label = %d\n", label);
+	return 1;
+}
 
-	// Contagem do nmero de blobs
-	// Passo 1: Eliminar, da tabela, etiquetas repetidas
-	for (a = 1; a < label - 1; a++)
+
+void vc_pyramid_release(IVCPOOL* pool, PYRVC* pyr)
+{
+	int i;
+
+	if (pyr == NULL) return;
+
+	for (i = 1; i < pyr->nlevels; i++)
 	{
-		for (b = a + 1; b < label; b++)
+		vc_pool_release(pool, pyr->level[i]);
+		pyr->level[i] = NULL;
+	}
+
+	pyr->nlevels = (pyr->nlevels > 0) ? 1 : 0;
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//    FUNES: LEITURA E ESCRITA DE IMAGENS (PBM, PGM E PPM)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+
+char* netpbm_get_token(FILE* file, char* tok, int len)
+{
+	char* t;
+	int c;
+
+	for (;;)
+	{
+		while (isspace(c = getc(file)));
+		if (c != '#') break;
+		do c = getc(file);
+		while ((c != '\n') && (c != EOF));
+		if (c == EOF) break;
+	}
+
+	t = tok;
+
+	if (c != EOF)
+	{
+		do
 		{
-			if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
-		}
+			*t++ = c;
+			c = getc(file);
+		} while ((!isspace(c)) && (c != '#') && (c != EOF) && (t - tok < len - 1));
+
+		if (c == '#') ungetc(c, file);
 	}
-	// Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que no hajam valores vazios (zero) entre etiquetas
-	*nlabels = 0;
-	for (a = 1; a < label; a++)
+
+	*t = 0;
+
+	return tok;
+}
+
+
+// Inverso da ordem dos bits de um byte (bit 0 <-> bit 7, ...)
+static const unsigned char vc_pbm_bitreverse[256] = {
+	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+
+// Pixis (na nossa conveno: 1 = Branco, 0 = Preto) correspondentes a cada byte PBM (1 = Preto, MSB primeiro)
+static const unsigned char vc_pbm_unpack[256][8] = {
+	{ 1, 1, 1, 1, 1, 1, 1, 1 }, { 1, 1, 1, 1, 1, 1, 1, 0 }, { 1, 1, 1, 1, 1, 1, 0, 1 }, { 1, 1, 1, 1, 1, 1, 0, 0 },
+	{ 1, 1, 1, 1, 1, 0, 1, 1 }, { 1, 1, 1, 1, 1, 0, 1, 0 }, { 1, 1, 1, 1, 1, 0, 0, 1 }, { 1, 1, 1, 1, 1, 0, 0, 0 },
+	{ 1, 1, 1, 1, 0, 1, 1, 1 }, { 1, 1, 1, 1, 0, 1, 1, 0 }, { 1, 1, 1, 1, 0, 1, 0, 1 }, { 1, 1, 1, 1, 0, 1, 0, 0 },
+	{ 1, 1, 1, 1, 0, 0, 1, 1 }, { 1, 1, 1, 1, 0, 0, 1, 0 }, { 1, 1, 1, 1, 0, 0, 0, 1 }, { 1, 1, 1, 1, 0, 0, 0, 0 },
+	{ 1, 1, 1, 0, 1, 1, 1, 1 }, { 1, 1, 1, 0, 1, 1, 1, 0 }, { 1, 1, 1, 0, 1, 1, 0, 1 }, { 1, 1, 1, 0, 1, 1, 0, 0 },
+	{ 1, 1, 1, 0, 1, 0, 1, 1 }, { 1, 1, 1, 0, 1, 0, 1, 0 }, { 1, 1, 1, 0, 1, 0, 0, 1 }, { 1, 1, 1, 0, 1, 0, 0, 0 },
+	{ 1, 1, 1, 0, 0, 1, 1, 1 }, { 1, 1, 1, 0, 0, 1, 1, 0 }, { 1, 1, 1, 0, 0, 1, 0, 1 }, { 1, 1, 1, 0, 0, 1, 0, 0 },
+	{ 1, 1, 1, 0, 0, 0, 1, 1 }, { 1, 1, 1, 0, 0, 0, 1, 0 }, { 1, 1, 1, 0, 0, 0, 0, 1 }, { 1, 1, 1, 0, 0, 0, 0, 0 },
+	{ 1, 1, 0, 1, 1, 1, 1, 1 }, { 1, 1, 0, 1, 1, 1, 1, 0 }, { 1, 1, 0, 1, 1, 1, 0, 1 }, { 1, 1, 0, 1, 1, 1, 0, 0 },
+	{ 1, 1, 0, 1, 1, 0, 1, 1 }, { 1, 1, 0, 1, 1, 0, 1, 0 }, { 1, 1, 0, 1, 1, 0, 0, 1 }, { 1, 1, 0, 1, 1, 0, 0, 0 },
+	{ 1, 1, 0, 1, 0, 1, 1, 1 }, { 1, 1, 0, 1, 0, 1, 1, 0 }, { 1, 1, 0, 1, 0, 1, 0, 1 }, { 1, 1, 0, 1, 0, 1, 0, 0 },
+	{ 1, 1, 0, 1, 0, 0, 1, 1 }, { 1, 1, 0, 1, 0, 0, 1, 0 }, { 1, 1, 0, 1, 0, 0, 0, 1 }, { 1, 1, 0, 1, 0, 0, 0, 0 },
+	{ 1, 1, 0, 0, 1, 1, 1, 1 }, { 1, 1, 0, 0, 1, 1, 1, 0 }, { 1, 1, 0, 0, 1, 1, 0, 1 }, { 1, 1, 0, 0, 1, 1, 0, 0 },
+	{ 1, 1, 0, 0, 1, 0, 1, 1 }, { 1, 1, 0, 0, 1, 0, 1, 0 }, { 1, 1, 0, 0, 1, 0, 0, 1 }, { 1, 1, 0, 0, 1, 0, 0, 0 },
+	{ 1, 1, 0, 0, 0, 1, 1, 1 }, { 1, 1, 0, 0, 0, 1, 1, 0 }, { 1, 1, 0, 0, 0, 1, 0, 1 }, { 1, 1, 0, 0, 0, 1, 0, 0 },
+	{ 1, 1, 0, 0, 0, 0, 1, 1 }, { 1, 1, 0, 0, 0, 0, 1, 0 }, { 1, 1, 0, 0, 0, 0, 0, 1 }, { 1, 1, 0, 0, 0, 0, 0, 0 },
+	{ 1, 0, 1, 1, 1, 1, 1, 1 }, { 1, 0, 1, 1, 1, 1, 1, 0 }, { 1, 0, 1, 1, 1, 1, 0, 1 }, { 1, 0, 1, 1, 1, 1, 0, 0 },
+	{ 1, 0, 1, 1, 1, 0, 1, 1 }, { 1, 0, 1, 1, 1, 0, 1, 0 }, { 1, 0, 1, 1, 1, 0, 0, 1 }, { 1, 0, 1, 1, 1, 0, 0, 0 },
+	{ 1, 0, 1, 1, 0, 1, 1, 1 }, { 1, 0, 1, 1, 0, 1, 1, 0 }, { 1, 0, 1, 1, 0, 1, 0, 1 }, { 1, 0, 1, 1, 0, 1, 0, 0 },
+	{ 1, 0, 1, 1, 0, 0, 1, 1 }, { 1, 0, 1, 1, 0, 0, 1, 0 }, { 1, 0, 1, 1, 0, 0, 0, 1 }, { 1, 0, 1, 1, 0, 0, 0, 0 },
+	{ 1, 0, 1, 0, 1, 1, 1, 1 }, { 1, 0, 1, 0, 1, 1, 1, 0 }, { 1, 0, 1, 0, 1, 1, 0, 1 }, { 1, 0, 1, 0, 1, 1, 0, 0 },
+	{ 1, 0, 1, 0, 1, 0, 1, 1 }, { 1, 0, 1, 0, 1, 0, 1, 0 }, { 1, 0, 1, 0, 1, 0, 0, 1 }, { 1, 0, 1, 0, 1, 0, 0, 0 },
+	{ 1, 0, 1, 0, 0, 1, 1, 1 }, { 1, 0, 1, 0, 0, 1, 1, 0 }, { 1, 0, 1, 0, 0, 1, 0, 1 }, { 1, 0, 1, 0, 0, 1, 0, 0 },
+	{ 1, 0, 1, 0, 0, 0, 1, 1 }, { 1, 0, 1, 0, 0, 0, 1, 0 }, { 1, 0, 1, 0, 0, 0, 0, 1 }, { 1, 0, 1, 0, 0, 0, 0, 0 },
+	{ 1, 0, 0, 1, 1, 1, 1, 1 }, { 1, 0, 0, 1, 1, 1, 1, 0 }, { 1, 0, 0, 1, 1, 1, 0, 1 }, { 1, 0, 0, 1, 1, 1, 0, 0 },
+	{ 1, 0, 0, 1, 1, 0, 1, 1 }, { 1, 0, 0, 1, 1, 0, 1, 0 }, { 1, 0, 0, 1, 1, 0, 0, 1 }, { 1, 0, 0, 1, 1, 0, 0, 0 },
+	{ 1, 0, 0, 1, 0, 1, 1, 1 }, { 1, 0, 0, 1, 0, 1, 1, 0 }, { 1, 0, 0, 1, 0, 1, 0, 1 }, { 1, 0, 0, 1, 0, 1, 0, 0 },
+	{ 1, 0, 0, 1, 0, 0, 1, 1 }, { 1, 0, 0, 1, 0, 0, 1, 0 }, { 1, 0, 0, 1, 0, 0, 0, 1 }, { 1, 0, 0, 1, 0, 0, 0, 0 },
+	{ 1, 0, 0, 0, 1, 1, 1, 1 }, { 1, 0, 0, 0, 1, 1, 1, 0 }, { 1, 0, 0, 0, 1, 1, 0, 1 }, { 1, 0, 0, 0, 1, 1, 0, 0 },
+	{ 1, 0, 0, 0, 1, 0, 1, 1 }, { 1, 0, 0, 0, 1, 0, 1, 0 }, { 1, 0, 0, 0, 1, 0, 0, 1 }, { 1, 0, 0, 0, 1, 0, 0, 0 },
+	{ 1, 0, 0, 0, 0, 1, 1, 1 }, { 1, 0, 0, 0, 0, 1, 1, 0 }, { 1, 0, 0, 0, 0, 1, 0, 1 }, { 1, 0, 0, 0, 0, 1, 0, 0 },
+	{ 1, 0, 0, 0, 0, 0, 1, 1 }, { 1, 0, 0, 0, 0, 0, 1, 0 }, { 1, 0, 0, 0, 0, 0, 0, 1 }, { 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 1, 1, 1, 1, 1, 1 }, { 0, 1, 1, 1, 1, 1, 1, 0 }, { 0, 1, 1, 1, 1, 1, 0, 1 }, { 0, 1, 1, 1, 1, 1, 0, 0 },
+	{ 0, 1, 1, 1, 1, 0, 1, 1 }, { 0, 1, 1, 1, 1, 0, 1, 0 }, { 0, 1, 1, 1, 1, 0, 0, 1 }, { 0, 1, 1, 1, 1, 0, 0, 0 },
+	{ 0, 1, 1, 1, 0, 1, 1, 1 }, { 0, 1, 1, 1, 0, 1, 1, 0 }, { 0, 1, 1, 1, 0, 1, 0, 1 }, { 0, 1, 1, 1, 0, 1, 0, 0 },
+	{ 0, 1, 1, 1, 0, 0, 1, 1 }, { 0, 1, 1, 1, 0, 0, 1, 0 }, { 0, 1, 1, 1, 0, 0, 0, 1 }, { 0, 1, 1, 1, 0, 0, 0, 0 },
+	{ 0, 1, 1, 0, 1, 1, 1, 1 }, { 0, 1, 1, 0, 1, 1, 1, 0 }, { 0, 1, 1, 0, 1, 1, 0, 1 }, { 0, 1, 1, 0, 1, 1, 0, 0 },
+	{ 0, 1, 1, 0, 1, 0, 1, 1 }, { 0, 1, 1, 0, 1, 0, 1, 0 }, { 0, 1, 1, 0, 1, 0, 0, 1 }, { 0, 1, 1, 0, 1, 0, 0, 0 },
+	{ 0, 1, 1, 0, 0, 1, 1, 1 }, { 0, 1, 1, 0, 0, 1, 1, 0 }, { 0, 1, 1, 0, 0, 1, 0, 1 }, { 0, 1, 1, 0, 0, 1, 0, 0 },
+	{ 0, 1, 1, 0, 0, 0, 1, 1 }, { 0, 1, 1, 0, 0, 0, 1, 0 }, { 0, 1, 1, 0, 0, 0, 0, 1 }, { 0, 1, 1, 0, 0, 0, 0, 0 },
+	{ 0, 1, 0, 1, 1, 1, 1, 1 }, { 0, 1, 0, 1, 1, 1, 1, 0 }, { 0, 1, 0, 1, 1, 1, 0, 1 }, { 0, 1, 0, 1, 1, 1, 0, 0 },
+	{ 0, 1, 0, 1, 1, 0, 1, 1 }, { 0, 1, 0, 1, 1, 0, 1, 0 }, { 0, 1, 0, 1, 1, 0, 0, 1 }, { 0, 1, 0, 1, 1, 0, 0, 0 },
+	{ 0, 1, 0, 1, 0, 1, 1, 1 }, { 0, 1, 0, 1, 0, 1, 1, 0 }, { 0, 1, 0, 1, 0, 1, 0, 1 }, { 0, 1, 0, 1, 0, 1, 0, 0 },
+	{ 0, 1, 0, 1, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 0, 1, 0 }, { 0, 1, 0, 1, 0, 0, 0, 1 }, { 0, 1, 0, 1, 0, 0, 0, 0 },
+	{ 0, 1, 0, 0, 1, 1, 1, 1 }, { 0, 1, 0, 0, 1, 1, 1, 0 }, { 0, 1, 0, 0, 1, 1, 0, 1 }, { 0, 1, 0, 0, 1, 1, 0, 0 },
+	{ 0, 1, 0, 0, 1, 0, 1, 1 }, { 0, 1, 0, 0, 1, 0, 1, 0 }, { 0, 1, 0, 0, 1, 0, 0, 1 }, { 0, 1, 0, 0, 1, 0, 0, 0 },
+	{ 0, 1, 0, 0, 0, 1, 1, 1 }, { 0, 1, 0, 0, 0, 1, 1, 0 }, { 0, 1, 0, 0, 0, 1, 0, 1 }, { 0, 1, 0, 0, 0, 1, 0, 0 },
+	{ 0, 1, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 0, 0, 0, 1, 0 }, { 0, 1, 0, 0, 0, 0, 0, 1 }, { 0, 1, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 1, 1, 1, 0 }, { 0, 0, 1, 1, 1, 1, 0, 1 }, { 0, 0, 1, 1, 1, 1, 0, 0 },
+	{ 0, 0, 1, 1, 1, 0, 1, 1 }, { 0, 0, 1, 1, 1, 0, 1, 0 }, { 0, 0, 1, 1, 1, 0, 0, 1 }, { 0, 0, 1, 1, 1, 0, 0, 0 },
+	{ 0, 0, 1, 1, 0, 1, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 0 }, { 0, 0, 1, 1, 0, 1, 0, 1 }, { 0, 0, 1, 1, 0, 1, 0, 0 },
+	{ 0, 0, 1, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 0 }, { 0, 0, 1, 1, 0, 0, 0, 1 }, { 0, 0, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 1, 0, 1, 1, 1, 1 }, { 0, 0, 1, 0, 1, 1, 1, 0 }, { 0, 0, 1, 0, 1, 1, 0, 1 }, { 0, 0, 1, 0, 1, 1, 0, 0 },
+	{ 0, 0, 1, 0, 1, 0, 1, 1 }, { 0, 0, 1, 0, 1, 0, 1, 0 }, { 0, 0, 1, 0, 1, 0, 0, 1 }, { 0, 0, 1, 0, 1, 0, 0, 0 },
+	{ 0, 0, 1, 0, 0, 1, 1, 1 }, { 0, 0, 1, 0, 0, 1, 1, 0 }, { 0, 0, 1, 0, 0, 1, 0, 1 }, { 0, 0, 1, 0, 0, 1, 0, 0 },
+	{ 0, 0, 1, 0, 0, 0, 1, 1 }, { 0, 0, 1, 0, 0, 0, 1, 0 }, { 0, 0, 1, 0, 0, 0, 0, 1 }, { 0, 0, 1, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 1, 1, 1, 1, 1 }, { 0, 0, 0, 1, 1, 1, 1, 0 }, { 0, 0, 0, 1, 1, 1, 0, 1 }, { 0, 0, 0, 1, 1, 1, 0, 0 },
+	{ 0, 0, 0, 1, 1, 0, 1, 1 }, { 0, 0, 0, 1, 1, 0, 1, 0 }, { 0, 0, 0, 1, 1, 0, 0, 1 }, { 0, 0, 0, 1, 1, 0, 0, 0 },
+	{ 0, 0, 0, 1, 0, 1, 1, 1 }, { 0, 0, 0, 1, 0, 1, 1, 0 }, { 0, 0, 0, 1, 0, 1, 0, 1 }, { 0, 0, 0, 1, 0, 1, 0, 0 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 0, 1, 0, 0, 1, 0 }, { 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1 }, { 0, 0, 0, 0, 1, 1, 1, 0 }, { 0, 0, 0, 0, 1, 1, 0, 1 }, { 0, 0, 0, 0, 1, 1, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 1, 1 }, { 0, 0, 0, 0, 1, 0, 1, 0 }, { 0, 0, 0, 0, 1, 0, 0, 1 }, { 0, 0, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 1 }, { 0, 0, 0, 0, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 0, 1 }, { 0, 0, 0, 0, 0, 1, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 1, 1 }, { 0, 0, 0, 0, 0, 0, 1, 0 }, { 0, 0, 0, 0, 0, 0, 0, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0 }
+};
+
+
+// Compacta a imagem (1 byte por pixel) no formato PBM (1 bit por pixel, cada linha arredondada ao byte).
+// Processa 8 pixis (16 com SSE2) de cada vez. Devolve o nmero de bytes escritos.
+long int unsigned_char_to_bit(unsigned char* datauchar, unsigned char* databit, int width, int height, int bytesperline)
+{
+	int x, y;
+	int rowbytes = width / 8 + ((width % 8) ? 1 : 0);
+	unsigned char* p = databit;
+
+	for (y = 0; y < height; y++)
+	{
+		const unsigned char* row = &datauchar[(long int)bytesperline * y];
+
+		x = 0;
+
+		// Numa imagem PBM:
+		// 1 = Preto
+		// 0 = Branco
+		// Na nossa imagem:
+		// 1 = Branco
+		// 0 = Preto
+#ifdef VC_SSE2
+		for (; x + 16 <= width; x += 16)
+		{
+			// Bit i da mscara = (pixel i == 0); o PBM guarda o primeiro pixel no bit mais significativo
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) & row[x]), _mm_setzero_si128()));
+
+			*p++ = vc_pbm_bitreverse[mask & 0xFF];
+			*p++ = vc_pbm_bitreverse[(mask >> 8) & 0xFF];
+		}
+#endif
+		for (; x + 8 <= width; x += 8)
+		{
+			*p++ = (unsigned char)(((row[x] == 0) << 7) | ((row[x + 1] == 0) << 6) | ((row[x + 2] == 0) << 5) | ((row[x + 3] == 0) << 4) |
+				((row[x + 4] == 0) << 3) | ((row[x + 5] == 0) << 2) | ((row[x + 6] == 0) << 1) | (row[x + 7] == 0));
+		}
+		if (x < width)
+		{
+			unsigned char b = 0;
+			int bit;
+
+			for (bit = 7; x < width; x++, bit--)
+			{
+				b |= (row[x] == 0) << bit;
+			}
+			*p++ = b;
+		}
+	}
+
+	return (long int)rowbytes * height;
+}
+
+
+// Descompacta uma imagem PBM (1 bit por pixel) para 1 byte por pixel, um byte (8 pixis) de cada vez
+void bit_to_unsigned_char(unsigned char* databit, unsigned char* datauchar, int width, int height, int bytesperline)
+{
+	int x, y;
+	const unsigned char* p = databit;
+
+	for (y = 0; y < height; y++)
+	{
+		unsigned char* row = &datauchar[(long int)bytesperline * y];
+
+		for (x = 0; x + 8 <= width; x += 8)
+		{
+			memcpy(&row[x], vc_pbm_unpack[*p++], 8);
+		}
+		if (x < width)
+		{
+			memcpy(&row[x], vc_pbm_unpack[*p++], width - x);
+		}
+	}
+}
+
+
+// L uma imagem PBM, PGM ou PPM a partir da posio actual do ficheiro (um ficheiro pode conter
+// vrias imagens seguidas). *image  reutilizada se tiver as mesmas caractersticas; caso
+// contrrio  libertada e alocada de novo.
+// Devolve 1 se leu uma imagem, 0 se o ficheiro terminou antes de um novo header, -1 em caso de erro.
+static int vc_netpbm_read_frame(FILE* file, IVC** image, const char* caller)
+{
+	unsigned char* tmp;
+	char tok[20];
+	long int size, sizeofbinarydata;
+	int width, height, channels;
+	int levels = 255;
+	long int v;
+	int y;
+
+	// Efectua a leitura do header
+	netpbm_get_token(file, tok, sizeof(tok));
+
+	if (tok[0] == 0) return 0;												// Fim do ficheiro
+	if (strcmp(tok, "P4") == 0) { channels = 1; levels = 1; }	// Se PBM (Binary [0,1])
+	else if (strcmp(tok, "P5") == 0) channels = 1;				// Se PGM (Gray [0,MAX(level,255)])
+	else if (strcmp(tok, "P6") == 0) channels = 3;				// Se PPM (RGB [0,MAX(level,255)])
+	else
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> %s:\n\tFile is not a valid PBM, PGM or PPM file.\n\tBad magic number!\n", caller);
+#endif
+
+		return -1;
+	}
+
+	if (levels == 1) // PBM
+	{
+		if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
+			sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1)
+		{
+#ifdef VC_DEBUG
+			printf("ERROR -> %s:\n\tFile is not a valid PBM file.\n\tBad size!\n", caller);
+#endif
+
+			return -1;
+		}
+	}
+	else // PGM ou PPM
+	{
+		if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
+			sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1 ||
+			sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &levels) != 1 || levels <= 0 || levels > 255)
+		{
+#ifdef VC_DEBUG
+			printf("ERROR -> %s:\n\tFile is not a valid PGM or PPM file.\n\tBad size!\n", caller);
+#endif
+
+			return -1;
+		}
+	}
+
+	// Aloca memria para imagem (ou reutiliza a imagem anterior)
+	if ((*image == NULL) || ((*image)->width != width) || ((*image)->height != height) || ((*image)->channels != channels) || ((*image)->mapaddr != NULL))
+	{
+		*image = vc_image_free(*image);
+		*image = vc_image_new(width, height, channels, levels);
+		if (*image == NULL) return -1;
+	}
+	(*image)->levels = levels;
+
+	if (levels == 1) // PBM
+	{
+		sizeofbinarydata = ((*image)->width / 8 + (((*image)->width % 8) ? 1 : 0)) * (*image)->height;
+		tmp = (unsigned char*)malloc(sizeofbinarydata);
+		if (tmp == NULL) return -1;
+
+		if ((v = (long int)fread(tmp, sizeof(unsigned char), sizeofbinarydata, file)) != sizeofbinarydata)
+		{
+#ifdef VC_DEBUG
+			printf("ERROR -> %s:\n\tPremature EOF on file.\n", caller);
+#endif
+
+			free(tmp);
+			return -1;
+		}
+
+		bit_to_unsigned_char(tmp, (*image)->data, (*image)->width, (*image)->height, (*image)->bytesperline);
+
+		free(tmp);
+	}
+	else // PGM ou PPM
+	{
+		size = (*image)->width * (*image)->channels;
+
+		// Linha a linha, por causa do enchimento no fim de cada linha
+		for (y = 0; y < (*image)->height; y++)
+		{
+			if ((v = (long int)fread(&(*image)->data[y * (*image)->bytesperline], sizeof(unsigned char), size, file)) != size)
+			{
+#ifdef VC_DEBUG
+				printf("ERROR -> %s:\n\tPremature EOF on file.\n", caller);
+#endif
+
+				return -1;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+IVC* vc_read_image(char* filename)
+{
+	FILE* file = NULL;
+	IVC* image = NULL;
+
+	// Abre o ficheiro
+	if ((file = fopen(filename, "rb")) != NULL)
+	{
+		if (vc_netpbm_read_frame(file, &image, "vc_read_image()") != 1)
+		{
+			image = vc_image_free(image);
+		}
+		else
+		{
+			// S aqui (e no em vc_netpbm_read_frame(), chamada em cada frame de vc_stream_read())
+#ifdef VC_DEBUG
+			printf("\nchannels=%d w=%d h=%d levels=%d\n", image->channels, image->width, image->height, image->levels);
+#endif
+		}
+
+		fclose(file);
+	}
+	else
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_read_image():\n\tFile not found.\n");
+#endif
+	}
+
+	return image;
+}
+
+
+// Escreve uma imagem na posio actual do ficheiro. Devolve 1 em caso de sucesso.
+static int vc_netpbm_write_frame(FILE* file, IVC* image)
+{
+	unsigned char* tmp;
+	long int totalbytes, sizeofbinarydata;
+	int y;
+
+	if (image->levels == 1)
+	{
+		sizeofbinarydata = (image->width / 8 + ((image->width % 8) ? 1 : 0)) * image->height + 1;
+		tmp = (unsigned char*)malloc(sizeofbinarydata);
+		if (tmp == NULL) return 0;
+
+		fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+
+		totalbytes = unsigned_char_to_bit(image->data, tmp, image->width, image->height, image->bytesperline);
+		if ((long int)fwrite(tmp, sizeof(unsigned char), totalbytes, file) != totalbytes)
+		{
+#ifdef VC_DEBUG
+			fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+#endif
+
+			free(tmp);
+			return 0;
+		}
+
+		free(tmp);
+	}
+	else
+	{
+		fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
+
+		// Linha a linha, sem os bytes de enchimento
+		for (y = 0; y < image->height; y++)
+		{
+			if (fwrite(&image->data[y * image->bytesperline], image->width * image->channels, 1, file) != 1)
+			{
+#ifdef VC_DEBUG
+				fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+#endif
+
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+int vc_write_image(char* filename, IVC* image)
+{
+	FILE* file = NULL;
+	int ok;
+
+	if (image == NULL) return 0;
+
+	if ((file = fopen(filename, "wb")) != NULL)
+	{
+		ok = vc_netpbm_write_frame(file, image);
+
+		fclose(file);
+
+		return ok;
+	}
+
+	return 0;
+}
+
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//     FUNES: LEITURA DE IMAGENS MAPEADAS EM MEMRIA (PGM E PPM)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+
+// Mapeia um ficheiro completo em memria, em modo copy-on-write (escritas no chegam ao ficheiro)
+static void* vc_file_map(char* filename, size_t* size)
+{
+	void* addr = NULL;
+
+#ifdef _WIN32
+	HANDLE file, mapping;
+	LARGE_INTEGER filesize;
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return NULL;
+
+	if ((!GetFileSizeEx(file, &filesize)) || (filesize.QuadPart == 0))
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping != NULL)
+	{
+		addr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		// A vista mantm o mapeamento vlido depois de fechados os handles
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	*size = (size_t)filesize.QuadPart;
+#else
+	struct stat st;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+	{
+		close(fd);
+		return NULL;
+	}
+
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return NULL;
+
+	*size = (size_t)st.st_size;
+#endif
+
+	return addr;
+}
+
+
+static void vc_file_unmap(void* addr, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(addr);
+#else
+	munmap(addr, size);
+#endif
+}
+
+
+// Igual a netpbm_get_token(), mas a partir de um buffer em memria (pos  actualizado)
+static char* netpbm_get_token_mem(const unsigned char* buf, size_t size, size_t* pos, char* tok, int len)
+{
+	char* t = tok;
+	size_t p = *pos;
+
+	for (;;)
+	{
+		while ((p < size) && isspace(buf[p])) p++;
+		if ((p >= size) || (buf[p] != '#')) break;
+		while ((p < size) && (buf[p] != '\n')) p++;
+	}
+
+	while ((p < size) && (!isspace(buf[p])) && (buf[p] != '#') && (t - tok < len - 1))
+	{
+		*t++ = buf[p++];
+	}
+
+	*t = 0;
+	*pos = p;
+
+	return tok;
+}
+
+
+// Leitura de uma imagem PGM/PPM sem cpia: o ficheiro  mapeado em memria e image->data
+// aponta directamente para os pixis do ficheiro. S so lidas do disco as pginas acedidas.
+// As escritas em image->data so privadas (no alteram o ficheiro).
+// O mapeamento  libertado por vc_image_free(). Ficheiros PBM (P4) so lidos com vc_read_image().
+// As linhas ficam como no ficheiro: sem padding nem alinhamento a VC_ALIGNMENT (ver vc.h).
+IVC* vc_read_image_mmap(char* filename)
+{
+	IVC* image;
+	unsigned char* base;
+	size_t size, pos = 0;
+	char tok[20];
+	int width, height, channels;
+	int levels;
+
+	base = (unsigned char*)vc_file_map(filename, &size);
+	if (base == NULL)
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_read_image_mmap():\n\tFile not found.\n");
+#endif
+		return NULL;
+	}
+
+	// Efectua a leitura do header
+	netpbm_get_token_mem(base, size, &pos, tok, sizeof(tok));
+
+	if (strcmp(tok, "P5") == 0) channels = 1;				// Se PGM (Gray [0,MAX(level,255)])
+	else if (strcmp(tok, "P6") == 0) channels = 3;			// Se PPM (RGB [0,MAX(level,255)])
+	else
+	{
+		vc_file_unmap(base, size);
+
+		// PBM tem de ser descompactado, pelo que no  possvel evitar a cpia
+		if (strcmp(tok, "P4") == 0) return vc_read_image(filename);
+
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_read_image_mmap():\n\tFile is not a valid PBM, PGM or PPM file.\n\tBad magic number!\n");
+#endif
+		return NULL;
+	}
+
+	if (sscanf(netpbm_get_token_mem(base, size, &pos, tok, sizeof(tok)), "%d", &width) != 1 ||
+		sscanf(netpbm_get_token_mem(base, size, &pos, tok, sizeof(tok)), "%d", &height) != 1 ||
+		sscanf(netpbm_get_token_mem(base, size, &pos, tok, sizeof(tok)), "%d", &levels) != 1 || levels <= 0 || levels > 255 ||
+		width <= 0 || height <= 0)
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_read_image_mmap():\n\tFile is not a valid PGM or PPM file.\n\tBad size!\n");
+#endif
+		vc_file_unmap(base, size);
+		return NULL;
+	}
+
+	// Um nico carcter branco separa o header dos dados
+	pos++;
+
+	if ((pos > size) || (size - pos < (size_t)width * height * channels))
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_read_image_mmap():\n\tPremature EOF on file.\n");
+#endif
+		vc_file_unmap(base, size);
+		return NULL;
+	}
+
+	image = (IVC*)malloc(sizeof(IVC));
+	if (image == NULL)
+	{
+		vc_file_unmap(base, size);
+		return NULL;
+	}
+
+	image->width = width;
+	image->height = height;
+	image->channels = channels;
+	image->levels = levels;
+	image->bytesperline = width * channels;
+	image->data = base + pos;
+	image->mapaddr = base;
+	image->mapsize = size;
+
+	return image;
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//   FUNES: SEQUNCIAS DE IMAGENS (VRIAS FRAMES NUM FICHEIRO)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+
+// Primitivas mnimas de threads (Win32 / POSIX)
+#ifdef _WIN32
+typedef HANDLE vc_thread_t;
+typedef CRITICAL_SECTION vc_mutex_t;
+typedef CONDITION_VARIABLE vc_cond_t;
+#define vc_mutex_init(m)		InitializeCriticalSection(m)
+#define vc_mutex_destroy(m)		DeleteCriticalSection(m)
+#define vc_mutex_lock(m)		EnterCriticalSection(m)
+#define vc_mutex_unlock(m)		LeaveCriticalSection(m)
+#define vc_cond_init(c)			InitializeConditionVariable(c)
+#define vc_cond_destroy(c)		((void)0)
+#define vc_cond_wait(c, m)		SleepConditionVariableCS(c, m, INFINITE)
+#define vc_cond_broadcast(c)	WakeAllConditionVariable(c)
+#else
+typedef pthread_t vc_thread_t;
+typedef pthread_mutex_t vc_mutex_t;
+typedef pthread_cond_t vc_cond_t;
+#define vc_mutex_init(m)		pthread_mutex_init(m, NULL)
+#define vc_mutex_destroy(m)		pthread_mutex_destroy(m)
+#define vc_mutex_lock(m)		pthread_mutex_lock(m)
+#define vc_mutex_unlock(m)		pthread_mutex_unlock(m)
+#define vc_cond_init(c)			pthread_cond_init(c, NULL)
+#define vc_cond_destroy(c)		pthread_cond_destroy(c)
+#define vc_cond_wait(c, m)		pthread_cond_wait(c, m)
+#define vc_cond_broadcast(c)	pthread_cond_broadcast(c)
+#endif
+
+#ifdef _WIN32
+typedef LPTHREAD_START_ROUTINE vc_thread_func;
+#else
+typedef void* (*vc_thread_func)(void*);
+#endif
+
+static int vc_thread_create(vc_thread_t* thread, vc_thread_func func, void* arg)
+{
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+	return *thread != NULL;
+#else
+	return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+static void vc_thread_join(vc_thread_t thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+// Nmero de processadores lgicos disponveis
+static int vc_cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0) ? (int)n : 1;
+#endif
+}
+
+// Relgio monotnico, em milissegundos
+static double vc_time_ms(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+
+	return (double)count.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Estado de cada um dos dois buffers
+#define VC_BUFFER_EMPTY	0
+#define VC_BUFFER_FULL	1
+#define VC_BUFFER_END	2
+#define VC_BUFFER_ERROR	3
+
+struct vc_stream {
+	FILE* file;
+	int writing;			// 0 = leitura; 1 = escrita
+	IVC* buffer[2];			// Duplo buffer: um  usado pelo utilizador enquanto a thread de I/O trata do outro
+	int status[2];
+	int next;				// Prximo buffer a entregar (leitura) ou a preencher (escrita)
+	int held;				// Buffer entregue ao utilizador em vc_stream_read() (-1 = nenhum)
+	int error;
+	int stop;
+	vc_thread_t thread;
+	vc_mutex_t mutex;
+	vc_cond_t cond;
+};
+
+
+// Thread de leitura: l a frame seguinte para o buffer livre enquanto o utilizador processa o outro
+#ifdef _WIN32
+static DWORD WINAPI vc_stream_reader(LPVOID arg)
+#else
+static void* vc_stream_reader(void* arg)
+#endif
+{
+	VCSTREAM* stream = (VCSTREAM*)arg;
+	int fill = 0;
+	int r;
+
+	vc_mutex_lock(&stream->mutex);
+	while (!stream->stop)
+	{
+		while ((!stream->stop) && (stream->status[fill] != VC_BUFFER_EMPTY)) vc_cond_wait(&stream->cond, &stream->mutex);
+		if (stream->stop) break;
+		vc_mutex_unlock(&stream->mutex);
+
+		r = vc_netpbm_read_frame(stream->file, &stream->buffer[fill], "vc_stream_read()");
+
+		vc_mutex_lock(&stream->mutex);
+		stream->status[fill] = (r > 0) ? VC_BUFFER_FULL : ((r == 0) ? VC_BUFFER_END : VC_BUFFER_ERROR);
+		vc_cond_broadcast(&stream->cond);
+		if (r <= 0) break;
+
+		fill ^= 1;
+	}
+	vc_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
+
+
+// Thread de escrita: escreve os buffers preenchidos por vc_stream_write(), pela ordem de chegada
+#ifdef _WIN32
+static DWORD WINAPI vc_stream_writer(LPVOID arg)
+#else
+static void* vc_stream_writer(void* arg)
+#endif
+{
+	VCSTREAM* stream = (VCSTREAM*)arg;
+	int drain = 0;
+	int ok;
+
+	vc_mutex_lock(&stream->mutex);
+	for (;;)
+	{
+		// Ao fechar, escreve primeiro o que estiver pendente
+		while ((!stream->stop) && (stream->status[drain] != VC_BUFFER_FULL)) vc_cond_wait(&stream->cond, &stream->mutex);
+		if (stream->status[drain] != VC_BUFFER_FULL) break;
+		vc_mutex_unlock(&stream->mutex);
+
+		ok = vc_netpbm_write_frame(stream->file, stream->buffer[drain]);
+
+		vc_mutex_lock(&stream->mutex);
+		stream->status[drain] = VC_BUFFER_EMPTY;
+		if (!ok) stream->error = 1;
+		vc_cond_broadcast(&stream->cond);
+
+		drain ^= 1;
+	}
+	vc_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
+
+
+static VCSTREAM* vc_stream_open(char* filename, int writing)
+{
+	VCSTREAM* stream;
+
+	stream = (VCSTREAM*)calloc(1, sizeof(VCSTREAM));
+	if (stream == NULL) return NULL;
+
+	if ((stream->file = fopen(filename, writing ? "wb" : "rb")) == NULL)
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_stream_open():\n\tFile not found.\n");
+#endif
+		free(stream);
+		return NULL;
+	}
+
+	stream->writing = writing;
+	stream->held = -1;
+	vc_mutex_init(&stream->mutex);
+	vc_cond_init(&stream->cond);
+
+#ifdef _WIN32
+	stream->thread = CreateThread(NULL, 0, writing ? vc_stream_writer : vc_stream_reader, stream, 0, NULL);
+	if (stream->thread == NULL)
+#else
+	if (pthread_create(&stream->thread, NULL, writing ? vc_stream_writer : vc_stream_reader, stream) != 0)
+#endif
+	{
+		vc_cond_destroy(&stream->cond);
+		vc_mutex_destroy(&stream->mutex);
+		fclose(stream->file);
+		free(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+
+// Abre um ficheiro com uma ou mais imagens PBM/PGM/PPM seguidas, para leitura.
+// A leitura da frame seguinte  feita numa thread em paralelo com o processamento da actual.
+VCSTREAM* vc_stream_open_read(char* filename)
+{
+	return vc_stream_open(filename, 0);
+}
+
+
+// Cria um ficheiro para escrita de uma sequncia de imagens PBM/PGM/PPM.
+// A escrita  feita numa thread; vc_stream_write() s bloqueia se os dois buffers estiverem ocupados.
+VCSTREAM* vc_stream_open_write(char* filename)
+{
+	return vc_stream_open(filename, 1);
+}
+
+
+// Devolve a frame seguinte, ou NULL no fim do ficheiro (ou em caso de erro).
+// A imagem devolvida pertence  sequncia e  reutilizada: s  vlida at  prxima chamada.
+IVC* vc_stream_read(VCSTREAM* stream)
+{
+	IVC* image = NULL;
+
+	if ((stream == NULL) || (stream->writing)) return NULL;
+
+	vc_mutex_lock(&stream->mutex);
+
+	// O buffer da frame anterior pode voltar a ser preenchido
+	if (stream->held >= 0)
+	{
+		stream->status[stream->held] = VC_BUFFER_EMPTY;
+		stream->held = -1;
+		vc_cond_broadcast(&stream->cond);
+	}
+
+	while (stream->status[stream->next] == VC_BUFFER_EMPTY) vc_cond_wait(&stream->cond, &stream->mutex);
+
+	if (stream->status[stream->next] == VC_BUFFER_FULL)
+	{
+		image = stream->buffer[stream->next];
+		stream->held = stream->next;
+		stream->next ^= 1;
+	}
+	else if (stream->status[stream->next] == VC_BUFFER_ERROR)
+	{
+		stream->error = 1;
+	}
+
+	vc_mutex_unlock(&stream->mutex);
+
+	return image;
+}
+
+
+// Acrescenta uma imagem  sequncia. A imagem  copiada, podendo ser reutilizada logo a seguir.
+int vc_stream_write(VCSTREAM* stream, IVC* image)
+{
+	IVC* buffer;
+	int slot, y, error;
+
+	if ((stream == NULL) || (!stream->writing) || (image == NULL) || (image->data == NULL)) return 0;
+
+	vc_mutex_lock(&stream->mutex);
+	slot = stream->next;
+	while (stream->status[slot] == VC_BUFFER_FULL) vc_cond_wait(&stream->cond, &stream->mutex);
+	error = stream->error;
+	vc_mutex_unlock(&stream->mutex);
+
+	if (error) return 0;
+
+	// O buffer livre no est a ser usado pela thread de escrita
+	buffer = stream->buffer[slot];
+	if ((buffer == NULL) || (buffer->width != image->width) || (buffer->height != image->height) || (buffer->channels != image->channels))
+	{
+		vc_image_free(buffer);
+		buffer = stream->buffer[slot] = vc_image_new(image->width, image->height, image->channels, image->levels);
+		if (buffer == NULL) return 0;
+	}
+	buffer->levels = image->levels;
+
+	for (y = 0; y < image->height; y++)
+	{
+		memcpy(&buffer->data[y * buffer->bytesperline], &image->data[y * image->bytesperline], image->width * image->channels);
+	}
+
+	vc_mutex_lock(&stream->mutex);
+	stream->status[slot] = VC_BUFFER_FULL;
+	stream->next ^= 1;
+	vc_cond_broadcast(&stream->cond);
+	vc_mutex_unlock(&stream->mutex);
+
+	return 1;
+}
+
+
+// Fecha a sequncia (na escrita, espera que as frames pendentes sejam escritas).
+// Devolve 0 se houve algum erro de leitura/escrita.
+int vc_stream_close(VCSTREAM* stream)
+{
+	int ok;
+
+	if (stream == NULL) return 0;
+
+	vc_mutex_lock(&stream->mutex);
+	stream->stop = 1;
+	vc_cond_broadcast(&stream->cond);
+	vc_mutex_unlock(&stream->mutex);
+
+#ifdef _WIN32
+	WaitForSingleObject(stream->thread, INFINITE);
+	CloseHandle(stream->thread);
+#else
+	pthread_join(stream->thread, NULL);
+#endif
+
+	ok = !stream->error;
+	if (fclose(stream->file) != 0) ok = 0;
+
+	vc_image_free(stream->buffer[0]);
+	vc_image_free(stream->buffer[1]);
+	vc_cond_destroy(&stream->cond);
+	vc_mutex_destroy(&stream->mutex);
+	free(stream);
+
+	return ok;
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNES: LEITURA ANTECIPADA DE FRAMES (PREFETCH)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Uma thread de descodificao preenche um anel de depth frames  frente do processamento:
+// chama decode() (ex.: VideoCapture::read() e cpia para a IVC) e faz logo as converses de cor
+// (BGR -> RGB, RGB -> HSV), pelo que a thread de processamento recebe as frames j convertidas
+// e s espera se o processamento for mais rpido do que a descodificao.
+
+struct vc_prefetch {
+	int depth;
+	int flags;
+	VCDECODE decode;
+	void* arg;
+	IVCPOOL pool;			// Imagens do anel, alocadas na criao
+	VCFRAME* frames;
+	int* status;			// VC_BUFFER_EMPTY / FULL / END / ERROR de cada posio do anel
+	int next;				// Prxima posio a entregar
+	int held;				// Posio entregue em vc_prefetch_read() (-1 = nenhuma)
+	int stop;
+	double waitms;			// Tempo total  espera em vc_prefetch_read()
+	vc_thread_t thread;
+	vc_mutex_t mutex;
+	vc_cond_t cond;
+};
+
+
+// Thread de descodificao: descodifica e converte para a posio livre seguinte do anel
+#ifdef _WIN32
+static DWORD WINAPI vc_prefetch_decoder(LPVOID arg)
+#else
+static void* vc_prefetch_decoder(void* arg)
+#endif
+{
+	VCPREFETCH* pf = (VCPREFETCH*)arg;
+	VCFRAME* frame;
+	int fill = 0, number = 0;
+	int r;
+
+	vc_mutex_lock(&pf->mutex);
+	while (!pf->stop)
+	{
+		while ((!pf->stop) && (pf->status[fill] != VC_BUFFER_EMPTY)) vc_cond_wait(&pf->cond, &pf->mutex);
+		if (pf->stop) break;
+		vc_mutex_unlock(&pf->mutex);
+
+		frame = &pf->frames[fill];
+		r = pf->decode(pf->arg, frame->rgb);
+		if (r > 0)
+		{
+			if ((pf->flags & VC_PREFETCH_BGR) && !vc_bgr_to_rgb(frame->rgb, frame->rgb)) r = -1;
+			else if ((frame->hsv != NULL) && !vc_rgb_to_hsv(frame->rgb, frame->hsv)) r = -1;
+		}
+		frame->number = number++;
+
+		vc_mutex_lock(&pf->mutex);
+		pf->status[fill] = (r > 0) ? VC_BUFFER_FULL : ((r == 0) ? VC_BUFFER_END : VC_BUFFER_ERROR);
+		vc_cond_broadcast(&pf->cond);
+		if (r <= 0) break;
+
+		fill = (fill + 1) % pf->depth;
+	}
+	vc_mutex_unlock(&pf->mutex);
+
+	return 0;
+}
+
+
+// Cria o anel de depth frames (>= 2) width x height e inicia a thread de descodificao.
+// decode(arg, image) escreve a frame seguinte em image (3 canais, width x height) e devolve 1,
+// 0 no fim da fonte ou -1 em caso de erro; corre sempre na thread de descodificao.
+// flags: VC_PREFETCH_BGR (decode() escreve BGR, convertido para RGB), VC_PREFETCH_HSV (calcula tambm frame->hsv)
+VCPREFETCH* vc_prefetch_open(int width, int height, int depth, int flags, VCDECODE decode, void* arg)
+{
+	VCPREFETCH* pf;
+	int i;
+
+	if ((width <= 0) || (height <= 0) || (decode == NULL)) return NULL;
+	if (depth < 2) depth = 2;
+
+	// A tabela de despacho  inicializada antes de a thread de descodificao a usar
+	vc_cpu_dispatch();
+
+	pf = (VCPREFETCH*)calloc(1, sizeof(VCPREFETCH));
+	if (pf == NULL) return NULL;
+
+	pf->depth = depth;
+	pf->flags = flags;
+	pf->decode = decode;
+	pf->arg = arg;
+	pf->held = -1;
+	vc_pool_init(&pf->pool);
+
+	pf->frames = (VCFRAME*)calloc(depth, sizeof(VCFRAME));
+	pf->status = (int*)calloc(depth, sizeof(int));
+	if ((pf->frames == NULL) || (pf->status == NULL) || (depth * ((flags & VC_PREFETCH_HSV) ? 2 : 1) > VC_POOL_MAX_IMAGES))
+	{
+		free(pf->frames);
+		free(pf->status);
+		free(pf);
+		return NULL;
+	}
+
+	for (i = 0; i < depth; i++)
+	{
+		pf->frames[i].rgb = vc_pool_get(&pf->pool, width, height, 3, 255);
+		if (flags & VC_PREFETCH_HSV) pf->frames[i].hsv = vc_pool_get(&pf->pool, width, height, 3, 255);
+
+		if ((pf->frames[i].rgb == NULL) || ((flags & VC_PREFETCH_HSV) && (pf->frames[i].hsv == NULL))) break;
+	}
+
+	vc_mutex_init(&pf->mutex);
+	vc_cond_init(&pf->cond);
+
+	if ((i < depth) || !vc_thread_create(&pf->thread, vc_prefetch_decoder, pf))
+	{
+		vc_cond_destroy(&pf->cond);
+		vc_mutex_destroy(&pf->mutex);
+		vc_pool_free(&pf->pool);
+		free(pf->frames);
+		free(pf->status);
+		free(pf);
+		return NULL;
+	}
+
+	return pf;
+}
+
+
+// Devolve a frame seguinte (j convertida), ou NULL no fim da fonte (ou em caso de erro).
+// A frame pertence ao anel: s  vlida at  prxima chamada, que a devolve  thread de descodificao.
+VCFRAME* vc_prefetch_read(VCPREFETCH* pf)
+{
+	VCFRAME* frame = NULL;
+	double t0;
+
+	if (pf == NULL) return NULL;
+
+	vc_mutex_lock(&pf->mutex);
+
+	// A posio da frame anterior pode voltar a ser preenchida
+	if (pf->held >= 0)
+	{
+		pf->status[pf->held] = VC_BUFFER_EMPTY;
+		pf->held = -1;
+		vc_cond_broadcast(&pf->cond);
+	}
+
+	if (pf->status[pf->next] == VC_BUFFER_EMPTY)
+	{
+		t0 = vc_time_ms();
+		while (pf->status[pf->next] == VC_BUFFER_EMPTY) vc_cond_wait(&pf->cond, &pf->mutex);
+		pf->waitms += vc_time_ms() - t0;
+	}
+
+	if (pf->status[pf->next] == VC_BUFFER_FULL)
+	{
+		frame = &pf->frames[pf->next];
+		pf->held = pf->next;
+		pf->next = (pf->next + 1) % pf->depth;
+	}
+
+	vc_mutex_unlock(&pf->mutex);
+
+	return frame;
+}
+
+
+// Tempo total (ms) que vc_prefetch_read() passou  espera da descodificao
+double vc_prefetch_wait_ms(VCPREFETCH* pf)
+{
+	double ms;
+
+	if (pf == NULL) return 0.0;
+
+	vc_mutex_lock(&pf->mutex);
+	ms = pf->waitms;
+	vc_mutex_unlock(&pf->mutex);
+
+	return ms;
+}
+
+
+// Pra a thread de descodificao (depois de decode() regressar) e liberta o anel.
+// Devolve 0 se a descodificao terminou com erro.
+int vc_prefetch_close(VCPREFETCH* pf)
+{
+	int ok = 1;
+	int i;
+
+	if (pf == NULL) return 0;
+
+	vc_mutex_lock(&pf->mutex);
+	pf->stop = 1;
+	vc_cond_broadcast(&pf->cond);
+	vc_mutex_unlock(&pf->mutex);
+
+	vc_thread_join(pf->thread);
+
+	for (i = 0; i < pf->depth; i++)
+	{
+		if (pf->status[i] == VC_BUFFER_ERROR) ok = 0;
+	}
+
+	vc_pool_free(&pf->pool);
+	vc_cond_destroy(&pf->cond);
+	vc_mutex_destroy(&pf->mutex);
+	free(pf->frames);
+	free(pf->status);
+	free(pf);
+
+	return ok;
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//           FUNES: CONTEXTO DE PROCESSAMENTO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Um contexto  usado por uma thread de cada vez (a que chama as funes _ctx, que  a thread 0);
+// as suas threads de trabalho ficam bloqueadas at vc_context_parallel_for() lhes entregar jobs.
+// Contextos diferentes no partilham estado, pelo que podem correr em paralelo (ex.: uma cmara por contexto).
+
+#define VC_CONTEXT_MAX_BLOBS 254	// Limite da etiquetagem com etiquetas de 8 bits
+
+typedef struct {
+	unsigned char* data;
+	size_t size;
+} VCSCRATCH;
+
+typedef struct {
+	VCCONTEXT* ctx;
+	int thread;
+} VCCONTEXTWORKER;
+
+// Tarefa do escalonador com roubo de trabalho: job(arg, index, thread)
+typedef struct {
+	VCJOB job;
+	void* arg;
+	int index;
+} VCTASKITEM;
+
+// Deque de tarefas de uma thread, em items[top, bottom[. As tarefas iniciais ficam no topo, da maior para a
+// menor; as criadas com vc_context_spawn() so acrescentadas ao fundo. A dona retira do fundo (LIFO: a tarefa
+// que acabou de criar ainda est em cache) e, quando s restam tarefas iniciais, do topo; as outras threads
+// roubam sempre do topo (as tarefas iniciais maiores e depois as criadas h mais tempo).
+typedef struct {
+	vc_mutex_t mutex;
+	VCTASKITEM* items;
+	int capacity;
+	int top;
+	int bottom;
+	int initial;				// Tarefas iniciais que restam em items[top, top + initial[
+} VCDEQUE;
+
+struct vc_context {
+	IVCPOOL pool;
+	VCCOUNTERS counters;
+	double timer;				// Incio do temporizador (ms)
+
+	// Etiquetagem (vc_binary_blob_labelling_ctx)
+	int labeltable[256];
+	OVC blobs[VC_CONTEXT_MAX_BLOBS];
+
+	// Threads: a thread 0  a que chama; as restantes nthreads - 1 so criadas com o contexto
+	int nthreads;
+	vc_thread_t* threads;
+	VCCONTEXTWORKER* workers;
+	VCSCRATCH* scratch;			// Memria de trabalho de cada thread
+	VCDEQUE* deques;			// Deque de tarefas de cada thread
+	int ndeques;
+
+	// Jobs em curso (protegidos por mutex)
+	vc_mutex_t mutex;
+	vc_cond_t work;				// Nova gerao de jobs ou paragem
+	vc_cond_t done;				// Todas as threads de trabalho acabaram a gerao actual
+	int generation;
+	int stop;
+	VCJOB job;
+	void* arg;
+	int n;
+	int next;
+	int active;					// Threads de trabalho que ainda no acabaram a gerao actual
+	int failed;
+
+	// Tarefas (vc_context_tasks), tambm protegidas por mutex
+	vc_cond_t tasks;			// Nova tarefa ou fim de todas as tarefas
+	int pending;				// Tarefas por acabar (incluindo as que esto a correr)
+	int spawned;				// Nmero de tarefas criadas (para as threads sem trabalho saberem que h novas)
+	int taskfailed;
+};
+
+
+// Corre jobs da gerao actual at se esgotarem; chamada (e termina) com o mutex fechado
+static void vc_context_run_jobs(VCCONTEXT* ctx, int thread)
+{
+	int i, ok;
+
+	while (ctx->next < ctx->n)
+	{
+		i = ctx->next++;
+		vc_mutex_unlock(&ctx->mutex);
+
+		ok = ctx->job(ctx->arg, i, thread);
+
+		vc_mutex_lock(&ctx->mutex);
+		if (!ok) ctx->failed = 1;
+	}
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI vc_context_worker(LPVOID arg)
+#else
+static void* vc_context_worker(void* arg)
+#endif
+{
+	VCCONTEXTWORKER* worker = (VCCONTEXTWORKER*)arg;
+	VCCONTEXT* ctx = worker->ctx;
+	int generation = 0;
+
+	vc_mutex_lock(&ctx->mutex);
+
+	for (;;)
+	{
+		while (!ctx->stop && (ctx->generation == generation)) vc_cond_wait(&ctx->work, &ctx->mutex);
+		if (ctx->stop) break;
+
+		generation = ctx->generation;
+		vc_context_run_jobs(ctx, worker->thread);
+
+		if (--ctx->active == 0) vc_cond_broadcast(&ctx->done);
+	}
+
+	vc_mutex_unlock(&ctx->mutex);
+
+	return 0;
+}
+
+
+// Cria um contexto com nthreads threads no total, incluindo a que chama (<= 0: uma por processador).
+// Se no for possvel criar todas as threads, o contexto fica com as que foram criadas.
+VCCONTEXT* vc_context_new(int nthreads)
+{
+	VCCONTEXT* ctx;
+	int i;
+
+	if (nthreads <= 0) nthreads = vc_cpu_count();
+
+	// A tabela de despacho  inicializada antes de existirem threads de trabalho
+	vc_cpu_dispatch();
+
+	ctx = (VCCONTEXT*)calloc(1, sizeof(VCCONTEXT));
+	if (ctx == NULL) return NULL;
+
+	vc_pool_init(&ctx->pool);
+	vc_mutex_init(&ctx->mutex);
+	vc_cond_init(&ctx->work);
+	vc_cond_init(&ctx->done);
+	vc_cond_init(&ctx->tasks);
+	ctx->nthreads = 1;
+
+	ctx->scratch = (VCSCRATCH*)calloc(nthreads, sizeof(VCSCRATCH));
+	ctx->deques = (VCDEQUE*)calloc(nthreads, sizeof(VCDEQUE));
+	if (ctx->deques != NULL)
+	{
+		for (i = 0; i < nthreads; i++) vc_mutex_init(&ctx->deques[i].mutex);
+		ctx->ndeques = nthreads;
+	}
+	if (nthreads > 1)
+	{
+		ctx->threads = (vc_thread_t*)malloc((nthreads - 1) * sizeof(vc_thread_t));
+		ctx->workers = (VCCONTEXTWORKER*)malloc((nthreads - 1) * sizeof(VCCONTEXTWORKER));
+	}
+	if ((ctx->scratch == NULL) || (ctx->deques == NULL) || ((nthreads > 1) && ((ctx->threads == NULL) || (ctx->workers == NULL))))
+	{
+		return vc_context_free(ctx);
+	}
+
+	for (i = 1; i < nthreads; i++)
+	{
+		ctx->workers[i - 1].ctx = ctx;
+		ctx->workers[i - 1].thread = i;
+
+		if (!vc_thread_create(&ctx->threads[i - 1], vc_context_worker, &ctx->workers[i - 1])) break;
+		ctx->nthreads++;
+	}
+
+	ctx->timer = vc_time_ms();
+
+	return ctx;
+}
+
+
+// Termina as threads e liberta as imagens da pool e a memria de trabalho
+VCCONTEXT* vc_context_free(VCCONTEXT* ctx)
+{
+	int i;
+
+	if (ctx == NULL) return NULL;
+
+	vc_mutex_lock(&ctx->mutex);
+	ctx->stop = 1;
+	vc_cond_broadcast(&ctx->work);
+	vc_mutex_unlock(&ctx->mutex);
+
+	for (i = 0; i < ctx->nthreads - 1; i++) vc_thread_join(ctx->threads[i]);
+
+	if (ctx->scratch != NULL)
+	{
+		for (i = 0; i < ctx->nthreads; i++) vc_aligned_free(ctx->scratch[i].data);
+	}
+	for (i = 0; i < ctx->ndeques; i++)
+	{
+		free(ctx->deques[i].items);
+		vc_mutex_destroy(&ctx->deques[i].mutex);
+	}
+
+	vc_pool_free(&ctx->pool);
+	vc_cond_destroy(&ctx->work);
+	vc_cond_destroy(&ctx->done);
+	vc_cond_destroy(&ctx->tasks);
+	vc_mutex_destroy(&ctx->mutex);
+
+	free(ctx->scratch);
+	free(ctx->deques);
+	free(ctx->threads);
+	free(ctx->workers);
+	free(ctx);
+
+	return NULL;
+}
+
+
+int vc_context_nthreads(VCCONTEXT* ctx)
+{
+	return (ctx != NULL) ? ctx->nthreads : 0;
+}
+
+
+// Entrega os jobs [0, n[ s threads do contexto e espera que acabem (sem os contar)
+static int vc_context_dispatch(VCCONTEXT* ctx, int n, VCJOB job, void* arg)
+{
+	int failed = 0;
+	int i;
+
+	// Sem trabalho para repartir: no acorda as threads
+	if ((ctx->nthreads == 1) || (n == 1))
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (!job(arg, i, 0)) failed = 1;
+		}
+		return !failed;
+	}
+
+	vc_mutex_lock(&ctx->mutex);
+
+	ctx->job = job;
+	ctx->arg = arg;
+	ctx->n = n;
+	ctx->next = 0;
+	ctx->failed = 0;
+	ctx->active = ctx->nthreads - 1;
+	ctx->generation++;
+	vc_cond_broadcast(&ctx->work);
+
+	vc_context_run_jobs(ctx, 0);
+
+	while (ctx->active > 0) vc_cond_wait(&ctx->done, &ctx->mutex);
+	failed = ctx->failed;
+
+	vc_mutex_unlock(&ctx->mutex);
+
+	return !failed;
+}
+
+
+// Executa job(arg, i, thread) para i em [0, n[ nas threads do contexto (thread em [0, nthreads[).
+// A thread que chama tambm trabalha. No pode ser chamada de dentro de um job. Devolve 0 se algum job falhou.
+int vc_context_parallel_for(VCCONTEXT* ctx, int n, VCJOB job, void* arg)
+{
+	if ((ctx == NULL) || (job == NULL)) return 0;
+	if (n <= 0) return 1;
+
+	ctx->counters.jobs += n;
+
+	return vc_context_dispatch(ctx, n, job, arg);
+}
+
+
+// Escalonador de tarefas com roubo de trabalho (work stealing).
+// Cada thread tem uma deque: tira as suas tarefas do fundo e, quando a deque fica vazia, rouba do topo
+// das deques das outras threads. Ao contrrio de vc_context_parallel_for() (ndices distribudos por ordem),
+// uma tarefa pode criar novas tarefas com vc_context_spawn(), que ficam na deque da thread que as criou.
+// Adequado a trabalho de custo muito varivel e no conhecido  partida (ex.: uma tarefa por blob).
+
+// Acrescenta task ao fundo da deque (a capacidade cresce quando  preciso)
+static int vc_deque_push(VCDEQUE* deque, const VCTASKITEM* task)
+{
+	VCTASKITEM* items;
+	int capacity;
+
+	vc_mutex_lock(&deque->mutex);
+
+	if (deque->bottom == deque->capacity)
+	{
+		// Reaproveita o espao libertado no topo antes de aumentar a capacidade
+		if (deque->top > 0)
+		{
+			memmove(deque->items, &deque->items[deque->top], (deque->bottom - deque->top) * sizeof(VCTASKITEM));
+			deque->bottom -= deque->top;
+			deque->top = 0;
+		}
+		else
+		{
+			capacity = (deque->capacity > 0) ? 2 * deque->capacity : 64;
+			items = (VCTASKITEM*)realloc(deque->items, capacity * sizeof(VCTASKITEM));
+			if (items == NULL)
+			{
+				vc_mutex_unlock(&deque->mutex);
+				return 0;
+			}
+			deque->items = items;
+			deque->capacity = capacity;
+		}
+	}
+
+	deque->items[deque->bottom++] = *task;
+
+	vc_mutex_unlock(&deque->mutex);
+
+	return 1;
+}
+
+// Retira uma tarefa da deque; 0 se est vazia.
+// steal = 0 (a dona): a do fundo, ou a do topo se s restam tarefas iniciais; steal = 1 (outra thread): a do topo
+static int vc_deque_pop(VCDEQUE* deque, VCTASKITEM* task, int steal)
+{
+	int found = 0;
+
+	vc_mutex_lock(&deque->mutex);
+
+	if (deque->top < deque->bottom)
+	{
+		if (steal || (deque->bottom - deque->top == deque->initial))
+		{
+			*task = deque->items[deque->top++];
+			if (deque->initial > 0) deque->initial--;
+		}
+		else
+		{
+			*task = deque->items[--deque->bottom];
+		}
+		if (deque->top == deque->bottom) deque->top = deque->bottom = 0;
+		found = 1;
+	}
+
+	vc_mutex_unlock(&deque->mutex);
+
+	return found;
+}
+
+// Prxima tarefa para a thread thread: da sua deque ou, se est vazia, roubada s seguintes
+static int vc_context_task_find(VCCONTEXT* ctx, int thread, VCTASKITEM* task)
+{
+	int i;
+
+	if (vc_deque_pop(&ctx->deques[thread], task, 0)) return 1;
+
+	for (i = 1; i < ctx->nthreads; i++)
+	{
+		if (vc_deque_pop(&ctx->deques[(thread + i) % ctx->nthreads], task, 1)) return 1;
+	}
+
+	return 0;
+}
+
+// Ciclo de cada thread: corre tarefas at no haver nenhuma por acabar.
+// Sem tarefas  vista, espera por uma nova (spawned muda) ou pelo fim de todas (pending = 0).
+static int vc_context_tasks_job(void* arg, int index, int thread)
+{
+	VCCONTEXT* ctx = (VCCONTEXT*)arg;
+	VCTASKITEM task;
+	int spawned, ok;
+
+	vc_mutex_lock(&ctx->mutex);
+	spawned = ctx->spawned;
+	vc_mutex_unlock(&ctx->mutex);
+
+	for (;;)
+	{
+		if (vc_context_task_find(ctx, thread, &task))
+		{
+			ok = task.job(task.arg, task.index, thread);
+
+			vc_mutex_lock(&ctx->mutex);
+			if (!ok) ctx->taskfailed = 1;
+			if (--ctx->pending == 0) vc_cond_broadcast(&ctx->tasks);
+			spawned = ctx->spawned;
+			vc_mutex_unlock(&ctx->mutex);
+		}
+		else
+		{
+			vc_mutex_lock(&ctx->mutex);
+			while ((ctx->pending > 0) && (ctx->spawned == spawned)) vc_cond_wait(&ctx->tasks, &ctx->mutex);
+			spawned = ctx->spawned;
+			if (ctx->pending == 0)
+			{
+				vc_mutex_unlock(&ctx->mutex);
+				return 1;
+			}
+			vc_mutex_unlock(&ctx->mutex);
+		}
+	}
+}
+
+// Executa as tarefas job(arg, i, thread), i em [0, n[, e todas as que estas criarem, com roubo de trabalho.
+// As tarefas iniciais so distribudas pelas deques em round-robin, de n - 1 para 0, e ficam no topo de cada
+// deque da maior para a menor: com os ndices por ordem crescente de custo, tanto a dona como as threads que
+// roubam comeam pelas maiores, e as pequenas ficam para equilibrar o fim.
+// A thread que chama tambm trabalha. No pode ser chamada de dentro de um job. Devolve 0 se alguma tarefa falhou.
+int vc_context_tasks(VCCONTEXT* ctx, int n, VCJOB job, void* arg)
+{
+	VCTASKITEM task;
+	int i, ok;
+
+	if ((ctx == NULL) || (job == NULL)) return 0;
+	if (n <= 0) return 1;
+
+	task.job = job;
+	task.arg = arg;
+
+	for (i = 0; i < n; i++)
+	{
+		task.index = n - 1 - i;
+		if (!vc_deque_push(&ctx->deques[i % ctx->nthreads], &task))
+		{
+			// Descarta as tarefas j distribudas
+			for (i = 0; i < ctx->nthreads; i++) ctx->deques[i].top = ctx->deques[i].bottom = 0;
+			return 0;
+		}
+	}
+	for (i = 0; i < ctx->nthreads; i++) ctx->deques[i].initial = ctx->deques[i].bottom - ctx->deques[i].top;
+
+	ctx->pending = n;
+	ctx->spawned = 0;
+	ctx->taskfailed = 0;
+
+	ok = vc_context_dispatch(ctx, ctx->nthreads, vc_context_tasks_job, ctx);
+
+	ctx->counters.tasks += n + ctx->spawned;
+
+	return ok && !ctx->taskfailed;
+}
+
+// Dentro de uma tarefa (de vc_context_tasks()) que corre na thread thread: cria a tarefa job(arg, index, ...),
+// que fica na deque desta thread e pode ser roubada pelas outras. vc_context_tasks() s regressa depois de ela acabar.
+int vc_context_spawn(VCCONTEXT* ctx, int thread, VCJOB job, void* arg, int index)
+{
+	VCTASKITEM task;
+	int ok;
+
+	if ((ctx == NULL) || (job == NULL) || (thread < 0) || (thread >= ctx->nthreads)) return 0;
+
+	task.job = job;
+	task.arg = arg;
+	task.index = index;
+
+	// Contada antes de poder ser roubada, para que pending no chegue a 0 antes do tempo
+	vc_mutex_lock(&ctx->mutex);
+	ok = vc_deque_push(&ctx->deques[thread], &task);
+	if (ok)
+	{
+		ctx->pending++;
+		ctx->spawned++;
+		vc_cond_broadcast(&ctx->tasks);
+	}
+	vc_mutex_unlock(&ctx->mutex);
+
+	return ok;
+}
+
+
+// Memria de trabalho da thread thread do contexto, com pelo menos size bytes, alinhada a VC_ALIGNMENT.
+// Mantm-se entre chamadas (s  realocada quando tem de crescer, sem preservar o contedo).
+// Cada thread s deve pedir a sua; a thread que chama  a thread 0.
+void* vc_context_scratch(VCCONTEXT* ctx, int thread, size_t size)
+{
+	VCSCRATCH* scratch;
+
+	if ((ctx == NULL) || (thread < 0) || (thread >= ctx->nthreads)) return NULL;
+
+	scratch = &ctx->scratch[thread];
+
+	if (scratch->size < size)
+	{
+		vc_aligned_free(scratch->data);
+		scratch->data = (unsigned char*)vc_aligned_malloc(size);
+		scratch->size = (scratch->data != NULL) ? size : 0;
+	}
+
+	return scratch->data;
+}
+
+
+// Imagens da pool do contexto (s a thread que chama as funes _ctx as deve pedir e devolver)
+IVC* vc_context_image_get(VCCONTEXT* ctx, int width, int height, int channels, int levels)
+{
+	IVC* image;
+	int nimages, i;
+
+	if (ctx == NULL) return vc_image_new(width, height, channels, levels);
+
+	nimages = ctx->pool.nimages;
+	image = vc_pool_get(&ctx->pool, width, height, channels, levels);
+	if (image == NULL) return NULL;
+
+	// Conta as imagens alocadas (as que no vieram das j existentes na pool)
+	for (i = 0; (i < nimages) && (ctx->pool.images[i] != image); i++);
+	if (i == nimages) ctx->counters.images++;
+
+	return image;
+}
+
+void vc_context_image_release(VCCONTEXT* ctx, IVC* image)
+{
+	vc_pool_release((ctx != NULL) ? &ctx->pool : NULL, image);
+}
+
+
+const VCCOUNTERS* vc_context_counters(VCCONTEXT* ctx)
+{
+	return (ctx != NULL) ? &ctx->counters : NULL;
+}
+
+void vc_context_counters_reset(VCCONTEXT* ctx)
+{
+	if (ctx != NULL) memset(&ctx->counters, 0, sizeof(VCCOUNTERS));
+}
+
+
+// Temporizador do contexto: reinicia, e devolve os segundos decorridos desde o incio
+void vc_context_timer_start(VCCONTEXT* ctx)
+{
+	if (ctx != NULL) ctx->timer = vc_time_ms();
+}
+
+double vc_context_timer_elapsed(VCCONTEXT* ctx)
+{
+	return (ctx != NULL) ? (vc_time_ms() - ctx->timer) / 1000.0 : 0.0;
+}
+
+
+// Contagem das chamadas _ctx e do tempo passado nelas
+static double vc_context_enter(VCCONTEXT* ctx)
+{
+	ctx->counters.calls++;
+
+	return vc_time_ms();
+}
+
+static int vc_context_leave(VCCONTEXT* ctx, double t0, int ok)
+{
+	ctx->counters.ms += vc_time_ms() - t0;
+
+	return ok;
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNES: PROCESSAMENTO DE VRIAS STREAMS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Vrias fontes de vdeo num s processo, com um conjunto partilhado de threads de trabalho.
+// Cada stream tem um anel de depth frames: o produtor (ex.: a thread que descodifica o vdeo)
+// pede uma frame livre com vc_multistream_acquire(), preenche-a e entrega-a com vc_multistream_submit().
+// O escalonamento  central: os anis de todas as streams esto sob um s mutex e cada thread livre escolhe
+// a frame seguinte em vc_multistream_pick(). Cada thread de trabalho tem uma stream "prpria" (thread % nstreams)
+// e s serve outra quando esta no tem trabalho ou j recebeu mais tempo de CPU do que as outras (escalonamento
+// justo:  servida a stream com menos tempo de processamento acumulado). As frames de uma stream podem ser
+// processadas em paralelo, mas so entregues por ordem (done), uma de cada vez.
+
+// Tolerncia (ms de CPU) antes de uma thread deixar a sua stream para servir uma menos servida
+#define VC_MULTISTREAM_SLICE_MS 10.0
+
+#define VC_SLOT_FREE	0		// Livre para vc_multistream_acquire()
+#define VC_SLOT_FILLING	1		// Entregue ao produtor
+#define VC_SLOT_QUEUED	2		//  espera de uma thread
+#define VC_SLOT_RUNNING	3
+#define VC_SLOT_DONE	4		// Processada,  espera da vez para ser entregue
+
+typedef struct {
+	IVC* image;
+	int state;
+	int frame;
+	int ok;
+	double tsubmit;				// ms
+} VCSLOT;
+
+typedef struct {
+	VCSLOT* slots;				// Anel de depth frames
+	int acquire;				// Prximo slot a entregar ao produtor
+	int submit;					// Prximo slot a ser submetido pelo produtor
+	int run;					// Prximo slot a processar
+	int deliver;				// Prximo slot a entregar por ordem
+	int queued;					// Frames  espera de uma thread
+	int delivering;				// H uma thread a chamar done()
+	int nframes;				// Frames submetidas
+	double service;				// Tempo de processamento acumulado (para o escalonamento)
+	int started;
+
+	VCSTREAMSTATS stats;
+	double tfirst, tlast;		// Primeira submisso e ltima entrega (ms)
+	double latency;				// Soma das latncias (ms)
+} VCSTREAMSTATE;
+
+typedef struct {
+	VCMULTISTREAM* ms;
+	int thread;
+} VCMULTIWORKER;
+
+struct vc_multistream {
+	int nstreams;
+	int depth;
+	VCSTREAMSTATE* streams;
+	VCFRAMEPROC process;
+	VCFRAMEDONE done;
+	void* arg;
+
+	int nthreads;
+	vc_thread_t* threads;
+	VCMULTIWORKER* workers;
+	VCCONTEXT** contexts;		// Um contexto (de uma thread) por thread de trabalho
+	int ncontexts;
+
+	vc_mutex_t mutex;
+	vc_cond_t work;				// H frames  espera, ou paragem
+	vc_cond_t state;			// Um slot ficou livre ou uma frame foi entregue
+	int pending;				// Frames submetidas e ainda no entregues
+	int stop;
+};
+
+
+// Stream a servir pela thread thread, ou -1 se no h frames  espera (com o mutex fechado)
+static int vc_multistream_pick(VCMULTISTREAM* ms, int thread)
+{
+	int home = thread % ms->nstreams;
+	int best = -1;
+	int s;
+
+	for (s = 0; s < ms->nstreams; s++)
+	{
+		if ((ms->streams[s].queued > 0) && ((best < 0) || (ms->streams[s].service < ms->streams[best].service))) best = s;
+	}
+
+	if ((best >= 0) && (ms->streams[home].queued > 0) && (ms->streams[home].service <= ms->streams[best].service + VC_MULTISTREAM_SLICE_MS)) return home;
+
+	return best;
+}
+
+
+// Entrega por ordem as frames j processadas da stream s; s uma thread de cada vez (com o mutex fechado)
+static void vc_multistream_deliver(VCMULTISTREAM* ms, int s)
+{
+	VCSTREAMSTATE* stream = &ms->streams[s];
+	VCSLOT* slot;
+	double latency;
+
+	if (stream->delivering) return;
+	stream->delivering = 1;
+
+	while ((slot = &stream->slots[stream->deliver])->state == VC_SLOT_DONE)
+	{
+		if (ms->done != NULL)
+		{
+			vc_mutex_unlock(&ms->mutex);
+			ms->done(ms->arg, s, slot->frame, slot->image, slot->ok);
+			vc_mutex_lock(&ms->mutex);
+		}
+
+		stream->tlast = vc_time_ms();
+		latency = stream->tlast - slot->tsubmit;
+		stream->latency += latency;
+		if (latency > stream->stats.latency_max) stream->stats.latency_max = latency;
+		stream->stats.frames++;
+		if (!slot->ok) stream->stats.failed++;
+
+		slot->state = VC_SLOT_FREE;
+		stream->deliver = (stream->deliver + 1) % ms->depth;
+		ms->pending--;
+		vc_cond_broadcast(&ms->state);
+	}
+
+	stream->delivering = 0;
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI vc_multistream_worker(LPVOID arg)
+#else
+static void* vc_multistream_worker(void* arg)
+#endif
+{
+	VCMULTIWORKER* worker = (VCMULTIWORKER*)arg;
+	VCMULTISTREAM* ms = worker->ms;
+	VCCONTEXT* ctx = ms->contexts[worker->thread];
+	VCSTREAMSTATE* stream;
+	VCSLOT* slot;
+	double t0, dt;
+	int s, ok;
+
+	vc_mutex_lock(&ms->mutex);
+
+	for (;;)
+	{
+		while (((s = vc_multistream_pick(ms, worker->thread)) < 0) && !ms->stop) vc_cond_wait(&ms->work, &ms->mutex);
+		if (s < 0) break;
+
+		stream = &ms->streams[s];
+		slot = &stream->slots[stream->run];
+		slot->state = VC_SLOT_RUNNING;
+		stream->run = (stream->run + 1) % ms->depth;
+		stream->queued--;
+
+		vc_mutex_unlock(&ms->mutex);
+
+		t0 = vc_time_ms();
+		ok = ms->process(ms->arg, ctx, s, slot->frame, slot->image);
+		dt = vc_time_ms() - t0;
+
+		vc_mutex_lock(&ms->mutex);
+
+		stream->service += dt;
+		stream->stats.busy += dt;
+		slot->ok = ok;
+		slot->state = VC_SLOT_DONE;
+
+		vc_multistream_deliver(ms, s);
+	}
+
+	vc_mutex_unlock(&ms->mutex);
+
+	return 0;
+}
+
+
+// nstreams fontes; nthreads threads de trabalho (<= 0: uma por processador); depth frames em curso por stream
+// (>= 2; quando se esgotam, vc_multistream_acquire() bloqueia). process(arg, ctx, stream, frame, image) corre
+// numa thread de trabalho, com o contexto dessa thread; done(arg, stream, frame, image, ok) recebe as frames
+// de cada stream por ordem (pode ser NULL). Depois de done() a imagem volta ao anel.
+VCMULTISTREAM* vc_multistream_new(int nstreams, int nthreads, int depth, VCFRAMEPROC process, VCFRAMEDONE done, void* arg)
+{
+	VCMULTISTREAM* ms;
+	int s, i;
+
+	if ((nstreams < 1) || (process == NULL)) return NULL;
+	if (nthreads <= 0) nthreads = vc_cpu_count();
+	if (depth < 2) depth = 2;
+
+	// A tabela de despacho  inicializada antes de existirem threads de trabalho
+	vc_cpu_dispatch();
+
+	ms = (VCMULTISTREAM*)calloc(1, sizeof(VCMULTISTREAM));
+	if (ms == NULL) return NULL;
+
+	ms->nstreams = nstreams;
+	ms->depth = depth;
+	ms->process = process;
+	ms->done = done;
+	ms->arg = arg;
+	vc_mutex_init(&ms->mutex);
+	vc_cond_init(&ms->work);
+	vc_cond_init(&ms->state);
+
+	ms->streams = (VCSTREAMSTATE*)calloc(nstreams, sizeof(VCSTREAMSTATE));
+	ms->threads = (vc_thread_t*)malloc(nthreads * sizeof(vc_thread_t));
+	ms->workers = (VCMULTIWORKER*)malloc(nthreads * sizeof(VCMULTIWORKER));
+	ms->contexts = (VCCONTEXT**)calloc(nthreads, sizeof(VCCONTEXT*));
+	if ((ms->streams == NULL) || (ms->threads == NULL) || (ms->workers == NULL) || (ms->contexts == NULL))
+	{
+		return vc_multistream_free(ms);
+	}
+
+	for (s = 0; s < nstreams; s++)
+	{
+		ms->streams[s].slots = (VCSLOT*)calloc(depth, sizeof(VCSLOT));
+		if (ms->streams[s].slots == NULL) return vc_multistream_free(ms);
+	}
+
+	for (i = 0; i < nthreads; i++)
+	{
+		ms->contexts[i] = vc_context_new(1);
+		if (ms->contexts[i] == NULL) return vc_multistream_free(ms);
+		ms->ncontexts++;
+	}
+
+	// Se no for possvel criar todas as threads, fica com as que foram criadas
+	for (i = 0; i < nthreads; i++)
+	{
+		ms->workers[i].ms = ms;
+		ms->workers[i].thread = i;
+
+		if (!vc_thread_create(&ms->threads[i], vc_multistream_worker, &ms->workers[i])) break;
+		ms->nthreads++;
+	}
+
+	if (ms->nthreads == 0) return vc_multistream_free(ms);
+
+	return ms;
+}
+
+
+// Espera que todas as frames submetidas sejam entregues, termina as threads e liberta tudo
+VCMULTISTREAM* vc_multistream_free(VCMULTISTREAM* ms)
+{
+	int s, i;
+
+	if (ms == NULL) return NULL;
+
+	if (ms->nthreads > 0) vc_multistream_wait(ms);
+
+	vc_mutex_lock(&ms->mutex);
+	ms->stop = 1;
+	vc_cond_broadcast(&ms->work);
+	vc_mutex_unlock(&ms->mutex);
+
+	for (i = 0; i < ms->nthreads; i++) vc_thread_join(ms->threads[i]);
+
+	if (ms->contexts != NULL)
+	{
+		for (i = 0; i < ms->ncontexts; i++) vc_context_free(ms->contexts[i]);
+	}
+
+	if (ms->streams != NULL)
+	{
+		for (s = 0; s < ms->nstreams; s++)
+		{
+			if (ms->streams[s].slots == NULL) continue;
+			for (i = 0; i < ms->depth; i++) vc_image_free(ms->streams[s].slots[i].image);
+			free(ms->streams[s].slots);
+		}
+	}
+
+	vc_cond_destroy(&ms->work);
+	vc_cond_destroy(&ms->state);
+	vc_mutex_destroy(&ms->mutex);
+
+	free(ms->streams);
+	free(ms->threads);
+	free(ms->workers);
+	free(ms->contexts);
+	free(ms);
+
+	return NULL;
+}
+
+
+// Prxima frame livre da stream, com as dimenses pedidas; bloqueia enquanto a stream tiver depth frames em curso.
+// O contedo anterior da imagem no  preservado. As frames tm de ser submetidas pela ordem em que foram pedidas.
+IVC* vc_multistream_acquire(VCMULTISTREAM* ms, int stream, int width, int height, int channels)
+{
+	VCSTREAMSTATE* st;
+	VCSLOT* slot;
+
+	if ((ms == NULL) || (stream < 0) || (stream >= ms->nstreams)) return NULL;
+
+	st = &ms->streams[stream];
+
+	vc_mutex_lock(&ms->mutex);
+	while (st->slots[st->acquire].state != VC_SLOT_FREE) vc_cond_wait(&ms->state, &ms->mutex);
+	slot = &st->slots[st->acquire];
+	slot->state = VC_SLOT_FILLING;
+	st->acquire = (st->acquire + 1) % ms->depth;
+	vc_mutex_unlock(&ms->mutex);
+
+	// A imagem do slot s  realocada se as dimenses mudarem
+	if ((slot->image == NULL) || (slot->image->width != width) || (slot->image->height != height) || (slot->image->channels != channels))
+	{
+		vc_image_free(slot->image);
+		slot->image = vc_image_new(width, height, channels, 255);
+	}
+
+	if (slot->image == NULL)
+	{
+		vc_mutex_lock(&ms->mutex);
+		st->acquire = (st->acquire + ms->depth - 1) % ms->depth;
+		slot->state = VC_SLOT_FREE;
+		vc_mutex_unlock(&ms->mutex);
+	}
+
+	return slot->image;
+}
+
+
+// Entrega para processamento a frame obtida com vc_multistream_acquire(); devolve o nmero da frame na stream
+int vc_multistream_submit(VCMULTISTREAM* ms, int stream, IVC* image)
+{
+	VCSTREAMSTATE* st;
+	VCSLOT* slot;
+	int frame, s;
+
+	if ((ms == NULL) || (stream < 0) || (stream >= ms->nstreams) || (image == NULL)) return -1;
+
+	st = &ms->streams[stream];
+
+	vc_mutex_lock(&ms->mutex);
+
+	// As frames so submetidas pela ordem de aquisio
+	slot = &st->slots[st->submit];
+	if ((slot->state != VC_SLOT_FILLING) || (slot->image != image))
+	{
+		vc_mutex_unlock(&ms->mutex);
+		return -1;
+	}
+	st->submit = (st->submit + 1) % ms->depth;
+
+	// Uma stream nova comea com o tempo de servio da menos servida, para no monopolizar as threads
+	if (!st->started)
+	{
+		int first = 1;
+
+		for (s = 0; s < ms->nstreams; s++)
+		{
+			if (!ms->streams[s].started) continue;
+			if (first || (ms->streams[s].service < st->service)) st->service = ms->streams[s].service;
+			first = 0;
+		}
+		st->started = 1;
+		st->tfirst = vc_time_ms();
+	}
+
+	frame = st->nframes++;
+	slot->frame = frame;
+	slot->tsubmit = vc_time_ms();
+	slot->state = VC_SLOT_QUEUED;
+	st->queued++;
+	ms->pending++;
+
+	vc_cond_broadcast(&ms->work);
+	vc_mutex_unlock(&ms->mutex);
+
+	return frame;
+}
+
+
+// Espera que todas as frames submetidas (em todas as streams) tenham sido entregues
+int vc_multistream_wait(VCMULTISTREAM* ms)
+{
+	if (ms == NULL) return 0;
+
+	vc_mutex_lock(&ms->mutex);
+	while (ms->pending > 0) vc_cond_wait(&ms->state, &ms->mutex);
+	vc_mutex_unlock(&ms->mutex);
+
+	return 1;
+}
+
+
+int vc_multistream_stats(VCMULTISTREAM* ms, int stream, VCSTREAMSTATS* stats)
+{
+	VCSTREAMSTATE* st;
+	double elapsed;
+
+	if ((ms == NULL) || (stream < 0) || (stream >= ms->nstreams) || (stats == NULL)) return 0;
+
+	st = &ms->streams[stream];
+
+	vc_mutex_lock(&ms->mutex);
+
+	*stats = st->stats;
+	stats->pending = st->nframes - (int)st->stats.frames;
+	elapsed = st->tlast - st->tfirst;
+	stats->fps = (elapsed > 0.0) ? st->stats.frames * 1000.0 / elapsed : 0.0;
+	stats->latency = (st->stats.frames > 0) ? st->latency / st->stats.frames : 0.0;
+
+	vc_mutex_unlock(&ms->mutex);
+
+	return 1;
+}
+
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//  FUNES: PROCESSAMENTO EM LOTE (PARALELO ENTRE FRAMES)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cada etapa  aplicada a todas as frames do lote antes da etapa seguinte; as frames so
+// distribudas dinamicamente pelas threads (uma frame inteira de cada vez, sem partir linhas).
+
+typedef struct {
+	int (*job)(void* ctx, int index);
+	void* ctx;
+	int n;
+	int next;				// Prxima frame a entregar
+	int failed;
+	vc_mutex_t mutex;
+} VCPARALLEL;
+
+
+#ifdef _WIN32
+static DWORD WINAPI vc_parallel_worker(LPVOID arg)
+#else
+static void* vc_parallel_worker(void* arg)
+#endif
+{
+	VCPARALLEL* par = (VCPARALLEL*)arg;
+	int i;
+
+	for (;;)
+	{
+		vc_mutex_lock(&par->mutex);
+		i = par->next++;
+		vc_mutex_unlock(&par->mutex);
+
+		if (i >= par->n) break;
+
+		if (!par->job(par->ctx, i))
+		{
+			vc_mutex_lock(&par->mutex);
+			par->failed = 1;
+			vc_mutex_unlock(&par->mutex);
+		}
+	}
+
+	return 0;
+}
+
+
+// Executa job(ctx, i) para i em [0, n[ com nthreads threads (<= 0: uma por processador).
+// A thread que chama tambm trabalha. Devolve 0 se algum job falhou.
+static int vc_parallel_for(int n, int nthreads, int (*job)(void* ctx, int index), void* ctx)
+{
+	VCPARALLEL par;
+	vc_thread_t* threads;
+	int nstarted = 0;
+	int i;
+
+	if (n <= 0) return 1;
+	if (nthreads <= 0) nthreads = vc_cpu_count();
+	if (nthreads > n) nthreads = n;
+
+	// A tabela de despacho  inicializada aqui, e no em simultneo por vrias threads
+	vc_cpu_dispatch();
+
+	par.job = job;
+	par.ctx = ctx;
+	par.n = n;
+	par.next = 0;
+	par.failed = 0;
+	vc_mutex_init(&par.mutex);
+
+	threads = (nthreads > 1) ? (vc_thread_t*)malloc((nthreads - 1) * sizeof(vc_thread_t)) : NULL;
+
+	// Se no for possvel criar todas as threads, as restantes frames ficam para as que existem
+	if (threads != NULL)
+	{
+		for (i = 0; i < nthreads - 1; i++)
+		{
+			if (!vc_thread_create(&threads[nstarted], vc_parallel_worker, &par)) break;
+			nstarted++;
+		}
+	}
+
+	vc_parallel_worker(&par);
+
+	for (i = 0; i < nstarted; i++) vc_thread_join(threads[i]);
+
+	free(threads);
+	vc_mutex_destroy(&par.mutex);
+
+	return !par.failed;
+}
+
+
+typedef struct {
+	IVC** src;
+	IVC** dst;
+	VCSTAGE stage;
+	void* param;
+} VCBATCHSTAGE;
+
+static int vc_batch_stage_job(void* ctx, int i)
+{
+	VCBATCHSTAGE* b = (VCBATCHSTAGE*)ctx;
+
+	return b->stage(b->src[i], (b->dst != NULL) ? b->dst[i] : NULL, b->param);
+}
+
+
+// Aplica stage(src[i], dst[i], param) a todas as frames do lote, em paralelo (dst pode ser NULL).
+// Devolve 0 se a etapa falhou em alguma frame.
+int vc_batch_run(IVC** src, IVC** dst, int nframes, VCSTAGE stage, void* param, int nthreads)
+{
+	VCBATCHSTAGE b;
+
+	if (src == NULL || stage == NULL || nframes < 0) return 0;
+
+	b.src = src;
+	b.dst = dst;
+	b.stage = stage;
+	b.param = param;
+
+	return vc_parallel_for(nframes, nthreads, vc_batch_stage_job, &b);
+}
+
+
+// Estado da segmentao HSV em lote
+typedef struct {
+	IVC** frames;
+	IVC** masks;
+	IVCPLANAR* hsv;
+	IVC** seg;
+	int hmin, hmax, smin, smax, vmin, vmax;
+	int kernel;
+	VCCONTEXT* ctx;			// != NULL: jobs nas threads do contexto
+} VCBATCHHSV;
+
+// Definidas com a morfologia binria
+static size_t vc_binary_morph_scratch_size(int width, int kernel);
+static int vc_binary_morph_scratch(IVC* src, IVC* dst, int kernel, unsigned char value, unsigned char* scratch);
+
+static int vc_batch_hsv_job(void* ctx, int i)
+{
+	VCBATCHHSV* b = (VCBATCHHSV*)ctx;
+
+	return vc_rgb_to_hsv_planar(b->frames[i], &b->hsv[i]);
+}
+
+static int vc_batch_segmentation_job(void* ctx, int i)
+{
+	VCBATCHHSV* b = (VCBATCHHSV*)ctx;
+
+	return vc_hsv_segmentation_planar(&b->hsv[i], b->seg[i], b->hmin, b->hmax, b->smin, b->smax, b->vmin, b->vmax);
+}
+
+// Abertura: eroso para o plano H (j no  preciso) e dilatao para a mscara final
+static int vc_batch_open_job(void* ctx, int i)
+{
+	VCBATCHHSV* b = (VCBATCHHSV*)ctx;
+
+	if (!vc_binary_erode(b->seg[i], b->hsv[i].plane[0], b->kernel)) return 0;
+
+	return vc_binary_dilate(b->hsv[i].plane[0], b->masks[i], b->kernel);
+}
+
+// Jobs para as threads do contexto; a abertura usa a memria de trabalho da thread
+static int vc_batch_hsv_job_ctx(void* arg, int i, int thread)
+{
+	return vc_batch_hsv_job(arg, i);
+}
+
+static int vc_batch_segmentation_job_ctx(void* arg, int i, int thread)
+{
+	return vc_batch_segmentation_job(arg, i);
+}
+
+static int vc_batch_open_job_ctx(void* arg, int i, int thread)
+{
+	VCBATCHHSV* b = (VCBATCHHSV*)arg;
+	unsigned char* scratch = (unsigned char*)vc_context_scratch(b->ctx, thread, vc_binary_morph_scratch_size(b->frames[i]->width, b->kernel));
+
+	if (scratch == NULL) return 0;
+
+	return vc_binary_morph_scratch(b->seg[i], b->hsv[i].plane[0], b->kernel, 0, scratch) &&
+		vc_binary_morph_scratch(b->hsv[i].plane[0], b->masks[i], b->kernel, 255, scratch);
+}
+
+
+// Segmentao HSV de um lote de frames RGB: RGB -> HSV planar -> segmentao -> abertura (kernel > 1).
+// Cada etapa corre sobre o lote inteiro, em paralelo entre frames. As imagens intermdias
+// (3 planos HSV e 1 mscara por frame) vm de pool e so devolvidas no fim.
+// masks[i] deve ser uma imagem de 1 canal com as dimenses de frames[i].
+// Com ctx != NULL usa a pool e as threads do contexto (pool e nthreads so ignorados).
+static int vc_batch_hsv_segmentation_run(IVCPOOL* pool, VCCONTEXT* ctx, IVC** frames, IVC** masks, int nframes, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int nthreads)
+{
+	VCBATCHHSV b;
+	int ok = 1;
+	int i, c;
+
+	if (frames == NULL || masks == NULL || nframes < 0) return 0;
+
+	b.frames = frames;
+	b.masks = masks;
+	b.hmin = hmin; b.hmax = hmax;
+	b.smin = smin; b.smax = smax;
+	b.vmin = vmin; b.vmax = vmax;
+	b.kernel = kernel;
+	b.ctx = ctx;
+	b.hsv = (IVCPLANAR*)calloc(MAX2(nframes, 1), sizeof(IVCPLANAR));
+	b.seg = (IVC**)calloc(MAX2(nframes, 1), sizeof(IVC*));
+
+	if (b.hsv == NULL || b.seg == NULL)
+	{
+		free(b.hsv);
+		free(b.seg);
+		return 0;
+	}
+
+	if (ctx != NULL) pool = &ctx->pool;
+
+	// A pool no  partilhada entre threads: as imagens so pedidas e devolvidas aqui
+	for (i = 0; (i < nframes) && ok; i++)
+	{
+		if (frames[i] == NULL || masks[i] == NULL) { ok = 0; break; }
+
+		b.hsv[i].width = frames[i]->width;
+		b.hsv[i].height = frames[i]->height;
+		b.hsv[i].nplanes = 3;
+
+		for (c = 0; c < 3; c++)
+		{
+			b.hsv[i].plane[c] = vc_pool_get(pool, frames[i]->width, frames[i]->height, 1, 255);
+			if (b.hsv[i].plane[c] == NULL) ok = 0;
+		}
+
+		b.seg[i] = (kernel > 1) ? vc_pool_get(pool, frames[i]->width, frames[i]->height, 1, 255) : masks[i];
+		if (b.seg[i] == NULL) ok = 0;
+	}
+
+	if (ctx != NULL)
+	{
+		if (ok) ok = vc_context_parallel_for(ctx, nframes, vc_batch_hsv_job_ctx, &b);
+		if (ok) ok = vc_context_parallel_for(ctx, nframes, vc_batch_segmentation_job_ctx, &b);
+		if (ok && (kernel > 1)) ok = vc_context_parallel_for(ctx, nframes, vc_batch_open_job_ctx, &b);
+	}
+	else
+	{
+		if (ok) ok = vc_parallel_for(nframes, nthreads, vc_batch_hsv_job, &b);
+		if (ok) ok = vc_parallel_for(nframes, nthreads, vc_batch_segmentation_job, &b);
+		if (ok && (kernel > 1)) ok = vc_parallel_for(nframes, nthreads, vc_batch_open_job, &b);
+	}
+
+	for (i = 0; i < nframes; i++)
+	{
+		for (c = 0; c < 3; c++) vc_pool_release(pool, b.hsv[i].plane[c]);
+		if (kernel > 1) vc_pool_release(pool, b.seg[i]);
+	}
+
+	free(b.hsv);
+	free(b.seg);
+
+	return ok;
+}
+
+int vc_batch_hsv_segmentation(IVCPOOL* pool, IVC** frames, IVC** masks, int nframes, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int nthreads)
+{
+	return vc_batch_hsv_segmentation_run(pool, NULL, frames, masks, nframes, hmin, hmax, smin, smax, vmin, vmax, kernel, nthreads);
+}
+
+// Verso com contexto: pool, threads e memria de trabalho do contexto
+int vc_batch_hsv_segmentation_ctx(VCCONTEXT* ctx, IVC** frames, IVC** masks, int nframes, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel)
+{
+	double t0;
+	int ok;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+	ok = vc_batch_hsv_segmentation_run(NULL, ctx, frames, masks, nframes, hmin, hmax, smin, smax, vmin, vmax, kernel, 0);
+	if (ok) ctx->counters.frames += nframes;
+
+	return vc_context_leave(ctx, t0, ok);
+}
+
+
+
+int vc_gray_negative(IVC* srcdst) {
+	unsigned char* data = (unsigned char*)srcdst->data;
+	int width = srcdst->width;
+	int height = srcdst->height;
+	int bytesperline = srcdst->bytesperline;
+	int channels = srcdst->channels;
+	int x, y;
+	long int pos;
+
+	//Verificao de erros
+	if ((srcdst->width <= 0) || (srcdst->height <= 0) || (srcdst->data == NULL)) {
+		return 0;
+	}
+	if (channels != 1) {
+		return 0;
+	}
+
+	//Inverter a Imagem Gray
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			pos = y * bytesperline + x * channels;
+			data[pos] = 255 - data[pos];
+			//data[pos] = srcdst->levels - data[pos];
+		}
+	}
+	return 1;
+}
+
+// Gerar negativo da imagem RGB
+int vc_rgb_negative(IVC* srcdst)
+{
+	unsigned char* data = (unsigned char*)srcdst->data;
+	int width = srcdst->width;
+	int height = srcdst->height;
+	int bytesperline = srcdst->bytesperline;
+	int channels = srcdst->channels;
+	int x, y;
+	long int pos;
+
+	// Verificao de erros
+	if ((srcdst->width <= 0) || (srcdst->height <= 0) || (srcdst->data == NULL)) return 0;
+	if (channels != 3) return 0;
+
+	// Inverte a imagem RGB
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pos = y * bytesperline + x * channels;
+
+			data[pos] = 255 - data[pos];
+			data[pos + 1] = 255 - data[pos + 1];
+			data[pos + 2] = 255 - data[pos + 2];
+		}
+	}
+
+	return 1;
+}
+
+
+
+// Troca os canais 0 e 2 (BGR <-> RGB); src e dst podem ser a mesma imagem
+int vc_bgr_to_rgb(IVC* src, IVC* dst)
+{
+	if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3) || (dst->channels != 3)) return 0;
+
+	for (int y = 0; y < src->height; y++)
+	{
+		unsigned char* data_src = &src->data[y * src->bytesperline];
+		unsigned char* data_dst = &dst->data[y * dst->bytesperline];
+
+		for (int x = 0; x < src->width * 3; x += 3)
+		{
+			unsigned char b = data_src[x];
+
+			data_dst[x + 1] = data_src[x + 1];
+			data_dst[x] = data_src[x + 2];
+			data_dst[x + 2] = b;
+		}
+	}
+
+	return 1;
+}
+
+
+// Converter de RGB para Gray
+int vc_rgb_to_gray(IVC* src, IVC* dst)
+{
+	unsigned char* datasrc = (unsigned char*)src->data;
+	int bytesperline_src = src->bytesperline;
+	int channels_src = src->channels;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int bytesperline_dst = dst->bytesperline;
+	int channels_dst = dst->channels;
+	int width = src->width;
+	int height = src->height;
+	int x, y;
+	long int pos_src, pos_dst;
+	float rf, gf, bf;
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pos_src = y * bytesperline_src + x * channels_src;
+			pos_dst = y * bytesperline_dst + x * channels_dst;
+
+			rf = (float)datasrc[pos_src];
+			gf = (float)datasrc[pos_src + 1];
+			bf = (float)datasrc[pos_src + 2];
+
+			datadst[pos_dst] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
+		}
+	}
+
+	return 1;
+}
+
+
+int vec_rgb_to_hsv(IVC* src, IVC* dst)
+{
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3 || dst->channels != 3)) return 0;
+
+	int size = src->width * src->channels;
+
+	for (int y = 0; y < src->height; y++)
+	{
+		unsigned char* data_src = &src->data[y * src->bytesperline];
+		unsigned char* data_dst = &dst->data[y * dst->bytesperline];
+
+		for (int i = 0; i < size; i += 3)
+		{
+			float r = data_src[i] / 255.0f;
+			float g = data_src[i + 1] / 255.0f;
+			float b = data_src[i + 2] / 255.0f;
+
+
+			float max = MAX3(r, g, b);
+			float min = MIN3(r, g, b);
+			float delta = max - min;
+			float h = 0, s = 0, v = max;
+
+			if (delta > 0)
+			{
+				if (max == r)
+				{
+					h = 60 * fmodf(((g - b) / delta), 6);
+				}
+				else if (max == g)
+				{
+					h = 60 * (((b - r) / delta) + 2);
+				}
+				else
+				{
+					h = 60 * (((r - g) / delta) + 4);
+				}
+
+				if (h < 0)
+					h += 360;
+
+				s = max == 0 ? 0 : (delta / max);
+			}
+
+			data_dst[i] = (unsigned char)(h / 2);          // Convertendo H para 0-255
+			data_dst[i + 1] = (unsigned char)(s * 255);   // Convertendo S para 0-255
+			data_dst[i + 2] = (unsigned char)(v * 255);   // Convertendo V para 0-255
+		}
+	}
+	return 1;
+}
+
+
+
+int vc_rgb_to_hsv(IVC* src, IVC* dst)
+{
+	if (src == NULL || dst == NULL)
+	{
+		return 0;
+	}
+
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3 || dst->channels != 3))
+	{
+		return 0;
+	}
+
+	const VCCPUDISPATCH* cpu = vc_cpu_dispatch();
+
+	for (int y = 0; y < src->height; y++)
+	{
+		unsigned char* data_src = &src->data[y * src->bytesperline];
+		unsigned char* data_dst = &dst->data[y * dst->bytesperline];
+
+		cpu->rgb_to_hsv_row(data_src, &data_dst[0], &data_dst[1], &data_dst[2], src->width, 3);
+	}
+
+	return 1;
+}
+
+
+// Escreve H, S e V em planos separados (dst->plane[0], [1] e [2])
+int vc_rgb_to_hsv_planar(IVC* src, IVCPLANAR* dst)
+{
+	if (src == NULL || src->channels != 3) return 0;
+	if (!vc_planar_check(src, dst)) return 0;
+
+	const VCCPUDISPATCH* cpu = vc_cpu_dispatch();
+
+	for (int y = 0; y < src->height; y++)
+	{
+		unsigned char* data_src = &src->data[y * src->bytesperline];
+		unsigned char* data_h = &dst->plane[0]->data[y * dst->plane[0]->bytesperline];
+		unsigned char* data_s = &dst->plane[1]->data[y * dst->plane[1]->bytesperline];
+		unsigned char* data_v = &dst->plane[2]->data[y * dst->plane[2]->bytesperline];
+
+		cpu->rgb_to_hsv_row(data_src, data_h, data_s, data_v, src->width, 1);
+	}
+
+	return 1;
+}
+
+
+// Segmenta apenas o rectngulo [x0,x1[ x [y0,y1[ (os restantes pixis de dst no so alterados)
+static void vc_hsv_segmentation_rect(IVC* src, IVC* dst, int x0, int y0, int x1, int y1, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	int bytesperline = src->bytesperline;
+	unsigned char* data_src = src->data;
+	unsigned char* data_dst = dst->data;
+
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			int pos = y * bytesperline + x * src->channels;
+
+			// Obter os valores HSV da imagem de entrada
+			float h = data_src[pos] * 2;     // H: 0-360 graus
+			float s = data_src[pos + 1] / 255.0 * 100; // S: 0-100 %
+			float v = data_src[pos + 2] / 255.0 * 100; // V: 0-100 %
+
+			// Verificar se está dentro do intervalo
+			if ((h >= hmin && h <= hmax) && (s >= smin && s <= smax) && (v >= vmin && v <= vmax)) {
+				data_dst[y * dst->bytesperline + x] = 255; // Branco
+			}
+			else {
+				data_dst[y * dst->bytesperline + x] = 0;   // Preto
+			}
+		}
+	}
+}
+
+// hmin,hmax = [0, 360]; smin,smax = [0, 100]; vmin,vmax = [0, 100]
+int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3)) return 0;
+
+	vc_hsv_segmentation_rect(src, dst, 0, 0, src->width, src->height, hmin, hmax, smin, smax, vmin, vmax);
+
+	return 1;
+}
+
+
+// Intervalo [lo, hi] de bytes de um canal HSV que cai em [vmin, vmax], com as mesmas
+// converses de vc_hsv_segmentation() (canal 0: H em graus; 1 e 2: S e V em %).
+// Como as converses so montonas, o conjunto aceite  sempre um intervalo (vazio se lo > hi).
+static void vc_hsv_byte_range(int channel, int vmin, int vmax, int* lo, int* hi)
+{
+	*lo = 256;
+	*hi = -1;
+
+	for (int i = 0; i < 256; i++)
+	{
+		float value = (channel == 0) ? (float)(i * 2) : (float)(i / 255.0 * 100);
+
+		if (value >= vmin && value <= vmax)
+		{
+			if (*lo > i) *lo = i;
+			*hi = i;
+		}
+	}
+}
+
+
+// hmin,hmax = [0, 360]; smin,smax = [0, 100]; vmin,vmax = [0, 100]
+// Cada plano  comparado com um intervalo de bytes, em blocos contguos (SSE2/AVX2/AVX-512)
+int vc_hsv_segmentation_planar(IVCPLANAR* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	int lo[3], hi[3];
+
+	if (src == NULL || dst == NULL || src->nplanes != 3) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 1)) return 0;
+	for (int c = 0; c < 3; c++)
+	{
+		if (src->plane[c] == NULL || src->plane[c]->width != src->width || src->plane[c]->height != src->height) return 0;
+	}
+
+	vc_hsv_byte_range(0, hmin, hmax, &lo[0], &hi[0]);
+	vc_hsv_byte_range(1, smin, smax, &lo[1], &hi[1]);
+	vc_hsv_byte_range(2, vmin, vmax, &lo[2], &hi[2]);
+
+	int empty = (lo[0] > hi[0]) || (lo[1] > hi[1]) || (lo[2] > hi[2]);
+	const VCCPUDISPATCH* cpu = vc_cpu_dispatch();
+
+	for (int y = 0; y < dst->height; y++)
+	{
+		unsigned char* data_h = &src->plane[0]->data[y * src->plane[0]->bytesperline];
+		unsigned char* data_s = &src->plane[1]->data[y * src->plane[1]->bytesperline];
+		unsigned char* data_v = &src->plane[2]->data[y * src->plane[2]->bytesperline];
+		unsigned char* data_dst = &dst->data[y * dst->bytesperline];
+
+		if (empty)
+		{
+			memset(data_dst, 0, dst->width);
+			continue;
+		}
+
+		cpu->hsv_range_row(data_h, data_s, data_v, data_dst, dst->width, lo, hi);
+	}
+
+	return 1;
+}
+
+
+int vc_scale_gray_to_color_palette(IVC* src, IVC* dst)
+{
+	if (src == NULL || dst == NULL)
+		return 0;
+	if (src->width != dst->width || src->height != dst->height || src->channels != 1 || dst->channels != 3)
+		return 0;
+
+	int width = src->width;
+	int height = src->height;
+	unsigned char* gray_data = src->data;
+	unsigned char* color_data = dst->data;
+
+	int r, g, b;
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int i = y * src->bytesperline + x;
+			int o = y * dst->bytesperline + x * 3;
+			unsigned char gray = gray_data[i];
+
+			if (gray >= 0 && gray < 64) {
+				r = 255;
+				g = gray * 4;
+				b = 0;
+			}
+			else if (gray >= 64 && gray < 128) {
+				r = 255 - (gray - 64) * 4;
+				g = 255;
+				b = 0;
+			}
+			else if (gray >= 128 && gray < 193) {
+				r = 0;
+				g = 255;
+				b = (gray - 128) * 4;
+			}
+			else {
+				r = 0;
+				g = 255 - (gray - 193) * 4;
+				b = 255;
+			}
+
+			color_data[o] = b;
+			color_data[o + 1] = g;
+			color_data[o + 2] = r;
+		}
+	}
+
+	return 1;
+}
+
+// Binariza uma linha: dst[x] = (src[x] > threshold) ? 255 : 0
+static void vc_threshold_row(const unsigned char* src, unsigned char* dst, int n, int threshold)
+{
+	if (threshold < 0) {
+		memset(dst, 255, n);
+		return;
+	}
+	if (threshold >= 255) {
+		memset(dst, 0, n);
+		return;
+	}
+
+	vc_cpu_dispatch()->threshold_row(src, dst, n, threshold);
+}
+
+int vc_gray_to_binary(IVC* src, IVC* dst, int threshold) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	for (int y = 0; y < src->height; y++) {
+		vc_threshold_row(&src->data[y * src->bytesperline], &dst->data[y * dst->bytesperline], src->width, threshold);
+	}
+
+	return 1;
+}
+
+// Threshold = mdia global, obtida do histograma (uma passagem pela imagem + O(256))
+int vc_gray_to_binary_global_mean(IVC* src, IVC* dst) {
+	int hist[256];
+
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	if (vc_gray_histogram(src, hist) == 0) return 0;
+
+	return vc_gray_to_binary(src, dst, vc_histogram_mean(hist));
+}
+
+// Threshold de Otsu (maximiza a varincia entre classes), obtido do histograma em O(256)
+int vc_gray_to_binary_otsu(IVC* src, IVC* dst) {
+	int hist[256];
+
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	if (vc_gray_histogram(src, hist) == 0) return 0;
+
+	return vc_gray_to_binary(src, dst, vc_histogram_otsu(hist));
+}
+
+// Mnimo (ismax = 0) ou mximo (ismax = 1) numa janela deslizante 1D de raio r (algoritmo de van Herk/Gil-Werman).
+// Custo O(1) por elemento, independente do tamanho da janela. A janela  cortada nos limites,
+// tal como na verso por fora bruta (os elementos fora do array no contam).
+// buf deve ter espao para 3 * (n + 4 * r + 1) elementos.
+static void vc_sliding_extreme(const unsigned char* in, int n, int instep, int r, int ismax, unsigned char* out, int outstep, unsigned char* buf)
+{
+	int k = 2 * r + 1;
+	int len = ((n + 2 * r + k - 1) / k) * k;
+	unsigned char neutral = ismax ? 0 : 255;
+	unsigned char* p = buf;
+	unsigned char* g = p + len;
+	unsigned char* h = g + len;
+	int i;
+
+	// Preenchimento com o elemento neutro fora do array
+	for (i = 0; i < len; i++)
+	{
+		p[i] = ((i >= r) && (i < r + n)) ? in[(i - r) * instep] : neutral;
+	}
+
+	// Prefixos (g) e sufixos (h) dentro de cada bloco de k elementos
+	for (i = 0; i < len; i++)
+	{
+		if (i % k == 0) g[i] = p[i];
+		else g[i] = ismax ? MAX2(g[i - 1], p[i]) : MIN2(g[i - 1], p[i]);
+	}
+	for (i = len - 1; i >= 0; i--)
+	{
+		if (i % k == k - 1) h[i] = p[i];
+		else h[i] = ismax ? MAX2(h[i + 1], p[i]) : MIN2(h[i + 1], p[i]);
+	}
+
+	// A janela [i, i+k-1] (em coordenadas com preenchimento) cobre no mximo dois blocos
+	for (i = 0; i < n; i++)
+	{
+		out[i * outstep] = ismax ? MAX2(h[i], g[i + k - 1]) : MIN2(h[i], g[i + k - 1]);
+	}
+}
+
+// Threshold local pelo ponto mdio (min + max) / 2 da vizinhana kernel x kernel.
+// Min/max calculados de forma separvel (linhas e depois colunas) com janelas deslizantes.
+int vc_gray_to_binary_midpoint(IVC* src, IVC* dst, int kernel) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) ||
+		(src->channels != 1) || (dst->channels != 1)) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	unsigned char* data_src = src->data;
+	unsigned char* data_dst = dst->data;
+	int half_kernel = kernel / 2;
+	int n = MAX2(width, height);
+	unsigned char* rowmin = (unsigned char*)malloc(width * height);
+	unsigned char* rowmax = (unsigned char*)malloc(width * height);
+	unsigned char* colmin = (unsigned char*)malloc(height);
+	unsigned char* colmax = (unsigned char*)malloc(height);
+	unsigned char* buf = (unsigned char*)malloc(3 * (n + 4 * half_kernel + 1));
+
+	if (rowmin == NULL || rowmax == NULL || colmin == NULL || colmax == NULL || buf == NULL) {
+		free(rowmin);
+		free(rowmax);
+		free(colmin);
+		free(colmax);
+		free(buf);
+		return 0;
+	}
+
+	// Passo 1: min/max horizontal
+	for (int y = 0; y < height; y++) {
+		vc_sliding_extreme(&data_src[y * src->bytesperline], width, 1, half_kernel, 0, &rowmin[y * width], 1, buf);
+		vc_sliding_extreme(&data_src[y * src->bytesperline], width, 1, half_kernel, 1, &rowmax[y * width], 1, buf);
+	}
+
+	// Passo 2: min/max vertical sobre o resultado horizontal, e binarizao
+	for (int x = 0; x < width; x++) {
+		vc_sliding_extreme(&rowmin[x], height, width, half_kernel, 0, colmin, 1, buf);
+		vc_sliding_extreme(&rowmax[x], height, width, half_kernel, 1, colmax, 1, buf);
+
+		for (int y = 0; y < height; y++) {
+			int threshold = (colmin[y] + colmax[y]) / 2;
+
+			// Aplica a binarizao
+			if (data_src[y * src->bytesperline + x] > threshold) {
+				data_dst[y * dst->bytesperline + x] = 255;
+			}
+			else {
+				data_dst[y * dst->bytesperline + x] = 0;
+			}
+		}
+	}
+
+	free(rowmin);
+	free(rowmax);
+	free(colmin);
+	free(colmax);
+	free(buf);
+
+	return 1;
+}
+
+
+// Imagem integral (summed-area table) de src e, opcionalmente (sqsum != NULL), dos quadrados.
+// sum e sqsum tm (width + 1) x (height + 1) elementos, com a primeira linha e coluna a 0.
+static void vc_gray_integral(IVC* src, unsigned int* sum, unsigned long long* sqsum)
+{
+	int width = src->width;
+	int height = src->height;
+	int stride = width + 1;
+
+	memset(sum, 0, stride * sizeof(unsigned int));
+	if (sqsum != NULL) memset(sqsum, 0, stride * sizeof(unsigned long long));
+
+	for (int y = 0; y < height; y++) {
+		unsigned char* row = &src->data[y * src->bytesperline];
+		unsigned int rowsum = 0;
+		unsigned long long rowsqsum = 0;
+
+		sum[(y + 1) * stride] = 0;
+		if (sqsum != NULL) sqsum[(y + 1) * stride] = 0;
+
+		for (int x = 0; x < width; x++) {
+			rowsum += row[x];
+			sum[(y + 1) * stride + x + 1] = sum[y * stride + x + 1] + rowsum;
+
+			if (sqsum != NULL) {
+				rowsqsum += (unsigned int)row[x] * row[x];
+				sqsum[(y + 1) * stride + x + 1] = sqsum[y * stride + x + 1] + rowsqsum;
+			}
+		}
+	}
+}
+
+// Threshold adaptativo com custo por pixel independente do tamanho do kernel.
+// mode = VC_THRESHOLD_MEAN    : Bradley; pixel a 255 se for maior que mdia local * (1 - k), k em [0, 1[ (ex.: 0.15)
+// mode = VC_THRESHOLD_SAUVOLA : Sauvola; T = mdia * (1 + k * (desvio padro / 128 - 1)), k tipicamente 0.2 a 0.5
+// mode = VC_THRESHOLD_MIDPOINT: (min + max) / 2 local, igual a vc_gray_to_binary_midpoint() (k  ignorado)
+int vc_gray_to_binary_adaptive(IVC* src, IVC* dst, int kernel, int mode, float k) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) ||
+		(src->channels != 1) || (dst->channels != 1)) return 0;
+	if (kernel < 1) return 0;
+
+	if (mode == VC_THRESHOLD_MIDPOINT) return vc_gray_to_binary_midpoint(src, dst, kernel);
+	if ((mode != VC_THRESHOLD_MEAN) && (mode != VC_THRESHOLD_SAUVOLA)) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	int stride = width + 1;
+	int half_kernel = kernel / 2;
+	unsigned char* data_src = src->data;
+	unsigned char* data_dst = dst->data;
+	unsigned int* sum = (unsigned int*)malloc(stride * (height + 1) * sizeof(unsigned int));
+	unsigned long long* sqsum = NULL;
+
+	if (sum == NULL) return 0;
+
+	if (mode == VC_THRESHOLD_SAUVOLA) {
+		sqsum = (unsigned long long*)malloc(stride * (height + 1) * sizeof(unsigned long long));
+		if (sqsum == NULL) {
+			free(sum);
+			return 0;
+		}
+	}
+
+	vc_gray_integral(src, sum, sqsum);
+
+	for (int y = 0; y < height; y++) {
+		// Janela cortada nos limites da imagem
+		int y0 = MAX2(y - half_kernel, 0);
+		int y1 = MIN2(y + half_kernel + 1, height);
+
+		for (int x = 0; x < width; x++) {
+			int x0 = MAX2(x - half_kernel, 0);
+			int x1 = MIN2(x + half_kernel + 1, width);
+			int count = (x1 - x0) * (y1 - y0);
+
+			// Soma da janela em O(1): D - B - C + A
+			unsigned int s = sum[y1 * stride + x1] - sum[y0 * stride + x1] - sum[y1 * stride + x0] + sum[y0 * stride + x0];
+			float mean = (float)s / count;
+			float threshold;
+
+			if (mode == VC_THRESHOLD_MEAN) {
+				threshold = mean * (1.0f - k);
+			}
+			else {
+				unsigned long long sq = sqsum[y1 * stride + x1] - sqsum[y0 * stride + x1] - sqsum[y1 * stride + x0] + sqsum[y0 * stride + x0];
+				float var = (float)sq / count - mean * mean;
+				float stddev = (var > 0.0f) ? sqrtf(var) : 0.0f;
+
+				threshold = mean * (1.0f + k * (stddev / 128.0f - 1.0f));
+			}
+
+			// Aplica a binarizao
+			if (data_src[y * src->bytesperline + x] > threshold) {
+				data_dst[y * dst->bytesperline + x] = 255;
+			}
+			else {
+				data_dst[y * dst->bytesperline + x] = 0;
+			}
+		}
+	}
+
+	free(sum);
+	free(sqsum);
+
+	return 1;
+}
+
+
+//Operadores morfologicos
+/*int vc_binary_dilate(IVC* src, IVC* dst, int kernel) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	unsigned char* data_src = src->data;
+	unsigned char* data_dst = dst->data;
+	int half_kernel = kernel / 2;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int pos = y * width + x;
+			int found_white = 0;
+
+			// Percorre a vizinhana
+			for (int ky = -half_kernel; ky <= half_kernel; ky++) {
+				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
+					int ny = y + ky;
+					int nx = x + kx;
+
+					// Verifica se est dentro da imagem
+					if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
+						int neighbor_pos = ny * width + nx;
+						if (data_src[neighbor_pos] == 255) {
+							found_white = 1;
+						}
+					}
+				}
+			}
+
+			// Aplica a dilatao
+			data_dst[pos] = found_white ? 255 : 0;
+		}
+	}
+
+	return 1;
+}
+
+int vc_binary_erode(IVC* src, IVC* dst, int kernel) {
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	unsigned char* data_src = src->data;
+	unsigned char* data_dst = dst->data;
+	int half_kernel = kernel / 2;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int pos = y * width + x;
+			int found_black = 0;
+
+			// Percorre a vizinhana
+			for (int ky = -half_kernel; ky <= half_kernel; ky++) {
+				for (int kx = -half_kernel; kx <= half_kernel; kx++) {
+					int ny = y + ky;
+					int nx = x + kx;
+
+					// Verifica se est dentro da imagem
+					if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
+						int neighbor_pos = ny * width + nx;
+						if (data_src[neighbor_pos] == 0) {
+							found_black = 1;
+						}
+					}
+				}
+			}
+
+			// Aplica a eroso
+			data_dst[pos] = found_black ? 0 : 255;
+		}
+	}
+
+	return 1;
+}
+*/
+
+// Memria de trabalho de vc_binary_morph_scratch(): anel de n linhas e n apontadores
+static size_t vc_binary_morph_scratch_size(int width, int kernel)
+{
+	int n = 2 * (kernel / 2) + 1;
+
+	return (size_t)n * width + n * sizeof(unsigned char*);
+}
+
+// Eroso (value = 0) ou dilatao (value = 255): um pixel interior fica a value se algum vizinho
+// da janela kernel x kernel for igual a value, seno a 255 - value. Os rebordos ficam iguais a src.
+// Separvel: passo horizontal para um anel de kernel linhas e passo vertical sobre o anel (kernels vc_cpu).
+// scratch: vc_binary_morph_scratch_size() bytes, alinhado para apontadores
+static int vc_binary_morph_scratch(IVC* src, IVC* dst, int kernel, unsigned char value, unsigned char* scratch)
+{
+	if (src == NULL || dst == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+	if (kernel < 1) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	int half_kernel = kernel / 2;
+	int n = 2 * half_kernel + 1;
+	const VCCPUDISPATCH* cpu = vc_cpu_dispatch();
+
+	// Copia original (rebordos)
+	for (int y = 0; y < height; y++) {
+		memcpy(&dst->data[y * dst->bytesperline], &src->data[y * src->bytesperline], width);
+	}
+
+	if ((width < n) || (height < n)) return 1;
+
+	unsigned char** rows = (unsigned char**)scratch;
+	unsigned char* ring = scratch + n * sizeof(unsigned char*);
+
+	// A linha y do passo horizontal fica em ring[y % n]
+	for (int y = 0; y < n - 1; y++) {
+		cpu->morph_hrow(&src->data[y * src->bytesperline], &ring[(y % n) * width], width, half_kernel, value);
+	}
+
+	// O OR vertical no depende da ordem das linhas: o anel inteiro  a janela
+	for (int j = 0; j < n; j++) rows[j] = &ring[j * width];
+
+	for (int y = half_kernel; y < height - half_kernel; y++) {
+		int last = y + half_kernel;
+
+		cpu->morph_hrow(&src->data[last * src->bytesperline], &ring[(last % n) * width], width, half_kernel, value);
+		cpu->morph_vrows(rows, n, &dst->data[y * dst->bytesperline], half_kernel, width - half_kernel, value);
+	}
+
+	return 1;
+}
+
+static int vc_binary_morph(IVC* src, IVC* dst, int kernel, unsigned char value)
+{
+	unsigned char* scratch;
+	int ok;
+
+	if (src == NULL || kernel < 1) return 0;
+
+	scratch = (unsigned char*)malloc(vc_binary_morph_scratch_size(src->width, kernel));
+	if (scratch == NULL) return 0;
+
+	ok = vc_binary_morph_scratch(src, dst, kernel, value, scratch);
+
+	free(scratch);
+
+	return ok;
+}
+
+int vc_binary_erode(IVC* src, IVC* dst, int kernel) {
+	return vc_binary_morph(src, dst, kernel, 0);
+}
+
+int vc_binary_dilate(IVC* src, IVC* dst, int kernel) {
+	return vc_binary_morph(src, dst, kernel, 255);
+}
+
+int vc_binary_open(IVC* src, IVC* dst, int kernel) {
+
+	IVC* imagefun[2];
+
+	//erosao
+	if (vc_binary_erode(src, dst, kernel) == 1) {
+		printf("Erosao feita com sucesso\n");
+	}
+	else
+	{
+		printf("Erro na erosao\n");
+	}
+
+	imagefun[0] = vc_image_new(src->width, src->height, src->channels, src->levels);
+	if (imagefun[0] == NULL)
+	{
+		printf("ERROR -> vc_image_new(): \n\nMemory allocation failed!\n");
+		vc_image_free(imagefun[0]);
+		getchar();
+		return 0;
+	}
+
+	//dilatacao
+	if (vc_binary_dilate(dst, imagefun[0], kernel) == 1) {
+		printf("Dilatacao feita com sucesso\n");
+	}
+	else
+	{
+		printf("Erro na dilatacao\n");
+	}
+
+	dst = imagefun[0];
+
+	return 1;
+}
+
+int vc_binary_close(IVC* src, IVC* dst, int kernel) {
+
+	IVC* imagefun[2];
+
+	//erosao
+	if (vc_binary_dilate(src, dst, kernel) == 1) {
+		printf("Dilatacao feita com sucesso\n");
+	}
+	else
+	{
+		printf("Erro na dilatacao\n");
+	}
+
+	imagefun[0] = vc_image_new(src->width, src->height, src->channels, src->levels);
+	if (imagefun[0] == NULL)
+	{
+		printf("ERROR -> vc_image_new(): \n\nMemory allocation failed!\n");
+		vc_image_free(imagefun[0]);
+		getchar();
+		return 0;
+	}
+
+	//dilatacao
+	if (vc_binary_erode(dst, imagefun[0], kernel) == 1) {
+		printf("erosao feita com sucesso\n");
+	}
+	else
+	{
+		printf("Erro na erosao\n");
+	}
+
+	dst = imagefun[0];
+
+	return 1;
+}
+
+
+// Morfologia com a memria de trabalho da thread 0 do contexto
+static int vc_binary_morph_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel, unsigned char value)
+{
+	unsigned char* scratch;
+
+	if ((src == NULL) || (kernel < 1)) return 0;
+
+	scratch = (unsigned char*)vc_context_scratch(ctx, 0, vc_binary_morph_scratch_size(src->width, kernel));
+	if (scratch == NULL) return 0;
+
+	return vc_binary_morph_scratch(src, dst, kernel, value, scratch);
+}
+
+// Eroso seguida de dilatao (value = 0) ou o inverso (value = 255), com intermdio da pool do contexto
+static int vc_binary_morph2_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel, unsigned char value)
+{
+	IVC* tmp;
+	int ok;
+
+	if ((src == NULL) || (dst == NULL)) return 0;
+
+	tmp = vc_context_image_get(ctx, src->width, src->height, 1, src->levels);
+	if (tmp == NULL) return 0;
+
+	ok = vc_binary_morph_ctx(ctx, src, tmp, kernel, value) && vc_binary_morph_ctx(ctx, tmp, dst, kernel, 255 - value);
+
+	vc_context_image_release(ctx, tmp);
+
+	return ok;
+}
+
+int vc_binary_erode_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel)
+{
+	double t0;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+
+	return vc_context_leave(ctx, t0, vc_binary_morph_ctx(ctx, src, dst, kernel, 0));
+}
+
+int vc_binary_dilate_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel)
+{
+	double t0;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+
+	return vc_context_leave(ctx, t0, vc_binary_morph_ctx(ctx, src, dst, kernel, 255));
+}
+
+int vc_binary_open_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel)
+{
+	double t0;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+
+	return vc_context_leave(ctx, t0, vc_binary_morph2_ctx(ctx, src, dst, kernel, 0));
+}
+
+int vc_binary_close_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel)
+{
+	double t0;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+
+	return vc_context_leave(ctx, t0, vc_binary_morph2_ctx(ctx, src, dst, kernel, 255));
+}
+
+
+// Blobs e Etiquetagem
+//int vc_binary_blob_labelling(IVC* src, IVC* dst) {
+//	if (!src || !dst || !src->data || !dst->data) return -1;
+//
+//	// Copiar os dados da imagem fonte para a imagem destino (considerando bytesperline)
+//	memcpy(dst->data, src->data, src->bytesperline * src->height);
+//
+//	int label = 1;
+//
+//	for (int y = 1; y < dst->height - 1; y++) { // Evita acessar fora da memria
+//		for (int x = 1; x < dst->width - 1; x++) {
+//			int posX = y * dst->bytesperline + x;
+//			int posA = (y - 1) * dst->bytesperline + (x - 1);
+//			int posB = (y - 1) * dst->bytesperline + x;
+//			int posC = (y - 1) * dst->bytesperline + (x + 1);
+//			int posD = y * dst->bytesperline + (x - 1);
+//
+//			if (dst->data[posX] == 255) {
+//				int min_label = 255;
+//
+//				// Encontrar o menor rtulo vizinho
+//				if (dst->data[posA] > 0 && dst->data[posA] < min_label) min_label = dst->data[posA];
+//				if (dst->data[posB] > 0 && dst->data[posB] < min_label) min_label = dst->data[posB];
+//				if (dst->data[posC] > 0 && dst->data[posC] < min_label) min_label = dst->data[posC];
+//				if (dst->data[posD] > 0 && dst->data[posD] < min_label) min_label = dst->data[posD];
+//
+//				if (min_label == 255) { // Nenhum vizinho rotulado
+//					dst->data[posX] = label;
+//					label++;
+//					if (label > 254) label = 254; // Evita estouro
+//				}
+//				else {
+//					dst->data[posX] = min_label;
+//				}
+//			}
+//			else {
+//				dst->data[posX] = 0;
+//			}
+//		}
+//	}
+//
+//	return 1; // Sucesso
+//}
+
+// Etiquetagem de blobs (algoritmo comum a vc_binary_blob_labelling() e vc_binary_blob_labelling_ctx())
+// labeltable	: Tabela de equivalncias com 256 entradas, a zeros; no fim contm as etiquetas dos blobs em [0, nlabels[
+// Devolve o nmero de etiquetas encontradas, ou -1 em caso de erro.
+static int vc_binary_blob_label(IVC* src, IVC* dst, int* labeltable)
+{
+	unsigned char* datasrc = (unsigned char*)src->data;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = dst->bytesperline;
+	int channels = src->channels;
+	int x, y, a, b;
+	long int i, size;
+	long int posX, posA, posB, posC, posD;
+	int label = 1; // Etiqueta inicial.
+	int num, tmplabel;
+	int nlabels;
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return -1;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return -1;
+	if (channels != 1) return -1;
+
+	// Copia dados da imagem binria para imagem grayscale
+	for (y = 0; y < height; y++)
+	{
+		memcpy(&datadst[y * bytesperline], &datasrc[y * src->bytesperline], width * channels);
+	}
+
+	// Todos os pixis de plano de fundo devem obrigatriamente ter valor 0
+	// Todos os pixis de primeiro plano devem obrigatriamente ter valor 255
+	// Sero atribudas etiquetas no intervalo [1,254]
+	// Este algoritmo est assim limitado a 254 labels
+	for (i = 0, size = bytesperline * height; i < size; i++)
+	{
+		if (datadst[i] != 0) datadst[i] = 255;
+	}
+
+	// Limpa os rebordos da imagem binria
+	for (y = 0; y < height; y++)
+	{
+		datadst[y * bytesperline + 0 * channels] = 0;
+		datadst[y * bytesperline + (width - 1) * channels] = 0;
+	}
+	for (x = 0; x < width; x++)
+	{
+		datadst[0 * bytesperline + x * channels] = 0;
+		datadst[(height - 1) * bytesperline + x * channels] = 0;
+	}
+
+	// Efectua a etiquetagem
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			// Kernel:
+			// A B C
+			// D X
+
+			posA = (y - 1) * bytesperline + (x - 1) * channels; // A
+			posB = (y - 1) * bytesperline + x * channels; // B
+			posC = (y - 1) * bytesperline + (x + 1) * channels; // C
+			posD = y * bytesperline + (x - 1) * channels; // D
+			posX = y * bytesperline + x * channels; // X
+
+			// Se o pixel foi marcado
+			if (datadst[posX] != 0)
+			{
+				if ((datadst[posA] == 0) && (datadst[posB] == 0) && (datadst[posC] == 0) && (datadst[posD] == 0))
+				{
+					// Esgotaram-se as etiquetas disponveis
+					if (label > 254)
+					{
+#ifdef VC_DEBUG
+						printf("ERROR -> vc_binary_blob_labelling():\n\tmais de 254 etiquetas!\n");
+#endif
+						return -1;
+					}
+
+					datadst[posX] = label;
+					labeltable[label] = label;
+					label++;
+				}
+				else
+				{
+					num = 255;
+
+					// Se A est marcado
+					if (datadst[posA] != 0) num = labeltable[datadst[posA]];
+					// Se B est marcado, e  menor que a etiqueta "num"
+					if ((datadst[posB] != 0) && (labeltable[datadst[posB]] < num)) num = labeltable[datadst[posB]];
+					// Se C est marcado, e  menor que a etiqueta "num"
+					if ((datadst[posC] != 0) && (labeltable[datadst[posC]] < num)) num = labeltable[datadst[posC]];
+					// Se D est marcado, e  menor que a etiqueta "num"
+					if ((datadst[posD] != 0) && (labeltable[datadst[posD]] < num)) num = labeltable[datadst[posD]];
+
+					// Atribui a etiqueta ao pixel
+					datadst[posX] = num;
+					labeltable[num] = num;
+
+					// Actualiza a tabela de etiquetas
+					if (datadst[posA] != 0)
+					{
+						if (labeltable[datadst[posA]] != num)
+						{
+							for (tmplabel = labeltable[datadst[posA]], a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = num;
+								}
+							}
+						}
+					}
+					if (datadst[posB] != 0)
+					{
+						if (labeltable[datadst[posB]] != num)
+						{
+							for (tmplabel = labeltable[datadst[posB]], a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = num;
+								}
+							}
+						}
+					}
+					if (datadst[posC] != 0)
+					{
+						if (labeltable[datadst[posC]] != num)
+						{
+							for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = num;
+								}
+							}
+						}
+					}
+					if (datadst[posD] != 0)
+					{
+						if (labeltable[datadst[posD]] != num)
+						{
+							for (tmplabel = labeltable[datadst[posD]], a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = num;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Volta a etiquetar a imagem
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			posX = y * bytesperline + x * channels; // X
+
+			if (datadst[posX] != 0)
+			{
+				datadst[posX] = labeltable[datadst[posX]];
+			}
+		}
+	}
+
+	//printf("\nMax Label = %d\n", label);
+
+	// Contagem do nmero de blobs
+	// Passo 1: Eliminar, da tabela, etiquetas repetidas
+	for (a = 1; a < label - 1; a++)
+	{
+		for (b = a + 1; b < label; b++)
+		{
+			if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
+		}
+	}
+	// Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que no hajam valores vazios (zero) entre etiquetas
+	nlabels = 0;
+	for (a = 1; a < label; a++)
+	{
+		if (labeltable[a] != 0)
+		{
+			labeltable[nlabels] = labeltable[a]; // Organiza tabela de etiquetas
+			nlabels++; // Conta etiquetas
+		}
+	}
+
+	return nlabels;
+}
+
+
+// Etiquetagem de blobs
+// src		: Imagem binria de entrada
+// dst		: Imagem grayscale (ir conter as etiquetas)
+// nlabels	: Endereo de memria de uma varivel, onde ser armazenado o nmero de etiquetas encontradas.
+// OVC*		: Retorna um array de estruturas de blobs (objectos), com respectivas etiquetas.  necessrio libertar posteriormente esta memria.
+OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
+{
+	int labeltable[256] = { 0 };
+	OVC* blobs; // Apontador para array de blobs (objectos) que ser retornado desta funo.
+	int a;
+
+	*nlabels = vc_binary_blob_label(src, dst, labeltable);
+
+	// Se no h blobs (ou em caso de erro)
+	if (*nlabels <= 0)
+	{
+		*nlabels = 0;
+		return NULL;
+	}
+
+	// Cria lista de blobs (objectos) e preenche a etiqueta
+	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
+	if (blobs != NULL)
+	{
+		for (a = 0; a < (*nlabels); a++) blobs[a].label = labeltable[a];
+	}
+	else return NULL;
+
+	return blobs;
+}
+
+
+// Etiquetagem com as tabelas do contexto (sem contar a chamada)
+static OVC* vc_binary_blob_labelling_tables(VCCONTEXT* ctx, IVC* src, IVC* dst, int* nlabels)
+{
+	int a;
+
+	memset(ctx->labeltable, 0, sizeof(ctx->labeltable));
+	*nlabels = vc_binary_blob_label(src, dst, ctx->labeltable);
+
+	if (*nlabels <= 0)
+	{
+		*nlabels = 0;
+		return NULL;
+	}
+
+	memset(ctx->blobs, 0, (*nlabels) * sizeof(OVC));
+	for (a = 0; a < (*nlabels); a++) ctx->blobs[a].label = ctx->labeltable[a];
+
+	ctx->counters.blobs += *nlabels;
+
+	return ctx->blobs;
+}
+
+// Etiquetagem de blobs com as tabelas do contexto: devolve o array de blobs do contexto
+// (com as etiquetas preenchidas e os restantes campos a zero), vlido at  chamada seguinte.
+OVC* vc_binary_blob_labelling_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int* nlabels)
+{
+	OVC* blobs;
+	double t0;
+
+	*nlabels = 0;
+	if (ctx == NULL) return NULL;
+
+	t0 = vc_context_enter(ctx);
+	blobs = vc_binary_blob_labelling_tables(ctx, src, dst, nlabels);
+	vc_context_leave(ctx, t0, blobs != NULL);
+
+	return blobs;
+}
+
+int vc_binary_blob_info(IVC* src, OVC* blobs, int nblobs)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int channels = src->channels;
+	int x, y, i;
+	long int pos;
+	int xmin, ymin, xmax, ymax;
+	long int sumx, sumy;
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if (channels != 1) return 0;
+
+	// Conta rea de cada blob
+	for (i = 0; i < nblobs; i++)
+	{
+		xmin = width - 1;
+		ymin = height - 1;
+		xmax = 0;
+		ymax = 0;
+
+		sumx = 0;
+		sumy = 0;
+
+		blobs[i].area = 0;
+
+		for (y = 1; y < height - 1; y++)
+		{
+			for (x = 1; x < width - 1; x++)
+			{
+				pos = y * bytesperline + x * channels;
+
+				if (data[pos] == blobs[i].label)
+				{
+					// rea
+					blobs[i].area++;
+
+					// Centro de Gravidade
+					sumx += x;
+					sumy += y;
+
+					// Bounding Box
+					if (xmin > x) xmin = x;
+					if (ymin > y) ymin = y;
+					if (xmax < x) xmax = x;
+					if (ymax < y) ymax = y;
+
+					// Permetro
+					// Se pelo menos um dos quatro vizinhos no pertence ao mesmo label, ento  um pixel de contorno
+					if ((data[pos - 1] != blobs[i].label) || (data[pos + 1] != blobs[i].label) || (data[pos - bytesperline] != blobs[i].label) || (data[pos + bytesperline] != blobs[i].label))
+					{
+						blobs[i].perimeter++;
+					}
+				}
+			}
+		}
+
+		// Bounding Box
+		blobs[i].x = xmin;
+		blobs[i].y = ymin;
+		blobs[i].width = (xmax - xmin) + 1;
+		blobs[i].height = (ymax - ymin) + 1;
+
+		// Centro de Gravidade
+		//blobs[i].xc = (xmax - xmin) / 2;
+		//blobs[i].yc = (ymax - ymin) / 2;
+		blobs[i].yc = sumy / MAX2(blobs[i].area, 1);
+		blobs[i].xc = sumx / MAX2(blobs[i].area, 1);
+	}
+
+	return 1;
+}
+
+
+// Estado de vc_binary_blob_tasks()
+typedef struct {
+	IVC* labels;
+	OVC* blobs;
+	int order[VC_CONTEXT_MAX_BLOBS];	// ndices dos blobs, por ordem crescente de rea
+	VCBLOBTASK task;
+	void* arg;
+} VCBLOBTASKS;
+
+// Tarefa de um blob: permetro (percorrendo s a caixa delimitadora) e trabalho do utilizador
+static int vc_binary_blob_task(void* arg, int index, int thread)
+{
+	VCBLOBTASKS* state = (VCBLOBTASKS*)arg;
+	OVC* blob = &state->blobs[state->order[index]];
+	unsigned char* data = (unsigned char*)state->labels->data;
+	int bytesperline = state->labels->bytesperline;
+	int label = blob->label;
+	int perimeter = 0;
+	int x, y;
+	long int pos;
+
+	if (blob->area > 0)
+	{
+		for (y = blob->y; y < blob->y + blob->height; y++)
+		{
+			for (x = blob->x; x < blob->x + blob->width; x++)
+			{
+				pos = y * bytesperline + x;
+
+				// Pixel do blob com pelo menos um dos quatro vizinhos fora dele
+				if ((data[pos] == label) && ((data[pos - 1] != label) || (data[pos + 1] != label) || (data[pos - bytesperline] != label) || (data[pos + bytesperline] != label)))
+				{
+					perimeter++;
+				}
+			}
+		}
+	}
+	blob->perimeter = perimeter;
+
+	return (state->task != NULL) ? state->task(state->arg, state->labels, blob, thread) : 1;
+}
+
+// Informao dos blobs (mesmos resultados de vc_binary_blob_info()) com uma tarefa por blob.
+// 1. rea, caixa delimitadora e centro de todos os blobs numa s passagem pela imagem de etiquetas
+// 2. Uma tarefa por blob no escalonador do contexto: permetro dentro da caixa e task(arg, labels, blob, thread).
+//    O custo das tarefas varia com o tamanho dos blobs: os ndices vo por ordem crescente de rea, pelo que
+//    cada thread comea pelo maior dos seus, e as threads que acabam roubam s outras o maior que lhes resta.
+int vc_binary_blob_tasks(VCCONTEXT* ctx, IVC* labels, OVC* blobs, int nblobs, VCBLOBTASK task, void* arg)
+{
+	VCBLOBTASKS state;
+	unsigned char* data;
+	int width, height, bytesperline;
+	int index[256];
+	int xmin[VC_CONTEXT_MAX_BLOBS], ymin[VC_CONTEXT_MAX_BLOBS], xmax[VC_CONTEXT_MAX_BLOBS], ymax[VC_CONTEXT_MAX_BLOBS];
+	long int sumx[VC_CONTEXT_MAX_BLOBS], sumy[VC_CONTEXT_MAX_BLOBS];
+	int x, y, i, j;
+	double t0;
+
+	// Verificao de erros
+	if ((ctx == NULL) || (labels == NULL) || (labels->data == NULL) || (labels->channels != 1)) return 0;
+	if ((labels->width <= 0) || (labels->height <= 0)) return 0;
+	if ((nblobs < 0) || (nblobs > VC_CONTEXT_MAX_BLOBS) || ((nblobs > 0) && (blobs == NULL))) return 0;
+
+	t0 = vc_context_enter(ctx);
+
+	data = (unsigned char*)labels->data;
+	width = labels->width;
+	height = labels->height;
+	bytesperline = labels->bytesperline;
+
+	for (i = 0; i < 256; i++) index[i] = -1;
+	for (i = 0; i < nblobs; i++)
+	{
+		index[blobs[i].label & 0xFF] = i;
+
+		blobs[i].area = 0;
+		xmin[i] = width - 1;
+		ymin[i] = height - 1;
+		xmax[i] = 0;
+		ymax[i] = 0;
+		sumx[i] = 0;
+		sumy[i] = 0;
+	}
+	index[0] = -1;
+
+	// Passagem nica: rea, centro de gravidade e caixa de todos os blobs
+	for (y = 1; y < height - 1; y++)
+	{
+		unsigned char* row = &data[y * bytesperline];
+
+		for (x = 1; x < width - 1; x++)
+		{
+			i = index[row[x]];
+			if (i < 0) continue;
+
+			blobs[i].area++;
+			sumx[i] += x;
+			sumy[i] += y;
+			if (xmin[i] > x) xmin[i] = x;
+			if (xmax[i] < x) xmax[i] = x;
+			if (ymin[i] > y) ymin[i] = y;
+			ymax[i] = y;
+		}
+	}
+
+	for (i = 0; i < nblobs; i++)
+	{
+		blobs[i].x = xmin[i];
+		blobs[i].y = ymin[i];
+		blobs[i].width = (xmax[i] - xmin[i]) + 1;
+		blobs[i].height = (ymax[i] - ymin[i]) + 1;
+		blobs[i].yc = sumy[i] / MAX2(blobs[i].area, 1);
+		blobs[i].xc = sumx[i] / MAX2(blobs[i].area, 1);
+		blobs[i].perimeter = 0;
+	}
+
+	// Ordem crescente de rea (por insero: h no mximo 254 blobs)
+	for (i = 0; i < nblobs; i++)
+	{
+		for (j = i; (j > 0) && (blobs[state.order[j - 1]].area > blobs[i].area); j--) state.order[j] = state.order[j - 1];
+		state.order[j] = i;
+	}
+
+	state.labels = labels;
+	state.blobs = blobs;
+	state.task = task;
+	state.arg = arg;
+
+	return vc_context_leave(ctx, t0, vc_context_tasks(ctx, nblobs, vc_binary_blob_task, &state));
+}
+
+
+// Contorno exterior do blob (seguimento de fronteira de Moore, vizinhana 8).
+// O pixel inicial  o primeiro do blob na linha de cima da caixa delimitadora (os vizinhos acima e 
+// esquerda so fundo). Em cada pixel, os vizinhos so procurados no sentido directo a partir da direco
+// de chegada rodada para trs, pelo que o blob  contornado sempre com o fundo do mesmo lado.
+// Pra ao repetir o primeiro passo (critrio de Jacob), o que trata correctamente os blobs com partes
+// de um pixel de largura. O custo  proporcional ao comprimento do contorno (mais a largura da caixa).
+int vc_binary_blob_contour(IVC* labels, OVC* blob, CHAINVC* chain)
+{
+	static const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	static const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+	unsigned char* data;
+	unsigned char* codes;
+	int bytesperline, label;
+	int offset[8];
+	long int pos, start;
+	int x, y, dir, first, k, n, capacity, diagonal;
+
+	// Verificao de erros
+	if ((labels == NULL) || (labels->data == NULL) || (labels->channels != 1) || (blob == NULL) || (chain == NULL)) return 0;
+	if ((blob->area <= 0) || (blob->x < 1) || (blob->y < 1) || (blob->x + blob->width > labels->width - 1) || (blob->y + blob->height > labels->height - 1)) return 0;
+
+	data = (unsigned char*)labels->data;
+	bytesperline = labels->bytesperline;
+	label = blob->label;
+
+	for (k = 0; k < 8; k++) offset[k] = dy[k] * bytesperline + dx[k];
+
+	// Pixel inicial: s  percorrida a linha de cima da caixa
+	y = blob->y;
+	for (x = blob->x; (x < blob->x + blob->width) && (data[y * bytesperline + x] != label); x++);
+	if (x == blob->x + blob->width) return 0;
+
+	chain->x = x;
+	chain->y = y;
+	chain->length = 0;
+	chain->perimeter = 0.0f;
+
+	start = y * bytesperline + x;
+	pos = start;
+	first = -1;
+	dir = 7;			// Como se o pixel inicial tivesse sido alcanado a partir de cima,  direita
+	diagonal = 0;
+	n = 0;
+
+	for (;;)
+	{
+		// Primeiro vizinho do blob, no sentido directo, a partir de (dir + 7) % 8 (dir par) ou (dir + 6) % 8 (dir mpar)
+		dir = (dir + ((dir & 1) ? 6 : 7)) & 7;
+		for (k = 0; (k < 8) && (data[pos + offset[dir]] != label); k++) dir = (dir + 1) & 7;
+
+		// Blob de um s pixel
+		if (k == 8) break;
+
+		// O contorno fecha quando, partindo de novo do pixel inicial, se repete o primeiro passo
+		if ((pos == start) && (dir == first)) break;
+		if (first < 0) first = dir;
+
+		if (n == chain->capacity)
+		{
+			capacity = (chain->capacity > 0) ? 2 * chain->capacity : 2 * (blob->width + blob->height) + 8;
+			codes = (unsigned char*)realloc(chain->codes, capacity);
+			if (codes == NULL) return 0;
+			chain->codes = codes;
+			chain->capacity = capacity;
+		}
+
+		chain->codes[n++] = (unsigned char)dir;
+		diagonal += dir & 1;
+		pos += offset[dir];
+	}
+
+	chain->length = n;
+	chain->perimeter = (float)(n - diagonal) + (float)diagonal * 1.41421356f;
+
+	return 1;
+}
+
+
+void vc_chain_free(CHAINVC* chain)
+{
+	if (chain == NULL) return;
+
+	free(chain->codes);
+	memset(chain, 0, sizeof(CHAINVC));
+}
+
+
+// Transformada de distncia chamfer 3-4: 3 por passo horizontal ou vertical, 4 por passo diagonal
+// (aproxima 3 x a distncia euclidiana). Duas passagens (directa e inversa) com a vizinhana j calculada.
+// dist tem width x height elementos; os pixis de fundo e os do rebordo da imagem ficam a 0.
+// Devolve a maior distncia.
+static int vc_chamfer_distance(IVC* src, unsigned short* dist)
+{
+	int width = src->width, height = src->height;
+	int x, y, d, maxd = 0;
+	unsigned short* p;
+
+	// Passagem directa: vizinhos de cima e da esquerda
+	for (y = 0; y < height; y++)
+	{
+		const unsigned char* row = &src->data[y * src->bytesperline];
+
+		p = &dist[y * width];
+		for (x = 0; x < width; x++)
+		{
+			if ((row[x] == 0) || (x == 0) || (y == 0) || (x == width - 1) || (y == height - 1))
+			{
+				p[x] = 0;
+				continue;
+			}
+
+			d = p[x - 1] + 3;
+			d = MIN2(d, p[x - width - 1] + 4);
+			d = MIN2(d, p[x - width] + 3);
+			d = MIN2(d, p[x - width + 1] + 4);
+			p[x] = (unsigned short)d;
+		}
+	}
+
+	// Passagem inversa: vizinhos de baixo e da direita
+	for (y = height - 2; y > 0; y--)
+	{
+		p = &dist[y * width];
+		for (x = width - 2; x > 0; x--)
+		{
+			if (p[x] == 0) continue;
+
+			d = p[x];
+			d = MIN2(d, p[x + 1] + 3);
+			d = MIN2(d, p[x + width + 1] + 4);
+			d = MIN2(d, p[x + width] + 3);
+			d = MIN2(d, p[x + width - 1] + 4);
+			p[x] = (unsigned short)d;
+
+			if (d > maxd) maxd = d;
+		}
+	}
+
+	return maxd;
+}
+
+
+// Distncia (em pixis, aproximada por chamfer 3-4 e saturada a 255) de cada pixel do objecto ao fundo mais prximo
+int vc_binary_distance_transform(IVC* src, IVC* dst)
+{
+	unsigned short* dist;
+	int x, y, d;
+
+	// Verificao de erros
+	if ((src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	dist = (unsigned short*)malloc((size_t)src->width * src->height * sizeof(unsigned short));
+	if (dist == NULL) return 0;
+
+	vc_chamfer_distance(src, dist);
+
+	for (y = 0; y < src->height; y++)
+	{
+		for (x = 0; x < src->width; x++)
+		{
+			d = (dist[y * src->width + x] + 1) / 3;
+			dst->data[y * dst->bytesperline + x] = (unsigned char)MIN2(d, 255);
+		}
+	}
+
+	free(dist);
+
+	return 1;
+}
+
+
+// Memria de trabalho de vc_binary_watershed_label(): distncias, ordem/fila, union-find e baldes
+static size_t vc_binary_watershed_scratch_size(int width, int height)
+{
+	size_t npixels = (size_t)width * height;
+	size_t nlevels = 3 * (size_t)(MAX2(width, height) / 2 + 1) + 1;
+
+	return npixels * (2 * sizeof(int) + sizeof(unsigned short)) + 2 * nlevels * sizeof(int) + 16;
+}
+
+// Raiz de p no union-find (com compresso do caminho a meio)
+static int vc_watershed_find(int* parent, int p)
+{
+	while (parent[p] != p)
+	{
+		parent[p] = parent[parent[p]];
+		p = parent[p];
+	}
+
+	return p;
+}
+
+// Etiquetagem com separao de blobs que se tocam, pela linha de gua (watershed) da transformada de distncia.
+// 1. Transformada de distncia chamfer (duas passagens).
+// 2. Marcadores: os pixis so visitados por ordem decrescente de distncia (ordenao por baldes) e agrupados
+//    em bacias com union-find; quando duas bacias se encontram, a de pico mais baixo  absorvida se a sua
+//    profundidade (pico - distncia no ponto de encontro) for menor que depth. O pico de cada bacia que resta
+//     um marcador (os blobs isolados tm sempre um).
+// 3. Inundao a partir dos marcadores com uma fila de prioridade por baldes (um balde FIFO por nvel de
+//    distncia, do mais alto para o mais baixo): cada pixel recebe a etiqueta da frente que o alcana primeiro.
+// Todos os passos so lineares no nmero de pixis (mais o nmero de nveis de distncia).
+// dst fica com as etiquetas [1, nlabels]; devolve nlabels, ou -1 em caso de erro (mais de 254 regies).
+static int vc_binary_watershed_label(IVC* src, IVC* dst, int depth, unsigned char* scratch)
+{
+	static const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	static const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+	int width = src->width, height = src->height;
+	int npixels = width * height;
+	int offset[8];
+	int* order, * parent, * head, * tail;
+	unsigned short* dist;
+	int maxd, nlevels, h, level, nlabels;
+	int i, k, p, q, x, y, rp, rq, hi, lo, n;
+
+	order = (int*)scratch;
+	parent = &order[npixels];
+	head = &parent[npixels];
+	nlevels = 3 * (MAX2(width, height) / 2 + 1) + 1;
+	tail = &head[nlevels];
+	dist = (unsigned short*)&tail[nlevels];
+
+	for (k = 0; k < 8; k++) offset[k] = dy[k] * width + dx[k];
+
+	maxd = vc_chamfer_distance(src, dist);
+	h = 3 * MAX2(depth, 0);
+
+	// Ordenao por contagem, por distncia decrescente (head: contagem e depois incio de cada nvel)
+	memset(head, 0, (maxd + 1) * sizeof(int));
+	for (p = 0; p < npixels; p++)
+	{
+		if (dist[p] > 0) head[dist[p]]++;
+	}
+	for (level = maxd, n = 0; level > 0; level--)
+	{
+		k = head[level];
+		head[level] = n;
+		n += k;
+	}
+	for (p = 0; p < npixels; p++)
+	{
+		if (dist[p] > 0) order[head[dist[p]]++] = p;
+		parent[p] = -1;
+	}
+
+	// 2. Bacias por ordem decrescente de distncia (o pixel de fundo e o rebordo nunca so visitados)
+	for (i = 0; i < n; i++)
+	{
+		p = order[i];
+		parent[p] = p;
+
+		for (k = 0; k < 8; k++)
+		{
+			q = p + offset[k];
+			if (parent[q] < 0) continue;
+
+			rq = vc_watershed_find(parent, q);
+
+			// O pixel novo junta-se  primeira bacia vizinha
+			if (parent[p] == p)
+			{
+				parent[p] = rq;
+				continue;
+			}
+
+			rp = vc_watershed_find(parent, p);
+			if (rp == rq) continue;
+
+			// Duas bacias encontram-se em p; a raiz de cada uma  o seu pico
+			if ((dist[rp] > dist[rq]) || ((dist[rp] == dist[rq]) && (rp < rq)))
+			{
+				hi = rp;
+				lo = rq;
+			}
+			else
+			{
+				hi = rq;
+				lo = rp;
+			}
+
+			if (dist[lo] - dist[p] < h) parent[lo] = hi;
+		}
+	}
+
+	// Marcadores, etiquetados por ordem de varrimento; parent passa a guardar a etiqueta de cada pixel
+	nlabels = 0;
+	for (level = 0; level < nlevels; level++) head[level] = tail[level] = -1;
+
+	for (p = 0; p < npixels; p++)
+	{
+		if ((dist[p] == 0) || (parent[p] != p))
+		{
+			parent[p] = 0;
+			continue;
+		}
+
+		if (++nlabels > 254)
+		{
+#ifdef VC_DEBUG
+			printf("ERROR -> vc_binary_blob_watershed():\n\tmais de 254 etiquetas!\n");
+#endif
+			return -1;
+		}
+		parent[p] = nlabels;
+
+		// 3. Os marcadores entram na fila no nvel da sua distncia (order liga os pixis de cada balde)
+		order[p] = -1;
+		if (tail[dist[p]] < 0) head[dist[p]] = p;
+		else order[tail[dist[p]]] = p;
+		tail[dist[p]] = p;
+	}
+
+	// Inundao: retira do nvel mais alto no vazio; um vizinho mais alto que o nvel actual entra neste nvel
+	for (level = maxd; level > 0; )
+	{
+		p = head[level];
+		if (p < 0)
+		{
+			level--;
+			continue;
+		}
+		head[level] = order[p];
+		if (head[level] < 0) tail[level] = -1;
+
+		for (k = 0; k < 8; k++)
+		{
+			q = p + offset[k];
+			if ((dist[q] == 0) || (parent[q] != 0)) continue;
+
+			parent[q] = parent[p];
+
+			n = MIN2((int)dist[q], level);
+			order[q] = -1;
+			if (tail[n] < 0) head[n] = q;
+			else order[tail[n]] = q;
+			tail[n] = q;
+		}
+	}
+
+	for (y = 0, p = 0; y < height; y++)
+	{
+		unsigned char* row = &dst->data[y * dst->bytesperline];
+
+		for (x = 0; x < width; x++, p++) row[x] = (unsigned char)parent[p];
+	}
+
+	return nlabels;
+}
+
+
+// Etiquetagem de blobs com separao dos que se tocam (ex.: moedas encostadas), sobre uma mscara binria
+// (ex.: de vc_hsv_segmentation()). Igual a vc_binary_blob_labelling(), excepto que um blob com vrios
+// "centros" (mximos da distncia ao fundo com profundidade >= depth pixis)  dividido em vrias etiquetas.
+// depth		: profundidade mnima, em pixis, do estrangulamento entre dois objectos (ex.: 2)
+// OVC*		: array de nlabels blobs com as etiquetas preenchidas (libertar com free()); completar com vc_binary_blob_info()
+OVC* vc_binary_blob_watershed(IVC* src, IVC* dst, int depth, int* nlabels)
+{
+	unsigned char* scratch;
+	OVC* blobs;
+	int a;
+
+	*nlabels = 0;
+
+	// Verificao de erros
+	if ((src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return NULL;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return NULL;
+	if ((src->width < 3) || (src->height < 3)) return NULL;
+
+	scratch = (unsigned char*)malloc(vc_binary_watershed_scratch_size(src->width, src->height));
+	if (scratch == NULL) return NULL;
+
+	*nlabels = vc_binary_watershed_label(src, dst, depth, scratch);
+	free(scratch);
+
+	if (*nlabels <= 0)
+	{
+		*nlabels = 0;
+		return NULL;
+	}
+
+	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
+	if (blobs == NULL)
+	{
+		*nlabels = 0;
+		return NULL;
+	}
+	for (a = 0; a < (*nlabels); a++) blobs[a].label = a + 1;
+
+	return blobs;
+}
+
+
+// Verso com contexto: memria de trabalho da thread 0 e array de blobs do contexto (vlido at  chamada seguinte)
+OVC* vc_binary_blob_watershed_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int depth, int* nlabels)
+{
+	unsigned char* scratch;
+	double t0;
+	int a;
+
+	*nlabels = 0;
+
+	// Verificao de erros
+	if ((ctx == NULL) || (src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return NULL;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return NULL;
+	if ((src->width < 3) || (src->height < 3)) return NULL;
+
+	t0 = vc_context_enter(ctx);
+
+	scratch = (unsigned char*)vc_context_scratch(ctx, 0, vc_binary_watershed_scratch_size(src->width, src->height));
+	*nlabels = (scratch != NULL) ? vc_binary_watershed_label(src, dst, depth, scratch) : -1;
+
+	if (*nlabels <= 0)
+	{
+		vc_context_leave(ctx, t0, *nlabels == 0);
+		*nlabels = 0;
+		return NULL;
+	}
+
+	memset(ctx->blobs, 0, (*nlabels) * sizeof(OVC));
+	for (a = 0; a < (*nlabels); a++) ctx->blobs[a].label = a + 1;
+	ctx->counters.blobs += *nlabels;
+
+	vc_context_leave(ctx, t0, 1);
+
+	return ctx->blobs;
+}
+
+
+// Segmentao HSV coarse-to-fine
+// 1. Reduz src (HSV) por factor, por amostragem simples (no mistura tonalidades)
+// 2. Segmenta e etiqueta a imagem reduzida
+// 3. Segmenta  resoluo original apenas dentro das caixas delimitadoras dos blobs (com margem de 1 pixel reduzido)
+// Com ctx != NULL usa a pool e as tabelas de etiquetas do contexto (pool  ignorada)
+static int vc_hsv_segmentation_coarse_to_fine_run(IVCPOOL* pool, VCCONTEXT* ctx, IVC* src, IVC* dst, int factor, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	IVC* small, * smallmask, * smalllabels;
+	OVC* blobs;
+	int nblobs = 0;
+	int fallback = 0;
+	int i, y;
+
+	// Verificao de erros
+	if ((src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3)) return 0;
+
+	if (factor <= 1) return vc_hsv_segmentation(src, dst, hmin, hmax, smin, smax, vmin, vmax);
+	if ((factor != 2) && (factor != 4)) return 0;
+	if ((src->width / factor < 3) || (src->height / factor < 3)) return vc_hsv_segmentation(src, dst, hmin, hmax, smin, smax, vmin, vmax);
+
+	if (ctx != NULL) pool = &ctx->pool;
+
+	small = vc_pool_get(pool, src->width / factor, src->height / factor, 3, src->levels);
+	smallmask = vc_pool_get(pool, src->width / factor, src->height / factor, 1, 255);
+	smalllabels = vc_pool_get(pool, src->width / factor, src->height / factor, 1, 255);
+	if ((small == NULL) || (smallmask == NULL) || (smalllabels == NULL))
+	{
+		vc_pool_release(pool, small);
+		vc_pool_release(pool, smallmask);
+		vc_pool_release(pool, smalllabels);
+		return 0;
+	}
+
+	vc_image_downsample(src, small, factor, VC_DOWNSAMPLE_NEAREST);
+	vc_hsv_segmentation(small, smallmask, hmin, hmax, smin, smax, vmin, vmax);
+
+	blobs = (ctx != NULL) ? vc_binary_blob_labelling_tables(ctx, smallmask, smalllabels, &nblobs) : vc_binary_blob_labelling(smallmask, smalllabels, &nblobs);
+	if (blobs != NULL) vc_binary_blob_info(smalllabels, blobs, nblobs);
+
+	// Sem blobs, a mscara reduzida est vazia (fora do rebordo, que a etiquetagem ignora) ou a etiquetagem
+	// falhou (ex.: mais de 254 etiquetas numa cena densa); neste caso segmenta a imagem inteira
+	if (blobs == NULL)
+	{
+		for (y = 1; (y < smallmask->height - 1) && !fallback; y++)
+		{
+			const unsigned char* row = &smallmask->data[y * smallmask->bytesperline];
+
+			for (i = 1; (i < smallmask->width - 1) && !fallback; i++) fallback = (row[i] != 0);
+		}
+	}
+
+	if (fallback)
+	{
+		vc_pool_release(pool, small);
+		vc_pool_release(pool, smallmask);
+		vc_pool_release(pool, smalllabels);
+
+		return vc_hsv_segmentation(src, dst, hmin, hmax, smin, smax, vmin, vmax);
+	}
+
+	// Fora das caixas candidatas a mscara  0
+	for (y = 0; y < dst->height; y++)
+	{
+		memset(&dst->data[y * dst->bytesperline], 0, dst->width);
+	}
+
+	for (i = 0; i < nblobs; i++)
+	{
+		int x0 = MAX2((blobs[i].x - 1) * factor, 0);
+		int y0 = MAX2((blobs[i].y - 1) * factor, 0);
+		int x1 = (blobs[i].x + blobs[i].width + 1) * factor;
+		int y1 = (blobs[i].y + blobs[i].height + 1) * factor;
+
+		if (x1 > src->width) x1 = src->width;
+		if (y1 > src->height) y1 = src->height;
+
+		vc_hsv_segmentation_rect(src, dst, x0, y0, x1, y1, hmin, hmax, smin, smax, vmin, vmax);
+	}
+
+	if (ctx == NULL) free(blobs);
+	vc_pool_release(pool, small);
+	vc_pool_release(pool, smallmask);
+	vc_pool_release(pool, smalllabels);
+
+	return 1;
+}
+
+
+int vc_hsv_segmentation_coarse_to_fine(IVCPOOL* pool, IVC* src, IVC* dst, int factor, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	return vc_hsv_segmentation_coarse_to_fine_run(pool, NULL, src, dst, factor, hmin, hmax, smin, smax, vmin, vmax);
+}
+
+int vc_hsv_segmentation_coarse_to_fine_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int factor, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	double t0;
+	int ok;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+	ok = vc_hsv_segmentation_coarse_to_fine_run(NULL, ctx, src, dst, factor, hmin, hmax, smin, smax, vmin, vmax);
+	if (ok) ctx->counters.frames++;
+
+	return vc_context_leave(ctx, t0, ok);
+}
+
+
+// Vista (sem cpia) das linhas [y0, y0 + rows[ de image; no deve ser libertada
+static IVC vc_image_rows(IVC* image, int y0, int rows)
+{
+	IVC view = *image;
+
+	view.data = &image->data[y0 * image->bytesperline];
+	view.height = rows;
+	view.mapaddr = NULL;
+	view.mapsize = 0;
+
+	return view;
+}
+
+
+// Nmero de linhas por faixa do executor por faixas (ver vc_hsv_segmentation_tiled());
+// em maxrows fica a altura dos intermdios (faixa mais halos)
+static int vc_tiled_bandrows(IVC* src, int kernel, int bandrows, int* maxrows)
+{
+	int halo = (kernel > 1) ? 2 * (kernel / 2) : 0;
+
+	// Por linha: 3 planos HSV + mscara + erodida + dilatada, mais a linha RGB lida
+	if (bandrows <= 0) bandrows = VC_TILE_CACHE_BYTES / (6 * src->width + 3 * src->width);
+	// Halos no devem dominar o trabalho de cada faixa
+	if (bandrows < 4 * halo) bandrows = 4 * halo;
+	if (bandrows < 1) bandrows = 1;
+	if (bandrows > src->height) bandrows = src->height;
+
+	*maxrows = MIN2(bandrows + 2 * halo, src->height);
+
+	return bandrows;
+}
+
+
+// Corpo do executor por faixas, sobre intermdios j alocados com maxrows linhas (hsv: 3 planos).
+// scratch: memria de trabalho da morfologia (NULL: alocada em cada chamada)
+static int vc_hsv_segmentation_bands(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int bandrows,
+	IVC** hsv, IVC* seg, IVC* ero, IVC* out, unsigned char* scratch)
+{
+	IVC srcband, segband, eroband, outband;
+	IVC planes[3];
+	IVCPLANAR hsvband;
+	IVC* result;
+	int halo = (kernel > 1) ? 2 * (kernel / 2) : 0;
+	int ok = 1;
+	int y, y0, y1, b0, b1, rows, c;
+
+	for (y0 = 0; (y0 < src->height) && ok; y0 += bandrows)
+	{
+		y1 = MIN2(y0 + bandrows, src->height);
+
+		// Faixa com halo, cortada nos limites da imagem
+		b0 = MAX2(y0 - halo, 0);
+		b1 = MIN2(y1 + halo, src->height);
+		rows = b1 - b0;
+		srcband = vc_image_rows(src, b0, rows);
+		segband = vc_image_rows(seg, 0, rows);
+		eroband = vc_image_rows(ero, 0, rows);
+		outband = vc_image_rows(out, 0, rows);
+		result = &segband;
+
+		hsvband.width = src->width;
+		hsvband.height = rows;
+		hsvband.nplanes = 3;
+		for (c = 0; c < 3; c++)
+		{
+			planes[c] = vc_image_rows(hsv[c], 0, rows);
+			hsvband.plane[c] = &planes[c];
+		}
+
+		ok = vc_rgb_to_hsv_planar(&srcband, &hsvband) &&
+			vc_hsv_segmentation_planar(&hsvband, &segband, hmin, hmax, smin, smax, vmin, vmax);
+
+		if (ok && (kernel > 1))
+		{
+			if (scratch != NULL)
+			{
+				ok = vc_binary_morph_scratch(&segband, &eroband, kernel, 0, scratch) && vc_binary_morph_scratch(&eroband, &outband, kernel, 255, scratch);
+			}
+			else
+			{
+				ok = vc_binary_erode(&segband, &eroband, kernel) && vc_binary_dilate(&eroband, &outband, kernel);
+			}
+			result = &outband;
+		}
+
+		// S as linhas da faixa (sem halo) vo para dst
+		for (y = y0; (y < y1) && ok; y++)
+		{
+			memcpy(&dst->data[y * dst->bytesperline], &result->data[(y - b0) * result->bytesperline], dst->width);
+		}
+	}
+
+	return ok;
+}
+
+
+// Executor por faixas de linhas (cache-blocked): RGB -> HSV planar -> segmentao -> abertura (kernel > 1).
+// Cada faixa de bandrows linhas  processada at ao fim antes da seguinte, pelo que os intermdios
+// (planos HSV, mscara, mscara erodida) ficam em cache e s a mscara final  escrita em dst.
+// Com raio r = kernel / 2, a faixa  alargada com 2r linhas de halo em cima e em baixo
+// (r para a eroso e r para a dilatao); o resultado  igual ao do processamento da imagem inteira.
+// bandrows <= 0: escolhido para que os intermdios de uma faixa ocupem cerca de VC_TILE_CACHE_BYTES.
+int vc_hsv_segmentation_tiled(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int bandrows)
+{
+	IVCPLANAR* hsv;
+	IVC* seg, * ero, * out;
+	int maxrows;
+	int ok;
+
+	// Verificao de erros
+	if ((src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3) || (dst->channels != 1)) return 0;
+	if (src->height <= 0) return 1;
+
+	bandrows = vc_tiled_bandrows(src, kernel, bandrows, &maxrows);
+
+	hsv = vc_planar_new(src->width, maxrows, 3, 255);
+	seg = vc_image_new(src->width, maxrows, 1, 255);
+	ero = vc_image_new(src->width, maxrows, 1, 255);
+	out = vc_image_new(src->width, maxrows, 1, 255);
+
+	ok = (hsv != NULL) && (seg != NULL) && (ero != NULL) && (out != NULL) &&
+		vc_hsv_segmentation_bands(src, dst, hmin, hmax, smin, smax, vmin, vmax, kernel, bandrows, hsv->plane, seg, ero, out, NULL);
+
+	vc_planar_free(hsv);
+	vc_image_free(seg);
+	vc_image_free(ero);
+	vc_image_free(out);
+
+	return ok;
+}
+
+
+// Verso com contexto: intermdios da pool do contexto e morfologia com a memria de trabalho da thread 0
+int vc_hsv_segmentation_tiled_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int bandrows)
+{
+	IVC* hsv[3];
+	IVC* seg, * ero, * out;
+	unsigned char* scratch = NULL;
+	double t0;
+	int maxrows;
+	int ok;
+	int c;
+
+	// Verificao de erros
+	if ((ctx == NULL) || (src == NULL) || (dst == NULL) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3) || (dst->channels != 1)) return 0;
+	if (src->height <= 0) return 1;
+
+	t0 = vc_context_enter(ctx);
+
+	bandrows = vc_tiled_bandrows(src, kernel, bandrows, &maxrows);
+
+	for (c = 0; c < 3; c++) hsv[c] = vc_context_image_get(ctx, src->width, maxrows, 1, 255);
+	seg = vc_context_image_get(ctx, src->width, maxrows, 1, 255);
+	ero = vc_context_image_get(ctx, src->width, maxrows, 1, 255);
+	out = vc_context_image_get(ctx, src->width, maxrows, 1, 255);
+	if (kernel > 1) scratch = (unsigned char*)vc_context_scratch(ctx, 0, vc_binary_morph_scratch_size(src->width, kernel));
+
+	ok = (hsv[0] != NULL) && (hsv[1] != NULL) && (hsv[2] != NULL) && (seg != NULL) && (ero != NULL) && (out != NULL) && ((kernel <= 1) || (scratch != NULL)) &&
+		vc_hsv_segmentation_bands(src, dst, hmin, hmax, smin, smax, vmin, vmax, kernel, bandrows, hsv, seg, ero, out, scratch);
+
+	for (c = 0; c < 3; c++) vc_context_image_release(ctx, hsv[c]);
+	vc_context_image_release(ctx, seg);
+	vc_context_image_release(ctx, ero);
+	vc_context_image_release(ctx, out);
+
+	if (ok) ctx->counters.frames++;
+
+	return vc_context_leave(ctx, t0, ok);
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              FUNES: REGISTO BINRIO DE BLOBS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Formato do ficheiro (inteiros em little-endian):
+//   Header  : "VCBLOG01" | tamanho de cada registo (u32) | reservado (u32)
+//   Frame   : "FRAM" | nmero da frame (i32) | nblobs (i32) | nblobs registos OVC
+//   Registo : x, y, width, height, area, xc, yc, perimeter, label (9 x i32)
+//   ndice  : por frame: nmero da frame (i32) | nblobs (i32) | offset do header da frame (i64)
+//   Trailer : offset do ndice (i64) | nmero de frames (i64) | "VCBLIDX1"
+// O ndice permite aceder a qualquer frame em O(1). Se o ficheiro no foi fechado
+// (sem ndice), vc_bloblog_open() reconstri o ndice percorrendo os headers das frames.
+
+#define VC_BLOBLOG_MAGIC		"VCBLOG01"
+#define VC_BLOBLOG_FRAME		"FRAM"
+#define VC_BLOBLOG_INDEX		"VCBLIDX1"
+#define VC_BLOBLOG_HEADERSIZE	16
+#define VC_BLOBLOG_FRAMESIZE	12
+#define VC_BLOBLOG_RECORDSIZE	36
+#define VC_BLOBLOG_ENTRYSIZE	16
+#define VC_BLOBLOG_TRAILERSIZE	24
+
+#ifdef _WIN32
+#define vc_fseek64(f, o, w)	_fseeki64(f, o, w)
+#define vc_ftell64(f)		_ftelli64(f)
+#else
+#define vc_fseek64(f, o, w)	fseeko(f, (off_t)(o), w)
+#define vc_ftell64(f)		((long long)ftello(f))
+#endif
+
+typedef struct {
+	int frame;
+	int nblobs;
+	long long offset;
+} VCBLOBLOGENTRY;
+
+struct vc_bloblog {
+	FILE* file;
+	int writing;
+	VCBLOBLOGENTRY* index;		// Escrita: ndice acumulado em memria; leitura: ndice reconstrudo (se necessrio)
+	long long nframes;
+	long long capacity;
+	long long indexoffset;		// Leitura: offset do ndice no ficheiro (-1 se o ndice est em memria)
+	unsigned char* buffer;		// Buffer de (de)serializao dos registos
+	int buffersize;
+};
+
+
+static void vc_put32(unsigned char* p, int v)
+{
+	unsigned int u = (unsigned int)v;
+
+	p[0] = (unsigned char)u;
+	p[1] = (unsigned char)(u >> 8);
+	p[2] = (unsigned char)(u >> 16);
+	p[3] = (unsigned char)(u >> 24);
+}
+
+static int vc_get32(const unsigned char* p)
+{
+	return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static void vc_put64(unsigned char* p, long long v)
+{
+	vc_put32(p, (int)(v & 0xFFFFFFFF));
+	vc_put32(p + 4, (int)(v >> 32));
+}
+
+static long long vc_get64(const unsigned char* p)
+{
+	return (long long)(unsigned int)vc_get32(p) | ((long long)vc_get32(p + 4) << 32);
+}
+
+
+// Garante que o buffer de serializao tem pelo menos size bytes
+static int vc_bloblog_reserve(VCBLOBLOG* log, int size)
+{
+	unsigned char* tmp;
+
+	if (log->buffersize >= size) return 1;
+
+	tmp = (unsigned char*)realloc(log->buffer, size);
+	if (tmp == NULL) return 0;
+
+	log->buffer = tmp;
+	log->buffersize = size;
+
+	return 1;
+}
+
+
+// Cria um registo de blobs (o ficheiro  truncado)
+VCBLOBLOG* vc_bloblog_create(char* filename)
+{
+	VCBLOBLOG* log;
+	unsigned char header[VC_BLOBLOG_HEADERSIZE];
+
+	log = (VCBLOBLOG*)calloc(1, sizeof(VCBLOBLOG));
+	if (log == NULL) return NULL;
+
+	if ((log->file = fopen(filename, "wb")) == NULL)
+	{
+		free(log);
+		return NULL;
+	}
+
+	// Buffer grande: as frames so acrescentadas sem uma chamada ao sistema por frame
+	setvbuf(log->file, NULL, _IOFBF, 1 << 20);
+
+	log->writing = 1;
+	log->indexoffset = -1;
+
+	memcpy(header, VC_BLOBLOG_MAGIC, 8);
+	vc_put32(header + 8, VC_BLOBLOG_RECORDSIZE);
+	vc_put32(header + 12, 0);
+
+	if (fwrite(header, 1, VC_BLOBLOG_HEADERSIZE, log->file) != VC_BLOBLOG_HEADERSIZE)
+	{
+		fclose(log->file);
+		free(log);
+		return NULL;
+	}
+
+	return log;
+}
+
+
+// Acrescenta os blobs de uma frame ao registo
+int vc_bloblog_append(VCBLOBLOG* log, int frame, OVC* blobs, int nblobs)
+{
+	VCBLOBLOGENTRY* entry;
+	unsigned char* p;
+	int size, i;
+
+	if ((log == NULL) || (!log->writing) || (nblobs < 0) || ((nblobs > 0) && (blobs == NULL))) return 0;
+
+	// ndice em memria
+	if (log->nframes == log->capacity)
+	{
+		long long capacity = (log->capacity > 0) ? log->capacity * 2 : 1024;
+		VCBLOBLOGENTRY* tmp = (VCBLOBLOGENTRY*)realloc(log->index, (size_t)capacity * sizeof(VCBLOBLOGENTRY));
+
+		if (tmp == NULL) return 0;
+
+		log->index = tmp;
+		log->capacity = capacity;
+	}
+
+	entry = &log->index[log->nframes];
+	entry->frame = frame;
+	entry->nblobs = nblobs;
+	entry->offset = vc_ftell64(log->file);
+
+	size = VC_BLOBLOG_FRAMESIZE + nblobs * VC_BLOBLOG_RECORDSIZE;
+	if (!vc_bloblog_reserve(log, size)) return 0;
+
+	p = log->buffer;
+	memcpy(p, VC_BLOBLOG_FRAME, 4);
+	vc_put32(p + 4, frame);
+	vc_put32(p + 8, nblobs);
+	p += VC_BLOBLOG_FRAMESIZE;
+
+	for (i = 0; i < nblobs; i++, p += VC_BLOBLOG_RECORDSIZE)
+	{
+		vc_put32(p, blobs[i].x);
+		vc_put32(p + 4, blobs[i].y);
+		vc_put32(p + 8, blobs[i].width);
+		vc_put32(p + 12, blobs[i].height);
+		vc_put32(p + 16, blobs[i].area);
+		vc_put32(p + 20, blobs[i].xc);
+		vc_put32(p + 24, blobs[i].yc);
+		vc_put32(p + 28, blobs[i].perimeter);
+		vc_put32(p + 32, blobs[i].label);
+	}
+
+	if (fwrite(log->buffer, 1, size, log->file) != (size_t)size) return 0;
+
+	log->nframes++;
+
+	return 1;
+}
+
+
+// Reconstri o ndice percorrendo os headers das frames (ficheiro sem trailer, com size bytes).
+// Pra na primeira frame incompleta (ex.: escrita interrompida a meio dos registos).
+static int vc_bloblog_rebuild_index(VCBLOBLOG* log, long long size)
+{
+	unsigned char header[VC_BLOBLOG_FRAMESIZE];
+	long long offset = VC_BLOBLOG_HEADERSIZE;
+
+	vc_fseek64(log->file, offset, SEEK_SET);
+
+	while (fread(header, 1, VC_BLOBLOG_FRAMESIZE, log->file) == VC_BLOBLOG_FRAMESIZE)
+	{
+		int nblobs = vc_get32(header + 8);
+
+		if ((memcmp(header, VC_BLOBLOG_FRAME, 4) != 0) || (nblobs < 0)) break;
+		if (offset + VC_BLOBLOG_FRAMESIZE + (long long)nblobs * VC_BLOBLOG_RECORDSIZE > size) break;
+
+		if (log->nframes == log->capacity)
+		{
+			long long capacity = (log->capacity > 0) ? log->capacity * 2 : 1024;
+			VCBLOBLOGENTRY* tmp = (VCBLOBLOGENTRY*)realloc(log->index, (size_t)capacity * sizeof(VCBLOBLOGENTRY));
+
+			if (tmp == NULL) return 0;
+
+			log->index = tmp;
+			log->capacity = capacity;
+		}
+
+		log->index[log->nframes].frame = vc_get32(header + 4);
+		log->index[log->nframes].nblobs = nblobs;
+		log->index[log->nframes].offset = offset;
+		log->nframes++;
+
+		offset += VC_BLOBLOG_FRAMESIZE + (long long)nblobs * VC_BLOBLOG_RECORDSIZE;
+		if (vc_fseek64(log->file, offset, SEEK_SET) != 0) break;
+	}
+
+	return 1;
+}
+
+
+// Abre um registo de blobs para leitura
+VCBLOBLOG* vc_bloblog_open(char* filename)
+{
+	VCBLOBLOG* log;
+	unsigned char header[VC_BLOBLOG_HEADERSIZE];
+	unsigned char trailer[VC_BLOBLOG_TRAILERSIZE];
+	long long size;
+
+	log = (VCBLOBLOG*)calloc(1, sizeof(VCBLOBLOG));
+	if (log == NULL) return NULL;
+
+	if ((log->file = fopen(filename, "rb")) == NULL)
+	{
+		free(log);
+		return NULL;
+	}
+
+	if ((fread(header, 1, VC_BLOBLOG_HEADERSIZE, log->file) != VC_BLOBLOG_HEADERSIZE) ||
+		(memcmp(header, VC_BLOBLOG_MAGIC, 8) != 0) || (vc_get32(header + 8) != VC_BLOBLOG_RECORDSIZE))
+	{
+#ifdef VC_DEBUG
+		printf("ERROR -> vc_bloblog_open():\n\tFile is not a valid blob log.\n");
+#endif
+		fclose(log->file);
+		free(log);
+		return NULL;
+	}
+
+	// Trailer com o ndice no fim do ficheiro
+	log->indexoffset = -1;
+	vc_fseek64(log->file, 0, SEEK_END);
+	size = vc_ftell64(log->file);
+
+	if ((size >= VC_BLOBLOG_HEADERSIZE + VC_BLOBLOG_TRAILERSIZE) &&
+		(vc_fseek64(log->file, size - VC_BLOBLOG_TRAILERSIZE, SEEK_SET) == 0) &&
+		(fread(trailer, 1, VC_BLOBLOG_TRAILERSIZE, log->file) == VC_BLOBLOG_TRAILERSIZE) &&
+		(memcmp(trailer + 16, VC_BLOBLOG_INDEX, 8) == 0))
+	{
+		log->indexoffset = vc_get64(trailer);
+		log->nframes = vc_get64(trailer + 8);
+	}
+	else if (!vc_bloblog_rebuild_index(log, size))
+	{
+		vc_bloblog_close(log);
+		return NULL;
+	}
+
+	return log;
+}
+
+
+// Nmero de frames no registo
+int vc_bloblog_nframes(VCBLOBLOG* log)
+{
+	return (log != NULL) ? (int)log->nframes : 0;
+}
+
+
+// L os blobs da frame de ordem index (0 = primeira frame registada), em O(1).
+// Em blobs fica um array de nblobs blobs (a libertar com free()); numa frame sem blobs, nblobs = 0 e blobs = NULL.
+// Devolve 1 em caso de sucesso (mesmo sem blobs) e 0 em caso de erro (ndice invlido, leitura ou registo corrompido).
+int vc_bloblog_read(VCBLOBLOG* log, int index, int* frame, OVC** blobs, int* nblobs)
+{
+	unsigned char entry[VC_BLOBLOG_ENTRYSIZE];
+	unsigned char* p;
+	long long offset;
+	OVC* array;
+	int n, i, size;
+
+	if (blobs != NULL) *blobs = NULL;
+	if (nblobs != NULL) *nblobs = 0;
+	if ((log == NULL) || (log->writing) || (index < 0) || (index >= log->nframes) || (blobs == NULL) || (nblobs == NULL)) return 0;
+
+	// Localiza a frame atravs do ndice
+	if (log->indexoffset >= 0)
+	{
+		if ((vc_fseek64(log->file, log->indexoffset + (long long)index * VC_BLOBLOG_ENTRYSIZE, SEEK_SET) != 0) ||
+			(fread(entry, 1, VC_BLOBLOG_ENTRYSIZE, log->file) != VC_BLOBLOG_ENTRYSIZE)) return 0;
+
+		offset = vc_get64(entry + 8);
+	}
+	else
+	{
+		offset = log->index[index].offset;
+	}
+
+	if (!vc_bloblog_reserve(log, VC_BLOBLOG_FRAMESIZE)) return 0;
+	if ((vc_fseek64(log->file, offset, SEEK_SET) != 0) ||
+		(fread(log->buffer, 1, VC_BLOBLOG_FRAMESIZE, log->file) != VC_BLOBLOG_FRAMESIZE) ||
+		(memcmp(log->buffer, VC_BLOBLOG_FRAME, 4) != 0)) return 0;
+
+	if (frame != NULL) *frame = vc_get32(log->buffer + 4);
+	n = vc_get32(log->buffer + 8);
+	if (n < 0) return 0;
+	if (n == 0) return 1;
+
+	size = n * VC_BLOBLOG_RECORDSIZE;
+	if (!vc_bloblog_reserve(log, size)) return 0;
+	if (fread(log->buffer, 1, size, log->file) != (size_t)size) return 0;
+
+	array = (OVC*)calloc(n, sizeof(OVC));
+	if (array == NULL) return 0;
+
+	for (i = 0, p = log->buffer; i < n; i++, p += VC_BLOBLOG_RECORDSIZE)
+	{
+		array[i].x = vc_get32(p);
+		array[i].y = vc_get32(p + 4);
+		array[i].width = vc_get32(p + 8);
+		array[i].height = vc_get32(p + 12);
+		array[i].area = vc_get32(p + 16);
+		array[i].xc = vc_get32(p + 20);
+		array[i].yc = vc_get32(p + 24);
+		array[i].perimeter = vc_get32(p + 28);
+		array[i].label = vc_get32(p + 32);
+	}
+
+	*blobs = array;
+	*nblobs = n;
+
+	return 1;
+}
+
+
+// Fecha o registo. Na escrita, acrescenta o ndice frame -> offset e o trailer.
+int vc_bloblog_close(VCBLOBLOG* log)
+{
+	unsigned char buf[VC_BLOBLOG_ENTRYSIZE > VC_BLOBLOG_TRAILERSIZE ? VC_BLOBLOG_ENTRYSIZE : VC_BLOBLOG_TRAILERSIZE];
+	long long i, indexoffset;
+	int ok = 1;
+
+	if (log == NULL) return 0;
+
+	if (log->writing)
+	{
+		indexoffset = vc_ftell64(log->file);
+
+		for (i = 0; (i < log->nframes) && ok; i++)
+		{
+			vc_put32(buf, log->index[i].frame);
+			vc_put32(buf + 4, log->index[i].nblobs);
+			vc_put64(buf + 8, log->index[i].offset);
+			ok = (fwrite(buf, 1, VC_BLOBLOG_ENTRYSIZE, log->file) == VC_BLOBLOG_ENTRYSIZE);
+		}
+
+		vc_put64(buf, indexoffset);
+		vc_put64(buf + 8, log->nframes);
+		memcpy(buf + 16, VC_BLOBLOG_INDEX, 8);
+		if (ok) ok = (fwrite(buf, 1, VC_BLOBLOG_TRAILERSIZE, log->file) == VC_BLOBLOG_TRAILERSIZE);
+	}
+
+	if (fclose(log->file) != 0) ok = 0;
+
+	free(log->index);
+	free(log->buffer);
+	free(log);
+
+	return ok;
+}
+
+
+
+
+
+// Histograma de uma imagem de 1 canal.
+// Usa 4 sub-histogramas intercalados para que pixis consecutivos com o mesmo valor no
+// incrementem o mesmo contador (evita a dependncia store-to-load entre iteraes).
+int vc_gray_histogram(IVC* src, int hist[256]) {
+	int sub[4][256];
+	int x, y, i;
+
+	if (src == NULL || src->data == NULL || hist == NULL) return 0;
+	if ((src->width <= 0) || (src->height <= 0) || (src->channels != 1)) return 0;
+
+	memset(sub, 0, sizeof(sub));
+
+	for (y = 0; y < src->height; y++) {
+		const unsigned char* row = &src->data[y * src->bytesperline];
+
+		for (x = 0; x + 4 <= src->width; x += 4) {
+			sub[0][row[x]]++;
+			sub[1][row[x + 1]]++;
+			sub[2][row[x + 2]]++;
+			sub[3][row[x + 3]]++;
+		}
+		for (; x < src->width; x++) {
+			sub[0][row[x]]++;
+		}
+	}
+
+	for (i = 0; i < 256; i++) {
+		hist[i] = sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i];
+	}
+
+	return 1;
+}
+
+// Mdia (inteira) dos nveis de cinzento
+int vc_histogram_mean(const int hist[256]) {
+	long long sum = 0, n = 0;
+
+	for (int i = 0; i < 256; i++) {
+		sum += (long long)i * hist[i];
+		n += hist[i];
+	}
+
+	return (n > 0) ? (int)(sum / n) : 0;
+}
+
+// Threshold de Otsu: nvel t que maximiza a varincia entre as classes [0,t] e ]t,255]
+int vc_histogram_otsu(const int hist[256]) {
+	double sum = 0.0, sumb = 0.0;
+	double wb = 0.0, wf, mb, mf, between, best = -1.0;
+	double n = 0.0;
+	int threshold = 0;
+
+	for (int i = 0; i < 256; i++) {
+		sum += (double)i * hist[i];
+		n += hist[i];
+	}
+
+	for (int t = 0; t < 256; t++) {
+		wb += hist[t];
+		if (wb == 0) continue;
+
+		wf = n - wb;
+		if (wf == 0) break;
+
+		sumb += (double)t * hist[t];
+		mb = sumb / wb;
+		mf = (sum - sumb) / wf;
+
+		between = wb * wf * (mb - mf) * (mb - mf);
+		if (between > best) {
+			best = between;
+			threshold = t;
+		}
+	}
+
+	return threshold;
+}
+
+// LUT de equalizao a partir da PDF (pdf normalizada, soma 1): lut[i] = (cdf[i] - cdfmin) / (1 - cdfmin) * 255
+static void vc_equalization_lut_from_pdf(const float pdf[256], unsigned char lut[256]) {
+	float cdf[256];   // Funo de distribuio acumulada (CDF)
+
+	cdf[0] = pdf[0];
+	for (int i = 1; i < 256; i++) {
+		cdf[i] = cdf[i - 1] + pdf[i];
+	}
+
+	// Encontrar cdfmin (primeiro valor de CDF diferente de zero)
+	float cdfmin = 0.0;
+	for (int i = 0; i < 256; i++) {
+		if (cdf[i] > 0) {
+			cdfmin = cdf[i];
+			break;
+		}
+	}
+
+	// Imagem com um nico nvel: no h nada a equalizar
+	if (cdfmin >= 1.0f) {
+		for (int i = 0; i < 256; i++) lut[i] = (unsigned char)i;
+		return;
+	}
+
+	for (int i = 0; i < 256; i++) {
+		lut[i] = (unsigned char)(((cdf[i] - cdfmin) / (1 - cdfmin)) * (256 - 1));
+	}
+}
+
+// LUT de equalizao a partir do histograma
+int vc_histogram_equalization_lut(const int hist[256], unsigned char lut[256]) {
+	float pdf[256];   // Probabilidade de ocorrncia
+	long long total_pixels = 0;
+
+	for (int i = 0; i < 256; i++) total_pixels += hist[i];
+	if (total_pixels == 0) return 0;
+
+	for (int i = 0; i < 256; i++) {
+		pdf[i] = (float)hist[i] / total_pixels;
+	}
+
+	vc_equalization_lut_from_pdf(pdf, lut);
+
+	return 1;
+}
+
+// Aplica uma LUT a uma imagem de 1 canal (src e dst podem ser a mesma imagem).
+// Desenrolado de 8 em 8 para que as leituras da tabela sejam independentes.
+int vc_gray_lut_apply(IVC* src, IVC* dst, const unsigned char lut[256]) {
+	int x, y;
+
+	if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		const unsigned char* s = &src->data[y * src->bytesperline];
+		unsigned char* d = &dst->data[y * dst->bytesperline];
+
+		for (x = 0; x + 8 <= src->width; x += 8) {
+			unsigned char v0 = lut[s[x]], v1 = lut[s[x + 1]], v2 = lut[s[x + 2]], v3 = lut[s[x + 3]];
+			unsigned char v4 = lut[s[x + 4]], v5 = lut[s[x + 5]], v6 = lut[s[x + 6]], v7 = lut[s[x + 7]];
+
+			d[x] = v0; d[x + 1] = v1; d[x + 2] = v2; d[x + 3] = v3;
+			d[x + 4] = v4; d[x + 5] = v5; d[x + 6] = v6; d[x + 7] = v7;
+		}
+		for (; x < src->width; x++) {
+			d[x] = lut[s[x]];
+		}
+	}
+
+	return 1;
+}
+
+
+int vc_gray_histogram_equalization(IVC* src, IVC* dst) {
+	if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
+		return 0; // Erro: imagens invlidas
+	}
+
+	int n[256];               // Histograma
+	unsigned char lut[256];   // Look-up table para transformao de nveis de cinza
+
+	// Passo 1: Calcular o histograma
+	if (vc_gray_histogram(src, n) == 0) return 0;
+
+	// Passo 2: Construir a LUT a partir da CDF
+	if (vc_histogram_equalization_lut(n, lut) == 0) return 0;
+
+	// Passo 3: Aplicar a transformao nos pixels da imagem de entrada
+	return vc_gray_lut_apply(src, dst, lut);
+}
+
+
+// Inicializa o estado da equalizao em modo vdeo
+// alpha : peso da frame actual na mdia exponencial do histograma, ]0, 1] (ex.: 0.1)
+// step  : subamostragem da grelha de pixis usada no histograma (1 = todos os pixis)
+// drift : distncia L1 entre histogramas normalizados, em [0, 2], a partir da qual a LUT  recalculada (ex.: 0.05)
+void vc_equalization_stream_init(EQVC* eq, float alpha, int step, float drift) {
+	if (eq == NULL) return;
+
+	memset(eq, 0, sizeof(EQVC));
+	eq->alpha = (alpha > 0.0f && alpha <= 1.0f) ? alpha : 0.1f;
+	eq->step = MAX2(step, 1);
+	eq->drift = (drift >= 0.0f) ? drift : 0.05f;
+}
+
+// Equalizao em modo vdeo: mantm um histograma suavizado exponencialmente, calculado
+// sobre uma grelha subamostrada, e s reconstri a LUT quando a distribuio se afasta da
+// que originou a LUT actual. Por frame, o custo fica reduzido a uma aplicao da LUT.
+int vc_gray_histogram_equalization_stream(EQVC* eq, IVC* src, IVC* dst) {
+	int sub[256] = { 0 };
+	float pdf[256];
+	float distance = 0.0f;
+	int total = 0;
+
+	if (eq == NULL || src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1) || (dst->channels != 1)) return 0;
+
+	// Passo 1: Histograma da grelha subamostrada
+	for (int y = 0; y < src->height; y += eq->step) {
+		const unsigned char* row = &src->data[y * src->bytesperline];
+
+		for (int x = 0; x < src->width; x += eq->step) {
+			sub[row[x]]++;
+		}
+	}
+	for (int i = 0; i < 256; i++) total += sub[i];
+	if (total == 0) return 0;
+
+	// Passo 2: Mdia exponencial do histograma normalizado
+	for (int i = 0; i < 256; i++) {
+		pdf[i] = (float)sub[i] / total;
+
+		if (eq->initialized) eq->hist[i] += eq->alpha * (pdf[i] - eq->hist[i]);
+		else eq->hist[i] = pdf[i];
+
+		distance += fabsf(eq->hist[i] - eq->lut_hist[i]);
+	}
+
+	// Passo 3: S recalcula a LUT se a distribuio derivou o suficiente
+	if ((!eq->initialized) || (distance > eq->drift)) {
+		vc_equalization_lut_from_pdf(eq->hist, eq->lut);
+		memcpy(eq->lut_hist, eq->hist, sizeof(eq->hist));
+		eq->initialized = 1;
+		eq->nupdates++;
+	}
+
+	// Passo 4: Aplicar a LUT
+	return vc_gray_lut_apply(src, dst, eq->lut);
+}
+
+
+
+
+
+// Gradiente 3x3 (Prewitt: w = 1; Sobel: w = 2) e limiarizao de |G| > th no domnio quadrtico.
+// Usa trs apontadores de linha deslizantes (y-1, y, y+1), sem recalcular y * width por vizinho.
+// Os pixis do rebordo de dst (e de magnitude/direction) ficam a 0.
+// magnitude (opcional): |G| saturado a 255
+// direction (opcional): ngulo de (gx, gy) em [0, 360[ graus, quantizado para [0, 255] (256 nveis),
+//                       com gy positivo para cima (linha de cima mais clara que a de baixo)
+static int vc_gray_edge_3x3(IVC* src, IVC* dst, float th, int w, IVC* magnitude, IVC* direction)
+{
+	int width, height;
+	int x, y;
+	int gx, gy, g2;
+	int th2;
+	const VCCPUDISPATCH* cpu;
+
+	// Verificaes bsicas
+	if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1 || dst->channels != 1)) return 0;
+	if ((magnitude != NULL) && ((magnitude->width != src->width) || (magnitude->height != src->height) || (magnitude->channels != 1))) return 0;
+	if ((direction != NULL) && ((direction->width != src->width) || (direction->height != src->height) || (direction->channels != 1))) return 0;
+
+	width = src->width;
+	height = src->height;
+
+	cpu = vc_cpu_dispatch();
+
+	// g > th  <=>  g^2 > th^2 (para th >= 0); como g^2  inteiro, basta comparar com floor(th^2).
+	// g^2 nunca passa de 2 * (4 * 255)^2, pelo que th^2  limitado a esse valor (sem overflow em int)
+	th2 = (th < 0.0f) ? -1 : (int)floorf(MIN2(th * th, 2.0f * (4 * 255) * (4 * 255)));
+
+	// Rebordos
+	for (y = 0; y < height; y++)
+	{
+		if ((y == 0) || (y == height - 1))
+		{
+			memset(&dst->data[y * dst->bytesperline], 0, width);
+			if (magnitude != NULL) memset(&magnitude->data[y * magnitude->bytesperline], 0, width);
+			if (direction != NULL) memset(&direction->data[y * direction->bytesperline], 0, width);
+		}
+		else
+		{
+			dst->data[y * dst->bytesperline] = 0;
+			dst->data[y * dst->bytesperline + width - 1] = 0;
+			if (magnitude != NULL)
+			{
+				magnitude->data[y * magnitude->bytesperline] = 0;
+				magnitude->data[y * magnitude->bytesperline + width - 1] = 0;
+			}
+			if (direction != NULL)
+			{
+				direction->data[y * direction->bytesperline] = 0;
+				direction->data[y * direction->bytesperline + width - 1] = 0;
+			}
+		}
+	}
+
+	for (y = 1; y < height - 1; y++)
+	{
+		const unsigned char* p0 = &src->data[(y - 1) * src->bytesperline];
+		const unsigned char* p1 = &src->data[y * src->bytesperline];
+		const unsigned char* p2 = &src->data[(y + 1) * src->bytesperline];
+		unsigned char* d = &dst->data[y * dst->bytesperline];
+
+		x = 1;
+
+		// S limiarizao: kernel do nvel de CPU em uso; o ciclo abaixo trata o resto da linha
+		if ((magnitude == NULL) && (direction == NULL))
+		{
+			x = cpu->edge_row(p0, p1, p2, d, width - 1, w, th2);
+		}
+
+		for (; x < width - 1; x++)
+		{
+			gx = (p0[x + 1] - p0[x - 1]) + w * (p1[x + 1] - p1[x - 1]) + (p2[x + 1] - p2[x - 1]);
+			gy = (p0[x - 1] + w * p0[x] + p0[x + 1]) - (p2[x - 1] + w * p2[x] + p2[x + 1]);
+			g2 = gx * gx + gy * gy;
+
+			// Limiarizao
+			d[x] = (g2 > th2) ? 255 : 0;
+
+			if (magnitude != NULL)
+			{
+				float g = sqrtf((float)g2);
+				magnitude->data[y * magnitude->bytesperline + x] = (g > 255.0f) ? 255 : (unsigned char)(g + 0.5f);
+			}
+			if (direction != NULL)
+			{
+				float angle = atan2f((float)gy, (float)gx) * (180.0f / 3.14159265f);
+				if (angle < 0.0f) angle += 360.0f;
+				direction->data[y * direction->bytesperline + x] = (unsigned char)((int)(angle * (256.0f / 360.0f) + 0.5f) & 255);
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+int vc_gray_edge_prewitt(IVC* src, IVC* dst, float th)
+{
+	return vc_gray_edge_3x3(src, dst, th, 1, NULL, NULL);
+}
+
+
+int vc_gray_edge_sobel(IVC* src, IVC* dst, float th)
+{
+	return vc_gray_edge_3x3(src, dst, th, 2, NULL, NULL);
+}
+
+
+// Igual a vc_gray_edge_prewitt()/vc_gray_edge_sobel(), devolvendo tambm (se != NULL) a magnitude e a direco do gradiente
+int vc_gray_edge_prewitt_ex(IVC* src, IVC* dst, float th, IVC* magnitude, IVC* direction)
+{
+	return vc_gray_edge_3x3(src, dst, th, 1, magnitude, direction);
+}
+
+
+int vc_gray_edge_sobel_ex(IVC* src, IVC* dst, float th, IVC* magnitude, IVC* direction)
+{
+	return vc_gray_edge_3x3(src, dst, th, 2, magnitude, direction);
+}
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNES: DETECO DE CRCULOS (TRANSFORMADA DE HOUGH)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cada pixel de contorno vota, ao longo da direco do seu gradiente (para os dois lados, pois a moeda pode ser
+// mais clara ou mais escura do que o fundo), nos centros a distncia r, para r em [rmin, rmax].
+// O acumulador  reduzido: cada clula cobre VC_HOUGH_DECIMATION x VC_HOUGH_DECIMATION pixis e os raios so
+// percorridos com o mesmo passo. Os mximos locais so depois verificados  resoluo original: o raio  o que
+// rene mais pixis de contorno  distncia certa do centro, com o gradiente na direco radial, e o suporte  a
+// fraco de sectores angulares do permetro onde h pelo menos um desses pixis (no mximo 1).
+
+#define VC_HOUGH_DECIMATION		2
+#define VC_HOUGH_MARGIN			2		// Pixis acrescentados  volta da caixa de cada blob
+#define VC_HOUGH_MAX_CANDIDATES	32		// Mximos locais verificados por blob (os mais votados)
+#define VC_HOUGH_ANGLES			64		// Sectores angulares do permetro contados no suporte
+#define VC_HOUGH_STEPS			(4 * VC_HOUGH_DECIMATION)	// Deslocamentos mximos do centro no afinamento
+#define VC_HOUGH_SAMPLES		16		// Pontos do permetro testados na supresso de crculos contidos
+
+typedef struct {
+	short x, y;
+	unsigned char direction;
+} VCHOUGHPOINT;
+
+typedef struct {
+	int cell;
+	int votes;
+} VCHOUGHCANDIDATE;
+
+// Vista (sem cpia) do rectngulo [x0, x0 + width[ x [y0, y0 + height[ de image; no deve ser libertada
+static IVC vc_image_rect(IVC* image, int x0, int y0, int width, int height)
+{
+	IVC view = *image;
+
+	view.data = &image->data[y0 * image->bytesperline + x0 * image->channels];
+	view.width = width;
+	view.height = height;
+	view.mapaddr = NULL;
+	view.mapsize = 0;
+
+	return view;
+}
+
+// Raio mais suportado  volta do centro (cx, cy), em [rmin, rmax]; em support fica o nmero de pixis de contorno
+// (com o gradiente alinhado com o raio) a menos de 1 pixel desse raio. hist tem rmax + 2 elementos.
+static int vc_hough_radius(const VCHOUGHPOINT* points, int npoints, const float* cosine, const float* sine, int cx, int cy, int rmin, int rmax, int* hist, int* support)
+{
+	int i, r, best = 0, bestr = 0, n;
+	float dx, dy, d, dot;
+
+	memset(hist, 0, (rmax + 2) * sizeof(int));
+
+	for (i = 0; i < npoints; i++)
+	{
+		dx = (float)(points[i].x - cx);
+		dy = (float)(points[i].y - cy);
+		d = sqrtf(dx * dx + dy * dy);
+		r = (int)(d + 0.5f);
+		if ((r < rmin - 1) || (r > rmax + 1) || (d < 1.0f)) continue;
+
+		// Gradiente (y para cima) alinhado com a direco radial (y para baixo): |cos| > 0.7
+		dot = (dx * cosine[points[i].direction] - dy * sine[points[i].direction]) / d;
+		if ((dot > -0.7f) && (dot < 0.7f)) continue;
+
+		hist[r]++;
+	}
+
+	// Soma de trs raios vizinhos (contornos com mais de um pixel de espessura), normalizada pelo permetro
+	for (r = rmin; r <= rmax; r++)
+	{
+		n = hist[r - 1] + hist[r] + hist[r + 1];
+		if ((n > 0) && ((bestr == 0) || (n * bestr > best * r)))
+		{
+			best = n;
+			bestr = r;
+		}
+	}
+
+	*support = best;
+
+	return bestr;
+}
+
+// Copia para ring os pixis de contorno a uma distncia de (cx, cy) em [rlo, rhi]; devolve quantos so
+static int vc_hough_annulus(const VCHOUGHPOINT* points, int npoints, int cx, int cy, int rlo, int rhi, VCHOUGHPOINT* ring)
+{
+	int i, dx, dy, d2, n = 0;
+
+	rlo = MAX2(rlo, 0);
+
+	for (i = 0; i < npoints; i++)
+	{
+		dx = points[i].x - cx;
+		dy = points[i].y - cy;
+		d2 = dx * dx + dy * dy;
+		if ((d2 >= rlo * rlo) && (d2 <= rhi * rhi)) ring[n++] = points[i];
+	}
+
+	return n;
+}
+
+// Afina o centro (cx, cy), dado pela clula do acumulador,  resoluo original: desloca-o para o vizinho
+// (8-vizinhana) com melhor suporte relativo (support / raio) enquanto houver melhoria. S o primeiro raio 
+// procurado em todos os pixis de contorno; depois, s nos do anel  volta desse raio (copiados para ring), que
+// contm todos os que podem contar para raios at VC_HOUGH_STEPS / 2 de distncia, com o centro deslocado at
+// VC_HOUGH_STEPS pixis. Devolve o raio; em nring fica o nmero de pixis do anel.
+static int vc_hough_refine(const VCHOUGHPOINT* points, int npoints, VCHOUGHPOINT* ring, int* nring, const float* cosine, const float* sine, int* cx, int* cy, int rmin, int rmax, int* hist, int* support)
+{
+	int radius, r, s, i, j, bx, by, iterations, rlo, rhi;
+
+	*nring = 0;
+	radius = vc_hough_radius(points, npoints, cosine, sine, *cx, *cy, rmin, rmax, hist, support);
+	if (radius == 0) return 0;
+
+	*nring = vc_hough_annulus(points, npoints, *cx, *cy, radius - 2 * VC_HOUGH_STEPS - 2, radius + 2 * VC_HOUGH_STEPS + 2, ring);
+	rlo = MAX2(rmin, radius - VC_HOUGH_STEPS / 2);
+	rhi = MIN2(rmax, radius + VC_HOUGH_STEPS / 2);
+
+	for (iterations = 0; iterations < VC_HOUGH_STEPS; iterations++)
+	{
+		bx = *cx;
+		by = *cy;
+
+		for (j = -1; j <= 1; j++)
+		{
+			for (i = -1; i <= 1; i++)
+			{
+				if ((i == 0) && (j == 0)) continue;
+
+				r = vc_hough_radius(ring, *nring, cosine, sine, *cx + i, *cy + j, rlo, rhi, hist, &s);
+				if ((r > 0) && (s * radius > *support * r))
+				{
+					radius = r;
+					*support = s;
+					bx = *cx + i;
+					by = *cy + j;
+				}
+			}
+		}
+
+		if ((bx == *cx) && (by == *cy)) break;
+		*cx = bx;
+		*cy = by;
+	}
+
+	return radius;
+}
+
+// Fraco do permetro do crculo (cx, cy, radius) coberta por pixis de contorno a menos de 1 pixel do raio e com
+// o gradiente na direco radial: sectores angulares com pelo menos um pixel, em VC_HOUGH_ANGLES (ou em 2 * pi * r,
+// se for menor, para que um crculo pequeno completo chegue a 1)
+static float vc_hough_coverage(const VCHOUGHPOINT* points, int npoints, const float* cosine, const float* sine, int cx, int cy, int radius)
+{
+	unsigned char hit[VC_HOUGH_ANGLES];
+	int i, r, bin, nbins, n = 0;
+	float dx, dy, d, dot;
+
+	nbins = MIN2((int)(2.0f * 3.14159265f * radius), VC_HOUGH_ANGLES);
+	memset(hit, 0, sizeof(hit));
+
+	for (i = 0; i < npoints; i++)
 	{
-		if (labeltable[a] != 0)
+		dx = (float)(points[i].x - cx);
+		dy = (float)(points[i].y - cy);
+		d = sqrtf(dx * dx + dy * dy);
+		r = (int)(d + 0.5f);
+		if ((r < radius - 1) || (r > radius + 1) || (d < 1.0f)) continue;
+
+		dot = (dx * cosine[points[i].direction] - dy * sine[points[i].direction]) / d;
+		if ((dot > -0.7f) && (dot < 0.7f)) continue;
+
+		bin = (int)((atan2f(dy, dx) + 3.14159265f) * ((float)nbins / (2.0f * 3.14159265f)));
+		bin = MAX2(MIN2(bin, nbins - 1), 0);
+		if (!hit[bin])
 		{
-			labeltable[*nlabels] = labeltable[a]; // Organiza tabela de etiquetas
-			(*nlabels)++; // Conta etiquetas
+			hit[bin] = 1;
+			n++;
 		}
 	}
 
-	// Se no h blobs
-	if (*nlabels == 0) return NULL;
+	return (float)n / (float)nbins;
+}
 
-	// Cria lista de blobs (objectos) e preenche a etiqueta
-	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
-	if (blobs != NULL)
+// Verdadeiro se a maior parte do permetro do crculo (cx, cy, radius) fica dentro dos crculos j aceites
+// (ex.: votos de uma moeda que se juntam no interior de outra, ou na juno de duas moedas encostadas)
+static int vc_hough_contained(const CIRCLEVC* circles, int ncircles, const float* cosine, const float* sine, int cx, int cy, int radius)
+{
+	int i, k, inside = 0;
+	float x, y, dx, dy;
+
+	for (k = 0; k < VC_HOUGH_SAMPLES; k++)
 	{
-		for (a = 0; a < (*nlabels); a++) blobs[a].label = labeltable[a];
+		x = cx + radius * cosine[k * (256 / VC_HOUGH_SAMPLES)];
+		y = cy - radius * sine[k * (256 / VC_HOUGH_SAMPLES)];
+
+		for (i = 0; i < ncircles; i++)
+		{
+			dx = x - circles[i].x;
+			dy = y - circles[i].y;
+			if (dx * dx + dy * dy <= (float)((circles[i].r + 1) * (circles[i].r + 1)))
+			{
+				inside++;
+				break;
+			}
+		}
 	}
-	else return NULL;
 
-	return blobs;
+	return 2 * inside > VC_HOUGH_SAMPLES;
 }
 
-int vc_binary_blob_info(IVC* src, OVC* blobs, int nblobs)
+// Crculos com raio em [rmin, rmax] dentro das caixas delimitadoras dos blobs (de vc_binary_blob_info(),
+// vc_binary_blob_tasks(), ...), sobre a imagem em cinzentos gray. Blobs de moedas que se tocam do vrios crculos.
+// th		: limiar da magnitude do gradiente de Sobel (como em vc_gray_edge_sobel())
+// minsupport	: fraco mnima do permetro coberta por pixis de contorno, em [0, 1] (ex.: 0.4)
+// circles	: array com espao para maxcircles crculos; o nmero de crculos encontrados fica em ncircles
+// ctx		: opcional; com contexto, as imagens e a memria de trabalho vm do contexto
+int vc_gray_hough_circles(VCCONTEXT* ctx, IVC* gray, OVC* blobs, int nblobs, int rmin, int rmax, float th, float minsupport, CIRCLEVC* circles, int maxcircles, int* ncircles)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, i;
-	long int pos;
-	int xmin, ymin, xmax, ymax;
-	long int sumx, sumy;
+	const int dec = VC_HOUGH_DECIMATION;
+	float cosine[256], sine[256];
+	VCHOUGHCANDIDATE candidates[VC_HOUGH_MAX_CANDIDATES];
+	IVC* edges = NULL, * direction = NULL;
+	IVC gview, eview, dview;
+	unsigned short* acc;
+	VCHOUGHPOINT* points, * ring;
+	int* hist;
+	unsigned char* scratch = NULL;
+	size_t size, offset;
+	int maxw = 0, maxh = 0, aw, ah, ncand, npoints, nring, first;
+	int b, i, j, k, x, y, r, x0, y0, x1, y1, rw, rh, rmaxb, cell, votes, minvotes;
+	int cx, cy, radius, support, dup;
+	float c, s;
+	double t0 = 0.0;
+	int ok = 0;
+
+	if (ncircles != NULL) *ncircles = 0;
 
 	// Verificao de erros
-	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
-	if (channels != 1) return 0;
+	if ((gray == NULL) || (gray->data == NULL) || (gray->channels != 1) || (ncircles == NULL)) return 0;
+	if ((nblobs < 0) || ((nblobs > 0) && (blobs == NULL)) || ((maxcircles > 0) && (circles == NULL))) return 0;
+	if ((rmin < 2) || (rmax < rmin)) return 0;
 
-	// Conta rea de cada blob
-	for (i = 0; i < nblobs; i++)
+	if (ctx != NULL) t0 = vc_context_enter(ctx);
+
+	// Maior rectngulo a analisar
+	for (b = 0; b < nblobs; b++)
 	{
-		xmin = width - 1;
-		ymin = height - 1;
-		xmax = 0;
-		ymax = 0;
+		if (blobs[b].area <= 0) continue;
+		maxw = MAX2(maxw, blobs[b].width + 2 * VC_HOUGH_MARGIN);
+		maxh = MAX2(maxh, blobs[b].height + 2 * VC_HOUGH_MARGIN);
+	}
+	maxw = MIN2(maxw, gray->width);
+	maxh = MIN2(maxh, gray->height);
+	if ((maxw < 3) || (maxh < 3))
+	{
+		return (ctx != NULL) ? vc_context_leave(ctx, t0, 1) : 1;
+	}
 
-		sumx = 0;
-		sumy = 0;
+	// Memria de trabalho: acumulador, histograma de raios, pixis de contorno e pixis do anel de um candidato,
+	// cada bloco alinhado a 8 bytes (VCHOUGHPOINT tem 6 bytes)
+	aw = maxw / dec + 1;
+	ah = maxh / dec + 1;
+	offset = (((size_t)aw * ah * sizeof(unsigned short)) + 7) & ~(size_t)7;
+	size = offset + ((((size_t)rmax + 2) * sizeof(int) + 7) & ~(size_t)7) + 2 * (size_t)maxw * maxh * sizeof(VCHOUGHPOINT);
+	scratch = (ctx != NULL) ? (unsigned char*)vc_context_scratch(ctx, 0, size) : (unsigned char*)malloc(size);
 
-		blobs[i].area = 0;
+	edges = vc_context_image_get(ctx, maxw, maxh, 1, 255);
+	direction = vc_context_image_get(ctx, maxw, maxh, 1, 255);
 
-		for (y = 1; y < height - 1; y++)
+	if ((scratch != NULL) && (edges != NULL) && (direction != NULL))
+	{
+		acc = (unsigned short*)scratch;
+		hist = (int*)&scratch[offset];
+		points = (VCHOUGHPOINT*)&scratch[offset + ((((size_t)rmax + 2) * sizeof(int) + 7) & ~(size_t)7)];
+		ring = &points[(size_t)maxw * maxh];
+
+		// Direco quantizada (256 nveis em [0, 360[ graus) -> cos e sin
+		for (i = 0; i < 256; i++)
 		{
-			for (x = 1; x < width - 1; x++)
+			cosine[i] = cosf((float)i * (2.0f * 3.14159265f / 256.0f));
+			sine[i] = sinf((float)i * (2.0f * 3.14159265f / 256.0f));
+		}
+
+		ok = 1;
+
+		for (b = 0; (b < nblobs) && (*ncircles < maxcircles); b++)
+		{
+			if (blobs[b].area <= 0) continue;
+
+			// Rectngulo do blob, com margem; os crculos tm de caber nele
+			x0 = MAX2(blobs[b].x - VC_HOUGH_MARGIN, 0);
+			y0 = MAX2(blobs[b].y - VC_HOUGH_MARGIN, 0);
+			x1 = MIN2(blobs[b].x + blobs[b].width + VC_HOUGH_MARGIN, gray->width);
+			y1 = MIN2(blobs[b].y + blobs[b].height + VC_HOUGH_MARGIN, gray->height);
+			rw = x1 - x0;
+			rh = y1 - y0;
+			rmaxb = MIN2(rmax, MAX2(rw, rh) / 2);
+			if ((rw < 3) || (rh < 3) || (rmaxb < rmin)) continue;
+
+			gview = vc_image_rect(gray, x0, y0, rw, rh);
+			eview = vc_image_rect(edges, 0, 0, rw, rh);
+			dview = vc_image_rect(direction, 0, 0, rw, rh);
+
+			if (!vc_gray_edge_sobel_ex(&gview, &eview, th, NULL, &dview))
 			{
-				pos = y * bytesperline + x * channels;
+				ok = 0;
+				break;
+			}
 
-				if (data[pos] == blobs[i].label)
+			// Pixis de contorno
+			npoints = 0;
+			for (y = 1; y < rh - 1; y++)
+			{
+				for (x = 1; x < rw - 1; x++)
 				{
-					// rea
-					blobs[i].area++;
+					if (eview.data[y * eview.bytesperline + x] == 0) continue;
 
-					// Centro de Gravidade
-					sumx += x;
-					sumy += y;
+					points[npoints].x = (short)x;
+					points[npoints].y = (short)y;
+					points[npoints].direction = dview.data[y * dview.bytesperline + x];
+					npoints++;
+				}
+			}
 
-					// Bounding Box
-					if (xmin > x) xmin = x;
-					if (ymin > y) ymin = y;
-					if (xmax < x) xmax = x;
-					if (ymax < y) ymax = y;
+			// Votao no acumulador reduzido, para os dois sentidos do gradiente
+			aw = rw / dec + 1;
+			ah = rh / dec + 1;
+			memset(acc, 0, (size_t)aw * ah * sizeof(unsigned short));
 
-					// Permetro
-					// Se pelo menos um dos quatro vizinhos no pertence ao mesmo label, ento  um pixel de contorno
-					if ((data[pos - 1] != blobs[i].label) || (data[pos + 1] != blobs[i].label) || (data[pos - bytesperline] != blobs[i].label) || (data[pos + bytesperline] != blobs[i].label))
+			for (i = 0; i < npoints; i++)
+			{
+				c = cosine[points[i].direction];
+				s = sine[points[i].direction];
+
+				for (r = rmin; r <= rmaxb; r += dec)
+				{
+					x = (int)(points[i].x + r * c + 0.5f);
+					y = (int)(points[i].y - r * s + 0.5f);
+					if ((x >= 0) && (x < rw) && (y >= 0) && (y < rh) && (acc[(y / dec) * aw + x / dec] < 65535)) acc[(y / dec) * aw + x / dec]++;
+
+					x = (int)(points[i].x - r * c + 0.5f);
+					y = (int)(points[i].y + r * s + 0.5f);
+					if ((x >= 0) && (x < rw) && (y >= 0) && (y < rh) && (acc[(y / dec) * aw + x / dec] < 65535)) acc[(y / dec) * aw + x / dec]++;
+				}
+			}
+
+			// Mximos locais (3x3) com votos suficientes para o menor crculo; ficam os mais votados
+			minvotes = MAX2((int)(minsupport * 2.0f * 3.14159265f * rmin / dec), 3);
+			ncand = 0;
+			for (y = 0; y < ah; y++)
+			{
+				for (x = 0; x < aw; x++)
+				{
+					cell = y * aw + x;
+					votes = acc[cell];
+					if (votes < minvotes) continue;
+
+					// Em caso de empate, fica a primeira clula (pela ordem de varrimento)
+					for (j = -1, k = 1; (j <= 1) && k; j++)
 					{
-						blobs[i].perimeter++;
+						for (i = -1; (i <= 1) && k; i++)
+						{
+							if ((i == 0 && j == 0) || (x + i < 0) || (x + i >= aw) || (y + j < 0) || (y + j >= ah)) continue;
+							if ((acc[cell + j * aw + i] > votes) || ((acc[cell + j * aw + i] == votes) && (j * aw + i < 0))) k = 0;
+						}
 					}
+					if (!k) continue;
+
+					// Insero por ordem decrescente de votos
+					if ((ncand == VC_HOUGH_MAX_CANDIDATES) && (candidates[ncand - 1].votes >= votes)) continue;
+					if (ncand < VC_HOUGH_MAX_CANDIDATES) ncand++;
+					for (i = ncand - 1; (i > 0) && (candidates[i - 1].votes < votes); i--) candidates[i] = candidates[i - 1];
+					candidates[i].cell = cell;
+					candidates[i].votes = votes;
 				}
 			}
-		}
 
-		// Bounding Box
-		blobs[i].x = xmin;
-		blobs[i].y = ymin;
-		blobs[i].width = (xmax - xmin) + 1;
-		blobs[i].height = (ymax - ymin) + 1;
+			// Verificao  resoluo original e supresso de centros repetidos (do mesmo crculo) e de crculos
+			// contidos nos j aceites
+			first = *ncircles;
+			for (k = 0; (k < ncand) && (*ncircles < maxcircles); k++)
+			{
+				cx = (candidates[k].cell % aw) * dec + dec / 2;
+				cy = (candidates[k].cell / aw) * dec + dec / 2;
 
-		// Centro de Gravidade
-		//blobs[i].xc = (xmax - xmin) / 2;
-		//blobs[i].yc = (ymax - ymin) / 2;
-		blobs[i].yc = sumy / MAX2(blobs[i].area, 1);
-		blobs[i].xc = sumx / MAX2(blobs[i].area, 1);
+				// Clulas dentro de um crculo j aceite so votos dispersos desse crculo ou de um vizinho
+				for (i = first, dup = 0; (i < *ncircles) && !dup; i++)
+				{
+					x = circles[i].x - (x0 + cx);
+					y = circles[i].y - (y0 + cy);
+					dup = (x * x + y * y < circles[i].r * circles[i].r);
+				}
+				if (dup) continue;
+
+				radius = vc_hough_refine(points, npoints, ring, &nring, cosine, sine, &cx, &cy, rmin, rmaxb, hist, &support);
+				if ((radius == 0) || (vc_hough_coverage(ring, nring, cosine, sine, cx, cy, radius) < minsupport)) continue;
+
+				for (i = first, dup = 0; (i < *ncircles) && !dup; i++)
+				{
+					x = circles[i].x - (x0 + cx);
+					y = circles[i].y - (y0 + cy);
+					r = MIN2(circles[i].r, radius);
+					dup = (x * x + y * y < r * r);
+				}
+				if (dup || vc_hough_contained(&circles[first], *ncircles - first, cosine, sine, x0 + cx, y0 + cy, radius)) continue;
+
+				circles[*ncircles].x = x0 + cx;
+				circles[*ncircles].y = y0 + cy;
+				circles[*ncircles].r = radius;
+				circles[*ncircles].votes = support;
+				circles[*ncircles].label = blobs[b].label;
+				(*ncircles)++;
+			}
+		}
 	}
 
-	return 1;
+	vc_context_image_release(ctx, edges);
+	vc_context_image_release(ctx, direction);
+	if (ctx == NULL) free(scratch);
+
+	return (ctx != NULL) ? vc_context_leave(ctx, t0, ok) : ok;
 }
 
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNES: MODELO DE FUNDO E PRIMEIRO PLANO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// O fundo (ex.: tapete transportador)  esttico: um modelo por pixel permite obter, por diferena absoluta,
+// a mscara do que se move (primeiro plano), e s a correr a segmentao HSV e a etiquetagem.
+
+struct vc_background {
+	int mode;					// VC_BACKGROUND_AVERAGE ou VC_BACKGROUND_MEDIAN
+	int param;					// Taxa (2^-param) da mdia, ou nmero de frames da mediana
+	int width, height, channels;
+	int count;					// Frames j integradas no modelo
+	IVCPOOL pool;				// Modelo e histrico, alocados na criao
+	IVC* model;					// Imagem do fundo
+	IVC* history[VC_BACKGROUND_MAX_FRAMES];	// Mediana: ltimas frames (anel)
+	unsigned short* average;	// Mdia: acumulador em vrgula fixa (8 bits fraccionrios)
+	unsigned char* row;			// Linha de trabalho da diferena (width * channels)
+};
 
 
+VCBACKGROUND* vc_background_new(int width, int height, int channels, int mode, int param)
+{
+	VCBACKGROUND* bg;
+	int i, nhistory = 0;
 
-int vc_gray_histogram_equalization(IVC* src, IVC* dst) {
-	if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
-		return 0; // Erro: imagens invlidas
+	if ((width <= 0) || (height <= 0) || (channels <= 0)) return NULL;
+	if (mode == VC_BACKGROUND_AVERAGE)
+	{
+		if ((param < 0) || (param > 8)) return NULL;
 	}
+	else if (mode == VC_BACKGROUND_MEDIAN)
+	{
+		if ((param < 1) || (param > VC_BACKGROUND_MAX_FRAMES)) return NULL;
+		nhistory = param;
+	}
+	else return NULL;
 
-	int n[256] = { 0 };      // Histograma
-	float pdf[256];   // Probabilidade de ocorrncia
-	float cdf[256];   // Funo de distribuio acumulada (CDF)
-	unsigned char lut[256];   // Look-up table para transformao de nveis de cinza
-	int total_pixels = src->width * src->height;
+	bg = (VCBACKGROUND*)calloc(1, sizeof(VCBACKGROUND));
+	if (bg == NULL) return NULL;
 
-	// Passo 1: Calcular o histograma
-	for (int i = 0; i < total_pixels; n[src->data[i++]]++);
+	bg->mode = mode;
+	bg->param = param;
+	bg->width = width;
+	bg->height = height;
+	bg->channels = channels;
+	vc_pool_init(&bg->pool);
 
-	// Passo 2: Calcular a PDF (Probabilidade de ocorrncia)
-	for (int i = 0; i < 256; i++) {
-		pdf[i] = (float)n[i] / total_pixels;
+	bg->model = vc_pool_get(&bg->pool, width, height, channels, 255);
+	for (i = 0; i < nhistory; i++) bg->history[i] = vc_pool_get(&bg->pool, width, height, channels, 255);
+	if (mode == VC_BACKGROUND_AVERAGE) bg->average = (unsigned short*)malloc((size_t)width * height * channels * sizeof(unsigned short));
+	bg->row = (unsigned char*)malloc((size_t)width * channels);
+
+	if ((bg->model == NULL) || ((nhistory > 0) && (bg->history[nhistory - 1] == NULL)) ||
+		((mode == VC_BACKGROUND_AVERAGE) && (bg->average == NULL)) || (bg->row == NULL))
+	{
+		vc_background_free(bg);
+		return NULL;
 	}
 
-	// Passo 3: Calcular a CDF (Distribuio acumulada)
-	cdf[0] = pdf[0];
-	for (int i = 1; i < 256; i++) {
-		cdf[i] = cdf[i - 1] + pdf[i];
+	return bg;
+}
+
+
+VCBACKGROUND* vc_background_free(VCBACKGROUND* bg)
+{
+	if (bg == NULL) return NULL;
+
+	vc_pool_free(&bg->pool);
+	free(bg->average);
+	free(bg->row);
+	free(bg);
+
+	return NULL;
+}
+
+
+// Imagem do fundo (pertence ao modelo); NULL antes da primeira actualizao
+IVC* vc_background_image(VCBACKGROUND* bg)
+{
+	return ((bg != NULL) && (bg->count > 0)) ? bg->model : NULL;
+}
+
+
+// Mediana de n valores (n <= VC_BACKGROUND_MAX_FRAMES), por insero
+static unsigned char vc_background_median(unsigned char* v, int n)
+{
+	int i, j;
+
+	for (i = 1; i < n; i++)
+	{
+		unsigned char value = v[i];
+
+		for (j = i; (j > 0) && (v[j - 1] > value); j--) v[j] = v[j - 1];
+		v[j] = value;
 	}
 
-	// Encontrar cdfmin (primeiro valor de CDF diferente de zero)
-	float cdfmin = 0.0;
-	for (int i = 0; i < 256; i++) {
-		if (cdf[i] > 0) {
-			cdfmin = cdf[i];
-			break;
+	return v[n / 2];
+}
+
+
+// Integra frame no modelo. A primeira frame inicializa o fundo.
+// mask (opcional, 1 canal): os pixis a 255 (primeiro plano) so actualizados muito mais devagar (mdia) ou s
+// periodicamente (mediana), para que os objectos que param demorem a ser absorvidos pelo fundo, mas um objecto
+// presente na primeira frame ou uma mudana de iluminao acabem por o ser
+int vc_background_update(VCBACKGROUND* bg, IVC* frame, IVC* mask)
+{
+	const unsigned char* rows[VC_BACKGROUND_MAX_FRAMES];
+	unsigned char values[VC_BACKGROUND_MAX_FRAMES];
+	int maskedshift, half, maskedhalf;
+	int x, y, c, i, n, slot;
+
+	// Verificao de erros
+	if ((bg == NULL) || (frame == NULL) || (frame->data == NULL)) return 0;
+	if ((frame->width != bg->width) || (frame->height != bg->height) || (frame->channels != bg->channels)) return 0;
+	if ((mask != NULL) && ((mask->width != bg->width) || (mask->height != bg->height) || (mask->channels != 1))) return 0;
+
+	// A primeira frame inicializa o modelo inteiro; na mediana, a mscara  ignorada de VC_BACKGROUND_REFRESH
+	// em VC_BACKGROUND_REFRESH actualizaes, para que o primeiro plano no fique preso no mesmo stio
+	if (bg->count == 0) mask = NULL;
+	if ((bg->mode == VC_BACKGROUND_MEDIAN) && (bg->count % VC_BACKGROUND_REFRESH == 0)) mask = NULL;
+
+	// Mdia: os pixis de primeiro plano tambm so actualizados, 2^VC_BACKGROUND_MASKED_SHIFT vezes mais devagar
+	maskedshift = MIN2(bg->param + VC_BACKGROUND_MASKED_SHIFT, 12);
+	half = (1 << bg->param) >> 1;
+	maskedhalf = (1 << maskedshift) >> 1;
+
+	if (bg->mode == VC_BACKGROUND_AVERAGE)
+	{
+		for (y = 0; y < bg->height; y++)
+		{
+			const unsigned char* src = &frame->data[y * frame->bytesperline];
+			const unsigned char* m = (mask != NULL) ? &mask->data[y * mask->bytesperline] : NULL;
+			unsigned char* dst = &bg->model->data[y * bg->model->bytesperline];
+			unsigned short* acc = &bg->average[(size_t)y * bg->width * bg->channels];
+
+			if (bg->count == 0)
+			{
+				for (c = 0; c < bg->width * bg->channels; c++) acc[c] = (unsigned short)(src[c] << 8);
+				memcpy(dst, src, (size_t)bg->width * bg->channels);
+				continue;
+			}
+
+			// acc += (frame - acc) / 2^shift, em vrgula fixa e arredondado
+			if (m == NULL)
+			{
+				for (c = 0; c < bg->width * bg->channels; c++)
+				{
+					int value = acc[c] + ((((src[c] << 8) - acc[c]) + half) >> bg->param);
+
+					acc[c] = (unsigned short)value;
+					dst[c] = (unsigned char)((value + 128) >> 8);
+				}
+				continue;
+			}
+
+			for (x = 0; x < bg->width; x++)
+			{
+				int shift = (m[x] != 0) ? maskedshift : bg->param;
+				int round = (m[x] != 0) ? maskedhalf : half;
+
+				for (c = x * bg->channels; c < (x + 1) * bg->channels; c++)
+				{
+					int value = acc[c] + ((((src[c] << 8) - acc[c]) + round) >> shift);
+
+					acc[c] = (unsigned short)value;
+					dst[c] = (unsigned char)((value + 128) >> 8);
+				}
+			}
 		}
 	}
+	else
+	{
+		// Guarda a frame no anel e recalcula a mediana das n frames disponveis
+		slot = bg->count % bg->param;
+		n = MIN2(bg->count + 1, bg->param);
 
-	// Passo 4: Construir a LUT (Look-Up Table)
-	for (int i = 0; i < 256; i++) {
-		lut[i] = (unsigned char)(((cdf[i] - cdfmin) / (1 - cdfmin)) * (256 - 1));
-	}
+		for (y = 0; y < bg->height; y++)
+		{
+			memcpy(&bg->history[slot]->data[y * bg->history[slot]->bytesperline], &frame->data[y * frame->bytesperline], (size_t)bg->width * bg->channels);
+		}
 
-	// Passo 5: Aplicar a transformao nos pixels da imagem de entrada
-	for (int i = 0; i < total_pixels; i++) {
-		dst->data[i] = lut[src->data[i]];
-	}
+		for (y = 0; y < bg->height; y++)
+		{
+			const unsigned char* m = (mask != NULL) ? &mask->data[y * mask->bytesperline] : NULL;
+			unsigned char* dst = &bg->model->data[y * bg->model->bytesperline];
 
-	return 1; // Sucesso
-}
+			for (i = 0; i < n; i++) rows[i] = &bg->history[i]->data[y * bg->history[i]->bytesperline];
+
+			for (x = 0; x < bg->width; x++)
+			{
+				if ((m != NULL) && (m[x] != 0)) continue;
 
+				for (c = x * bg->channels; c < (x + 1) * bg->channels; c++)
+				{
+					for (i = 0; i < n; i++) values[i] = rows[i][c];
+					dst[c] = vc_background_median(values, n);
+				}
+			}
+		}
+	}
 
+	bg->count++;
 
+	return 1;
+}
 
 
-int vc_gray_edge_prewitt(IVC* src, IVC* dst, float th)
+// Mscara do primeiro plano: dst = 255 onde algum canal de frame difere do fundo mais de threshold, 0 no resto.
+// Antes da primeira actualizao do modelo toda a imagem  primeiro plano.
+int vc_background_foreground(VCBACKGROUND* bg, IVC* frame, IVC* dst, int threshold)
 {
-	int x, y;
-	long int pos;
-	int gx, gy;
-	float g;
+	const VCCPUDISPATCH* cpu = vc_cpu_dispatch();
+	int x, y, c, n;
 
-	// Verificaes bsicas
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1 || dst->channels != 1)) return 0;
+	// Verificao de erros
+	if ((bg == NULL) || (frame == NULL) || (dst == NULL) || (frame->data == NULL) || (dst->data == NULL)) return 0;
+	if ((frame->width != bg->width) || (frame->height != bg->height) || (frame->channels != bg->channels)) return 0;
+	if ((dst->width != bg->width) || (dst->height != bg->height) || (dst->channels != 1)) return 0;
+
+	n = bg->width * bg->channels;
 
-	for (y = 1; y < src->height - 1; y++)
+	for (y = 0; y < bg->height; y++)
 	{
-		for (x = 1; x < src->width - 1; x++)
-		{
-			// Posio central da janela 3x3
-			pos = y * src->width + x;
+		unsigned char* d = &dst->data[y * dst->bytesperline];
 
-			// Clculo de Gx
-			gx =
-				-src->data[(y - 1) * src->width + (x - 1)] + src->data[(y - 1) * src->width + (x + 1)] +
-				-src->data[y * src->width + (x - 1)] + src->data[y * src->width + (x + 1)] +
-				-src->data[(y + 1) * src->width + (x - 1)] + src->data[(y + 1) * src->width + (x + 1)];
+		if ((bg->count == 0) || (threshold < 0))
+		{
+			memset(d, 255, bg->width);
+			continue;
+		}
+		if (threshold >= 255)
+		{
+			memset(d, 0, bg->width);
+			continue;
+		}
 
-			// Clculo de Gy
-			gy =
-				src->data[(y - 1) * src->width + (x - 1)] + src->data[(y - 1) * src->width + x] + src->data[(y - 1) * src->width + (x + 1)] -
-				src->data[(y + 1) * src->width + (x - 1)] - src->data[(y + 1) * src->width + x] - src->data[(y + 1) * src->width + (x + 1)];
+		if (bg->channels == 1)
+		{
+			cpu->absdiff_row(&frame->data[y * frame->bytesperline], &bg->model->data[y * bg->model->bytesperline], d, n, threshold);
+			continue;
+		}
 
-			// Magnitude do gradiente
-			g = sqrt((float)(gx * gx + gy * gy));
+		// Diferena por byte e depois OU dos canais de cada pixel
+		cpu->absdiff_row(&frame->data[y * frame->bytesperline], &bg->model->data[y * bg->model->bytesperline], bg->row, n, threshold);
+		if (bg->channels == 3)
+		{
+			for (x = 0; x < bg->width; x++) d[x] = bg->row[x * 3] | bg->row[x * 3 + 1] | bg->row[x * 3 + 2];
+		}
+		else
+		{
+			for (x = 0; x < bg->width; x++)
+			{
+				unsigned char value = 0;
 
-			// Limiarizao
-			dst->data[pos] = (g > th) ? 255 : 0;
+				for (c = 0; c < bg->channels; c++) value |= bg->row[x * bg->channels + c];
+				d[x] = value;
+			}
 		}
 	}
 
@@ -1416,41 +7421,101 @@ int vc_gray_edge_prewitt(IVC* src, IVC* dst, float th)
 }
 
 
-int vc_gray_edge_sobel(IVC* src, IVC* dst, float th)
+// Segmentao HSV restrita ao primeiro plano: a imagem  dividida em blocos de VC_FOREGROUND_TILE x VC_FOREGROUND_TILE
+// pixis; um bloco com pelo menos minpixels pixis de primeiro plano (o rudo isolado no chega)  activado, junto
+// com os 8 vizinhos (margem para as orlas dos objectos). A segmentao s corre nos blocos activos; o resto de dst fica a 0.
+static int vc_hsv_segmentation_foreground_run(VCCONTEXT* ctx, IVC* src, IVC* fg, IVC* dst, int minpixels, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
 {
-	int x, y;
-	long int pos;
-	int gx, gy;
-	float g;
+	int ntx, nty, tx, ty, x, y, i, j;
+	int* count;
+	unsigned char* active;
 
-	// Verificaes bsicas
-	if (src == NULL || dst == NULL) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1 || dst->channels != 1)) return 0;
+	// Verificao de erros
+	if ((src == NULL) || (fg == NULL) || (dst == NULL) || (src->data == NULL) || (fg->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((fg->width != src->width) || (fg->height != src->height) || (fg->channels != 1)) return 0;
+
+	ntx = (src->width + VC_FOREGROUND_TILE - 1) / VC_FOREGROUND_TILE;
+	nty = (src->height + VC_FOREGROUND_TILE - 1) / VC_FOREGROUND_TILE;
 
-	for (y = 1; y < src->height - 1; y++)
+	count = (ctx != NULL) ? (int*)vc_context_scratch(ctx, 0, (size_t)ntx * nty * (sizeof(int) + 1)) : (int*)malloc((size_t)ntx * nty * (sizeof(int) + 1));
+	if (count == NULL) return 0;
+	active = (unsigned char*)&count[ntx * nty];
+
+	memset(count, 0, (size_t)ntx * nty * sizeof(int));
+	memset(active, 0, (size_t)ntx * nty);
+
+	// Pixis de primeiro plano por bloco (somados por troos contguos de uma linha)
+	for (y = 0; y < src->height; y++)
+	{
+		const unsigned char* m = &fg->data[y * fg->bytesperline];
+		int* row = &count[(y / VC_FOREGROUND_TILE) * ntx];
+
+		for (tx = 0; tx < ntx; tx++)
+		{
+			int x1 = MIN2((tx + 1) * VC_FOREGROUND_TILE, src->width);
+			int n = 0;
+
+			for (x = tx * VC_FOREGROUND_TILE; x < x1; x++) n += (m[x] != 0);
+			row[tx] += n;
+		}
+	}
+
+	for (ty = 0; ty < nty; ty++)
 	{
-		for (x = 1; x < src->width - 1; x++)
+		for (tx = 0; tx < ntx; tx++)
 		{
-			pos = y * src->width + x;
+			if (count[ty * ntx + tx] < MAX2(minpixels, 1)) continue;
 
-			// Gx Sobel
-			gx =
-				-src->data[(y - 1) * src->width + (x - 1)] + src->data[(y - 1) * src->width + (x + 1)] +
-				-2 * src->data[y * src->width + (x - 1)] + 2 * src->data[y * src->width + (x + 1)] +
-				-src->data[(y + 1) * src->width + (x - 1)] + src->data[(y + 1) * src->width + (x + 1)];
+			for (j = MAX2(ty - 1, 0); j <= MIN2(ty + 1, nty - 1); j++)
+			{
+				for (i = MAX2(tx - 1, 0); i <= MIN2(tx + 1, ntx - 1); i++) active[j * ntx + i] = 1;
+			}
+		}
+	}
 
-			// Gy Sobel
-			gy =
-				src->data[(y - 1) * src->width + (x - 1)] + 2 * src->data[(y - 1) * src->width + x] + src->data[(y - 1) * src->width + (x + 1)] -
-				src->data[(y + 1) * src->width + (x - 1)] - 2 * src->data[(y + 1) * src->width + x] - src->data[(y + 1) * src->width + (x + 1)];
+	for (ty = 0; ty < nty; ty++)
+	{
+		int y0 = ty * VC_FOREGROUND_TILE;
+		int y1 = MIN2(y0 + VC_FOREGROUND_TILE, src->height);
 
-			// Magnitude do gradiente
-			g = sqrt((float)(gx * gx + gy * gy));
+		for (tx = 0; tx < ntx; tx++)
+		{
+			int x0 = tx * VC_FOREGROUND_TILE;
+			int x1 = MIN2(x0 + VC_FOREGROUND_TILE, src->width);
 
-			// Limiarizao
-			dst->data[pos] = (g > th) ? 255 : 0;
+			if (active[ty * ntx + tx])
+			{
+				vc_hsv_segmentation_rect(src, dst, x0, y0, x1, y1, hmin, hmax, smin, smax, vmin, vmax);
+			}
+			else
+			{
+				for (y = y0; y < y1; y++) memset(&dst->data[y * dst->bytesperline + x0], 0, x1 - x0);
+			}
 		}
 	}
 
+	if (ctx == NULL) free(count);
+
 	return 1;
 }
+
+
+int vc_hsv_segmentation_foreground(IVC* src, IVC* fg, IVC* dst, int minpixels, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	return vc_hsv_segmentation_foreground_run(NULL, src, fg, dst, minpixels, hmin, hmax, smin, smax, vmin, vmax);
+}
+
+int vc_hsv_segmentation_foreground_ctx(VCCONTEXT* ctx, IVC* src, IVC* fg, IVC* dst, int minpixels, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
+{
+	double t0;
+	int ok;
+
+	if (ctx == NULL) return 0;
+
+	t0 = vc_context_enter(ctx);
+	ok = vc_hsv_segmentation_foreground_run(ctx, src, fg, dst, minpixels, hmin, hmax, smin, smax, vmin, vmax);
+	if (ok) ctx->counters.frames++;
+
+	return vc_context_leave(ctx, t0, ok);
+}
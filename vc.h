@@ -8,11 +8,19 @@
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 
+#include <stddef.h>
+
 #define VC_DEBUG
 
+// Alinhamento (em bytes) do incio de cada linha de uma imagem alocada com vc_image_new()
+#ifndef VC_ALIGNMENT
+#define VC_ALIGNMENT 64
+#endif
+
 #define MAX3(a,b,c) (a>b?(a>c?a:c) : ( b>c?b:c))
 #define MAX2(a,b) (a>b?a:b)
 #define MIN3(a,b,c) (a<b?(a<c?a:c) : ( b<c?b:c))
+#define MIN2(a,b) (a<b?a:b)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //                   ESTRUTURA DE UMA IMAGEM
@@ -24,10 +32,59 @@ typedef struct {
 	int width, height;
 	int channels;			// Binrio/Cinzentos=1; RGB=3
 	int levels;				// Binrio=1; Cinzentos [1,255]; RGB [1,255]
-	int bytesperline;		// width * channels
+	int bytesperline;		// width * channels, arredondado ao mltiplo de VC_ALIGNMENT seguinte (excepto mapeadas)
+	void* mapaddr;			// != NULL se data aponta para um ficheiro mapeado em memria (vc_read_image_mmap)
+	size_t mapsize;
 } IVC;
 
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//               ESTRUTURA DE UMA IMAGEM PLANAR
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#define VC_PLANAR_MAX_PLANES 3
+
+// Disposio planar (SoA): cada canal (ex.: H, S e V) num plano contguo de 1 canal.
+// Cada plano  uma IVC normal, pelo que pode ser passado s funes de imagens em cinzentos.
+typedef struct {
+	IVC* plane[VC_PLANAR_MAX_PLANES];
+	int width, height;
+	int nplanes;
+} IVCPLANAR;
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                ESTRUTURA DE UMA POOL DE IMAGENS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#define VC_POOL_MAX_IMAGES 64
+
+// Reutiliza imagens entre frames, evitando malloc/free por frame
+typedef struct {
+	IVC* images[VC_POOL_MAX_IMAGES];
+	int inuse[VC_POOL_MAX_IMAGES];
+	int nimages;
+} IVCPOOL;
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                 ESTRUTURA DE UMA PIRMIDE
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#define VC_PYRAMID_MAX_LEVELS 5
+
+// Modos de reduo de resoluo
+#define VC_DOWNSAMPLE_NEAREST	0	// Amostragem simples (no mistura valores, adequado a HSV)
+#define VC_DOWNSAMPLE_BOX		1	// Mdia do bloco factor x factor
+#define VC_DOWNSAMPLE_GAUSS		2	// Filtro binomial [1 2 1] seguido de decimao
+
+// level[0]  a imagem original; level[i] tem resoluo 1/(2^i)
+typedef struct {
+	IVC* level[VC_PYRAMID_MAX_LEVELS];
+	int nlevels;
+} PYRVC;
+
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //                    PROTTIPOS DE FUNES
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -36,15 +93,159 @@ typedef struct {
 IVC* vc_image_new(int width, int height, int channels, int levels);
 IVC* vc_image_free(IVC* image);
 
+// FUNES: ALOCAR E LIBERTAR UMA IMAGEM PLANAR
+IVCPLANAR* vc_planar_new(int width, int height, int nplanes, int levels);
+IVCPLANAR* vc_planar_free(IVCPLANAR* image);
+int vc_planar_split(IVC* src, IVCPLANAR* dst);
+int vc_planar_merge(IVCPLANAR* src, IVC* dst);
+
+// FUNES: POOL DE IMAGENS
+void vc_pool_init(IVCPOOL* pool);
+IVC* vc_pool_get(IVCPOOL* pool, int width, int height, int channels, int levels);
+void vc_pool_release(IVCPOOL* pool, IVC* image);
+void vc_pool_free(IVCPOOL* pool);
+
+// FUNES: PIRMIDE DE IMAGENS
+// factor = 2 ou 4; dst deve ter dimenses src / factor
+int vc_image_downsample(IVC* src, IVC* dst, int factor, int mode);
+int vc_pyramid_build(IVCPOOL* pool, IVC* src, PYRVC* pyr, int nlevels, int mode);
+void vc_pyramid_release(IVCPOOL* pool, PYRVC* pyr);
+
 // FUNES: LEITURA E ESCRITA DE IMAGENS (PBM, PGM E PPM)
 IVC* vc_read_image(char* filename);
 int vc_write_image(char* filename, IVC* image);
 
+// Leitura sem cpia (ficheiro mapeado em memria); libertar com vc_image_free().
+// A imagem  densa (bytesperline = width * channels) e data no est alinhado a VC_ALIGNMENT (comea logo a seguir
+// ao header): as funes vc_* aceitam-na, mas no contar com linhas alinhadas nem com o padding de vc_image_new().
+IVC* vc_read_image_mmap(char* filename);
+
+// FUNES: SEQUNCIAS DE IMAGENS (PBM, PGM E PPM concatenados num s ficheiro), com I/O assncrono
+typedef struct vc_stream VCSTREAM;
+VCSTREAM* vc_stream_open_read(char* filename);
+VCSTREAM* vc_stream_open_write(char* filename);
+IVC* vc_stream_read(VCSTREAM* stream);
+int vc_stream_write(VCSTREAM* stream, IVC* image);
+int vc_stream_close(VCSTREAM* stream);
+
+// FUNES: LEITURA ANTECIPADA DE FRAMES (uma thread descodifica e converte as frames seguintes
+// para um anel de imagens, enquanto a thread que chama processa a actual)
+#define VC_PREFETCH_BGR	1		// decode() escreve BGR (ex.: OpenCV): convertido para RGB na thread de descodificao
+#define VC_PREFETCH_HSV	2		// Calcula tambm a frame em HSV na thread de descodificao
+
+typedef struct vc_prefetch VCPREFETCH;
+
+typedef struct {
+	int number;					// Ordem da frame na fonte (0, 1, ...)
+	IVC* rgb;
+	IVC* hsv;					// NULL sem VC_PREFETCH_HSV
+} VCFRAME;
+
+// Escreve a frame seguinte em image (3 canais); devolve 1, 0 no fim da fonte ou -1 em caso de erro
+typedef int (*VCDECODE)(void* arg, IVC* image);
+
+VCPREFETCH* vc_prefetch_open(int width, int height, int depth, int flags, VCDECODE decode, void* arg);
+VCFRAME* vc_prefetch_read(VCPREFETCH* pf);
+double vc_prefetch_wait_ms(VCPREFETCH* pf);
+int vc_prefetch_close(VCPREFETCH* pf);
+
+
+// FUNES: CONTEXTO DE PROCESSAMENTO
+// Rene o estado reutilizado entre chamadas: pool de imagens, threads de trabalho persistentes, memria de
+// trabalho por thread, tabelas de etiquetas e contadores. As funes com sufixo _ctx so as verses das
+// funes da biblioteca que usam este estado em vez de alocar memria ou criar threads em cada chamada.
+// Cada contexto  usado por uma thread de cada vez; contextos diferentes podem correr em paralelo.
+typedef struct vc_context VCCONTEXT;
+
+typedef struct {
+	long long calls;			// Chamadas a funes _ctx
+	double ms;					// Tempo total nessas chamadas
+	long long frames;			// Frames processadas (segmentao tiled, coarse-to-fine e em lote)
+	long long blobs;			// Blobs encontrados pela etiquetagem
+	long long jobs;				// Jobs entregues s threads do contexto
+	long long tasks;			// Tarefas executadas pelo escalonador com roubo de trabalho
+	long long images;			// Imagens alocadas pela pool do contexto (as restantes foram reutilizadas)
+} VCCOUNTERS;
+
+// Um job recebe o argumento, o ndice do trabalho e o ndice da thread (0 = a que chama)
+typedef int (*VCJOB)(void* arg, int index, int thread);
+
+// nthreads <= 0: uma thread por processador (incluindo a que chama)
+VCCONTEXT* vc_context_new(int nthreads);
+VCCONTEXT* vc_context_free(VCCONTEXT* ctx);
+int vc_context_nthreads(VCCONTEXT* ctx);
+int vc_context_parallel_for(VCCONTEXT* ctx, int n, VCJOB job, void* arg);
+// Tarefas com deques por thread e roubo de trabalho; os ndices devem ir por ordem crescente de custo (as maiores,
+// no fim, so as primeiras a correr e a ser roubadas); vc_context_spawn() s dentro de uma tarefa
+int vc_context_tasks(VCCONTEXT* ctx, int n, VCJOB job, void* arg);
+int vc_context_spawn(VCCONTEXT* ctx, int thread, VCJOB job, void* arg, int index);
+void* vc_context_scratch(VCCONTEXT* ctx, int thread, size_t size);
+IVC* vc_context_image_get(VCCONTEXT* ctx, int width, int height, int channels, int levels);
+void vc_context_image_release(VCCONTEXT* ctx, IVC* image);
+const VCCOUNTERS* vc_context_counters(VCCONTEXT* ctx);
+void vc_context_counters_reset(VCCONTEXT* ctx);
+void vc_context_timer_start(VCCONTEXT* ctx);
+double vc_context_timer_elapsed(VCCONTEXT* ctx);
+
+
+// FUNES: PROCESSAMENTO DE VRIAS STREAMS (vrias fontes de vdeo num processo, com threads partilhadas)
+// Um produtor por stream: vc_multistream_acquire() -> preencher a imagem -> vc_multistream_submit().
+// Uma fila central (um mutex) com um anel de frames por stream; cada thread prefere a sua stream, mas serve
+// a stream com menos tempo de CPU acumulado quando a sua est vazia ou j vai  frente (no h deques por thread
+// nem roubo de trabalho). Cada stream recebe as suas frames processadas por ordem em done().
+typedef struct vc_multistream VCMULTISTREAM;
+
+typedef struct {
+	long long frames;			// Frames entregues
+	long long failed;			// Frames em que process() devolveu 0
+	double fps;					// Frames entregues por segundo, desde a primeira submisso
+	double latency;				// Latncia mdia submisso -> entrega (ms)
+	double latency_max;			// (ms)
+	double busy;				// Tempo de processamento acumulado (ms)
+	int pending;				// Frames submetidas e ainda no entregues
+} VCSTREAMSTATS;
+
+// Corre numa thread de trabalho, com o contexto (de uma thread) dessa thread
+typedef int (*VCFRAMEPROC)(void* arg, VCCONTEXT* ctx, int stream, int frame, IVC* image);
+// Chamada por ordem de frame em cada stream; depois de regressar, a imagem volta ao anel da stream
+typedef void (*VCFRAMEDONE)(void* arg, int stream, int frame, IVC* image, int ok);
+
+VCMULTISTREAM* vc_multistream_new(int nstreams, int nthreads, int depth, VCFRAMEPROC process, VCFRAMEDONE done, void* arg);
+VCMULTISTREAM* vc_multistream_free(VCMULTISTREAM* ms);
+IVC* vc_multistream_acquire(VCMULTISTREAM* ms, int stream, int width, int height, int channels);
+int vc_multistream_submit(VCMULTISTREAM* ms, int stream, IVC* image);
+int vc_multistream_wait(VCMULTISTREAM* ms);
+int vc_multistream_stats(VCMULTISTREAM* ms, int stream, VCSTREAMSTATS* stats);
+
+
+// FUNES: PROCESSAMENTO EM LOTE (para reprocessamento offline: paralelo entre frames, no entre linhas)
+// Uma etapa recebe a frame de entrada, a de sada e um parmetro; devolve 1 se correu bem
+typedef int (*VCSTAGE)(IVC* src, IVC* dst, void* param);
+// nthreads <= 0: uma thread por processador
+int vc_batch_run(IVC** src, IVC** dst, int nframes, VCSTAGE stage, void* param, int nthreads);
+int vc_batch_hsv_segmentation(IVCPOOL* pool, IVC** frames, IVC** masks, int nframes, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int nthreads);
+int vc_batch_hsv_segmentation_ctx(VCCONTEXT* ctx, IVC** frames, IVC** masks, int nframes, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel);
+
+
+// FUNES: DESPACHO EM RUNTIME PELAS CAPACIDADES DO CPU
+// Converso HSV, segmentao planar, threshold, morfologia e Sobel/Prewitt usam as verses do nvel em uso.
+// Por omisso  o melhor nvel suportado; a varivel de ambiente VC_CPU (scalar, sse2, avx2, avx512)
+// ou vc_cpu_set_tier() foram um nvel inferior (til para benchmarks e depurao).
+#define VC_CPU_SCALAR	0	// C portvel
+#define VC_CPU_SSE2		1	// 128 bits (qualquer x86-64, incluindo mquinas s com SSE4.2)
+#define VC_CPU_AVX2		2	// 256 bits
+#define VC_CPU_AVX512	3	// 512 bits (AVX-512F + AVX-512BW)
+int vc_cpu_detect(void);
+int vc_cpu_tier(void);
+int vc_cpu_set_tier(int tier);
+const char* vc_cpu_tier_name(int tier);
+
 
 //FUNES: ESPAOS DE COR
 int vc_gray_negative(IVC* srcdst);
 int vc_rbg_negative(IVC* srcdst);
 
+int vc_bgr_to_rgb(IVC* src, IVC* dst);
 int vc_rgb_to_gray(IVC* src, IVC* dst);
 
 
@@ -54,6 +255,10 @@ int vc_rgb_to_hsv(IVC* src, IVC* dst);
 // hmin,hmax = [0, 360]; smin,smax = [0, 100]; vmin,vmax = [0, 100]
 int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
 
+// Verses planares: H, S e V em planos separados, com os mesmos valores de vc_rgb_to_hsv()
+int vc_rgb_to_hsv_planar(IVC* src, IVCPLANAR* dst);
+int vc_hsv_segmentation_planar(IVCPLANAR* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+
 //ivc src imagem de um canal
 int vc_scale_gray_to_color_palette(IVC* src, IVC* dst);
 
@@ -61,8 +266,15 @@ int vc_scale_gray_to_color_palette(IVC* src, IVC* dst);
 //Segmentacao de imagem
 int vc_gray_to_binary(IVC* src, IVC* dst, int threshold);
 int vc_gray_to_binary_global_mean(IVC* src, IVC* dst);
+int vc_gray_to_binary_otsu(IVC* src, IVC* dst);
 int vc_gray_to_binary_midpoint(IVC* src, IVC* dst, int kernel);
 
+// Threshold adaptativo sobre imagem integral / janelas deslizantes (custo por pixel independente de kernel)
+#define VC_THRESHOLD_MEAN		0	// Bradley: mdia local
+#define VC_THRESHOLD_SAUVOLA	1	// Sauvola: mdia e desvio padro locais
+#define VC_THRESHOLD_MIDPOINT	2	// (min + max) / 2 local
+int vc_gray_to_binary_adaptive(IVC* src, IVC* dst, int kernel, int mode, float k);
+
 //Operadores Morfologicos
 int vc_binary_dilate(IVC* src, IVC* dst, int kernel);
 int vc_binary_erode(IVC* src, IVC* dst, int kernel);
@@ -70,6 +282,12 @@ int vc_binary_erode(IVC* src, IVC* dst, int kernel);
 int vc_binary_open(IVC* src, IVC* dst, int kernel);
 int vc_binary_close(IVC* src, IVC* dst, int kernel);
 
+// Verses com contexto (sem alocaes por chamada); open e close devolvem o resultado em dst
+int vc_binary_erode_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel);
+int vc_binary_dilate_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel);
+int vc_binary_open_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel);
+int vc_binary_close_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int kernel);
+
 
 // Blobs e Etiquetagem
 //int vc_binary_blob_labelling(IVC* src, IVC* dst);
@@ -93,14 +311,137 @@ typedef struct {
 
 OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels);
 int vc_binary_blob_info(IVC* src, OVC* blobs, int nblobs);
+// Verso com contexto: o array de blobs pertence ao contexto (no libertar) e  vlido at  chamada seguinte
+OVC* vc_binary_blob_labelling_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int* nlabels);
+// Trabalho por blob, depois da etiquetagem: recebe a imagem de etiquetas e o blob (j com rea, caixa,
+// centro e permetro); thread identifica a thread do contexto (ex.: para vc_context_scratch())
+typedef int (*VCBLOBTASK)(void* arg, IVC* labels, OVC* blob, int thread);
+// Igual a vc_binary_blob_info(), com uma tarefa por blob nas threads do contexto (roubo de trabalho);
+// task (opcional) corre no fim de cada tarefa
+int vc_binary_blob_tasks(VCCONTEXT* ctx, IVC* labels, OVC* blobs, int nblobs, VCBLOBTASK task, void* arg);
+
+// Contorno exterior de um blob em cdigos de cadeia de Freeman (vizinhana 8, y cresce para baixo):
+// 3 2 1
+// 4 P 0
+// 5 6 7
+typedef struct {
+	int x, y;					// Pixel inicial: o primeiro do blob na linha de cima da caixa delimitadora
+	int length;					// Nmero de cdigos (0 num blob de um s pixel)
+	unsigned char* codes;
+	int capacity;				// Espao alocado em codes (reutilizado entre chamadas)
+	float perimeter;			// Comprimento do contorno: 1 por passo horizontal ou vertical, raiz de 2 por passo diagonal
+} CHAINVC;
+
+// labels: imagem de etiquetas; blob: com a caixa delimitadora j calculada (vc_binary_blob_info() ou _tasks()).
+// chain deve comear a zeros; libertar com vc_chain_free().
+int vc_binary_blob_contour(IVC* labels, OVC* blob, CHAINVC* chain);
+void vc_chain_free(CHAINVC* chain);
+
+// Distncia de cada pixel do objecto ao fundo (chamfer 3-4, em pixis, saturada a 255)
+int vc_binary_distance_transform(IVC* src, IVC* dst);
+// Etiquetagem que separa blobs que se tocam (watershed da transformada de distncia a partir dos seus mximos);
+// depth: profundidade mnima, em pixis, do estrangulamento entre dois objectos. Completar com vc_binary_blob_info().
+OVC* vc_binary_blob_watershed(IVC* src, IVC* dst, int depth, int* nlabels);
+OVC* vc_binary_blob_watershed_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int depth, int* nlabels);
+
+// Segmentao HSV em duas fases: segmenta e etiqueta a 1/factor da resoluo
+// e s refina  resoluo original dentro das caixas dos blobs candidatos.
+// Os pixis fora das caixas ficam a 0 em dst. Se a etiquetagem reduzida falhar (mais de 254 blobs),
+// a segmentao  feita  resoluo original.
+int vc_hsv_segmentation_coarse_to_fine(IVCPOOL* pool, IVC* src, IVC* dst, int factor, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+int vc_hsv_segmentation_coarse_to_fine_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int factor, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+
+// Executor por faixas de linhas (cache-blocked) da cadeia RGB -> HSV -> segmentao -> abertura (kernel > 1),
+// com linhas de halo para a morfologia. Resultado igual ao da cadeia sobre a imagem inteira.
+// bandrows <= 0: faixas com cerca de VC_TILE_CACHE_BYTES de intermdios
+#ifndef VC_TILE_CACHE_BYTES
+#define VC_TILE_CACHE_BYTES (512 * 1024)
+#endif
+int vc_hsv_segmentation_tiled(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int bandrows);
+int vc_hsv_segmentation_tiled_ctx(VCCONTEXT* ctx, IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax, int kernel, int bandrows);
+
+// Registo binrio (append-only) dos blobs de cada frame, com ndice frame -> offset para acesso em O(1)
+typedef struct vc_bloblog VCBLOBLOG;
+VCBLOBLOG* vc_bloblog_create(char* filename);
+int vc_bloblog_append(VCBLOBLOG* log, int frame, OVC* blobs, int nblobs);
+VCBLOBLOG* vc_bloblog_open(char* filename);
+int vc_bloblog_nframes(VCBLOBLOG* log);
+// Devolve 0 s em caso de erro; uma frame sem blobs d 1, com nblobs = 0 e blobs = NULL
+int vc_bloblog_read(VCBLOBLOG* log, int index, int* frame, OVC** blobs, int* nblobs);
+int vc_bloblog_close(VCBLOBLOG* log);
 
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //                    HISTOGRAMA DE UMA IMAGEM
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+int vc_gray_histogram(IVC* src, int hist[256]);
+int vc_histogram_mean(const int hist[256]);
+int vc_histogram_otsu(const int hist[256]);
+int vc_histogram_equalization_lut(const int hist[256], unsigned char lut[256]);
+int vc_gray_lut_apply(IVC* src, IVC* dst, const unsigned char lut[256]);
+
 int vc_gray_histogram_equalization(IVC* src, IVC* dst);
 
+// Estado da equalizao de histograma em modo vdeo
+typedef struct {
+	float hist[256];			// Histograma normalizado, suavizado entre frames
+	float lut_hist[256];		// Histograma que originou a LUT actual
+	unsigned char lut[256];		// LUT em uso
+	float alpha;				// Peso da frame actual na mdia exponencial
+	int step;					// Subamostragem da grelha de pixis
+	float drift;				// Distncia L1 a partir da qual a LUT  recalculada
+	int initialized;
+	int nupdates;				// Nmero de vezes que a LUT foi recalculada
+} EQVC;
+
+void vc_equalization_stream_init(EQVC* eq, float alpha, int step, float drift);
+int vc_gray_histogram_equalization_stream(EQVC* eq, IVC* src, IVC* dst);
+
 
 int vc_gray_edge_prewitt(IVC* src, IVC* dst, float th);
 
-int vc_gray_edge_sobel(IVC* src, IVC* dst, float th);
\ No newline at end of file
+int vc_gray_edge_sobel(IVC* src, IVC* dst, float th);
+
+// Verses com sadas opcionais (NULL para ignorar): magnitude do gradiente (saturada a 255)
+// e direco (ngulo [0, 360[ quantizado em [0, 255]). Os rebordos ficam a 0.
+int vc_gray_edge_prewitt_ex(IVC* src, IVC* dst, float th, IVC* magnitude, IVC* direction);
+int vc_gray_edge_sobel_ex(IVC* src, IVC* dst, float th, IVC* magnitude, IVC* direction);
+
+
+// Deteco de crculos (moedas) pela transformada de Hough com votao na direco do gradiente de Sobel,
+// limitada s caixas delimitadoras dos blobs; um blob de vrias moedas que se tocam d um crculo por moeda
+typedef struct {
+	int x, y;					// Centro
+	int r;						// Raio
+	int votes;					// Pixis de contorno que suportam o crculo
+	int label;					// Etiqueta do blob onde foi encontrado
+} CIRCLEVC;
+
+int vc_gray_hough_circles(VCCONTEXT* ctx, IVC* gray, OVC* blobs, int nblobs, int rmin, int rmax, float th, float minsupport, CIRCLEVC* circles, int maxcircles, int* ncircles);
+
+
+// Modelo de fundo (cena esttica, ex.: tapete transportador) e mscara do primeiro plano por diferena absoluta.
+// O modelo e o histrico so imagens de uma pool prpria, alocadas na criao.
+// vc_background_update() com a mscara do primeiro plano: esses pixis no ficam parados (seno um objecto
+// presente na primeira frame, ou uma mudana de iluminao, seriam primeiro plano para sempre):
+// na mdia so actualizados 2^VC_BACKGROUND_MASKED_SHIFT vezes mais devagar (no mximo a 2^-12 por frame);
+// na mediana a mscara  ignorada numa em cada VC_BACKGROUND_REFRESH actualizaes.
+#define VC_BACKGROUND_AVERAGE		0		// Mdia mvel: fundo += (frame - fundo) / 2^param, param em [0, 8]
+#define VC_BACKGROUND_MEDIAN		1		// Mediana das ltimas param frames, param em [1, VC_BACKGROUND_MAX_FRAMES]
+#define VC_BACKGROUND_MAX_FRAMES	15
+#define VC_BACKGROUND_MASKED_SHIFT	4
+#define VC_BACKGROUND_REFRESH		32
+#define VC_FOREGROUND_TILE			16		// Lado dos blocos de vc_hsv_segmentation_foreground()
+
+typedef struct vc_background VCBACKGROUND;
+
+VCBACKGROUND* vc_background_new(int width, int height, int channels, int mode, int param);
+// mask (opcional): pixis de primeiro plano (255), actualizados mais devagar (ver acima)
+int vc_background_update(VCBACKGROUND* bg, IVC* frame, IVC* mask);
+int vc_background_foreground(VCBACKGROUND* bg, IVC* frame, IVC* dst, int threshold);
+IVC* vc_background_image(VCBACKGROUND* bg);
+VCBACKGROUND* vc_background_free(VCBACKGROUND* bg);
+// Segmentao HSV s nos blocos com pelo menos minpixels pixis de primeiro plano (e nos seus vizinhos);
+// o resto de dst fica a 0
+int vc_hsv_segmentation_foreground(IVC* src, IVC* fg, IVC* dst, int minpixels, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+int vc_hsv_segmentation_foreground_ctx(VCCONTEXT* ctx, IVC* src, IVC* fg, IVC* dst, int minpixels, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
\ No newline at end of file
@@ -0,0 +1,92 @@
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//           INSTITUTO POLITCNICO DO CVADO E DO AVE
+//                          2022/2023
+//             ENGENHARIA DE SISTEMAS INFORMTICOS
+//                    VISO POR COMPUTADOR
+//
+//             [  DUARTE DUQUE - dduque@ipca.pt  ]
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Camada C++ fina sobre a biblioteca vc: posse (RAII) de imagens e contextos. O processamento  feito
+// directamente pelas funes vc_* (com as verses SIMD escolhidas em runtime), s quais vc::image e
+// vc::context se passam como IVC* e VCCONTEXT*.
+//
+//   vc::context ctx(0);                       // vc_context_free() no fim do bloco
+//   vc::image mask(width, height, 1);         // vc_image_free() no fim do bloco
+//   vc_binary_erode_ctx(ctx, src, mask, 5);
+
+#pragma once
+
+#include <utility>
+
+extern "C" {
+#include "vc.h"
+}
+
+namespace vc {
+
+// Imagem IVC com dono nico: libertada com vc_image_free() na destruio; pode ser movida, no copiada.
+// Converte-se implicitamente em IVC*, pelo que serve directamente s funes vc_*.
+class image {
+public:
+	image() = default;
+	image(int width, int height, int channels, int levels = 255) : p_(vc_image_new(width, height, channels, levels)) {}
+	explicit image(IVC* owned) : p_(owned) {}
+	~image() { vc_image_free(p_); }
+
+	image(const image&) = delete;
+	image& operator=(const image&) = delete;
+	image(image&& other) noexcept : p_(other.p_) { other.p_ = nullptr; }
+	image& operator=(image&& other) noexcept
+	{
+		if (this != &other) {
+			vc_image_free(p_);
+			p_ = other.p_;
+			other.p_ = nullptr;
+		}
+		return *this;
+	}
+
+	IVC* get() const { return p_; }
+	operator IVC*() const { return p_; }
+	explicit operator bool() const { return p_ != nullptr; }
+	IVC* operator->() const { return p_; }
+
+	// Deixa de ser dono da imagem (a libertar pelo chamador)
+	IVC* release() { return std::exchange(p_, nullptr); }
+
+	// Incio da linha y (as linhas tm bytesperline bytes, com enchimento)
+	unsigned char* row(int y) const { return &p_->data[y * p_->bytesperline]; }
+
+private:
+	IVC* p_ = nullptr;
+};
+
+// Contexto de processamento com dono nico (vc_context_free() na destruio)
+class context {
+public:
+	explicit context(int nthreads = 0) : p_(vc_context_new(nthreads)) {}
+	~context() { vc_context_free(p_); }
+
+	context(const context&) = delete;
+	context& operator=(const context&) = delete;
+	context(context&& other) noexcept : p_(other.p_) { other.p_ = nullptr; }
+	context& operator=(context&& other) noexcept
+	{
+		if (this != &other) {
+			vc_context_free(p_);
+			p_ = other.p_;
+			other.p_ = nullptr;
+		}
+		return *this;
+	}
+
+	VCCONTEXT* get() const { return p_; }
+	operator VCCONTEXT*() const { return p_; }
+	explicit operator bool() const { return p_ != nullptr; }
+
+private:
+	VCCONTEXT* p_ = nullptr;
+};
+
+} // namespace vc